@@ -0,0 +1,710 @@
+#include "A2SoftRenderer.h"
+#include <algorithm>
+
+// The constants below are copies of the ones in the shaders, keep them in sync
+
+// Legacy: colors for monitor color types
+static const float legacyMonitorColors[5][4] = {
+	{ 0.000000f,	0.000000f,	0.000000f,	1.000000f },	/*BLACK, -- this is a color monitor */
+	{ 1.000000f,	1.000000f,	1.000000f,	1.000000f },	/*WHITE PHOSPHOR,*/
+	{ 0.000000f,	1.000000f,	0.290196f,	1.000000f },	/*GREEN PHOSPHOR,*/
+	{ 1.000000f,	0.717647f,	0.000000f,	1.000000f },	/*AMBER PHOSPHOR,*/
+	{ 1.000000f,	0.000000f,	0.500000f,	1.000000f },	/*PINK, -- this option shouldn't exist */
+};
+
+// Legacy: colors for foreground, background and border
+static const float tintColors[16][4] = {
+	{ 0.000000f,	0.000000f,	0.000000f,	1.000000f },	/*BLACK,*/
+	{ 0.674510f,	0.070588f,	0.298039f,	1.000000f },	/*DEEP_RED,*/
+	{ 0.000000f,	0.027451f,	0.513725f,	1.000000f },	/*DARK_BLUE,*/
+	{ 0.666667f,	0.101961f,	0.819608f,	1.000000f },	/*MAGENTA,*/
+	{ 0.000000f,	0.513725f,	0.184314f,	1.000000f },	/*DARK_GREEN,*/
+	{ 0.623529f,	0.592157f,	0.494118f,	1.000000f },	/*DARK_GRAY,*/
+	{ 0.000000f,	0.541176f,	0.709804f,	1.000000f },	/*BLUE,*/
+	{ 0.623529f,	0.619608f,	1.000000f,	1.000000f },	/*LIGHT_BLUE,*/
+	{ 0.478431f,	0.372549f,	0.000000f,	1.000000f },	/*BROWN,*/
+	{ 1.000000f,	0.447059f,	0.278431f,	1.000000f },	/*ORANGE,*/
+	{ 0.470588f,	0.407843f,	0.498039f,	1.000000f },	/*LIGHT_GRAY,*/
+	{ 1.000000f,	0.478431f,	0.811765f,	1.000000f },	/*PINK,*/
+	{ 0.435294f,	0.901961f,	0.172549f,	1.000000f },	/*GREEN,*/
+	{ 1.000000f,	0.964706f,	0.482353f,	1.000000f },	/*YELLOW,*/
+	{ 0.423529f,	0.933333f,	0.698039f,	1.000000f },	/*AQUA,*/
+	{ 1.000000f,	1.000000f,	1.000000f,	1.000000f },	/*WHITE,*/
+};
+
+// SHR: colors for monitor color types
+static const float shrMonitorColors[5][4] = {
+	{ 0.000000f,	0.000000f,	0.000000f,	1.000000f },	/*BLACK, -- this is a color monitor */
+	{ 1.000000f,	1.000000f,	1.000000f,	1.000000f },	/*WHITE PHOSPHOR,*/
+	{ 0.290196f,	1.000000f,	0.000000f,	1.000000f },	/*GREEN PHOSPHOR,*/
+	{ 1.000000f,	0.717647f,	0.000000f,	1.000000f },	/*AMBER PHOSPHOR,*/
+	{ 1.000000f,	0.000000f,	0.500000f,	1.000000f },	/*PINK, -- this option shouldn't exist */
+};
+
+// SHR: border colors
+static const float shrBorderColors[16][4] = {
+	{ 0.00f, 0.00f, 0.00f, 1.0f },	// BLACK
+	{ 0.67f, 0.07f, 0.30f, 1.0f },	// DEEP_RED
+	{ 0.00f, 0.03f, 0.51f, 1.0f },	// DARK_BLUE
+	{ 0.67f, 0.10f, 0.82f, 1.0f },	// MAGENTA
+	{ 0.00f, 0.51f, 0.18f, 1.0f },	// DARK_GREEN
+	{ 0.62f, 0.59f, 0.49f, 1.0f },	// DARK_GRAY
+	{ 0.00f, 0.54f, 0.71f, 1.0f },	// BLUE
+	{ 0.62f, 0.62f, 1.00f, 1.0f },	// LIGHT_BLUE
+	{ 0.48f, 0.37f, 0.00f, 1.0f },	// BROWN
+	{ 1.00f, 0.45f, 0.28f, 1.0f },	// ORANGE
+	{ 0.47f, 0.41f, 0.49f, 1.0f },	// LIGHT_GRAY
+	{ 1.00f, 0.48f, 0.81f, 1.0f },	// PINK
+	{ 0.43f, 0.90f, 0.17f, 1.0f },	// GREEN
+	{ 1.00f, 0.96f, 0.48f, 1.0f },	// YELLOW
+	{ 0.42f, 0.93f, 0.70f, 1.0f },	// AQUA
+	{ 1.00f, 1.00f, 1.00f, 1.0f },	// WHITE
+};
+
+// SHR 640 mode palette indexes, reversed like the fragment offset
+static const uint32_t palette640[16] = {
+	4,5,6,7,
+	0,1,2,3,
+	12,13,14,15,
+	8,9,10,11
+};
+
+// RGGB linear filters, all scaled by 8. Indexed [column][row] like the shader's mat4
+static const float matGFilter[4][4] = {		// G at any location
+	{ -1, 0, 2, 0 },
+	{ -1, 2, 4, 2 },
+	{ -1, 0, 2, 0 },
+	{ -1, 0, 0, 0 }
+};
+static const float matXGFilter[4][4] = {	// R or B at green locations in their own color rows
+	{ 0.5f,-1, 0,-1 },
+	{ -1,  4, 5, 4 },
+	{ -1, -1, 0,-1 },
+	{ 0.5f, 0, 0, 0 }
+};
+static const float matXGXFilter[4][4] = {	// R or B at green locations in the other color rows
+	{ -1, -1, 4,-1 },
+	{ 0.5f, 0, 5, 0 },
+	{ 0.5f,-1, 4,-1 },
+	{ -1,  0, 0, 0 }
+};
+static const float matRBFilter[4][4] = {	// R at B or B at R
+	{ -1.5f, 2, 0, 2 },
+	{ -1.5f, 0, 6, 0 },
+	{ -1.5f, 2, 0, 2 },
+	{ -1.5f, 0, 0, 0 }
+};
+
+static float apply_filter(const float filterMatrix[4][4], const float colors[4][4])
+{
+	float colorComponent = 0.f;
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			colorComponent += colors[i][j] * filterMatrix[i][j];
+	return colorComponent;
+}
+
+// Perform left rotation on a 4-bit nibble (for DLGR AUX memory)
+static inline uint32_t rol_nib(uint32_t x)
+{
+	return ((x << 1) & 0xFu) | ((x >> 3) & 0x1u);
+}
+
+static inline uint8_t to_unorm8(float v)
+{
+	return (uint8_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+A2SoftRenderer::Color A2SoftRenderer::FetchModeTexel(ModeTexture_e idx, int x, int y) const
+{
+	// Nearest filtering on texel centers with GL_CLAMP_TO_EDGE, like the GL mode textures
+	const A2SoftTexture& tex = modeTextures[idx];
+	if (tex.data == nullptr || tex.width == 0 || tex.height == 0)
+		return { 0.f, 0.f, 0.f, 0.f };
+	x = std::clamp(x, 0, (int)tex.width - 1);
+	y = std::clamp(y, 0, (int)tex.height - 1);
+	const uint8_t* p = tex.data + ((size_t)y * tex.width + x) * 4;
+	return { p[0] / 255.f, p[1] / 255.f, p[2] / 255.f, p[3] / 255.f };
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Legacy
+//////////////////////////////////////////////////////////////////////////
+
+A2SoftRenderer::Color A2SoftRenderer::LegacyFragment(const uint8_t* vram, uint32_t x, uint32_t y) const
+{
+	const uint32_t vramWidth = 40 + 2 * hborder;
+	const uint32_t vramRows = (192 + 2 * vborder) * 2;
+	const uint32_t pagingOffset = (pagingMode == 0 ? 0 : 1) * (192 + 2 * vborder);
+	auto monoColor = [](int type) {
+		const float* c = legacyMonitorColors[type];
+		return Color{ c[0], c[1], c[2], c[3] };
+	};
+
+	// Shift based on paging mode
+	if (pagingMode == 1)		// the offset is used for odd lines (*2 because lines are doubled)
+		y += pagingOffset * 2 * (y & 1u);
+	if (pagingMode == 2)		// the offset is used for odd frames
+		y += pagingOffset * 2 * (uint32_t)frameIsOdd;
+	if ((y / 2) >= vramRows)
+		return { 0.f, 0.f, 0.f, 0.f };
+
+	const uint8_t* rowPtr = vram + (size_t)(y / 2) * vramWidth * 4;
+	const uint32_t xCol = x / 14;
+	const uint8_t* texel = rowPtr + xCol * 4;
+	uint32_t fragOffsetX = x % 14;
+	uint32_t fragOffsetY = y % 16;
+	const int xColNoBorder = (int)xCol - (int)hborder;
+
+	uint32_t a2mode = texel[2] & 7u;
+	switch (a2mode) {
+		case 0:		// TEXT
+		case 1:		// DTEXT
+		{
+			// In TEXT mode all 14 dots are from MAIN. In DTEXT mode the first 7 dots are AUX, last 7 are MAIN.
+			uint32_t charVal = (a2mode == 0 ? texel[0] : (fragOffsetX / 7 ? texel[0] : texel[1]));
+			uint32_t isAlt = ((texel[2] >> 3) & 1u);
+			// Inverse below 0x40, flashing below 0x80 when not inverse, but only in the regular charset
+			bool isInverse = charVal < 0x40;
+			bool isFlashing = (charVal < 0x80) && !isInverse && !isAlt && (((ticks / 310) % 2) != 0);
+			uint32_t charOriginX = (charVal & 0xFu) * 14;
+			uint32_t charOriginY = (charVal >> 4) * 16;
+			// In DTEXT, 0-6 is in one glyph and 7-13 is in another, both using the even pixels only
+			if (a2mode == 1)
+				fragOffsetX = (fragOffsetX >= 7 ? fragOffsetX - 7 : fragOffsetX) * 2;
+			Color tex = FetchModeTexel(isAlt ? MODETEX_FONT_ALTERNATE : MODETEX_FONT_REGULAR,
+				charOriginX + fragOffsetX, charOriginY + fragOffsetY);
+			if (isFlashing)
+				tex = { 1.f - tex.r, 1.f - tex.g, 1.f - tex.b, 1.f - tex.a };
+
+			Color c;
+			if (monitorColorType > 0)
+			{
+				if ((tex.r + tex.g + tex.b) > 0.f)	// phosphor color (dot is on)
+					c = monoColor(monitorColorType);
+				else								// black (dot is off)
+					c = monoColor(0);
+			} else {
+				// Color monitor, with the tint coloring that the 2gs can do
+				const float* fg = tintColors[(texel[3] & 0xF0u) >> 4];
+				const float* bg = tintColors[texel[3] & 0x0Fu];
+				c.r = tex.r * fg[0] + (1.f - tex.r) * bg[0];
+				c.g = tex.g * fg[1] + (1.f - tex.g) * bg[1];
+				c.b = tex.b * fg[2] + (1.f - tex.b) * bg[2];
+			}
+			c.a = 0.9f;		// to make the NTSC pass know it's mono
+			return c;
+		}
+		case 2:		// LGR
+		case 3:		// DLGR
+		{
+			// The low nibble is the color of the top half of the 14x16 dot square,
+			// the high nibble is the color of the bottom half.
+			// In DLGR the first 7 dots are AUX, with each nibble rotated left.
+			uint32_t byteVal = texel[0];
+			if ((a2mode == 3) && (fragOffsetX < 7))
+				byteVal = (rol_nib(texel[1] >> 4) << 4) | rol_nib(texel[1] & 0xFu);
+			uint32_t byteOriginY = ((fragOffsetY / 8) ? (byteVal >> 4) : (byteVal & 0xFu)) * 16;
+			// if we're in DLGR, get every other column
+			Color c = FetchModeTexel(MODETEX_LGR, fragOffsetX * (1 + (a2mode - 2)), byteOriginY + fragOffsetY);
+			if (monitorColorType > 0)	// monitor is monochrome
+			{
+				if ((c.r + c.g + c.b) > 0.f)
+					c = monoColor(monitorColorType);
+				else
+					c = monoColor(0);
+				c.a = 0.9f;
+			}
+			return c;
+		}
+		case 4:		// HGR
+		{
+			if (monitorColorType > 0)		// Special monochrome version
+			{
+				uint32_t xFragPos = x - hborder * 14;
+				Color c = { 0.f, 0.f, 0.f, 0.f };
+				if (texel[0] & (1u << ((xFragPos % 14u) / 2u)))
+					c = monoColor(monitorColorType);
+				c.a = 0.9f;
+				return c;
+			}
+			uint32_t byteValPrev = 0;
+			uint32_t byteValNext = 0;
+			if (xColNoBorder > 0)		// Not at start of row, byteValPrev is valid
+				byteValPrev = texel[-4];
+			if (xColNoBorder < 39)		// Not at end of row, byteValNext is valid
+				byteValNext = texel[4];
+
+			// the column offset in the HGR lookup texture
+			int texXOffset = ((int)((byteValPrev & 0xE0u) << 2) | (int)((byteValNext & 0x03u) << 5)) + (xColNoBorder & 1) * 16;
+
+			if ((specialModesMask & 0x6) > 0)	// HGRSPEC1 or HGRSPEC2
+			{
+				// Recreate the bit pattern around the dot, reversed: n1 n0 c6 .. c0 p6 p5
+				uint32_t bitStream = ((byteValNext & 0x3u) << 9) | ((texel[0] & 0x7Fu) << 2) | ((byteValPrev & 0x7Fu) >> 5);
+				uint32_t bankShift = texel[0] >> 7;
+				// When the shift underflows, the shader's bitStream shift is out of range and the GPUs return 0
+				uint32_t fiveCenteredBits = 0;
+				if (fragOffsetX >= bankShift)
+					fiveCenteredBits = (bitStream >> ((fragOffsetX - bankShift) / 2u)) & 0x1Fu;
+				if (((specialModesMask & 0x2) > 0) && (fiveCenteredBits == 0x1Bu))	// SPEC1: 11011 is black
+					return { 0.f, 0.f, 0.f, 1.f };
+				if (((specialModesMask & 0x4) > 0) && (fiveCenteredBits == 0x4u))	// SPEC2: 00100 is white
+					return { 1.f, 1.f, 1.f, 1.f };
+			}
+			return FetchModeTexel(MODETEX_HGR, texXOffset + (int)fragOffsetX, texel[0]);
+		}
+		case 5:		// DHGR
+		{
+			if (monitorColorType > 0)		// Special monochrome version (basically DHGRMONO)
+			{
+				uint32_t xFragPos = x - hborder * 14;
+				Color c = { 0.f, 0.f, 0.f, 0.f };
+				if ((((uint32_t)texel[0] << 7) | (texel[1] & 0x7Fu)) & (1u << (xFragPos % 14u)))
+					c = monoColor(monitorColorType);
+				c.a = 0.9f;
+				return c;
+			}
+			// We need a previous MAIN byte and a subsequent AUX byte to calculate the colors
+			uint32_t byteVal1 = 0;			// MAIN
+			uint32_t byteVal2 = texel[1];	// AUX
+			uint32_t byteVal3 = texel[0];	// MAIN
+			uint32_t byteVal4 = 0;			// AUX
+			if (xColNoBorder > 0)
+				byteVal1 = texel[-4];
+			if (xColNoBorder < 39)
+				byteVal4 = texel[4 + 1];
+
+			if ((specialModesMask & 0x1) == 1)	// DHGRCOL140Mixed
+			{
+				// The high bit of each byte controls the mode of 4-dot aligned color pixels,
+				// see the shader for the details
+				int xFragPos = (int)x - (int)(hborder * 14);
+				int bitPos = xFragPos % 7;
+				int modeByteOffset = std::clamp(bitPos - (xFragPos % 4), -1, 0);
+				int byteForMode = 1 + ((xFragPos / 7) % 2) + modeByteOffset;
+				uint32_t isColor;
+				if (byteForMode == 0)
+					isColor = byteVal1 >> 7;
+				else if (byteForMode == 1)
+					isColor = byteVal2 >> 7;
+				else
+					isColor = byteVal3 >> 7;
+				if (isColor == 0)	// bw mode, same as DHGRMONO
+				{
+					float v = ((((byteVal3 << 7) | (byteVal2 & 0x7Fu)) & (1u << ((uint32_t)xFragPos % 14u))) ? 1.f : 0.f);
+					return { v, v, v, 0.9f };
+				}
+			}
+			int wordVal = ((int)byteVal1 & 0x70) | (((int)byteVal2 & 0x7F) << 7) |
+				(((int)byteVal3 & 0x7F) << 14) | (((int)byteVal4 & 0x07) << 21);
+			int vColor = (xColNoBorder * 14 + (int)fragOffsetX) & 3;
+			int vValue = (wordVal >> (4 + (int)fragOffsetX - vColor));
+			int xVal = 10 * ((vValue >> 8) & 0xFF) + vColor;
+			int yVal = vValue & 0xFF;
+			return FetchModeTexel(MODETEX_DHGR, xVal, yVal);
+		}
+		case 6:		// DHGR MONO
+		{
+			uint32_t xFragPos = x - hborder * 14;
+			int mColorType = std::max(monitorColorType, 1);	// Force color to be white
+			Color c = { 0.f, 0.f, 0.f, 0.f };
+			if ((((uint32_t)texel[0] << 7) | (texel[1] & 0x7Fu)) & (1u << (xFragPos % 14u)))
+				c = monoColor(mColorType);
+			c.a = 0.9f;
+			return c;
+		}
+		default:	// BORDER
+		{
+			uint32_t borderColor = (texel[2] & 0xF0u) >> 4;
+			const float* t = tintColors[borderColor];
+			Color c = { t[0], t[1], t[2], t[3] };
+			if (monitorColorType > 0)	// Monitor is monochrome
+			{
+				c = monoColor(borderColor > 0 ? monitorColorType : 0);
+				c.a = 0.9f;
+			}
+			return c;
+		}
+	}
+}
+
+void A2SoftRenderer::RenderLegacy(const uint8_t* vram_legacy, std::vector<uint8_t>& rgba) const
+{
+	const uint32_t width = GetLegacyWidth();
+	const uint32_t height = GetLegacyHeight();
+	rgba.resize((size_t)width * height * 4);
+	uint8_t* out = rgba.data();
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			Color c = LegacyFragment(vram_legacy, x, y);
+			out[0] = to_unorm8(c.r);
+			out[1] = to_unorm8(c.g);
+			out[2] = to_unorm8(c.b);
+			out[3] = to_unorm8(c.a);
+			out += 4;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SHR
+//////////////////////////////////////////////////////////////////////////
+
+A2SoftRenderer::Color A2SoftRenderer::SHRRGGBFragment(const uint8_t* vram, uint32_t xpos, uint32_t ypos,
+	int originX, int originY, int originOffsetY, bool is640Mode) const
+{
+	const int vramWidth = (int)(A2SOFT_SHR_COLORBYTESOFFSET + (40 + 2 * hborder) * 4);
+	const int vramRows = (int)(A2SOFT_SHR_SCANLINES + 2 * vborder) * 2;
+	const int doubleSHR4YOffset = (doubleSHR4Mode == 0 ? 0 : 1) * (int)(A2SOFT_SHR_SCANLINES + 2 * vborder);
+	const bool isInterlace = (doubleSHR4Mode == 1);
+	const uint32_t ypos_noborder = ypos - vborder * 2;
+	const int minX = (int)(A2SOFT_SHR_COLORBYTESOFFSET + hborder * 4);
+	const int maxX = minX + (int)A2SOFT_SHR_BYTES_PER_LINE;
+
+	// Fetch a content byte. Outside of the content area, all its colors are 0.
+	auto fetchByte = [&](int bx, int by) -> uint32_t {
+		if (bx < minX || bx >= maxX || by < 0 || by >= vramRows)
+			return 0;
+		return vram[by * vramWidth + bx];
+	};
+	auto fetch640 = [&](int bx, int by, uint32_t colors[4]) {
+		uint32_t byteVal = fetchByte(bx, by);
+		for (int i = 0; i < 4; i++)
+			colors[i] = (byteVal >> (6 - 2 * i)) & 0x3u;
+	};
+	auto fetch320 = [&](int bx, int by, uint32_t colors[2]) {
+		uint32_t byteVal = fetchByte(bx, by);
+		for (int i = 0; i < 2; i++)
+			colors[i] = (byteVal >> (4 - 4 * i)) & 0xFu;
+	};
+
+	// Y Offsets for the 5 RGGB scanlines, the center line being offset 2
+	int yOffsets[5] = { -2, -1, 0, 1, 2 };
+	if (isInterlace)
+	{
+		if ((ypos_noborder & 1u) == 0u)		// even row
+		{
+			int o[5] = { -1, doubleSHR4YOffset - 1, 0, doubleSHR4YOffset, 1 };
+			std::copy(o, o + 5, yOffsets);
+		} else {							// odd row
+			int o[5] = { doubleSHR4YOffset - 1, 0, doubleSHR4YOffset, 1, doubleSHR4YOffset + 1 };
+			std::copy(o, o + 5, yOffsets);
+		}
+	}
+	// Lines close to the vertical borders fetch black
+	if (ypos_noborder < 2u)
+		yOffsets[0] = -5000;
+	if (ypos_noborder < 1u)
+		yOffsets[1] = -5000;
+	if (ypos_noborder > 398u)
+		yOffsets[3] = -5000;
+	if (ypos_noborder > 397u)
+		yOffsets[4] = -5000;
+
+	// The 13 colors around the origin, laid out like the filter matrices:
+	//         0
+	//     1   2   3
+	// 4   5   6   7   8
+	//     9   10  11
+	//         12
+	float colors[4][4] = {};
+	Color c = { 0.f, 0.f, 0.f, 1.f };
+	if (is640Mode)
+	{
+		uint32_t lp = xpos & 3u;	// Local pixel index [0, 3] within the byte
+		uint32_t bU[4], bD[4];
+
+		fetch640(originX, originY + yOffsets[0], bU);
+		fetch640(originX, originY + yOffsets[4], bD);
+		colors[0][0] = (float)bU[lp];
+		colors[3][0] = (float)bD[lp];
+
+		fetch640(originX, originY + yOffsets[1], bU);
+		fetch640(originX, originY + yOffsets[3], bD);
+		colors[0][2] = (float)bU[lp];
+		colors[2][2] = (float)bD[lp];
+		if (lp == 0u)
+		{
+			colors[0][3] = (float)bU[lp + 1];
+			colors[2][3] = (float)bD[lp + 1];
+			fetch640(originX - 1, originY + yOffsets[1], bU);
+			fetch640(originX - 1, originY + yOffsets[3], bD);
+			colors[0][1] = (float)bU[3];
+			colors[2][1] = (float)bD[3];
+		} else if (lp == 3u) {
+			colors[0][1] = (float)bU[lp - 1];
+			colors[2][1] = (float)bD[lp - 1];
+			fetch640(originX + 1, originY + yOffsets[1], bU);
+			fetch640(originX + 1, originY + yOffsets[3], bD);
+			colors[0][3] = (float)bU[0];
+			colors[2][3] = (float)bD[0];
+		} else {
+			colors[0][1] = (float)bU[lp - 1];
+			colors[2][1] = (float)bD[lp - 1];
+			colors[0][3] = (float)bU[lp + 1];
+			colors[2][3] = (float)bD[lp + 1];
+		}
+
+		fetch640(originX, originOffsetY, bU);
+		colors[1][2] = (float)bU[lp];
+		if (lp < 2u)
+		{
+			colors[1][3] = (float)bU[lp + 1];
+			colors[2][0] = (float)bU[lp + 2];
+			if (lp == 1u)
+			{
+				colors[1][1] = (float)bU[0];
+				fetch640(originX - 1, originY + yOffsets[2], bU);
+				colors[1][0] = (float)bU[3];
+			} else {
+				fetch640(originX - 1, originY + yOffsets[2], bU);
+				colors[1][0] = (float)bU[2];
+				colors[1][1] = (float)bU[3];
+			}
+		} else {
+			colors[1][0] = (float)bU[lp - 2];
+			colors[1][1] = (float)bU[lp - 1];
+			if (lp == 2u)
+			{
+				colors[1][3] = (float)bU[3];
+				fetch640(originX + 1, originY + yOffsets[2], bU);
+				colors[2][0] = (float)bU[0];
+			} else {
+				fetch640(originX + 1, originY + yOffsets[2], bU);
+				colors[1][3] = (float)bU[0];
+				colors[2][0] = (float)bU[1];
+			}
+		}
+		// Switch to 640x200, from 640x400 if not interlaced
+		if (!isInterlace)
+			ypos = ypos >> 1;
+	} else {	// 320 mode
+		uint32_t lp = (xpos >> 1) & 1u;	// Local pixel index [0, 1] within the byte
+		uint32_t bU[2], bD[2];
+
+		fetch320(originX, originY + yOffsets[0], bU);
+		fetch320(originX, originY + yOffsets[4], bD);
+		colors[0][0] = (float)bU[lp];
+		colors[3][0] = (float)bD[lp];
+
+		fetch320(originX, originY + yOffsets[1], bU);
+		fetch320(originX, originY + yOffsets[3], bD);
+		colors[0][2] = (float)bU[lp];
+		colors[2][2] = (float)bD[lp];
+		if (lp == 0u)
+		{
+			colors[0][3] = (float)bU[1];
+			colors[2][3] = (float)bD[1];
+			fetch320(originX - 1, originY + yOffsets[1], bU);
+			fetch320(originX - 1, originY + yOffsets[3], bD);
+			colors[0][1] = (float)bU[1];
+			colors[2][1] = (float)bD[1];
+		} else {
+			colors[0][1] = (float)bU[0];
+			colors[2][1] = (float)bD[0];
+			fetch320(originX + 1, originY + yOffsets[1], bU);
+			fetch320(originX + 1, originY + yOffsets[3], bD);
+			colors[0][3] = (float)bU[0];
+			colors[2][3] = (float)bD[0];
+		}
+
+		fetch320(originX, originOffsetY, bU);
+		colors[1][2] = (float)bU[lp];
+		if (lp == 0u)
+		{
+			colors[1][3] = (float)bU[1];
+			fetch320(originX + 1, originY + yOffsets[2], bU);
+			colors[2][0] = (float)bU[0];
+			fetch320(originX - 1, originY + yOffsets[2], bU);
+			colors[1][0] = (float)bU[0];
+			colors[1][1] = (float)bU[1];
+		} else {
+			colors[1][1] = (float)bU[0];
+			fetch320(originX - 1, originY + yOffsets[2], bU);
+			colors[1][0] = (float)bU[1];
+			fetch320(originX + 1, originY + yOffsets[2], bU);
+			colors[1][3] = (float)bU[0];
+			colors[2][0] = (float)bU[1];
+		}
+		// Switch to 320x200 or 320x400 (interlaced), from 640x400
+		xpos = xpos >> 1;
+		if (!isInterlace)
+			ypos = ypos >> 1;
+	}
+
+	if (((xpos & 1u) == 0u) && ((ypos & 1u) == 0u))
+	{
+		// red location, even row
+		c.r = colors[1][2] * 8.f;
+		c.g = apply_filter(matGFilter, colors);
+		c.b = apply_filter(matRBFilter, colors);
+	} else if (((xpos & 1u) == 1u) && ((ypos & 1u) == 0u)) {
+		// green location, even row
+		c.r = apply_filter(matXGFilter, colors);
+		c.g = colors[1][2] * 8.f;
+		c.b = apply_filter(matXGXFilter, colors);
+	} else if (((xpos & 1u) == 0u) && ((ypos & 1u) == 1u)) {
+		// green location, odd row
+		c.r = apply_filter(matXGXFilter, colors);
+		c.g = colors[1][2] * 8.f;
+		c.b = apply_filter(matXGFilter, colors);
+	} else {
+		// blue location, odd row
+		c.r = apply_filter(matRBFilter, colors);
+		c.g = apply_filter(matGFilter, colors);
+		c.b = colors[1][2] * 8.f;
+	}
+	// The filters give x8. Colors are 0-3 in 640 mode and 0-15 in 320 mode.
+	float scale = (is640Mode ? (1.f / 24.f) : (1.f / 120.f));
+	c.r = std::clamp(c.r * scale, 0.f, 1.f);
+	c.g = std::clamp(c.g * scale, 0.f, 1.f);
+	c.b = std::clamp(c.b * scale, 0.f, 1.f);
+	return c;
+}
+
+A2SoftRenderer::Color A2SoftRenderer::SHRFragment(const uint8_t* vram, const uint8_t* pal256, uint32_t x, uint32_t y) const
+{
+	const uint32_t vramWidth = A2SOFT_SHR_COLORBYTESOFFSET + (40 + 2 * hborder) * 4;
+	const uint32_t vramRows = (A2SOFT_SHR_SCANLINES + 2 * vborder) * 2;
+	const uint32_t hasDouble = (doubleSHR4Mode == 0 ? 0 : 1);
+	const uint32_t doubleSHR4YOffset = hasDouble * (A2SOFT_SHR_SCANLINES + 2 * vborder);
+	const uint32_t doublePal256YOffset = hasDouble * A2SOFT_SHR_SCANLINES;
+	auto fetch = [&](uint32_t bx, uint32_t by) -> uint32_t {
+		if (bx >= vramWidth || by >= vramRows)
+			return 0;
+		return vram[by * vramWidth + bx];
+	};
+	auto iigsColor = [](uint32_t r, uint32_t g, uint32_t b) {
+		return Color{ r / 16.f, g / 16.f, b / 16.f, 1.f };
+	};
+
+	uint32_t xpos = x;
+	uint32_t ypos = y;
+	uint32_t scanline = ypos >> 1;
+	uint32_t yOffsetLines = 0;
+	if (doubleSHR4Mode == 1)	// the offset is used for odd lines (i.e. use bank E0 for odd lines)
+		yOffsetLines = doubleSHR4YOffset * (ypos & 1u);
+	if (doubleSHR4Mode == 2)	// the offset is used for odd frames
+		yOffsetLines = doubleSHR4YOffset * (uint32_t)frameIsOdd;
+
+	Color c;
+	if ((ypos < vborder * 2) || (ypos >= vborder * 2 + 400) ||
+		(xpos < hborder * 16) || (xpos >= 640 + hborder * 16))
+	{
+		const float* b = shrBorderColors[fetch(A2SOFT_SHR_COLORBYTESOFFSET + (xpos >> 2), scanline + yOffsetLines) & 0x0Fu];
+		c = { b[0], b[1], b[2], b[3] };
+	} else {
+		uint32_t scb = fetch(0, scanline + yOffsetLines);
+		bool is640Mode = (scb & 0x80u) != 0;
+		if (scb & 0x10u)		// this line is unused, the pixel is transparent
+			return { 0.f, 0.f, 0.f, 0.f };
+
+		uint32_t fragOffset = 3u - (xpos & 3u);	// reversed so that palette calc is easier
+		int originX = (int)(A2SOFT_SHR_COLORBYTESOFFSET + (xpos >> 2));
+		int originY = (int)(ypos >> 1);
+		uint32_t originOffsetY = originY + yOffsetLines;
+		uint32_t byteVal = fetch(originX, originOffsetY);
+
+		uint32_t colorIdx;
+		if (is640Mode)
+			colorIdx = palette640[(fragOffset << 2) + ((byteVal >> (fragOffset << 1)) & 0x3u)];
+		else
+			colorIdx = (byteVal >> (4u * (fragOffset >> 1))) & 0xFu;
+
+		// The second palette byte determines if it's standard SHR or not
+		uint32_t paletteColorB2 = fetch(1 + colorIdx * 2 + 1, originOffsetY);
+		if (overrideSHR4Mode > 0)
+			paletteColorB2 = (paletteColorB2 & 0xFu) | ((uint32_t)(overrideSHR4Mode - 1) << 4);
+
+		if (((specialModesMask & 0xF0) != 0) || (overrideSHR4Mode > 0))	// Frame has SHR4 modes active
+		{
+			uint32_t xpos_noborder = xpos - hborder * 16;
+			uint32_t ypos_noborder = ypos - vborder * 2;
+			switch (paletteColorB2 >> 4) {
+				case 0:		// Standard SHR
+				{
+					uint32_t paletteColorB1 = fetch(1 + colorIdx * 2, originOffsetY);
+					c = iigsColor(paletteColorB2 & 0xFu, paletteColorB1 >> 4, paletteColorB1 & 0xFu);
+					break;
+				}
+				case 1:		// RGGB Color Filter Array
+					c = SHRRGGBFragment(vram, xpos, ypos, originX, originY, (int)originOffsetY, is640Mode);
+					break;
+				case 2:		// Pal256, from the pregenerated PAL256 colors buffer
+				{
+					uint32_t yPal256OffsetLines = 0;
+					if (doubleSHR4Mode == 1)
+						yPal256OffsetLines = doublePal256YOffset * (ypos_noborder & 1u);
+					if (doubleSHR4Mode == 2)
+						yPal256OffsetLines = doublePal256YOffset * ((uint32_t)ticks & 1u);
+					uint32_t pal256Word = 0;
+					if (pal256 != nullptr)
+					{
+						const uint8_t* p = pal256 + (((ypos_noborder >> 1) + yPal256OffsetLines) * A2SOFT_SHR_BYTES_PER_LINE
+							+ (xpos_noborder >> 2)) * 2;
+						pal256Word = p[0] | (p[1] << 8);
+					}
+					c = iigsColor((pal256Word >> 8) & 0xFu, (pal256Word >> 4) & 0xFu, pal256Word & 0xFu);
+					break;
+				}
+				case 3:		// R4G4B4: bytes AB CD EF are the pixels ABC and DEF, each spanning 3 dots at 320
+				{
+					uint32_t tripletPos = (xpos_noborder >> 1) % 6u;
+					if (tripletPos < 2u)		// AB
+					{
+						uint32_t other = fetch(originX + 1, originOffsetY);		// CD
+						c = iigsColor(byteVal >> 4, byteVal & 0xFu, other >> 4);
+					} else if (tripletPos == 2u) {	// C
+						uint32_t other = fetch(originX - 1, originOffsetY);		// AB
+						c = iigsColor(other >> 4, other & 0xFu, byteVal >> 4);
+					} else if (tripletPos == 3u) {	// D
+						uint32_t other = fetch(originX + 1, originOffsetY);		// EF
+						c = iigsColor(byteVal & 0xFu, other >> 4, other & 0xFu);
+					} else {						// EF
+						uint32_t other = fetch(originX - 1, originOffsetY);		// CD
+						c = iigsColor(other & 0xFu, byteVal >> 4, byteVal & 0xFu);
+					}
+					break;
+				}
+				default:	// the shader leaves the color undefined
+					c = { 0.f, 0.f, 0.f, 0.f };
+					break;
+			}
+		} else {	// Standard SHR
+			uint32_t paletteColorB1 = fetch(1 + colorIdx * 2, originOffsetY);
+			c = iigsColor(paletteColorB2 & 0xFu, paletteColorB1 >> 4, paletteColorB1 & 0xFu);
+		}
+	}
+
+	if (monitorColorType > 0)
+	{
+		// Apply the luminance of the color to the monochrome color
+		const float* m = shrMonitorColors[monitorColorType];
+		float luminance = c.r * 0.299f + c.g * 0.587f + c.b * 0.114f;
+		c = { m[0] * luminance, m[1] * luminance, m[2] * luminance, c.a };
+	}
+	return c;
+}
+
+void A2SoftRenderer::RenderSHR(const uint8_t* vram_shr, const uint8_t* vram_pal256, std::vector<uint8_t>& rgba) const
+{
+	const uint32_t width = GetSHRWidth();
+	const uint32_t height = GetSHRHeight();
+	rgba.resize((size_t)width * height * 4);
+	uint8_t* out = rgba.data();
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			Color c = SHRFragment(vram_shr, vram_pal256, x, y);
+			out[0] = to_unorm8(c.r);
+			out[1] = to_unorm8(c.g);
+			out[2] = to_unorm8(c.b);
+			out[3] = to_unorm8(c.a);
+			out += 4;
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef A2SOFTRENDERER_H
+#define A2SOFTRENDERER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+	CPU implementation of the beam shaders a2video_beam_legacy.frag and
+	a2video_beam_shr_raw.frag, for when there is no GL context.
+
+	It reads the same vram layouts that A2VideoManager builds in BeamRenderVRAMs
+	and that A2WindowBeam uploads to VRAMTEX and PAL256TEX, and runs the shaders'
+	per-fragment logic for every pixel of the window, into a top-down RGBA8 image:
+		Legacy:	(40 + 2*hborder) * 14 x (192 + 2*vborder) * 2 pixels
+		SHR:	(40 + 2*hborder) * 16 x (200 + 2*vborder) * 2 pixels
+
+	The settings are the shaders' uniforms, with the same values as in A2WindowBeam.
+	Merged mode (OFFSETTEX) is not supported, render the legacy and SHR vrams separately.
+
+	This file must stay free of GL and SDL so that it can be built headless,
+	which is why it doesn't include common.h or A2WindowBeam.h.
+*/
+
+// Same values as _COLORBYTESOFFSET, _A2VIDEO_SHR_BYTES_PER_LINE and _A2VIDEO_SHR_SCANLINES
+constexpr uint32_t A2SOFT_SHR_COLORBYTESOFFSET = 1 + 32;
+constexpr uint32_t A2SOFT_SHR_BYTES_PER_LINE = 160;
+constexpr uint32_t A2SOFT_SHR_SCANLINES = 200;
+
+// A mode texture (font, LGR, HGR or DHGR lookup), as RGBA8 with the PNG's top row first
+struct A2SoftTexture {
+	const uint8_t* data = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+class A2SoftRenderer
+{
+public:
+	// Legacy mode textures, in the shader's a2ModesTex0-4 order
+	enum ModeTexture_e
+	{
+		MODETEX_FONT_REGULAR = 0,
+		MODETEX_FONT_ALTERNATE,
+		MODETEX_LGR,
+		MODETEX_HGR,
+		MODETEX_DHGR,
+		MODETEX_TOTAL_COUNT
+	};
+	void SetModeTexture(ModeTexture_e idx, const A2SoftTexture& tex) { modeTextures[idx] = tex; };
+
+	// Uniforms shared by both shaders
+	uint32_t hborder = 0;				// horizontal border in cycles
+	uint32_t vborder = 0;				// vertical border in scanlines
+	int ticks = 0;						// ms since start, for flashing text
+	int frameIsOdd = 0;
+	int specialModesMask = 0;			// A2VideoSpecialMode_e
+	int monitorColorType = 0;			// A2VideoMonitorType_e
+	// Legacy uniforms
+	int pagingMode = 0;					// DoubleMode_e
+	// SHR uniforms
+	int overrideSHR4Mode = 0;
+	int doubleSHR4Mode = 0;				// DoubleMode_e
+
+	uint32_t GetLegacyWidth() const { return (40 + 2 * hborder) * 14; };
+	uint32_t GetLegacyHeight() const { return (192 + 2 * vborder) * 2; };
+	uint32_t GetSHRWidth() const { return (40 + 2 * hborder) * 16; };
+	uint32_t GetSHRHeight() const { return (A2SOFT_SHR_SCANLINES + 2 * vborder) * 2; };
+
+	// vram_legacy is 4 bytes per cycle, (40 + 2*hborder) cycles wide, with the paging
+	// half after the (192 + 2*vborder) lines of the main half
+	void RenderLegacy(const uint8_t* vram_legacy, std::vector<uint8_t>& rgba) const;
+	// vram_shr is 1 byte per texel, A2SOFT_SHR_COLORBYTESOFFSET + (40 + 2*hborder)*4 wide,
+	// with the double SHR4 half after the (200 + 2*vborder) lines of the main half.
+	// vram_pal256 is only read by PAL256 lines and can be null otherwise.
+	void RenderSHR(const uint8_t* vram_shr, const uint8_t* vram_pal256, std::vector<uint8_t>& rgba) const;
+
+private:
+	struct Color { float r, g, b, a; };
+
+	Color LegacyFragment(const uint8_t* vram, uint32_t x, uint32_t y) const;
+	Color SHRFragment(const uint8_t* vram, const uint8_t* pal256, uint32_t x, uint32_t y) const;
+	Color SHRRGGBFragment(const uint8_t* vram, uint32_t xpos, uint32_t ypos,
+		int originX, int originY, int originOffsetY, bool is640Mode) const;
+	Color FetchModeTexel(ModeTexture_e idx, int x, int y) const;
+
+	A2SoftTexture modeTextures[MODETEX_TOTAL_COUNT];
+};
+
+#endif // A2SOFTRENDERER_H
@@ -7,13 +7,12 @@
 #include <cstring>   // for std::memcmp
 #include <string>
 #include <algorithm>
+#include <array>
 #include <system_error>
 #include <map>
 #include "SDL.h"
 #include <SDL_opengl.h>
-#ifdef _DEBUGTIMINGS
 #include <chrono>
-#endif
 #include <iostream>
 #include <iomanip>
 #include "OpenGLHelper.h"
@@ -22,6 +21,10 @@
 #include "SoundManager.h"
 #include "MockingboardManager.h"
 #include "EventRecorder.h"
+#include "LatencyMonitor.h"
+#include "SDHRNetworking.h"
+#include "SHRExpand.h"
+#include "LegacyExpand.h"
 #include "GRAddr2XY.h"
 #include "imgui.h"
 #include "SDL_rect.h"
@@ -115,11 +118,19 @@ static uint16_t g_RAM_HGROffsets[] = {
 	0x0350, 0x0750, 0x0B50, 0x0F50, 0x1350, 0x1750, 0x1B50, 0x1F50,
 	0x03D0, 0x07D0, 0x0BD0, 0x0FD0, 0x13D0, 0x17D0, 0x1BD0, 0x1FD0
 };
+// And the TEXT row offsets for each scanline, to be indexed like the HGR ones
+static const std::array<uint16_t, 192> g_RAM_TEXTLineOffsets = [] {
+	std::array<uint16_t, 192> offsets{};
+	for (size_t y = 0; y < offsets.size(); ++y)
+		offsets[y] = g_RAM_TEXTOffsets[y / 8];
+	return offsets;
+}();
 
 static std::string fontpath = "assets/Apple2eFont14x16";
 
 // below because "The declaration of a static data member in its class definition is not a definition"
 A2VideoManager* A2VideoManager::s_instance;
+bool A2VideoManager::s_bHeadless = false;
 
 //////////////////////////////////////////////////////////////////////////
 // Overlay String Methods
@@ -185,7 +196,7 @@ inline void A2VideoManager::UpdateOverlayLine(uint32_t y)
 
 A2VideoManager::~A2VideoManager()
 {
-	for (int i = 0; i < 2; i++)
+	for (int i = 0; i < _VRAMS_RING_MAX; i++)
 	{
 		if (vrams_array[i].vram_legacy != nullptr)
 			delete[] vrams_array[i].vram_legacy;
@@ -227,13 +238,16 @@ void A2VideoManager::Initialize()
 
 	ResetGLData();
 	
-	auto oglHelper = OpenGLHelper::GetInstance();
-	for (int i = 0; i < 2; i++)
+	// All the buffers are allocated, so that the ring size can change at any reinit
+	vrams_ring_size = std::clamp(vrams_ring_size_requested, _VRAMS_RING_MIN, _VRAMS_RING_MAX);
+	for (int i = 0; i < _VRAMS_RING_MAX; i++)
 	{
 		vrams_array[i].id = i;
-		vrams_array[i].frame_idx = current_frame_idx + i;
-		vrams_array[i].bWasRendered = true;		// otherwise it won't render the first frame
+		vrams_array[i].frame_idx = current_frame_idx;
+		vrams_array[i].state = VRAMState_e::FREE;
 		vrams_array[i].mode = A2Mode_e::NONE;
+		vrams_array[i].frameSHR4Modes = 0;
+		vrams_array[i].pagedMode = 0;
 		if (vrams_array[i].vram_legacy != nullptr)
 		{
 			delete[] vrams_array[i].vram_legacy;
@@ -294,10 +308,33 @@ void A2VideoManager::Initialize()
 		memset(vrams_array[i].vram_forced_hgr2, 0, 40 * 192 * 4);
 	}
 	vrams_write = &vrams_array[0];
-	vrams_read = &vrams_array[1];
+	vrams_write->state = VRAMState_e::WRITING;
+	vrams_read = &vrams_array[1];		// an empty frame, so that the renderer has something
+	vrams_read->state = VRAMState_e::RENDERING;
+	lazyRunLength = 0;		// drop any queued beam cycles, the vrams are new
+	bDiscardWriteFrame = true;
+	scanlineSHR4Modes = 0;
+
+	beamState = BeamState_e::NBVBLANK;
+	// The region is otherwise only updated at frame starts, and it may have changed since the last one
+	current_region = CycleCounter::GetInstance()->GetVideoRegion();
+	region_scanlines = (current_region == VideoRegion_e::NTSC ? SC_TOTAL_NTSC : SC_TOTAL_PAL);
+	merge_last_change_mode = A2Mode_e::NONE;
+	merge_last_change_y = UINT_MAX;
+
+	// Set default border color
+	MemoryManager::GetInstance()->switch_c034 = 13;
+
+	// Headless, only the beam runs. Skip everything that is for the GPU.
+	if (s_bHeadless)
+	{
+		bIsReady = true;
+		return;
+	}
 
 	// Set up the image assets (textures)
 	// Assign them their respective GPU texture id
+	auto oglHelper = OpenGLHelper::GetInstance();
 	*image_assets = {};
 	for (uint8_t i = 0; i < (sizeof(image_assets) / sizeof(OpenGLHelper::ImageAsset)); i++)
 	{
@@ -350,10 +387,6 @@ void A2VideoManager::Initialize()
 	// Otherwise, Legacy size
 	fb_width = windowsbeam[A2VIDEOBEAM_LEGACY]->GetWidth();
 	fb_height = windowsbeam[A2VIDEOBEAM_LEGACY]->GetHeight();
-
-	beamState = BeamState_e::NBVBLANK;
-	merge_last_change_mode = A2Mode_e::NONE;
-	merge_last_change_y = UINT_MAX;
 	
 	shader_merge.build(_SHADER_VERTEX_BASIC, _SHADER_BEAM_MERGE_FRAGMENT);
 	offsetTextureExists = false;
@@ -368,9 +401,6 @@ void A2VideoManager::Initialize()
 	// clear the text overlay
 	std::memset(overlay_text, 0, sizeof(overlay_text));
 	std::memset(overlay_colors, 0, sizeof(overlay_colors));
-	
-	// Set default border color
-	MemoryManager::GetInstance()->switch_c034 = 13;
 
 	bIsReady = true;
 }
@@ -436,7 +466,8 @@ void A2VideoManager::CheckSetBordersWithReinit()
 	if (border_h_slider_val > _BORDER_WIDTH_MAX_CYCLES)
 		border_h_slider_val = _BORDER_WIDTH_MAX_CYCLES;
 	if ((border_w_slider_val == borders_w_cycles)
-		&& (border_h_slider_val == (borders_h_scanlines / 8)))
+		&& (border_h_slider_val == (borders_h_scanlines / 8))
+		&& (vrams_ring_size_requested == vrams_ring_size))
 		return;
 	bIsReady = false;
 	borders_w_cycles = border_w_slider_val;
@@ -479,21 +510,33 @@ SDL_FRect A2VideoManager::CenteredQuadInFramebufferWithOffset(const SDL_FRect& q
 
 void A2VideoManager::StartNextFrame()
 {
+	// The memory write highlights go by frames too, even the skipped ones
+	MemoryManager::GetInstance()->AdvanceWriteEpoch(CycleCounter::GetInstance()->GetCycleTimestamp());
+
+	// When the processing thread falls behind the Appletini, the beam work of a whole frame
+	// is skipped so it can catch up. A skipped frame has nothing new: don't flip it, the
+	// renderer keeps the last complete frame. Never skip two frames in a row.
+	if (bSkipBeamFrame)
+	{
+		bSkipBeamFrame = false;
+		return;
+	}
+	bSkipBeamFrame = is_ingest_backpressured();
+	if (bSkipBeamFrame)
+		++skipped_beam_frames;
+
 	// start the next frame
 	// set the frame index for the buffer we'll move to reading
 	vrams_write->frame_idx = ++current_frame_idx;
+	vrams_write->bus_timestamp_ns = LATENCY_GET_BUS_TIMESTAMP();
 	// std::cerr << "starting next frame at current index: " << current_frame_idx << std::endl;
 
-	// Flip the double buffers only if the read buffer was rendered
-	// Otherwise it means the renderer is too slow and hasn't finished rendering
-	// We just overwrite the current buffer
-	if (vrams_read->bWasRendered == true)
-	{
-		vrams_read->bWasRendered = false;
-		auto _vtmp = vrams_write;
-		vrams_write = vrams_read;
-		vrams_read = _vtmp;
-	}
+	// Hand the frame over to the renderer, and move on to another buffer.
+	// After a reset the beam started mid-frame: that partial frame is drawn over instead.
+	const bool bPublish = !bDiscardWriteFrame;
+	bDiscardWriteFrame = false;
+	if (bPublish)
+		PublishWriteFrame();
 //	memset(vrams_write->vram_legacy, 0, GetVramSizeLegacy());
 //	memset(vrams_write->vram_shr, 0, GetVramSizeSHR());
 //	memset(vrams_write->offset_buffer, 0, GetVramHeightSHR() * sizeof(GLfloat));
@@ -509,6 +552,10 @@ void A2VideoManager::StartNextFrame()
 	vrams_write->frameSHR4Modes = 0;
 	vrams_write->pagedMode = 0;
 
+	// Headless, the frames are polled with AcquireHeadlessFrame()
+	if (s_bHeadless || !bPublish)
+		return;
+
 	// And finally send an event to the main loop saying that the frame was updated
 	// This is necessary when synching to the Apple 2 VSYNC. Don't create a new event if there are 4
 	// events already in the queue.
@@ -530,7 +577,97 @@ void A2VideoManager::StartNextFrame()
 #endif
 }
 
-void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
+// Called by the beam when vrams_write holds a complete frame. Marks it ready for the renderer,
+// and finds the next buffer to draw into: a free one, or else the oldest ready frame, which is
+// dropped. With the LATEST policy the older ready frames are dropped right away, the renderer
+// would skip them anyway. The renderer holds one buffer, so a completed frame is only drawn
+// over in the short time the renderer holds two, while it swaps.
+void A2VideoManager::PublishWriteFrame()
+{
+	vrams_write->state = VRAMState_e::READY;
+	++frames_produced;
+	LATENCY_RECORD(LatencyStage_e::VBL_FLIP, vrams_write->bus_timestamp_ns);
+
+	const bool bLatest = (vrams_ring_policy == VRAMRingPolicy_e::LATEST);
+	// Takes back a ready frame that the renderer hasn't picked up. Fails if the renderer just did.
+	auto _reclaim = [this](BeamRenderVRAMs* vrams, VRAMState_e newState) {
+		VRAMState_e expected = VRAMState_e::READY;
+		if (!vrams->state.compare_exchange_strong(expected, newState))
+			return false;
+		++frames_dropped;
+		return true;
+	};
+	BeamRenderVRAMs* _next = nullptr;
+	while (_next == nullptr)
+	{
+		BeamRenderVRAMs* _oldestReady = nullptr;
+		for (int i = 0; i < vrams_ring_size; i++)
+		{
+			auto _vrams = &vrams_array[i];
+			if (_vrams == vrams_write)
+				continue;
+			auto _state = _vrams->state.load();
+			if (_state == VRAMState_e::READY && bLatest)
+			{
+				if (_reclaim(_vrams, VRAMState_e::FREE))
+					_state = VRAMState_e::FREE;
+			}
+			if (_state == VRAMState_e::FREE && _next == nullptr)
+				_next = _vrams;
+			else if (_state == VRAMState_e::READY
+				&& (_oldestReady == nullptr || _vrams->frame_idx < _oldestReady->frame_idx))
+				_oldestReady = _vrams;
+		}
+		if (_next != nullptr)
+			break;
+		if (_oldestReady != nullptr && _reclaim(_oldestReady, VRAMState_e::FREE))
+			_next = _oldestReady;
+		// The renderer is swapping and holds both other buffers: draw over the frame just completed
+		else if (_reclaim(vrams_write, VRAMState_e::WRITING))
+			return;
+		// Otherwise the renderer picked up a frame in the meantime, and is releasing its previous one
+	}
+	_next->state = VRAMState_e::WRITING;
+	vrams_write = _next;
+}
+
+// Called by the renderer to pick up a ready frame, per the ring policy. The previous
+// frame is released back to the beam. Returns false if there's no new frame.
+bool A2VideoManager::AcquireReadFrame()
+{
+	const bool bLatest = (vrams_ring_policy == VRAMRingPolicy_e::LATEST);
+	BeamRenderVRAMs* _ready = nullptr;
+	while (_ready == nullptr)
+	{
+		for (int i = 0; i < vrams_ring_size; i++)
+		{
+			auto _vrams = &vrams_array[i];
+			if (_vrams->state.load() != VRAMState_e::READY)
+				continue;
+			if ((_ready == nullptr)
+				|| (bLatest ? (_vrams->frame_idx > _ready->frame_idx) : (_vrams->frame_idx < _ready->frame_idx)))
+				_ready = _vrams;
+		}
+		if (_ready == nullptr)
+			return false;
+		VRAMState_e expected = VRAMState_e::READY;
+		if (!_ready->state.compare_exchange_strong(expected, VRAMState_e::RENDERING))
+			_ready = nullptr;	// the beam just dropped it, look again
+		else if (_ready->frame_idx <= vrams_read->frame_idx)
+		{
+			// An older frame the beam was about to drop, never go back in time
+			_ready->state = VRAMState_e::FREE;
+			++frames_dropped;
+			_ready = nullptr;
+		}
+	}
+	vrams_read->state = VRAMState_e::FREE;
+	vrams_read = _ready;
+	++frames_displayed;
+	return true;
+}
+
+void A2VideoManager::BeamRenderCycle(uint32_t _x, uint32_t _y)
 {
 	/*
 		@: Frame flip and start of next frame
@@ -647,6 +784,9 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 		_oldBeamState = beamState;
 	}
 
+	if (bSkipBeamFrame)
+		return;
+
 	// Check for text overlay in this position
 	if ((_y < COUNT_SC_CONTENT) && (overlay_lines[_y / 8] == 1))
 	{
@@ -685,7 +825,7 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 	// Always at the start of the row, set the SHR SCB to 0x10
 	// Because we check bit 4 of the SCB to know if that line is drawn as SHR
 	// The 2gs will always set bit 4 to 0 when sending it over
-	// Also check if the mode has switched in the middle of the frame
+	// Also tag the line with its mode, in case the frame ends up merged
 	if (_x == 0)
 	{
 		if (_TR_ANY_Y < (_A2VIDEO_SHR_SCANLINES + 2 * borders_h_scanlines))
@@ -694,50 +834,48 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 			vrams_write->vram_shr[GetVramWidthSHR() * _TR_ANY_Y] = 0x10;
 			vrams_write->vram_shr[vramSHRInterlaceOffset + GetVramWidthSHR() * _TR_ANY_Y] = 0x10;
 
-			if (vrams_write->mode == A2Mode_e::MERGED)
+			// Merge mode calculations, done for every frame so that a switch to merged mode
+			// already has the mode of all the previous lines. It's a single value per line.
+			// determine the mode switch and update merge_last_change_mode and merge_last_change_y
+			auto _curr_mode = (memMgr->IsSoftSwitch(A2SS_SHR) ? A2Mode_e::SHR : A2Mode_e::LEGACY);
+			if ((merge_last_change_mode == A2Mode_e::LEGACY) && (_curr_mode == A2Mode_e::SHR))
 			{
-				// Merge mode calculations
-				// determine the mode switch and update merge_last_change_mode and merge_last_change_y
-				auto _curr_mode = (memMgr->IsSoftSwitch(A2SS_SHR) ? A2Mode_e::SHR : A2Mode_e::LEGACY);
-				if ((merge_last_change_mode == A2Mode_e::LEGACY) && (_curr_mode == A2Mode_e::SHR))
-				{
-					// 14 -> 16MHz
-					merge_last_change_y = _TR_ANY_Y;
-					// std::cerr << "merge to 16 " << merge_last_change_y << std::endl;
-				}
-				else if ((merge_last_change_mode == A2Mode_e::SHR) && (_curr_mode == A2Mode_e::LEGACY))
-				{
-					// 16 -> 14MHz
-					merge_last_change_y = _TR_ANY_Y;
-					// std::cerr << "merge to 14 " << merge_last_change_y << std::endl;
-				}
-				merge_last_change_mode = _curr_mode;
+				// 14 -> 16MHz
+				merge_last_change_y = _TR_ANY_Y;
+				// std::cerr << "merge to 16 " << merge_last_change_y << std::endl;
+			}
+			else if ((merge_last_change_mode == A2Mode_e::SHR) && (_curr_mode == A2Mode_e::LEGACY))
+			{
+				// 16 -> 14MHz
+				merge_last_change_y = _TR_ANY_Y;
+				// std::cerr << "merge to 14 " << merge_last_change_y << std::endl;
+			}
+			merge_last_change_mode = _curr_mode;
 
-				// Finally set the offset
-				// NOTE: We add 10.f to the offset so that the shader can know which mode to apply
-				//		 If it's negative, it's Legacy. Positive, SHR.
-				if (bNoMergedModeWobble)
+			// Finally set the offset
+			// NOTE: We add 10.f to the offset so that the shader can know which mode to apply
+			//		 If it's negative, it's Legacy. Positive, SHR.
+			if (bNoMergedModeWobble)
+			{
+				vrams_write->offset_buffer[_TR_ANY_Y] = (_curr_mode == A2Mode_e::LEGACY ? -10.f : 10.f);
+			}
+			else
+			{
+				if (_TR_ANY_Y < merge_last_change_y					// the switch happened last frame
+					|| (_TR_ANY_Y - merge_last_change_y) > 15)		// the switch has been recovered
 				{
 					vrams_write->offset_buffer[_TR_ANY_Y] = (_curr_mode == A2Mode_e::LEGACY ? -10.f : 10.f);
 				}
 				else
 				{
-					if (_TR_ANY_Y < merge_last_change_y					// the switch happened last frame
-						|| (_TR_ANY_Y - merge_last_change_y) > 15)		// the switch has been recovered
-					{
-						vrams_write->offset_buffer[_TR_ANY_Y] = (_curr_mode == A2Mode_e::LEGACY ? -10.f : 10.f);
-					}
+					// If the change is to 28 MHz, shift negative (left). Otherwise, shift positive (right)
+					float pixelShift = (GLfloat)glm::pow(glm::exp(merge_last_change_y - _TR_ANY_Y + 15), bWobblePower) - 1.0;
+					if (_curr_mode == A2Mode_e::LEGACY)
+						vrams_write->offset_buffer[_TR_ANY_Y] = -(10.f + pixelShift);
 					else
-					{
-						// If the change is to 28 MHz, shift negative (left). Otherwise, shift positive (right)
-						float pixelShift = (GLfloat)glm::pow(glm::exp(merge_last_change_y - _TR_ANY_Y + 15), bWobblePower) - 1.0;
-						if (_curr_mode == A2Mode_e::LEGACY)
-							vrams_write->offset_buffer[_TR_ANY_Y] = -(10.f + pixelShift);
-						else
-							vrams_write->offset_buffer[_TR_ANY_Y] = 10.f + pixelShift;
-					}
-					// std::cerr << "Offset: " << vrams_write->offset_buffer[_TR_ANY_Y] << " y: " << _TR_ANY_Y << std::endl;
+						vrams_write->offset_buffer[_TR_ANY_Y] = 10.f + pixelShift;
 				}
+				// std::cerr << "Offset: " << vrams_write->offset_buffer[_TR_ANY_Y] << " y: " << _TR_ANY_Y << std::endl;
 			}
 		}
 
@@ -764,7 +902,7 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 			vrams_write->mode = A2Mode_e::SHR;
 			break;
 		case A2Mode_e::LEGACY:
-			SwitchToMergedMode(_y);
+			SwitchToMergedMode();
 			break;
 		default:
 			break;
@@ -835,100 +973,13 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 				memset(lineInterlaceStartPtr + _COLORBYTESOFFSET + (_TR_ANY_X * 4), (uint8_t)memMgr->switch_c034, 4);
 			break;
 		case BeamState_e::CONTENT:
-		{
 			if (_x < CYCLES_SC_HBL || _y >= mode_scanlines)
 			{
 				// Somehow in the middle of the frame the mode was switched, and we're beyond the
 				// legacy content area. Disregard.
 				break;
 			}
-			// Get the color info for the 4 bytes where the beam is
-			auto xfb = (_x - CYCLES_SC_HBL) * 4;	// the x first byte, given that every beam cycle renders 4 bytes
-			auto scb = lineStartPtr[0];
-			memcpy(lineStartPtr + _COLORBYTESOFFSET + _TR_ANY_X * 4,
-				memPtr + _A2VIDEO_SHR_START + _y * _A2VIDEO_SHR_BYTES_PER_LINE + xfb, 4);
-			if (!(scb & 0x80u) && (scb & 0x20u))	// 320 mode and colorfill
-			{
-				// Pre-calculate colorfill, so that the shader doesn't have to do it
-				// It's completely wasted on the shader. Here it's much more efficient
-				for (uint32_t i = 0; i < 4; i++)
-				{
-					auto byteColor = lineStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i];
-					// if the first color of the byte is 0, give it the last color of the previous byte
-					// assuming this is not the first byte of the line
-					if (((byteColor & 0xF0) == 0) && ((xfb + i) != 0))
-						byteColor |= (lineStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i - 1] & 0b1111) << 4;
-					// if the second color of the byte is 0, give it the first color of the byte
-					if ((byteColor & 0x0F) == 0)
-						byteColor |= (byteColor >> 4);
-					lineStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i] = byteColor;
-				}
-			}
-			// Here deal with the new SHR4 mode PAL256, where each byte is an index into the full palette
-			// of 256 colors. We have to do it here because the palette can be dynamically modified while
-			// racing the beam.
-			if (((scanlineSHR4Modes & A2_VSM_SHR4PAL256) != 0) || (windowsbeam[A2VIDEOBEAM_SHR]->overrideSHR4Mode == 3))
-			{
-				// calculate x value where x is 0-40 in the content area
-				auto _x_just_content = _x - CYCLES_SC_HBL;
-				auto pal256ByteStartPtr = vrams_write->vram_pal256 + (_y * _A2VIDEO_SHR_BYTES_PER_LINE + (4 * _x_just_content))*2;
-
-				for (uint32_t i = 0; i < 4; i++)
-				{
-					// get the byte value, a pointer to the palette color
-					auto byteColor = lineStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i];
-					// get the palette color (2 bytes), the palette being all 256 colors in a single palette
-					auto paletteColorStart = memPtr + _A2VIDEO_SHR_PALETTE_START + ((uint32_t)byteColor * 2);
-					pal256ByteStartPtr[2*i] = paletteColorStart[0];
-					pal256ByteStartPtr[2*i + 1] = paletteColorStart[1];
-				}
-			}
-
-			// Do the exact same thing for double SHR if necessary, getting the data from main RAM
-			if (bShouldPageDouble)
-			{
-				scb = lineInterlaceStartPtr[0];
-				memcpy(lineInterlaceStartPtr + _COLORBYTESOFFSET + _TR_ANY_X * 4,
-					   memInterlacePtr + _A2VIDEO_SHR_START + _y * _A2VIDEO_SHR_BYTES_PER_LINE + xfb, 4);
-				if (!(scb & 0x80u) && (scb & 0x20u))	// 320 mode and colorfill
-				{
-					// Pre-calculate colorfill, so that the shader doesn't have to do it
-					// It's completely wasted on the shader. Here it's much more efficient
-					for (uint32_t i = 0; i < 4; i++)
-					{
-						auto byteColor = lineInterlaceStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i];
-						// if the first color of the byte is 0, give it the last color of the previous byte
-						// assuming this is not the first byte of the line
-						if (((byteColor & 0xF0) == 0) && ((xfb + i) != 0))
-							byteColor |= (lineInterlaceStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i - 1] & 0b1111) << 4;
-						// if the second color of the byte is 0, give it the first color of the byte
-						if ((byteColor & 0x0F) == 0)
-							byteColor |= (byteColor >> 4);
-						lineInterlaceStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i] = byteColor;
-					}
-				}
-				// Here deal with the new SHR4 mode PAL256, where each byte is an index into the full palette
-				// of 256 colors. We have to do it here because the palette can be dynamically modified while
-				// racing the beam.
-				if (((scanlineSHR4Modes & A2_VSM_SHR4PAL256) != 0) || (windowsbeam[A2VIDEOBEAM_SHR]->overrideSHR4Mode == 3))
-				{
-					// calculate x value where x is 0-40 in the content area
-					// move to the offset to the interlace area which is the second half of the vram (i.e. slide down by _A2VIDEO_SHR_SCANLINES)
-					auto _x_just_content = _x - CYCLES_SC_HBL;
-					auto pal256ByteStartPtr = vrams_write->vram_pal256 + ((_y + _A2VIDEO_SHR_SCANLINES) * _A2VIDEO_SHR_BYTES_PER_LINE + (4 * _x_just_content))*2;
-
-					for (uint32_t i = 0; i < 4; i++)
-					{
-						// get the byte value, a pointer to the palette color
-						auto byteColor = lineInterlaceStartPtr[_COLORBYTESOFFSET + (_TR_ANY_X * 4) + i];
-						// get the palette color (2 bytes), the palette being all 256 colors in a single palette
-						auto paletteColorStart = memInterlacePtr + _A2VIDEO_SHR_PALETTE_START + ((uint32_t)byteColor * 2);
-						pal256ByteStartPtr[2*i] = paletteColorStart[0];
-						pal256ByteStartPtr[2*i + 1] = paletteColorStart[1];
-					}
-				}
-			}	// end interlacing
-		}
+			BeamRenderSHRContent(_y, _x, _x);
 			break;
 		default:
 			break;
@@ -946,21 +997,11 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 		vrams_write->mode = A2Mode_e::LEGACY;
 		break;
 	case A2Mode_e::SHR:
-		SwitchToMergedMode(_y);
+		SwitchToMergedMode();
 		break;
 	default:
 		break;
 	}
-	// the flags byte is:
-	// bits 0-2: mode (TEXT, DTEXT, LGR, DLGR, HGR, DHGR, DHGRMONO, BORDER)
-	// bit 3: ALT charset for TEXT
-	// bits 4-7: border color (like in the 2gs)
-	uint8_t flags = 0;
-	// the colors byte is:
-	// bits 0-3: background color
-	// bits 4-7: foreground color
-	uint8_t colors = 0;
-	
 	bShouldPageDouble = (overrideLegacyPaging > 0 ? 1 : 0);
 
 	switch (beamState)
@@ -983,185 +1024,339 @@ void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
 			(memMgr->switch_c034 << 4) + 0b111;
 		break;
 	case BeamState_e::CONTENT:
-	{
 		if (_x < CYCLES_SC_HBL || _y >= mode_scanlines)
 		{
 			// Somehow in the middle of the frame the mode was switched, and we're beyond the
 			// legacy content area. Disregard.
 			break;
 		}
-		// Set the mode, and depending on the mode, grab the bytes
-		if (!memMgr->IsSoftSwitch(A2SS_TEXT))
+		BeamRenderLegacyContent(_y, _x, _x);
+		break;
+	default:
+		break;
+	}
+}
+
+// Copies count SHR content bytes of scanline _y, starting at byte xfb of the line, into the vram
+// at bytesPtr. Precalculates the 320 mode colorfill, and the PAL256 colors if pal256LinePtr is set.
+static void copy_shr_content_bytes(const uint8_t* lineStartPtr, uint8_t* bytesPtr, const uint8_t* memPtr,
+	uint32_t _y, uint32_t xfb, uint32_t count, uint8_t* pal256LinePtr)
+{
+	memcpy(bytesPtr, memPtr + _A2VIDEO_SHR_START + _y * _A2VIDEO_SHR_BYTES_PER_LINE + xfb, count);
+	auto scb = lineStartPtr[0];
+	if (!(scb & 0x80u) && (scb & 0x20u))	// 320 mode and colorfill
+	{
+		// Pre-calculate colorfill, so that the shader doesn't have to do it
+		// It's completely wasted on the shader. Here it's much more efficient
+		// The first pixel continues the last color of the previous byte, unless it's the start of the line
+		shr_colorfill(bytesPtr, count, (xfb != 0) ? (*(bytesPtr - 1) & 0b1111) : 0);
+	}
+	if (pal256LinePtr != nullptr)
+	{
+		// get the palette colors (2 bytes), the palette being all 256 colors in a single palette
+		shr_pal256_expand(bytesPtr, count, memPtr + _A2VIDEO_SHR_PALETTE_START, pal256LinePtr + 2 * xfb);
+	}
+}
+
+// Renders the SHR content cycles xStart to xEnd of scanline _y, using the SCB and palette
+// that were set at the start of the line
+void A2VideoManager::BeamRenderSHRContent(uint32_t _y, uint32_t xStart, uint32_t xEnd)
+{
+	auto memMgr = MemoryManager::GetInstance();
+	uint32_t _x = xStart;
+	uint8_t* lineStartPtr = vrams_write->vram_shr + GetVramWidthSHR() * _TR_ANY_Y;
+	// Every beam cycle renders 4 bytes, and the cycles are contiguous in both memory and vram
+	auto xfb = (xStart - CYCLES_SC_HBL) * 4;	// the x first byte
+	auto byteCount = (xEnd - xStart + 1) * 4;
+
+	// Here deal with the new SHR4 mode PAL256, where each byte is an index into the full palette
+	// of 256 colors. We have to do it here because the palette can be dynamically modified while
+	// racing the beam.
+	bool bPAL256 = ((scanlineSHR4Modes & A2_VSM_SHR4PAL256) != 0)
+		|| (windowsbeam[A2VIDEOBEAM_SHR] && (windowsbeam[A2VIDEOBEAM_SHR]->overrideSHR4Mode == 3));	// no windows when headless
+	copy_shr_content_bytes(lineStartPtr, lineStartPtr + _COLORBYTESOFFSET + _TR_ANY_X * 4,
+		memMgr->GetApple2MemAuxPtr(), _y, xfb, byteCount,
+		bPAL256 ? vrams_write->vram_pal256 + _y * _A2VIDEO_SHR_BYTES_PER_LINE * 2 : nullptr);
+
+	// Do the exact same thing for double SHR if necessary, getting the data from main RAM (E0)
+	// into the interlace area, which is the second half of the vrams
+	if (bShouldPageDouble)
+	{
+		uint8_t* lineInterlaceStartPtr = lineStartPtr + GetVramSizeSHR() / _INTERLACE_MULTIPLIER;
+		copy_shr_content_bytes(lineInterlaceStartPtr, lineInterlaceStartPtr + _COLORBYTESOFFSET + _TR_ANY_X * 4,
+			memMgr->GetApple2MemPtr(), _y, xfb, byteCount,
+			bPAL256 ? vrams_write->vram_pal256 + (_y + _A2VIDEO_SHR_SCANLINES) * _A2VIDEO_SHR_BYTES_PER_LINE * 2 : nullptr);
+	}
+}
+
+// Rebuilds the legacy mode descriptors from the softswitches. The flags byte is:
+// bits 0-2: mode (TEXT, DTEXT, LGR, DLGR, HGR, DHGR, DHGRMONO, BORDER)
+// bit 3: ALT charset for TEXT
+// bits 4-7: border color (like in the 2gs), added by the beam
+void A2VideoManager::UpdateLegacyModeDescs()
+{
+	auto memMgr = MemoryManager::GetInstance();
+	legacyModeDescsVersion = memMgr->GetSoftSwitchesVersion();
+
+	// The text mode, for TEXT and the bottom of mixed mode
+	uint8_t textFlags = (memMgr->IsSoftSwitch(A2SS_80COL) ? 1 : 0);	// DTEXT or TEXT
+	uint8_t flags = textFlags;
+	if (!memMgr->IsSoftSwitch(A2SS_TEXT))
+	{
+		if (memMgr->IsSoftSwitch(A2SS_80COL) && memMgr->IsSoftSwitch(A2SS_DHGR))	// double resolution
 		{
-			if (memMgr->IsSoftSwitch(A2SS_MIXED) && _y > 159)	// check mixed mode
+			if (memMgr->IsSoftSwitch(A2SS_HIRES))
 			{
-				if (memMgr->IsSoftSwitch(A2SS_80COL))
-					flags = 1;	// DTEXT
+				if (memMgr->IsSoftSwitch(A2SS_DHGRMONO))
+					flags = 6;	// DHGRMONO
 				else
-					flags = 0;	// TEXT
-			}
-			else if (memMgr->IsSoftSwitch(A2SS_80COL) && memMgr->IsSoftSwitch(A2SS_DHGR))	// double resolution
-			{
-				if (memMgr->IsSoftSwitch(A2SS_HIRES))
-				{
-					if (memMgr->IsSoftSwitch(A2SS_DHGRMONO))
-						flags = 6;	// DHGRMONO
-					else
-						flags = 5;	// DHGR
-				}
-				else
-					flags = 3;	// DLGR
-			}
-			else if (memMgr->IsSoftSwitch(A2SS_HIRES))	// standard hires
-			{
-				flags = 4;	// HGR
+					flags = 5;	// DHGR
 			}
-			else {	// standard lores
-				flags = 2;	// LGR
-			}
-		}
-		else { 	// Now check the text modes
-			if (memMgr->IsSoftSwitch(A2SS_80COL))
-				flags = 1;	// DTEXT
 			else
-			{
-				flags = 0;	// TEXT
-			}
+				flags = 3;	// DLGR
 		}
-
-		// Fill in the rest of the flags. We already use bits 0-2 for the modes
-		flags |= ((memMgr->IsSoftSwitch(A2SS_ALTCHARSET) ? 1 : 0) << 3);	// bit 3 is alt charset
-		flags |= (memMgr->switch_c034 << 4);								// bits 4-7 are border color
-		// and the colors
-		colors = memMgr->switch_c022;
-		// Check for page 2
-		bool isPage2 = false;
-		// Careful: it's only page 2 if 80STORE is off
-		if (memMgr->IsSoftSwitch(A2SS_PAGE2) && !memMgr->IsSoftSwitch(A2SS_80STORE))
-			isPage2 = true;
-
-		// Finally set the 4 VRAM bytes
-		// 4 bytes in VRAM for each beam byte
-		uint8_t* byteStartPtr = vrams_write->vram_legacy +
-			(GetVramWidthLegacy() * _TR_ANY_Y + _TR_ANY_X) * 4;
-		auto _vramInterlaceOffset = GetVramSizeLegacy() / _INTERLACE_MULTIPLIER;	// Offset to 2nd half of the vram
-		uint8_t* byteStartPtrInterlace = byteStartPtr + _vramInterlaceOffset;	// For paged mode
-		uint32_t startMem;
-		
-		// Determine where in memory we should get the data from, and get it
-		if ((flags & 0b111) < 4)	// D/TEXT AND D/LGR
+		else if (memMgr->IsSoftSwitch(A2SS_HIRES))	// standard hires
 		{
-			startMem = _A2VIDEO_TEXT1_START;
-			if (((flags & 0b111) < 3) && isPage2)		// check for page 2 (DLGR doesn't have it)
-				startMem = _A2VIDEO_TEXT2_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-			if (bShouldPageDouble)
-			{
-				startMem = _A2VIDEO_TEXT2_START;		// does nothing if already in page 2
-				byteStartPtrInterlace[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-				byteStartPtrInterlace[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-			}
+			flags = 4;	// HGR
 		}
-		else {		// D/HIRES
-			startMem = _A2VIDEO_HGR1_START;
-			if (isPage2)
-				startMem = _A2VIDEO_HGR2_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-			if (bShouldPageDouble)
-			{
-				startMem = _A2VIDEO_HGR2_START;		// does nothing if already in page 2
-				byteStartPtrInterlace[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-				byteStartPtrInterlace[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-			}
+		else {	// standard lores
+			flags = 2;	// LGR
 		}
-		byteStartPtr[2] = flags;
-		byteStartPtr[3] = colors;
-		if (bShouldPageDouble)
+	}
+	bool bIsMixed = !memMgr->IsSoftSwitch(A2SS_TEXT) && memMgr->IsSoftSwitch(A2SS_MIXED);
+
+	// Careful: it's only page 2 if 80STORE is off
+	bool isPage2 = memMgr->IsSoftSwitch(A2SS_PAGE2) && !memMgr->IsSoftSwitch(A2SS_80STORE);
+	uint8_t altCharset = ((memMgr->IsSoftSwitch(A2SS_ALTCHARSET) ? 1 : 0) << 3);	// bit 3 is alt charset
+	for (int i = 0; i < 2; ++i)
+	{
+		auto& desc = legacyModeDescs[i];
+		desc.flags = ((i == 1 && bIsMixed) ? textFlags : flags) | altCharset;
+		// Determine where in memory we should get the data from
+		if ((desc.flags & 0b111) < 4)	// D/TEXT AND D/LGR
 		{
-			byteStartPtrInterlace[2] = flags;
-			byteStartPtrInterlace[3] = colors;
+			desc.startMem = _A2VIDEO_TEXT1_START;
+			if (((desc.flags & 0b111) < 3) && isPage2)		// check for page 2 (DLGR doesn't have it)
+				desc.startMem = _A2VIDEO_TEXT2_START;
+			desc.startMemInterlace = _A2VIDEO_TEXT2_START;
+			desc.lineOffsets = g_RAM_TEXTLineOffsets.data();
 		}
+		else {		// D/HIRES
+			desc.startMem = (isPage2 ? _A2VIDEO_HGR2_START : _A2VIDEO_HGR1_START);
+			desc.startMemInterlace = _A2VIDEO_HGR2_START;
+			desc.lineOffsets = g_RAM_HGROffsets;
+		}
+	}
+}
+
+// Renders the legacy content cycles xStart to xEnd of scanline _y
+void A2VideoManager::BeamRenderLegacyContent(uint32_t _y, uint32_t xStart, uint32_t xEnd)
+{
+	auto memMgr = MemoryManager::GetInstance();
+	if (legacyModeDescsVersion != memMgr->GetSoftSwitchesVersion())
+		UpdateLegacyModeDescs();
+	const auto& desc = legacyModeDescs[_y > 159 ? 1 : 0];	// check mixed mode
+
+	// The mode flags, plus the border color in bits 4-7
+	uint8_t flags = desc.flags | (memMgr->switch_c034 << 4);
+	// the colors byte is:
+	// bits 0-3: background color
+	// bits 4-7: foreground color
+	uint8_t colors = memMgr->switch_c022;
+	uint32_t startMem = desc.startMem;
+	uint32_t startMemInterlace = desc.startMemInterlace;	// for paged mode, does nothing if already in page 2
+	uint32_t lineOffset = desc.lineOffsets[_y];
+	auto memPtr = memMgr->GetApple2MemPtr();
+	auto memAuxPtr = memMgr->GetApple2MemAuxPtr();
+	auto _vramInterlaceOffset = GetVramSizeLegacy() / _INTERLACE_MULTIPLIER;	// Offset to 2nd half of the vram
+
+	// The content cycles are contiguous in both memory and vram
+	uint32_t _x = xStart;
+	uint32_t _xcStart = xStart - CYCLES_SC_HBL;	// x in the content area
+	uint32_t _count = xEnd - xStart + 1;
+	// 4 bytes in VRAM for each beam byte
+	uint8_t* lineVramPtr = vrams_write->vram_legacy + (GetVramWidthLegacy() * _TR_ANY_Y + _TR_ANY_X) * 4;
+	const uint8_t* lineMemPtr = memPtr + startMem + lineOffset + _xcStart;
+	const uint8_t* lineMemAuxPtr = memAuxPtr + startMem + lineOffset + _xcStart;
+	legacy_cycles_interleave(lineVramPtr, lineMemPtr, lineMemAuxPtr, _count, flags, colors);
+	if (bShouldPageDouble)
+	{
+		lineVramPtr += _vramInterlaceOffset;
+		lineMemPtr = memPtr + startMemInterlace + lineOffset + _xcStart;
+		lineMemAuxPtr = memAuxPtr + startMemInterlace + lineOffset + _xcStart;
+		legacy_cycles_interleave(lineVramPtr, lineMemPtr, lineMemAuxPtr, _count, flags, colors);
+	}
 
+	if (!(bRenderTEXT1 || bRenderTEXT2 || bRenderHGR1 || bRenderHGR2))
+		return;
+	for (uint32_t _xc = _xcStart; _xc < _xcStart + _count; ++_xc)
+	{
+		uint8_t* byteStartPtr;
 		// Generate the debug VRAMs if necessary
 		if (bRenderTEXT1)
 		{
-			byteStartPtr = vrams_write->vram_forced_text1 + (40 * _y + _x - CYCLES_SC_HBL) * 4;
-			startMem = _A2VIDEO_TEXT1_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
+			byteStartPtr = vrams_write->vram_forced_text1 + (40 * _y + _xc) * 4;
+			byteStartPtr[0] = memPtr[_A2VIDEO_TEXT1_START + g_RAM_TEXTOffsets[_y / 8] + _xc];
+			byteStartPtr[1] = memAuxPtr[_A2VIDEO_TEXT1_START + g_RAM_TEXTOffsets[_y / 8] + _xc];
 			byteStartPtr[2] = (flags & 0b1111'1000) | 0;	// force TEXT
 			byteStartPtr[3] = colors;
 		}
 		if (bRenderTEXT2)
 		{
-			byteStartPtr = vrams_write->vram_forced_text2 + (40 * _y + _x - CYCLES_SC_HBL) * 4;
-			startMem = _A2VIDEO_TEXT2_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_TEXTOffsets[_y / 8] + (_x - CYCLES_SC_HBL));
+			byteStartPtr = vrams_write->vram_forced_text2 + (40 * _y + _xc) * 4;
+			byteStartPtr[0] = memPtr[_A2VIDEO_TEXT2_START + g_RAM_TEXTOffsets[_y / 8] + _xc];
+			byteStartPtr[1] = memAuxPtr[_A2VIDEO_TEXT2_START + g_RAM_TEXTOffsets[_y / 8] + _xc];
 			byteStartPtr[2] = (flags & 0b1111'1000) | 0;	// force TEXT
 			byteStartPtr[3] = colors;
 		}
 		if (bRenderHGR1)
 		{
-			byteStartPtr = vrams_write->vram_forced_hgr1 + (40 * _y + _x - CYCLES_SC_HBL) * 4;
-			startMem = _A2VIDEO_HGR1_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
+			byteStartPtr = vrams_write->vram_forced_hgr1 + (40 * _y + _xc) * 4;
+			byteStartPtr[0] = memPtr[_A2VIDEO_HGR1_START + g_RAM_HGROffsets[_y] + _xc];
+			byteStartPtr[1] = memAuxPtr[_A2VIDEO_HGR1_START + g_RAM_HGROffsets[_y] + _xc];
 			byteStartPtr[2] = (flags & 0b1111'1000) | 4;	// force HGR
 			byteStartPtr[3] = colors;
 		}
 		if (bRenderHGR2)
 		{
-			byteStartPtr = vrams_write->vram_forced_hgr2 + (40 * _y + _x - CYCLES_SC_HBL) * 4;
-			startMem = _A2VIDEO_HGR2_START;
-			byteStartPtr[0] = *(memMgr->GetApple2MemPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
-			byteStartPtr[1] = *(memMgr->GetApple2MemAuxPtr() + startMem + g_RAM_HGROffsets[_y] + (_x - CYCLES_SC_HBL));
+			byteStartPtr = vrams_write->vram_forced_hgr2 + (40 * _y + _xc) * 4;
+			byteStartPtr[0] = memPtr[_A2VIDEO_HGR2_START + g_RAM_HGROffsets[_y] + _xc];
+			byteStartPtr[1] = memAuxPtr[_A2VIDEO_HGR2_START + g_RAM_HGROffsets[_y] + _xc];
 			byteStartPtr[2] = (flags & 0b1111'1000) | 4;	// force HGR
 			byteStartPtr[3] = colors;
 		}
 	}
-		break;
-	default:
-		break;
+}
+
+void A2VideoManager::BeamIsAtPosition(uint32_t _x, uint32_t _y)
+{
+	// The start of a line is always rendered right away: it's where the frame flips
+	// and where the merged mode and the overlay are checked
+	if (!bLazyBeam || _x == 0)
+	{
+		BeamFlush();
+		BeamRenderCycle(_x, _y);
+		return;
 	}
+	// Queue the cycle if it continues the current run. Otherwise render the run first.
+	if ((lazyRunLength > 0) && ((_y != lazyRunY) || (_x != (lazyRunXStart + lazyRunLength))))
+		BeamFlush();
+	if (lazyRunLength == 0)
+	{
+		lazyRunY = _y;
+		lazyRunXStart = _x;
+	}
+	++lazyRunLength;
+	if (_x == (CYCLES_SC_TOTAL - 1))	// end of the line
+		BeamFlush();
 }
 
-// When we learn we're in merged mode, we need to update all previous scanlines
-// to set the offset texture data. Ideally it should all be one integrated mode
-// between legacy and SHR. But then we'd have to always update the offset texture
-// to handle the wobble and remember the state, etc... That's a lot of work every
-// scanline for the _very_ rare case of merged mode which is only used in demos.
-void A2VideoManager::SwitchToMergedMode(uint32_t scanline)
+void A2VideoManager::BeamIsAtRun(uint32_t _xStart, uint32_t _xEnd, uint32_t _y)
 {
-	if (bIsSwitchingToMergedMode)
+	if (!bLazyBeam)
+	{
+		BeamFlush();
+		for (uint32_t _x = _xStart; _x <= _xEnd; ++_x)
+			BeamRenderCycle(_x, _y);
 		return;
-	bIsSwitchingToMergedMode = true;
-	// set the vrams write mode, and flip the A2SS_SHR softswitch to the previous
-	// setting to rerun the scanlines, before returning it to its current state
-	vrams_write->mode = A2Mode_e::MERGED;
-	auto memMgr = MemoryManager::GetInstance();
-	memMgr->SetSoftSwitch(A2SS_SHR, !memMgr->IsSoftSwitch(A2SS_SHR));
-	auto totalscanlines = (current_region == VideoRegion_e::NTSC ? SC_TOTAL_NTSC : SC_TOTAL_PAL);
-	int starty = _SCANLINE_START_FRAME + 2;
-	beamState = BeamState_e::NBVBLANK;
-	for (uint32_t y = starty; y < totalscanlines; y++)
+	}
+	// Extend the queued run like BeamIsAtPosition() would, one cycle at a time
+	if ((lazyRunLength > 0) && ((_y != lazyRunY) || (_xStart != (lazyRunXStart + lazyRunLength))))
+		BeamFlush();
+	if (lazyRunLength == 0)
 	{
-		for (uint32_t x = 0; x < 65; x++)
-		{
-			this->BeamIsAtPosition(x, y);
-		}
+		lazyRunY = _y;
+		lazyRunXStart = _xStart;
 	}
-	for (uint32_t y = 0; y < scanline; y++)
+	lazyRunLength += _xEnd - _xStart + 1;
+	if (_xEnd == (CYCLES_SC_TOTAL - 1))	// end of the line
+		BeamFlush();
+}
+
+void A2VideoManager::BeamFlush()
+{
+	if (lazyRunLength == 0)
+		return;
+	uint32_t xEnd = lazyRunXStart + lazyRunLength - 1;
+	lazyRunLength = 0;
+	BeamRenderRun(lazyRunY, lazyRunXStart, xEnd);
+}
+
+// Renders a whole line as if BeamIsAtPosition() were called for each of its cycles, with
+// no bus event in between: the line start as a single cycle, and the rest as one run.
+void A2VideoManager::BeamRenderLine(uint32_t _yBeam)
+{
+	BeamFlush();
+	BeamRenderCycle(0, _yBeam);
+	BeamRenderRun(_yBeam, 1, CYCLES_SC_TOTAL - 1);
+}
+
+// Renders the cycles xStart to xEnd of a line, during which nothing the beam reads has changed
+void A2VideoManager::BeamRenderRun(uint32_t _yBeam, uint32_t xStart, uint32_t xEnd)
+{
+	if (!bIsReady || bIsRebooting)
+		return;
+
+	auto memMgr = MemoryManager::GetInstance();
+	// The Apple 2gs drawing is shifted 6 scanlines down, as in BeamRenderCycle()
+	uint32_t _y = _yBeam;
+	if (memMgr->is2gs)
+		_y = (_y + region_scanlines - 6) % region_scanlines;
+	bool bIsOverlayLine = (_y < COUNT_SC_CONTENT) && (overlay_lines[_y / 8] == 1);
+
+	// The content and blanking cycles, where the beam state doesn't change, are done here all at once.
+	// Any other cycle goes through BeamRenderCycle() exactly as if it weren't deferred.
+	for (uint32_t _x = xStart; _x <= xEnd; ++_x)
 	{
-		for (uint32_t x = 0; x < 65; x++)
+		uint32_t mode_scanlines = (memMgr->IsSoftSwitch(A2SS_SHR) ? 200 : 192);
+		switch (beamState)
 		{
-			this->BeamIsAtPosition(x, y);
+		case BeamState_e::CONTENT:
+			// CONTENT lasts until the end of the line, so the rest of the run is content
+			if (_x <= CYCLES_SC_HBL || _y >= mode_scanlines || bIsOverlayLine)
+				break;
+			if (bSkipBeamFrame)
+				return;
+			if (memMgr->IsSoftSwitch(A2SS_SHR))
+			{
+				if (vrams_write->mode == A2Mode_e::LEGACY)
+					SwitchToMergedMode();
+				if (vrams_write->mode == A2Mode_e::NONE)
+					vrams_write->mode = A2Mode_e::SHR;
+				BeamRenderSHRContent(_y, _x, xEnd);
+			}
+			else
+			{
+				if (vrams_write->mode == A2Mode_e::SHR)
+					SwitchToMergedMode();
+				if (vrams_write->mode == A2Mode_e::NONE)
+					vrams_write->mode = A2Mode_e::LEGACY;
+				bShouldPageDouble = (overrideLegacyPaging > 0 ? 1 : 0);
+				BeamRenderLegacyContent(_y, _x, xEnd);
+			}
+			return;
+		case BeamState_e::NBHBLANK:
+			if (_x >= borders_w_cycles && _x < (CYCLES_SC_HBL - borders_w_cycles))
+				continue;
+			break;
+		case BeamState_e::NBVBLANK:
+			if (_y >= (mode_scanlines + borders_h_scanlines) && _y < (region_scanlines - borders_h_scanlines))
+				continue;
+			break;
+		default:
+			break;
 		}
+		BeamRenderCycle(_x, _yBeam);
 	}
-	memMgr->SetSoftSwitch(A2SS_SHR, !memMgr->IsSoftSwitch(A2SS_SHR));
-	bIsSwitchingToMergedMode = false;
+}
+
+// When we learn we're in merged mode, the previous scanlines are already complete:
+// each was drawn in its vram, and tagged with its mode in the offset buffer at its
+// start. The renderer picks each line's source from that tag, so there's nothing to
+// redo, whatever the number of switches in the frame.
+void A2VideoManager::SwitchToMergedMode()
+{
+	vrams_write->mode = A2Mode_e::MERGED;
 }
 
 void A2VideoManager::ForceBeamFullScreenRender(const uint64_t numFrames)
@@ -1170,16 +1365,13 @@ void A2VideoManager::ForceBeamFullScreenRender(const uint64_t numFrames)
 	auto totalscanlines = (current_region == VideoRegion_e::NTSC ? SC_TOTAL_NTSC : SC_TOTAL_PAL);
 	// Start 2 lines after the frame flip in the VBLANK non-border area
 	// and end 1 line after the frame flip, so we guarantee a clean frame flip
+	// Nothing changes memory during the frame, so each line is rendered whole.
 	int starty = _SCANLINE_START_FRAME + 2;
+	BeamFlush();
 	beamState = BeamState_e::NBVBLANK;
 
 	for (uint32_t y = starty; y < totalscanlines * numFrames; y++)
-	{
-		for (uint32_t x = 0; x < 65; x++)
-		{
-			this->BeamIsAtPosition(x, y);
-		}
-	}
+		this->BeamRenderLine(y);
 	for (uint32_t y = 0; y < starty; y++)
 	{
 		// For testing the merged mode
@@ -1190,16 +1382,150 @@ void A2VideoManager::ForceBeamFullScreenRender(const uint64_t numFrames)
 			if (y == 130)
 				MemoryManager::GetInstance()->SetSoftSwitch(A2SS_SHR, !MemoryManager::GetInstance()->IsSoftSwitch(A2SS_SHR));
 		}
-		for (uint32_t x = 0; x < 65; x++)
-		{
-			this->BeamIsAtPosition(x, y);
-		}
+		this->BeamRenderLine(y);
 	}
 	// std::cerr << "finished FBFSR" << std::endl;
 	// the y value _SCANLINE_START_FRAME flips the frame
 
 }
 
+bool A2VideoManager::BenchmarkBeam(const uint32_t numFrames)
+{
+	auto totalscanlines = (current_region == VideoRegion_e::NTSC ? SC_TOTAL_NTSC : SC_TOTAL_PAL);
+	int starty = _SCANLINE_START_FRAME + 2;
+	const bool _bLazyBeam = bLazyBeam;
+	BeamFlush();
+
+	// The vram areas a frame writes to, to compare the beams
+	const size_t _pal256Size = _A2VIDEO_SHR_BYTES_PER_LINE * 2 * _A2VIDEO_SHR_SCANLINES * _INTERLACE_MULTIPLIER;
+	std::pair<uint8_t*, size_t> _areas[] = {
+		{ vrams_write->vram_legacy, GetVramSizeLegacy() },
+		{ vrams_write->vram_shr, GetVramSizeSHR() },
+		{ vrams_write->vram_pal256, _pal256Size },
+		{ reinterpret_cast<uint8_t*>(vrams_write->offset_buffer), GetVramHeightSHR() * sizeof(GLfloat) },
+		{ vrams_write->vram_forced_text1, 40 * 192 * 4 },
+		{ vrams_write->vram_forced_text2, 40 * 192 * 4 },
+		{ vrams_write->vram_forced_hgr1, 40 * 192 * 4 },
+		{ vrams_write->vram_forced_hgr2, 40 * 192 * 4 },
+	};
+
+	// Render one frame up to just before the flip, from the same starting state for all beams.
+	// beamType is 0 for the per-cycle beam, 1 for the lazy beam, and 2 for the line builder.
+	// The vrams are cleared first so that any byte a beam misses shows up in the comparison.
+	const auto _scanlineSHR4Modes = scanlineSHR4Modes;
+	const auto _bShouldPageDouble = bShouldPageDouble;
+	const auto _mergeLastChangeMode = merge_last_change_mode;
+	auto _renderFrameForCompare = [&](int beamType) {
+		for (auto& area : _areas)
+			memset(area.first, 0, area.second);
+		vrams_write->mode = A2Mode_e::NONE;
+		vrams_write->frameSHR4Modes = 0;
+		vrams_write->pagedMode = 0;
+		scanlineSHR4Modes = _scanlineSHR4Modes;
+		bShouldPageDouble = _bShouldPageDouble;
+		merge_last_change_mode = _mergeLastChangeMode;
+		merge_last_change_y = UINT_MAX;
+		beamState = BeamState_e::NBVBLANK;
+		bLazyBeam = (beamType != 0);
+		for (uint32_t y = starty; y < totalscanlines + _SCANLINE_START_FRAME; y++)
+		{
+			if (beamType == 2)
+				this->BeamRenderLine(y % totalscanlines);
+			else
+				for (uint32_t x = 0; x < 65; x++)
+					this->BeamIsAtPosition(x, y % totalscanlines);
+		}
+		BeamFlush();
+	};
+	std::vector<uint8_t> _cycleVrams;
+	_renderFrameForCompare(0);
+	for (auto& area : _areas)
+		_cycleVrams.insert(_cycleVrams.end(), area.first, area.first + area.second);
+	auto _cycleMode = vrams_write->mode;
+	bBeamBenchmarkMatches = true;
+	for (int beamType = 1; beamType < 3; beamType++)
+	{
+		_renderFrameForCompare(beamType);
+		if (vrams_write->mode != _cycleMode)
+			bBeamBenchmarkMatches = false;
+		size_t _offset = 0;
+		for (auto& area : _areas)
+		{
+			if (memcmp(_cycleVrams.data() + _offset, area.first, area.second) != 0)
+				bBeamBenchmarkMatches = false;
+			_offset += area.second;
+		}
+	}
+
+	// Now time full frames, flips included, with each beam
+	for (int i = 0; i < 3; i++)
+	{
+		bLazyBeam = (i != 0);
+		beamState = BeamState_e::NBVBLANK;
+		auto _tstart = std::chrono::steady_clock::now();
+		for (uint32_t f = 0; f < numFrames; f++)
+			for (uint32_t y = 0; y < totalscanlines; y++)
+			{
+				if (i == 2)
+					this->BeamRenderLine((y + starty) % totalscanlines);
+				else
+					for (uint32_t x = 0; x < 65; x++)
+						this->BeamIsAtPosition(x, (y + starty) % totalscanlines);
+			}
+		BeamFlush();
+		auto _duration = std::chrono::steady_clock::now() - _tstart;
+		beamBenchmarkUsPerFrame[i] = std::chrono::duration<double, std::micro>(_duration).count() / numFrames;
+	}
+	bLazyBeam = _bLazyBeam;
+	bBeamBenchmarkDone = true;
+	std::cout << "Beam benchmark over " << numFrames << " frames: per-cycle " << beamBenchmarkUsPerFrame[0]
+		<< " us/frame, lazy " << beamBenchmarkUsPerFrame[1] << " us/frame, line builder "
+		<< beamBenchmarkUsPerFrame[2] << " us/frame, output "
+		<< (bBeamBenchmarkMatches ? "identical" : "DIFFERENT") << std::endl;
+	this->ForceBeamFullScreenRender();
+	return bBeamBenchmarkMatches;
+}
+
+void A2VideoManager::BenchmarkMergedMode(const uint32_t flipLines, const uint32_t numFrames)
+{
+	auto memMgr = MemoryManager::GetInstance();
+	auto totalscanlines = (current_region == VideoRegion_e::NTSC ? SC_TOTAL_NTSC : SC_TOTAL_PAL);
+	int starty = _SCANLINE_START_FRAME + 2;
+	const uint32_t _flipLines = std::max(flipLines, 1u);
+	const bool _bSHR = memMgr->IsSoftSwitch(A2SS_SHR);
+	BeamFlush();
+	beamState = BeamState_e::NBVBLANK;
+
+	double _totalUs = 0.0;
+	double _worstUs = 0.0;
+	for (uint32_t f = 0; f < numFrames; f++)
+	{
+		auto _tstart = std::chrono::steady_clock::now();
+		for (uint32_t y = 0; y < totalscanlines; y++)
+		{
+			uint32_t _y = (y + starty) % totalscanlines;
+			// Every frame starts in the current mode and flips every _flipLines content lines
+			bool _bLineSHR = (_y < _A2VIDEO_SHR_SCANLINES) ? (_bSHR != (((_y / _flipLines) & 1) == 1)) : _bSHR;
+			if (memMgr->IsSoftSwitch(A2SS_SHR) != _bLineSHR)
+				memMgr->SetSoftSwitch(A2SS_SHR, _bLineSHR);
+			for (uint32_t x = 0; x < 65; x++)
+				this->BeamIsAtPosition(x, _y);
+		}
+		BeamFlush();
+		double _us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _tstart).count();
+		_totalUs += _us;
+		_worstUs = std::max(_worstUs, _us);
+	}
+	memMgr->SetSoftSwitch(A2SS_SHR, _bSHR);
+	mergedBenchmarkUsPerFrame[0] = (numFrames > 0 ? _totalUs / numFrames : 0.0);
+	mergedBenchmarkUsPerFrame[1] = _worstUs;
+	bMergedBenchmarkDone = true;
+	std::cout << "Merged mode benchmark over " << numFrames << " frames, flipping every " << _flipLines
+		<< " lines: " << mergedBenchmarkUsPerFrame[0] << " us/frame, worst " << mergedBenchmarkUsPerFrame[1]
+		<< " us" << std::endl;
+	this->ForceBeamFullScreenRender();
+}
+
 bool A2VideoManager::SelectLegacyShader(const int index)
 {
 	switch (index)
@@ -1358,6 +1684,46 @@ void A2VideoManager::CreateOrResizeFramebuffer(int fb_width, int fb_height)
 	// std::cerr << "Generated two FBOs with size " << fb_width << " x " << fb_height << std::endl;
 }
 
+// Hashes everything that determines the output of Render() for the read frame: the vrams
+// used by the frame's mode, and the render parameters. When a program sits at a prompt the
+// beam keeps producing identical frames, which then all have the same hash.
+uint64_t A2VideoManager::HashReadFrame()
+{
+	uint64_t _hash = 0;
+	auto _hashBytes = [&_hash](const void* data, size_t len) {
+		_hash = (_hash ^ dirtyrows_hash_row(reinterpret_cast<const uint8_t*>(data), len)) * 0xFF51AFD7ED558CCDull;
+		_hash ^= _hash >> 32;
+	};
+
+	if ((vrams_read->mode == A2Mode_e::LEGACY) || (vrams_read->mode == A2Mode_e::MERGED))
+		_hashBytes(vrams_read->vram_legacy, GetVramSizeLegacy());
+	if ((vrams_read->mode == A2Mode_e::SHR) || (vrams_read->mode == A2Mode_e::MERGED))
+	{
+		_hashBytes(vrams_read->vram_shr, GetVramSizeSHR());
+		_hashBytes(vrams_read->vram_pal256, _A2VIDEO_SHR_BYTES_PER_LINE * 2 * _A2VIDEO_SHR_SCANLINES * _INTERLACE_MULTIPLIER);
+	}
+	if (vrams_read->mode == A2Mode_e::MERGED)
+		_hashBytes(vrams_read->offset_buffer, GetVramHeightSHR() * sizeof(GLfloat));
+	if (vidhdWindowBeam->GetVideoMode() != VIDHDMODE_NONE)
+		_hash ^= vidhdWindowBeam->HashVRAM();
+
+	const bool _bPaging = (windowsbeam[A2VIDEOBEAM_LEGACY]->pagingMode != DOUBLE_NONE) || (vrams_read->pagedMode != DOUBLE_NONE);
+	const int32_t _params[] = {
+		(int32_t)vrams_read->mode, vrams_read->frameSHR4Modes, vrams_read->pagedMode,
+		eA2MonitorType, bUseDHGRCOL140Mixed, bUseHGRSPEC1, bUseHGRSPEC2, bForceSHRWidth, bAlignQuadsToScanline,
+		overrideDoubleSHR, (int32_t)vidhdWindowBeam->GetVideoMode(),
+		windowsbeam[A2VIDEOBEAM_LEGACY]->pagingMode, windowsbeam[A2VIDEOBEAM_LEGACY]->specialModesMask,
+		windowsbeam[A2VIDEOBEAM_SHR]->overrideSHR4Mode, windowsbeam[A2VIDEOBEAM_SHR]->specialModesMask,
+		p_b_ntsc, p_b_ntscNoFilterMono,
+		(int32_t)((SDL_GetTicks() / 310) & 1),				// the text flash phase of the shaders
+		(int32_t)(_bPaging ? (current_frame_idx & 1) : 0)	// the page shown by the shaders
+	};
+	_hashBytes(_params, sizeof(_params));
+	const float _fparams[] = { p_f_ntscCombStrength, p_f_ntscGammaCorrection };
+	_hashBytes(_fparams, sizeof(_fparams));
+	return _hash;
+}
+
 bool A2VideoManager::Render(GLuint &_texUnit)
 {
 	// We first render both the legacy and shr "windows" as textures
@@ -1373,6 +1739,9 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 		return false;
 	}
 
+	// Pick up the next frame from the beam, if there is one
+	AcquireReadFrame();
+
 	// Exit if we've already rendered the buffer
 	if ((rendered_frame_idx == vrams_read->frame_idx) && !bAlwaysRenderBuffer)
 	{
@@ -1380,7 +1749,24 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 		return false;
 	}
 	if ((rendered_frame_idx == vrams_read->frame_idx) && bAlwaysRenderBuffer)
+	{
 		this->ForceBeamFullScreenRender();
+		AcquireReadFrame();
+	}
+
+	// Skip the whole render if the frame would render the same as the last one, the
+	// previous output texture is still bound for the postprocessor. The debug textures
+	// come from other vrams and always render.
+	const uint64_t _frameHash = HashReadFrame();
+	if ((_frameHash == rendered_frame_hash) && !bAlwaysRenderBuffer && !bShouldInitializeRender
+		&& !(bRenderTEXT1 || bRenderTEXT2 || bRenderHGR1 || bRenderHGR2))
+	{
+		rendered_frame_idx = vrams_read->frame_idx;
+		vram_bytes_uploaded = 0;
+		++static_frames_skipped;
+		_texUnit = _TEXUNIT_POSTPROCESS;
+		return false;
+	}
 
 	GLenum glerr;
 
@@ -1507,6 +1893,9 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 	if (vrams_read->mode == A2Mode_e::MERGED)
 		PrepareOffsetTexture();
 
+	// Bytes of vram sent to the GPU this frame. The windows only upload the rows that changed.
+	size_t _vramBytesUploaded = 0;
+
 	// ===============================================================================
 	// ============================= LEGACY MODE RENDER ==============================
 	// ===============================================================================
@@ -1539,6 +1928,7 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 			glClear(GL_COLOR_BUFFER_BIT);
 		}
 		windowsbeam[A2VIDEOBEAM_LEGACY]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_LEGACY]->GetBytesUploaded();
 		if (p_b_ntsc)
 		{
 			glBindFramebuffer(GL_FRAMEBUFFER, FBO_A2Video);
@@ -1572,6 +1962,7 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 		windowsbeam[A2VIDEOBEAM_SHR]->monitorColorType = eA2MonitorType;
 		windowsbeam[A2VIDEOBEAM_SHR]->bIsMergedMode = (vrams_read->mode == A2Mode_e::MERGED);
 		windowsbeam[A2VIDEOBEAM_SHR]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_SHR]->GetBytesUploaded();
 		// std::cerr << "Rendered SHR to viewport " << fb_width << "x" << fb_height << " - " << current_frame_idx << std::endl;
 		if ((glerr = glGetError()) != GL_NO_ERROR) {
 			std::cerr << "SHR Mode draw error: " << glerr << std::endl;
@@ -1583,6 +1974,7 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 	if (vidhdWindowBeam->GetVideoMode() != VIDHDMODE_NONE)	// VidHD
 	{
 		vidhdWindowBeam->Render();
+		_vramBytesUploaded += vidhdWindowBeam->GetBytesUploaded();
 		if ((glerr = glGetError()) != GL_NO_ERROR) {
 			std::cerr << "VidHD draw error: " << glerr << std::endl;
 		}
@@ -1613,29 +2005,38 @@ bool A2VideoManager::Render(GLuint &_texUnit)
 		glViewport(0, 0, _A2VIDEO_LEGACY_WIDTH, _A2VIDEO_LEGACY_HEIGHT);
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO_debug[0]);
 		windowsbeam[A2VIDEOBEAM_FORCED_TEXT1]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_FORCED_TEXT1]->GetBytesUploaded();
 	}
 	if (bRenderTEXT2) {
 		glViewport(0, 0, _A2VIDEO_LEGACY_WIDTH, _A2VIDEO_LEGACY_HEIGHT);
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO_debug[1]);
 		windowsbeam[A2VIDEOBEAM_FORCED_TEXT2]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_FORCED_TEXT2]->GetBytesUploaded();
 	}
 	if (bRenderHGR1) {
 		glViewport(0, 0, _A2VIDEO_LEGACY_WIDTH, _A2VIDEO_LEGACY_HEIGHT);
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO_debug[2]);
 		windowsbeam[A2VIDEOBEAM_FORCED_HGR1]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_FORCED_HGR1]->GetBytesUploaded();
 	}
 	if (bRenderHGR2) {
 		glViewport(0, 0, _A2VIDEO_LEGACY_WIDTH, _A2VIDEO_LEGACY_HEIGHT);
 		glBindFramebuffer(GL_FRAMEBUFFER, FBO_debug[3]);
 		windowsbeam[A2VIDEOBEAM_FORCED_HGR2]->Render(current_frame_idx);
+		_vramBytesUploaded += windowsbeam[A2VIDEOBEAM_FORCED_HGR2]->GetBytesUploaded();
 	}
 	if ((glerr = glGetError()) != GL_NO_ERROR) {
 		std::cerr << "A2VideoManager debugging textures render error: " << glerr << std::endl;
 	}
 
+	vram_bytes_uploaded = _vramBytesUploaded;
+	vram_bytes_uploaded_total += _vramBytesUploaded;
+
 	// all done, the texture for this Apple 2 beam cycle frame is rendered
 	rendered_frame_idx = vrams_read->frame_idx;
-	vrams_read->bWasRendered = true;
+	rendered_frame_hash = _frameHash;
+	LATENCY_BEGIN_FRAME(vrams_read->bus_timestamp_ns);
+	LATENCY_FRAME_STAGE(LatencyStage_e::A2_RENDER);
 
 	_texUnit = _TEXUNIT_POSTPROCESS;
 	return true;
@@ -1792,6 +2193,40 @@ void A2VideoManager::DisplayImGuiWindow(bool* p_open)
 				this->ForceBeamFullScreenRender();
 			ImGui::SameLine();
 			ImGui::Text("Frame ID: %d", this->GetVRAMReadId());
+			ImGui::Text("VRAM upload: %zu bytes last frame, %.1f MB total", vram_bytes_uploaded, vram_bytes_uploaded_total / (1024.0 * 1024.0));
+			ImGui::SliderInt("VRAM ring buffers", &vrams_ring_size_requested, _VRAMS_RING_MIN, _VRAMS_RING_MAX);
+			ImGui::SetItemTooltip("Buffers shared by the beam and the renderer. More buffers let the frame queue absorb longer render hiccups");
+			const char* _ringPolicies[] = { "Latest frame", "Frame queue" };
+			int _ringPolicy = (int)vrams_ring_policy.load();
+			if (ImGui::Combo("VRAM ring policy", &_ringPolicy, _ringPolicies, IM_ARRAYSIZE(_ringPolicies)))
+				vrams_ring_policy = (VRAMRingPolicy_e)_ringPolicy;
+			ImGui::SetItemTooltip("Latest frame: render the newest complete frame, for the lowest latency.\nFrame queue: render the complete frames in order, for the smoothest motion");
+			ImGui::Text("Frames produced: %llu  displayed: %llu  dropped: %llu",
+				(unsigned long long)frames_produced.load(), (unsigned long long)frames_displayed.load(),
+				(unsigned long long)frames_dropped.load());
+			ImGui::Text("Static frames skipped: %llu", (unsigned long long)static_frames_skipped);
+			ImGui::SetItemTooltip("Frames identical to the previous one, whose render was skipped. Shift-F10 forces all renders");
+			ImGui::Checkbox("Lazy beam rendering", &this->bLazyBeam);
+			ImGui::SetItemTooltip("Renders the beam cycles in runs between bus events instead of one at a time. Same output, less CPU");
+			if (ImGui::Button("Benchmark Beam"))
+				this->BenchmarkBeam();
+			ImGui::SetItemTooltip("Renders 120 frames of the current screen with each beam and compares their output. Best run with no incoming bus events");
+			if (bBeamBenchmarkDone)
+			{
+				ImGui::SameLine();
+				ImGui::Text("%.1f -> %.1f -> %.1f us/frame, %s", beamBenchmarkUsPerFrame[0], beamBenchmarkUsPerFrame[1],
+					beamBenchmarkUsPerFrame[2],
+					(bBeamBenchmarkMatches ? "identical" : "DIFFERENT"));
+			}
+			if (ImGui::Button("Benchmark Merged Mode"))
+				this->BenchmarkMergedMode(mergedBenchmarkFlipLines);
+			ImGui::SetItemTooltip("Renders 120 frames of the current screen, flipping between SHR and legacy every few lines");
+			ImGui::SameLine();
+			ImGui::PushItemWidth(80);
+			ImGui::SliderInt("lines##MergedBenchmark", &mergedBenchmarkFlipLines, 1, 100);
+			ImGui::PopItemWidth();
+			if (bMergedBenchmarkDone)
+				ImGui::Text("Merged mode: %.1f us/frame, worst %.1f us", mergedBenchmarkUsPerFrame[0], mergedBenchmarkUsPerFrame[1]);
 			
 			ImGui::SeparatorText("[ BORDERS AND WIDTH ]");
 			ImGui::SliderInt("Horizontal Borders", &border_w_slider_val, 0, _BORDER_WIDTH_MAX_CYCLES, "%d", 1);
@@ -1973,6 +2408,9 @@ nlohmann::json A2VideoManager::SerializeState()
 		{"align_quads_to_scanline", bAlignQuadsToScanline},
 		{"force_shr_width_in_merge_mode", bForceSHRWidth},
 		{"no_merged_mode_wobble", bNoMergedModeWobble},
+		{"lazy_beam", bLazyBeam},
+		{"vrams_ring_size", vrams_ring_size_requested},
+		{"vrams_ring_policy", (int)vrams_ring_policy.load()},
 		{"font_rom_regular_index", font_rom_regular_idx},
 		{"font_rom_slternate_index", font_rom_alternate_idx},
 		{"p_b_ntsc", p_b_ntsc},
@@ -1993,6 +2431,9 @@ void A2VideoManager::DeserializeState(const nlohmann::json &jsonState)
 	bAlignQuadsToScanline = jsonState.value("force_shr_width_in_merge_mode", bAlignQuadsToScanline);
 	bForceSHRWidth = jsonState.value("align_quads_to_scanline", bForceSHRWidth);
 	bNoMergedModeWobble = jsonState.value("no_merged_mode_wobble", bNoMergedModeWobble);
+	bLazyBeam = jsonState.value("lazy_beam", bLazyBeam);
+	vrams_ring_size_requested = jsonState.value("vrams_ring_size", vrams_ring_size_requested);
+	vrams_ring_policy = (VRAMRingPolicy_e)jsonState.value("vrams_ring_policy", (int)vrams_ring_policy.load());
 	font_rom_regular_idx = jsonState.value("font_rom_regular_index", font_rom_regular_idx);
 	font_rom_alternate_idx = jsonState.value("font_rom_slternate_index", font_rom_alternate_idx);
 	p_b_ntsc = jsonState.value("p_b_ntsc", p_b_ntsc);
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <vector>
+#include <atomic>
 
 #include "common.h"
 #include "BasicQuad.h"
@@ -103,6 +104,27 @@ constexpr uint32_t A2VIDEORENDER_ERROR = UINT32_MAX;			// render error
 constexpr int32_t SDLUSEREVENT_A2NEWFRAME = 1001;				// user code for new frame event
 constexpr int32_t MAX_USEREVENTS_IN_QUEUE = 4;					// maximum frames in queue when VSYNC to Apple 2 bus
 
+// Number of BeamRenderVRAMs in the ring between the beam and the renderer
+constexpr int _VRAMS_RING_MIN = 3;		// the renderer holds one, the beam draws in one, one is ready
+constexpr int _VRAMS_RING_MAX = 4;
+
+// Who owns a BeamRenderVRAMs of the ring
+enum class VRAMState_e
+{
+	FREE = 0,			// nobody, available to the beam
+	WRITING,			// the beam is drawing the frame
+	READY,				// the frame is complete, waiting for the renderer
+	RENDERING,			// the renderer holds it, it's the frame on screen
+};
+
+// Which ready frame the renderer picks up
+enum class VRAMRingPolicy_e
+{
+	LATEST = 0,			// the newest one, older ready frames are dropped. Lowest latency
+	QUEUE,				// the oldest one, frames are only dropped when the ring is full. Smoothest
+	VRAMRINGPOLICY_TOTAL_COUNT
+};
+
 class A2VideoManager
 {
 public:
@@ -114,11 +136,13 @@ public:
 		// NOTE:	Anything labled "id" is an internal identifier by the GPU
 		//			Anything labled "index" is an actual array or vector index used by the code
 
-	// We'll create 2 BeamRenderVRAMs objects, for double buffering
+	// We'll create a ring of BeamRenderVRAMs objects (3 by default), so that the beam
+	// always has a free one to draw into while the renderer holds another
 	struct BeamRenderVRAMs {
 		uint32_t id = 0;
 		uint64_t frame_idx = 0;
-		bool bWasRendered = false;
+		std::atomic<VRAMState_e> state = VRAMState_e::FREE;
+		uint64_t bus_timestamp_ns = 0;			// receipt time of the packet that ended the frame, for latency metrics
 		A2Mode_e mode = A2Mode_e::NONE;
 		uint8_t* vram_legacy = nullptr;
 		uint8_t* vram_shr = nullptr;
@@ -144,9 +168,18 @@ public:
 	uint64_t rendered_frame_idx = UINT64_MAX;
 
     bool bShouldReboot = false;             // When an Appletini reboot packet arrives
+	const uint64_t GetSkippedBeamFrames() { return skipped_beam_frames; };	// frames dropped under ingest backpressure
+	// VRAM ring counters: frames completed by the beam, picked up by the renderer,
+	// and completed but never rendered because newer ones replaced them
+	const uint64_t GetFramesProduced() { return frames_produced; };
+	const uint64_t GetFramesDisplayed() { return frames_displayed; };
+	const uint64_t GetFramesDropped() { return frames_dropped; };
+	const size_t GetVRAMBytesUploaded() { return vram_bytes_uploaded; };		// vram bytes sent to the GPU by the last Render()
+	const uint64_t GetStaticFramesSkipped() { return static_frames_skipped; };	// frames identical to the last one, not rendered
 	uXY ScreenSize();
 
 	bool bAlwaysRenderBuffer = false;		// If true, forces a rerender even if the VRAM hasn't changed
+	bool bLazyBeam = true;					// Defer the beam cycles and render them in runs, see BeamFlush()
 
 	// Multi-Mode Prefs
 	bool bAlignQuadsToScanline = false;		// Forces all the quads to align to the same scanline (for all modes)
@@ -197,8 +230,22 @@ public:
 
 	// Methods for the single multipurpose beam racing shader
 	void BeamIsAtPosition(uint32_t _x, uint32_t _y);
+	// With bLazyBeam, BeamIsAtPosition() only queues the cycles of the current scanline, and they're
+	// rendered together at the end of the line or when BeamFlush() is called. Call it before changing
+	// anything the beam reads (softswitches, display memory) so the queued cycles see the old state.
+	void BeamFlush();
+	// Same as calling BeamIsAtPosition() for each cycle from _xStart to _xEnd of a scanline, with
+	// nothing in between. _xStart is after the line start.
+	void BeamIsAtRun(uint32_t _xStart, uint32_t _xEnd, uint32_t _y);
 
 	void ForceBeamFullScreenRender(const uint64_t numFrames = 1);
+	// Times numFrames frames of the per-cycle beam, the lazy beam and the line builder on the current
+	// memory, and checks that all render the exact same vrams. Results are shown in the ImGui window.
+	// Returns true if they do.
+	bool BenchmarkBeam(const uint32_t numFrames = 120);
+	// Times numFrames frames of the current memory while flipping between SHR and legacy every
+	// flipLines scanlines, for the average and worst frame times of the merged mode.
+	void BenchmarkMergedMode(const uint32_t flipLines = 8, const uint32_t numFrames = 120);
 	
 	bool SelectLegacyShader(const int index);
 	bool SelectSHRShader(const int index);
@@ -230,7 +277,7 @@ public:
 
 	inline const VideoRegion_e GetCurrentRegion() { return current_region; };
 
-	// Changing borders reinitializes everything
+	// Changing borders or the vrams ring size reinitializes everything
 	// Cycle for width (7 or 8 (SHR) lines per increment)
 	// And a height (8 lines per increment)
 	// Call CheckSetBordersWithReinit() at the start of the main loop
@@ -247,6 +294,12 @@ public:
 	
 	void Initialize();
 	void ResetComputer();
+
+	// Headless mode, for the bench_replay tool: no GL, no SDL events, and Render() must not be called.
+	// Set it before the first GetInstance(). The completed frames are then consumed by calling
+	// AcquireHeadlessFrame() after each event. A frame stays valid until the next one is acquired.
+	static void SetHeadless(bool headless) { s_bHeadless = headless; };
+	const BeamRenderVRAMs* AcquireHeadlessFrame() { return (AcquireReadFrame() ? vrams_read : nullptr); };
 	
 	// public singleton code
 	static A2VideoManager* GetInstance()
@@ -259,13 +312,23 @@ public:
 
 private:
 	static A2VideoManager* s_instance;
+	static bool s_bHeadless;
 	A2VideoManager()
 	{
-		vrams_array = new BeamRenderVRAMs[2]{};
+		vrams_array = new BeamRenderVRAMs[_VRAMS_RING_MAX]{};
 		Initialize();
 	}
 	void StartNextFrame();
-	void SwitchToMergedMode(uint32_t scanline);
+	void PublishWriteFrame();		// beam side of the vrams ring
+	bool AcquireReadFrame();		// renderer side of the vrams ring
+	void BeamRenderCycle(uint32_t _x, uint32_t _y);		// renders a beam cycle right away
+	void BeamRenderSHRContent(uint32_t _y, uint32_t xStart, uint32_t xEnd);
+	void BeamRenderLegacyContent(uint32_t _y, uint32_t xStart, uint32_t xEnd);
+	void BeamRenderRun(uint32_t _yBeam, uint32_t xStart, uint32_t xEnd);	// cycles with no bus event in between
+	void BeamRenderLine(uint32_t _yBeam);	// a whole line at once, for the full screen renders
+	void UpdateLegacyModeDescs();
+	uint64_t HashReadFrame();		// identity of the read frame's render output, see Render()
+	void SwitchToMergedMode();
 	void CreateOrResizeFramebuffer(int fb_width, int fb_height);
 	void InitializeFullQuad();
 	void PrepareOffsetTexture();
@@ -278,7 +341,6 @@ private:
 	bool bA2VideoEnabled = true;			// Is standard Apple 2 video enabled?
 	bool bShouldInitializeRender = true;	// Used to tell the render method to run initialization
 	bool bIsRebooting = false;              // Rebooting semaphore
-	bool bIsSwitchingToMergedMode = false;	// True when refreshing earlier scanlines for merged mode
 	bool bShouldPageDouble = false;			// Handles updating for double paged mode
 
 	// imgui vars
@@ -304,11 +366,40 @@ private:
 	// beam render state variables
 	BeamState_e beamState = BeamState_e::UNKNOWN;
 	int scanlineSHR4Modes = 0;			// All SHR4 modes in the scanline
-
-	// Double-buffered vrams
-	BeamRenderVRAMs* vrams_array;	// 2 buffers of legacy+shr vrams
+	// The legacy video mode as the beam reads it, rebuilt by UpdateLegacyModeDescs() only when
+	// the softswitches change. Index 0 is for full screen lines, 1 for the text lines of mixed mode.
+	struct LegacyModeDesc {
+		uint8_t flags = 0;						// bits 0-3 of the vram flags byte: mode and alt charset
+		uint32_t startMem = 0;
+		uint32_t startMemInterlace = 0;			// for paged mode
+		const uint16_t* lineOffsets = nullptr;	// offset in RAM of each scanline
+	};
+	LegacyModeDesc legacyModeDescs[2];
+	uint32_t legacyModeDescsVersion = 0;	// MemoryManager::GetSoftSwitchesVersion() of legacyModeDescs
+	// Lazy beam: contiguous cycles of a scanline waiting for BeamFlush()
+	uint32_t lazyRunY = 0;
+	uint32_t lazyRunXStart = 0;
+	uint32_t lazyRunLength = 0;
+	// Last BenchmarkBeam() results
+	bool bBeamBenchmarkDone = false;
+	bool bBeamBenchmarkMatches = false;
+	double beamBenchmarkUsPerFrame[3] = { 0.0, 0.0, 0.0 };	// per-cycle, lazy, line builder
+	// Last BenchmarkMergedMode() results
+	bool bMergedBenchmarkDone = false;
+	int mergedBenchmarkFlipLines = 8;
+	double mergedBenchmarkUsPerFrame[2] = { 0.0, 0.0 };	// average, worst
+
+	// Ring of vrams. Only the beam changes vrams_write, and only the renderer changes vrams_read.
+	// The ownership of each buffer is in its state, see PublishWriteFrame() and AcquireReadFrame().
+	BeamRenderVRAMs* vrams_array;	// _VRAMS_RING_MAX buffers of legacy+shr vrams, vrams_ring_size are used
 	BeamRenderVRAMs* vrams_write;	// the write buffer
 	BeamRenderVRAMs* vrams_read;	// the read buffer
+	int vrams_ring_size = 3;
+	int vrams_ring_size_requested = 3;	// from the UI, applied at the next reinit
+	std::atomic<VRAMRingPolicy_e> vrams_ring_policy = VRAMRingPolicy_e::LATEST;
+	std::atomic<uint64_t> frames_produced = 0;
+	std::atomic<uint64_t> frames_displayed = 0;
+	std::atomic<uint64_t> frames_dropped = 0;
 
 	// Font ROMs array
 	// The font files must be 256 characters, each 14x16px. 16 rows and 16 columns.
@@ -353,6 +444,20 @@ private:
 	A2Mode_e merge_last_change_mode = A2Mode_e::NONE;
 	uint32_t merge_last_change_y = UINT_MAX;
 
+	// The frame in progress at Initialize() has no start, it isn't published
+	bool bDiscardWriteFrame = true;
+	// Ingest backpressure: skip the beam work of the current frame
+	bool bSkipBeamFrame = false;
+	uint64_t skipped_beam_frames = 0;
+
+	// VRAM upload counters
+	size_t vram_bytes_uploaded = 0;
+	uint64_t vram_bytes_uploaded_total = 0;
+
+	// Static screen detection: hash of the last rendered frame's vrams and render parameters
+	uint64_t rendered_frame_hash = 0;
+	uint64_t static_frames_skipped = 0;
+
 	// Those could be anywhere up to 6 or 7 cycles for horizontal borders
 	// and a lot more for vertical borders. We just decided on a size
 	// But SHR starts VBLANK just like legacy modes, at scanline 192. Hence
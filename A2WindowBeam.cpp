@@ -167,48 +167,78 @@ void A2WindowBeam::Render(uint64_t frame_idx)
 		std::cerr << "A2WindowBeam::Render 5 error: " << glerr << std::endl;
 	}
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-	if (vramTextureExists)	// it exists, do a glTexSubImage2D() update
+	bytesUploaded = 0;
+	if (vramTextureExists)	// it exists, only upload the rows that changed with glTexSubImage2D()
 	{
+		// Each texture row is a scanline (or a legacy cycle row for the forced modes)
+		const uint8_t* _vramPtr;
+		uint32_t _rowWidth;		// in texels
+		uint32_t _rowBytes;
+		uint32_t _rowCount;
+		GLenum _format = GL_RGBA_INTEGER;
 		switch (video_mode) {
 			case A2VIDEOBEAM_SHR:
+			{
+				// Don't update the interlace part if unnecessary
+				int _hasDSHR4 = (doubleSHR4 == DOUBLE_NONE ? 0 : 1);
+				_vramPtr = A2VideoManager::GetInstance()->GetSHRVRAMReadPtr();
+				_rowWidth = _COLORBYTESOFFSET + (cycles_w_with_border * 4);
+				_rowCount = (_A2VIDEO_SHR_SCANLINES + (2 * border_height_scanlines)) * (_hasDSHR4 + 1);
+				_format = GL_RED_INTEGER;
+				if (((specialModesMask & A2_VSM_SHR4PAL256) != 0) || (overrideSHR4Mode == 2))
 				{
-					// Adjust the unpack alignment for textures with arbitrary widths
-					glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-					// Don't update the interlace part if unnecessary
-					int _hasDSHR4 = (doubleSHR4 == DOUBLE_NONE ? 0 : 1);
-					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _COLORBYTESOFFSET + (cycles_w_with_border * 4),
-									(_A2VIDEO_SHR_SCANLINES + (2 * border_height_scanlines)) * (_hasDSHR4 + 1),
-									GL_RED_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetSHRVRAMReadPtr());
-					if (((specialModesMask & A2_VSM_SHR4PAL256) != 0) || (overrideSHR4Mode == 2))
-					{
-						glActiveTexture(_TEXUNIT_PAL256BUFFER);
-						glBindTexture(GL_TEXTURE_2D, PAL256TEX);
-						glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _A2VIDEO_SHR_BYTES_PER_LINE, _A2VIDEO_SHR_SCANLINES * (_hasDSHR4 + 1),
-										GL_RED_INTEGER, GL_UNSIGNED_SHORT, (uint16_t*)(A2VideoManager::GetInstance()->GetPAL256VRAMReadPtr()));
-						glActiveTexture(_TEXUNIT_DATABUFFER_R8UI);
-					}
-					glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+					glActiveTexture(_TEXUNIT_PAL256BUFFER);
+					glBindTexture(GL_TEXTURE_2D, PAL256TEX);
+					auto _pal256Ptr = A2VideoManager::GetInstance()->GetPAL256VRAMReadPtr();
+					bytesUploaded += pal256DirtyRows.Upload(_pal256Ptr, _A2VIDEO_SHR_BYTES_PER_LINE * 2,
+						_A2VIDEO_SHR_SCANLINES * (_hasDSHR4 + 1), [&](uint32_t y, uint32_t count) {
+							glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, _A2VIDEO_SHR_BYTES_PER_LINE, count, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+								(const uint16_t*)(_pal256Ptr + (size_t)y * _A2VIDEO_SHR_BYTES_PER_LINE * 2));
+						});
+					glActiveTexture(_TEXUNIT_DATABUFFER_R8UI);
 				}
+			}
 				break;
 			case A2VIDEOBEAM_FORCED_TEXT1:
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 40, 192, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetTEXT1VRAMReadPtr());
+				_vramPtr = A2VideoManager::GetInstance()->GetTEXT1VRAMReadPtr();
+				_rowWidth = 40;
+				_rowCount = 192;
 				break;
 			case A2VIDEOBEAM_FORCED_TEXT2:
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 40, 192, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetTEXT2VRAMReadPtr());
+				_vramPtr = A2VideoManager::GetInstance()->GetTEXT2VRAMReadPtr();
+				_rowWidth = 40;
+				_rowCount = 192;
 				break;
 			case A2VIDEOBEAM_FORCED_HGR1:
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 40, 192, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetHGR1VRAMReadPtr());
+				_vramPtr = A2VideoManager::GetInstance()->GetHGR1VRAMReadPtr();
+				_rowWidth = 40;
+				_rowCount = 192;
 				break;
 			case A2VIDEOBEAM_FORCED_HGR2:
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 40, 192, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetHGR2VRAMReadPtr());
+				_vramPtr = A2VideoManager::GetInstance()->GetHGR2VRAMReadPtr();
+				_rowWidth = 40;
+				_rowCount = 192;
 				break;
 			default:
+			{
 				int _hasDoubleSize = (pagingMode == DOUBLE_NONE ? 0 : 1);
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cycles_w_with_border, 
-					(192 + (2 * border_height_scanlines)) * (_hasDoubleSize + 1),
-						GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, A2VideoManager::GetInstance()->GetLegacyVRAMReadPtr());
+				_vramPtr = A2VideoManager::GetInstance()->GetLegacyVRAMReadPtr();
+				_rowWidth = cycles_w_with_border;
+				_rowCount = (192 + (2 * border_height_scanlines)) * (_hasDoubleSize + 1);
+			}
 				break;
 		}
+		if (_format == GL_RGBA_INTEGER)
+			_rowBytes = _rowWidth * 4;
+		else {
+			_rowBytes = _rowWidth;
+			// Adjust the unpack alignment for textures with arbitrary widths
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		}
+		bytesUploaded += vramDirtyRows.Upload(_vramPtr, _rowBytes, _rowCount, [&](uint32_t y, uint32_t count) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, _rowWidth, count, _format, GL_UNSIGNED_BYTE, _vramPtr + (size_t)y * _rowBytes);
+		});
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 	}
 	else {	// texture doesn't exist, create it with glTexImage2D()
 		switch (video_mode) {
@@ -247,6 +277,9 @@ void A2WindowBeam::Render(uint64_t frame_idx)
 				break;
 		}
 		vramTextureExists = true;
+		// The whole vram was just uploaded, but the trackers have no hashes for it yet
+		vramDirtyRows.Invalidate();
+		pal256DirtyRows.Invalidate();
 	}
 
 	if ((glerr = glGetError()) != GL_NO_ERROR) {
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include "shader.h"
+#include "DirtyRows.h"
 
 #define _A2_TEXT80_CHAR_WIDTH 7
 #define _A2_TEXT80_CHAR_HEIGHT 16
@@ -79,6 +80,7 @@ public:
 	Shader* GetShader() { return &shader; };
 	void SetShaderPrograms(const char* shaderVertexPath, const char* shaderFragmentPath);
 	A2VideoModeBeam_e Get_video_mode() const { return video_mode; }
+	size_t GetBytesUploaded() const { return bytesUploaded; };	// VRAM bytes sent to the GPU by the last Render()
 
 	std::vector<A2BeamVertex> vertices;		// Vertices with XYRelative and XYPixels
 	unsigned int VAO = UINT_MAX;			// Vertex Array Object (holds buffers that are vertex related)
@@ -102,6 +104,9 @@ private:
 
 	unsigned int VRAMTEX = UINT_MAX;		// GL_R8UI VRAM buffer texture. Format depends on legacy or SHR mode
 	unsigned int PAL256TEX = UINT_MAX;		// GL_R16UI Special VRAM for SHR4 PAL256 mode
+	DirtyRowTracker vramDirtyRows;			// rows of VRAMTEX that need an upload
+	DirtyRowTracker pal256DirtyRows;		// rows of PAL256TEX that need an upload
+	size_t bytesUploaded = 0;
 
 	uint32_t border_width_cycles = 0;
 	uint32_t border_height_scanlines = 0;
@@ -2,6 +2,7 @@
 #include <mutex>
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 #include "A2VideoManager.h"
 #include "SoundManager.h"
 #include "EventRecorder.h"
@@ -91,6 +92,34 @@ void CycleCounter::IncrementCycles(int inc, VBLState_e vblState)
 	A2VideoManager::GetInstance()->BeamIsAtPosition(GetByteXPos(), GetScanline());
 }
 
+void CycleCounter::AdvanceCycles(uint32_t count)
+{
+	if (count == 0)
+		return;
+	m_tstamp_cycle = GetCurrentTimeInMicroseconds() - m_tstamp_init;
+	m_cycles_since_reset += count;
+	auto a2VideoManager = A2VideoManager::GetInstance();
+	// A line at a time: the line start on its own, where the beam flips frames, then the rest
+	// of the cycles on the line as a single run. cycles_total is a whole number of lines.
+	while (count > 0)
+	{
+		m_cycle = ((m_cycle + 1) % cycles_total);
+		uint32_t _x = GetByteXPos();
+		if (_x == 0)
+		{
+			a2VideoManager->BeamIsAtPosition(0, GetScanline());
+			--count;
+			continue;
+		}
+		uint32_t _runLength = std::min(count, CYCLES_SC_TOTAL - _x);
+		m_cycle += _runLength - 1;
+		a2VideoManager->BeamIsAtRun(_x, _x + _runLength - 1, GetScanline());
+		count -= _runLength;
+	}
+	bIsVBL = (m_cycle >= CYCLES_SCREEN);
+	bIsHBL = (GetByteXPos() < CYCLES_SC_HBL);
+}
+
 const VideoRegion_e CycleCounter::GetVideoRegion()
 {
 	return m_region;
@@ -34,6 +34,9 @@ class CycleCounter
 {
 public:
 	void IncrementCycles(int inc, VBLState_e vblState);
+	// Same as count calls to IncrementCycles(1, VBLState_e::Unknown), for runs of
+	// events that nothing but the beam cares about. The beam gets them a line at a time.
+	void AdvanceCycles(uint32_t count);
 	const bool IsVBL();
 	const bool IsHBL();
 	const bool IsInBlank();
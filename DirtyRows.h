@@ -0,0 +1,102 @@
+#pragma once
+#ifndef DIRTYROWS_H
+#define DIRTYROWS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/**************************************************************/
+/* Tracks which rows of a GPU texture differ from the data    */
+/* that was last uploaded to it, so that only those rows get  */
+/* re-uploaded. Each row is hashed on upload and compared to  */
+/* the hash of the same row at the previous upload.           */
+/* The tracker compares against what the texture holds, not   */
+/* against the previous frame in the same vram buffer, so it  */
+/* works whatever the vram buffers' double buffering does.    */
+/* The upload itself is a callback, so the tracker has no GL  */
+/* dependency.                                                */
+/**************************************************************/
+
+// Clean gaps of up to this many rows between dirty rows are uploaded anyway, for every tracker.
+// Each glTexSubImage2D() call has a fixed driver cost (validation, staging, synchronization)
+// that is higher than sending 4 vram rows, which is under 1KB for the legacy and SHR vrams.
+#ifndef DIRTYROWS_MAX_MERGE_GAP
+#define DIRTYROWS_MAX_MERGE_GAP 4
+#endif
+
+inline uint64_t dirtyrows_hash_row(const uint8_t* data, size_t len)
+{
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ len;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		uint64_t w;
+		memcpy(&w, data + i, 8);
+		h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+	}
+	for (; i < len; ++i)
+		h = (h ^ data[i]) * 0x100000001B3ull;
+	return h;
+}
+
+class DirtyRowTracker
+{
+public:
+	// Forces the next Upload() to send all the rows, e.g. after the texture is recreated
+	void Invalidate() { bIsValid = false; }
+
+	// Calls upload(firstRow, rowCount) for each run of rows of data that changed since the last
+	// call, and returns the number of bytes uploaded. Any change in the row size or count
+	// uploads everything.
+	template <typename UploadFunc>
+	size_t Upload(const uint8_t* data, uint32_t rowBytes, uint32_t rowCount, UploadFunc&& upload)
+	{
+		if (!bIsValid || (rowBytes != lastRowBytes) || (rowCount != rowHashes.size()))
+		{
+			rowHashes.resize(rowCount);
+			for (uint32_t y = 0; y < rowCount; ++y)
+				rowHashes[y] = dirtyrows_hash_row(data + (size_t)y * rowBytes, rowBytes);
+			lastRowBytes = rowBytes;
+			bIsValid = true;
+			if (rowCount > 0)
+				upload(0u, rowCount);
+			return (size_t)rowBytes * rowCount;
+		}
+
+		size_t bytesUploaded = 0;
+		uint32_t runStart = 0;
+		uint32_t runEnd = 0;		// one past the last dirty row of the run, 0 if no run
+		for (uint32_t y = 0; y < rowCount; ++y)
+		{
+			auto h = dirtyrows_hash_row(data + (size_t)y * rowBytes, rowBytes);
+			if (h == rowHashes[y])
+				continue;
+			rowHashes[y] = h;
+			if ((runEnd > 0) && ((y - runEnd) > DIRTYROWS_MAX_MERGE_GAP))
+			{
+				upload(runStart, runEnd - runStart);
+				bytesUploaded += (size_t)rowBytes * (runEnd - runStart);
+				runEnd = 0;
+			}
+			if (runEnd == 0)
+				runStart = y;
+			runEnd = y + 1;
+		}
+		if (runEnd > 0)
+		{
+			upload(runStart, runEnd - runStart);
+			bytesUploaded += (size_t)rowBytes * (runEnd - runStart);
+		}
+		return bytesUploaded;
+	}
+
+private:
+	bool bIsValid = false;
+	uint32_t lastRowBytes = 0;
+	std::vector<uint64_t> rowHashes;
+};
+
+#endif // DIRTYROWS_H
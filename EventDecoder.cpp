@@ -0,0 +1,119 @@
+#include "EventDecoder.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EVENTDECODER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define EVENTDECODER_NEON
+#include <arm_neon.h>
+#endif
+
+static inline uint32_t load_event_word(const uint8_t* p)
+{
+	uint32_t w;
+	memcpy(&w, p, sizeof(w));	// the packet buffers are packed structs
+	return w;
+}
+
+static inline void decode_range_scalar(const uint8_t* words, size_t start, size_t end, SDHREventBatch& batch)
+{
+	for (size_t i = start; i < end; ++i)
+	{
+		uint32_t event = load_event_word(words + i * 4);
+		batch.addr[i] = (uint16_t)(event >> 16);
+		batch.data[i] = (uint8_t)((event >> 4) & 0xff);
+		batch.rw[i] = (uint8_t)(event & 0x01);
+		batch.reset[i] = (uint8_t)((event >> 1) & 0x01);
+	}
+}
+
+void decode_event_words_scalar(const uint8_t* words, size_t count, SDHREventBatch& batch)
+{
+	decode_range_scalar(words, 0, count, batch);
+	batch.count = count;
+}
+
+#if defined(EVENTDECODER_SSE2)
+
+const char* get_event_decoder_name() { return "SSE2"; }
+
+void decode_event_words(const uint8_t* words, size_t count, SDHREventBatch& batch)
+{
+	const __m128i mask_ff = _mm_set1_epi32(0xff);
+	const __m128i mask_01 = _mm_set1_epi32(0x01);
+	size_t i = 0;
+	// 16 events per iteration, so that the byte fields fill a whole register
+	for (; i + 16 <= count; i += 16)
+	{
+		const uint8_t* src = words + i * 4;
+		__m128i w0 = _mm_loadu_si128((const __m128i*)(src));
+		__m128i w1 = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i w2 = _mm_loadu_si128((const __m128i*)(src + 32));
+		__m128i w3 = _mm_loadu_si128((const __m128i*)(src + 48));
+
+		// Arithmetic shift keeps the address in int16 range, so the signed pack doesn't saturate
+		_mm_storeu_si128((__m128i*)(batch.addr + i),
+			_mm_packs_epi32(_mm_srai_epi32(w0, 16), _mm_srai_epi32(w1, 16)));
+		_mm_storeu_si128((__m128i*)(batch.addr + i + 8),
+			_mm_packs_epi32(_mm_srai_epi32(w2, 16), _mm_srai_epi32(w3, 16)));
+
+		__m128i d01 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(w0, 4), mask_ff), _mm_and_si128(_mm_srli_epi32(w1, 4), mask_ff));
+		__m128i d23 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(w2, 4), mask_ff), _mm_and_si128(_mm_srli_epi32(w3, 4), mask_ff));
+		_mm_storeu_si128((__m128i*)(batch.data + i), _mm_packus_epi16(d01, d23));
+
+		__m128i r01 = _mm_packs_epi32(_mm_and_si128(w0, mask_01), _mm_and_si128(w1, mask_01));
+		__m128i r23 = _mm_packs_epi32(_mm_and_si128(w2, mask_01), _mm_and_si128(w3, mask_01));
+		_mm_storeu_si128((__m128i*)(batch.rw + i), _mm_packus_epi16(r01, r23));
+
+		__m128i s01 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(w0, 1), mask_01), _mm_and_si128(_mm_srli_epi32(w1, 1), mask_01));
+		__m128i s23 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(w2, 1), mask_01), _mm_and_si128(_mm_srli_epi32(w3, 1), mask_01));
+		_mm_storeu_si128((__m128i*)(batch.reset + i), _mm_packus_epi16(s01, s23));
+	}
+	decode_range_scalar(words, i, count, batch);
+	batch.count = count;
+}
+
+#elif defined(EVENTDECODER_NEON)
+
+const char* get_event_decoder_name() { return "NEON"; }
+
+void decode_event_words(const uint8_t* words, size_t count, SDHREventBatch& batch)
+{
+	const uint32x4_t mask_ff = vdupq_n_u32(0xff);
+	const uint32x4_t mask_01 = vdupq_n_u32(0x01);
+	size_t i = 0;
+	// 8 events per iteration
+	for (; i + 8 <= count; i += 8)
+	{
+		const uint8_t* src = words + i * 4;
+		uint32x4_t w0 = vreinterpretq_u32_u8(vld1q_u8(src));
+		uint32x4_t w1 = vreinterpretq_u32_u8(vld1q_u8(src + 16));
+
+		vst1q_u16(batch.addr + i, vcombine_u16(vshrn_n_u32(w0, 16), vshrn_n_u32(w1, 16)));
+
+		uint16x8_t d = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(w0, 4), mask_ff)),
+			vmovn_u32(vandq_u32(vshrq_n_u32(w1, 4), mask_ff)));
+		vst1_u8(batch.data + i, vmovn_u16(d));
+
+		uint16x8_t r = vcombine_u16(vmovn_u32(vandq_u32(w0, mask_01)), vmovn_u32(vandq_u32(w1, mask_01)));
+		vst1_u8(batch.rw + i, vmovn_u16(r));
+
+		uint16x8_t s = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(w0, 1), mask_01)),
+			vmovn_u32(vandq_u32(vshrq_n_u32(w1, 1), mask_01)));
+		vst1_u8(batch.reset + i, vmovn_u16(s));
+	}
+	decode_range_scalar(words, i, count, batch);
+	batch.count = count;
+}
+
+#else
+
+const char* get_event_decoder_name() { return "scalar"; }
+
+void decode_event_words(const uint8_t* words, size_t count, SDHREventBatch& batch)
+{
+	decode_event_words_scalar(words, count, batch);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef EVENTDECODER_H
+#define EVENTDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+	Appletini event word layout (one 32-bit little endian word per bus cycle):
+		bits 16-31	address
+		bits  4-11	data
+		bit      1	reset line (active low)
+		bit      0	rw (read == 1, write == 0)
+
+	The decoder unpacks a run of event words into structure-of-arrays buffers,
+	using SSE2 or NEON when available and a scalar loop otherwise.
+*/
+
+// A single Appletini message is at most 1024 bytes including its 4-byte header
+constexpr size_t EVENTBATCH_MAX_EVENTS = 1024 / 4;
+
+struct SDHREventBatch {
+	uint16_t addr[EVENTBATCH_MAX_EVENTS];
+	uint8_t data[EVENTBATCH_MAX_EVENTS];
+	uint8_t rw[EVENTBATCH_MAX_EVENTS];		// 1 for read, 0 for write
+	uint8_t reset[EVENTBATCH_MAX_EVENTS];	// 1 when the reset line is high (not in reset)
+	size_t count = 0;
+};
+
+// Decodes count words (count <= EVENTBATCH_MAX_EVENTS) into batch, replacing its content.
+// words does not need to be aligned.
+void decode_event_words(const uint8_t* words, size_t count, SDHREventBatch& batch);
+void decode_event_words_scalar(const uint8_t* words, size_t count, SDHREventBatch& batch);
+
+// Name of the kernel used by decode_event_words(), for display
+const char* get_event_decoder_name();
+
+#endif // EVENTDECODER_H
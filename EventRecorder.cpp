@@ -11,12 +11,18 @@
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <cstring>
+#include <unordered_set>
 
 constexpr uint32_t MAXRECORDING_SECONDS = 30;	// Max number of seconds to record
 
 // below because "The declaration of a static data member in its class definition is not a definition"
 EventRecorder* EventRecorder::s_instance;
 
+static_assert(RECORDER_PAGE_SIZE == (1 << MEMWRITE_PAGE_SHIFT), "Snapshot pages are the write tracking pages");
+static_assert(STREAM_CHUNK_EVENTS == RECORDER_MEM_SNAPSHOT_CYCLES, "The keyframes of the stream chunks are the RAM snapshots");
+static_assert(STREAM_KEYFRAME_RAM == RECORDER_SNAPSHOT_PAGES * RECORDER_PAGE_SIZE, "The stream keyframes are whole RAM snapshots");
+
 // Mem snapshot cycles may be different in saved recordings
 static size_t m_current_snapshot_cycles = RECORDER_MEM_SNAPSHOT_CYCLES;
 
@@ -39,31 +45,129 @@ EventRecorder::~EventRecorder()
 // Serialization and data transfer methods
 //////////////////////////////////////////////////////////////////////////
 
+// Where each snapshot page goes in the 128k snapshots of v1 recording files: main at 0, aux at 0x10000
+static size_t snapshot_file_offset(size_t page)
+{
+	size_t offset = page * RECORDER_PAGE_SIZE;
+	if (offset >= _A2_MEMORY_SHADOW_END)
+		offset += 0x10000 - _A2_MEMORY_SHADOW_END;
+	return offset;
+}
+
+// And in the keyframes of v2 files and the memory: main then aux
+static size_t snapshot_mem_offset(size_t page)
+{
+	return page * RECORDER_PAGE_SIZE;
+}
+
+// Makes a snapshot of the memory in buffer, sharing the pages that are the same as in prevSnapshot
+static RAMSnapshot snapshot_from_buffer(const uint8_t* buffer, size_t (*page_offset)(size_t), const RAMSnapshot* prevSnapshot)
+{
+	RAMSnapshot snapshot(RECORDER_SNAPSHOT_PAGES);
+	for (size_t page = 0; page < RECORDER_SNAPSHOT_PAGES; ++page)
+	{
+		const uint8_t* pPage = buffer + page_offset(page);
+		if (prevSnapshot && (memcmp((*prevSnapshot)[page]->data(), pPage, RECORDER_PAGE_SIZE) == 0))
+		{
+			snapshot[page] = (*prevSnapshot)[page];
+			continue;
+		}
+		auto _page = std::make_shared<RAMSnapshotPage>();
+		memcpy(_page->data(), pPage, RECORDER_PAGE_SIZE);
+		snapshot[page] = std::move(_page);
+	}
+	return snapshot;
+}
+
 void EventRecorder::MakeRAMSnapshot(size_t cycle)
 {
 	(void)cycle; // mark as unused
-	auto _memsize = _A2_MEMORY_SHADOW_END;
-	ByteBuffer buffer(RECORDER_TOTALMEMSIZE);
-	// Get the MAIN chunk
-	buffer.copyFrom(MemoryManager::GetInstance()->GetApple2MemPtr(), 0, _memsize);
-	// Get the AUX chunk
-	buffer.copyFrom(MemoryManager::GetInstance()->GetApple2MemAuxPtr(), 0x10000, _memsize);
-
-	v_memSnapshots.push_back(std::move(buffer));
+	auto memMgr = MemoryManager::GetInstance();
+	const uint8_t* pMem = memMgr->GetApple2MemPtr();	// both banks, main then aux
+	const RAMSnapshot* prevSnapshot = ((bLastSnapshotIsLive && !v_memSnapshots.empty()) ? &v_memSnapshots.back() : nullptr);
+	RAMSnapshot snapshot(RECORDER_SNAPSHOT_PAGES);
+	for (size_t page = 0; page < RECORDER_SNAPSHOT_PAGES; ++page)
+	{
+		// Pages written during the epoch of the previous snapshot may have changed after it, so only
+		// the pages last written before that epoch are known to be the same as in the previous snapshot
+		if (prevSnapshot && (memMgr->GetPageWriteEpoch(page) < lastSnapshotEpoch))
+		{
+			snapshot[page] = (*prevSnapshot)[page];
+			continue;
+		}
+		auto _page = std::make_shared<RAMSnapshotPage>();
+		memcpy(_page->data(), pMem + page * RECORDER_PAGE_SIZE, RECORDER_PAGE_SIZE);
+		snapshot[page] = std::move(_page);
+	}
+	v_memSnapshots.push_back(std::move(snapshot));
+	v_stateSnapshots.push_back(memMgr->SerializeSwitches());
+	lastSnapshotEpoch = memMgr->GetWriteEpoch();
+	bLastSnapshotIsLive = true;
 }
 
 void EventRecorder::ApplyRAMSnapshot(size_t snapshot_index)
 {
-	if (snapshot_index > (v_memSnapshots.size() - 1))
+	if (snapshot_index > (GetRAMSnapshotCount() - 1))
 		std::cerr << "ERROR: Requested to apply nonexistent memory snapshot at index " << snapshot_index << std::endl;
-	auto _memsize = _A2_MEMORY_SHADOW_END;
-	// Set the MAIN chunk
-	v_memSnapshots.at(snapshot_index).copyTo(MemoryManager::GetInstance()->GetApple2MemPtr(), 0, _memsize);
-	// Set the AUX chunk
-	v_memSnapshots.at(snapshot_index).copyTo(MemoryManager::GetInstance()->GetApple2MemAuxPtr(), 0x10000, _memsize);
+	A2VideoManager::GetInstance()->BeamFlush();
+	auto memMgr = MemoryManager::GetInstance();
+	uint8_t* pMem = memMgr->GetApple2MemPtr();
+	if (bIsStreamed)
+	{
+		const uint8_t* pKeyframe;
+		std::string state;
+		streamRecorder.GetKeyframe(snapshot_index, pKeyframe, state);
+		memcpy(pMem, pKeyframe, STREAM_KEYFRAME_RAM);
+		memMgr->DeserializeSwitches(state);
+		bLastSnapshotIsLive = false;
+		return;
+	}
+	const auto& snapshot = v_memSnapshots.at(snapshot_index);
+	for (size_t page = 0; page < RECORDER_SNAPSHOT_PAGES; ++page)
+		memcpy(pMem + page * RECORDER_PAGE_SIZE, snapshot[page]->data(), RECORDER_PAGE_SIZE);
+	if (!v_stateSnapshots.at(snapshot_index).empty())
+		memMgr->DeserializeSwitches(v_stateSnapshots[snapshot_index]);
+	// The memory didn't change through writes, the next snapshot can't share the pages of the last one
+	bLastSnapshotIsLive = false;
 }
 
-void EventRecorder::WriteRecordingFile(std::ofstream& file)
+void EventRecorder::ClearRAMSnapshots()
+{
+	v_memSnapshots.clear();
+	v_stateSnapshots.clear();
+	bLastSnapshotIsLive = false;
+}
+
+size_t EventRecorder::GetRAMSnapshotsBytes()
+{
+	std::unordered_set<const RAMSnapshotPage*> pages;
+	for (const auto& snapshot : v_memSnapshots)
+	{
+		for (const auto& page : snapshot)
+			pages.insert(page.get());
+	}
+	return (pages.size() * sizeof(RAMSnapshotPage))
+		+ (v_memSnapshots.size() * RECORDER_SNAPSHOT_PAGES * sizeof(RAMSnapshot::value_type));
+}
+
+void EventRecorder::WriteRecordingFile(std::ostream& file, VcrCodec_e codec)
+{
+	VcrHeader header;
+	header.is_iigs = (!v_events.empty() && v_events.front().is_iigs);
+	header.is_pal = bIsPAL;
+	header.keyframeCycles = m_current_snapshot_cycles;
+	std::vector<VcrKeyframe> keyframes(v_memSnapshots.size());
+	for (size_t i = 0; i < v_memSnapshots.size(); ++i) {
+		keyframes[i].ram.resize(RECORDER_SNAPSHOT_PAGES * RECORDER_PAGE_SIZE);
+		for (size_t page = 0; page < RECORDER_SNAPSHOT_PAGES; ++page)
+			memcpy(keyframes[i].ram.data() + snapshot_mem_offset(page), v_memSnapshots[i][page]->data(), RECORDER_PAGE_SIZE);
+		keyframes[i].state = v_stateSnapshots[i];
+	}
+	std::cout << "Writing " << v_events.size() << " events to file" << std::endl;
+	vcr_write(file, header, v_events, keyframes, codec);
+}
+
+void EventRecorder::WriteRecordingFileV1(std::ostream& file)
 {
 	// First store the RAM snapshot interval
 	file.write(reinterpret_cast<const char*>(&m_current_snapshot_cycles), sizeof(m_current_snapshot_cycles));
@@ -71,21 +175,57 @@ void EventRecorder::WriteRecordingFile(std::ofstream& file)
 	auto _size = v_events.size();
 	file.write(reinterpret_cast<const char*>(&_size), sizeof(_size));
 	// Next store the RAM states
+	ByteBuffer buffer(RECORDER_TOTALMEMSIZE);
+	memset(buffer.data(), 0, RECORDER_TOTALMEMSIZE);
 	for (const auto& snapshot : v_memSnapshots) {
-		file.write(reinterpret_cast<const char*>(snapshot.data()), (RECORDER_TOTALMEMSIZE) / sizeof(uint8_t));
+		for (size_t page = 0; page < RECORDER_SNAPSHOT_PAGES; ++page)
+			buffer.copyFrom(snapshot[page]->data(), snapshot_file_offset(page), RECORDER_PAGE_SIZE);
+		file.write(reinterpret_cast<const char*>(buffer.data()), (RECORDER_TOTALMEMSIZE) / sizeof(uint8_t));
 	}
-
-	std::cout << "Writing " << _size << " events to file" << std::endl;
 	// And finally the events
 	for (const auto& event : v_events) {
 		WriteEvent(event, file);
 	}
 }
 
-void EventRecorder::ReadRecordingFile(std::ifstream& file)
+void EventRecorder::ReadRecordingFile(std::istream& file)
 {
 	StopReplay();
 	ClearRecording();
+	if (vcr_is_v2(file))
+		ReadRecordingFileV2(file);
+	else
+		ReadRecordingFileV1(file);
+	bHasRecording = true;
+}
+
+void EventRecorder::ReadRecordingFileV2(std::istream& file)
+{
+	VcrReader reader(file);
+	const auto& header = reader.GetHeader();
+	if ((header.cycles > 0) && (header.keyframeCycles == 0))
+		throw std::ios_base::failure("Recording file without keyframe interval");
+	m_current_snapshot_cycles = (header.keyframeCycles > 0 ? header.keyframeCycles : RECORDER_MEM_SNAPSHOT_CYCLES);
+	// Seeking needs the snapshot before every event
+	if ((header.cycles > 0) && (header.keyframeCount <= ((header.cycles - 1) / m_current_snapshot_cycles)))
+		throw std::ios_base::failure("Recording file is missing keyframes");
+	bIsPAL = header.is_pal;
+	for (size_t i = 0; i < header.keyframeCount; ++i) {
+		auto keyframe = reader.ReadKeyframe(i);
+		if (keyframe.ram.size() != RECORDER_SNAPSHOT_PAGES * RECORDER_PAGE_SIZE)
+			throw std::ios_base::failure("Recording file keyframe of the wrong size");
+		const RAMSnapshot* prevSnapshot = (v_memSnapshots.empty() ? nullptr : &v_memSnapshots.back());
+		v_memSnapshots.push_back(snapshot_from_buffer(keyframe.ram.data(), snapshot_mem_offset, prevSnapshot));
+		v_stateSnapshots.push_back(std::move(keyframe.state));
+	}
+	std::cout << "Reading " << header.cycles << " events from file" << std::endl;
+	v_events.reserve(header.cycles);
+	for (size_t i = 0; i < header.blockCount; ++i)
+		reader.ReadBlock(i, v_events);
+}
+
+void EventRecorder::ReadRecordingFileV1(std::istream& file)
+{
 	v_events.reserve(1000000 * MAXRECORDING_SECONDS);
 	// First read the ram snapshot interval
 	file.read(reinterpret_cast<char*>(&m_current_snapshot_cycles), sizeof(m_current_snapshot_cycles));
@@ -95,10 +235,13 @@ void EventRecorder::ReadRecordingFile(std::ifstream& file)
 	// Then all the RAM states
 	if (_size > 0)
 	{
+		ByteBuffer buffer(RECORDER_TOTALMEMSIZE);
 		for (size_t i = 0; i <= (_size / m_current_snapshot_cycles); ++i) {
-			auto snapshot = ByteBuffer(RECORDER_TOTALMEMSIZE);
-			file.read(reinterpret_cast<char*>(snapshot.data()), (RECORDER_TOTALMEMSIZE) / sizeof(uint8_t));
-			v_memSnapshots.push_back(std::move(snapshot));
+			file.read(reinterpret_cast<char*>(buffer.data()), (RECORDER_TOTALMEMSIZE) / sizeof(uint8_t));
+			// Share the pages that are the same as in the previous snapshot
+			const RAMSnapshot* prevSnapshot = (v_memSnapshots.empty() ? nullptr : &v_memSnapshots.back());
+			v_memSnapshots.push_back(snapshot_from_buffer(buffer.data(), snapshot_file_offset, prevSnapshot));
+			v_stateSnapshots.push_back(std::string());	// v1 files don't have the softswitches
 		}
 	}
 	std::cout << "Reading " << _size << " events from file" << std::endl;
@@ -109,7 +252,30 @@ void EventRecorder::ReadRecordingFile(std::ifstream& file)
 			ReadEvent(file);
 		}
 	}
-	bHasRecording = true;
+}
+
+// The loaders that build the events instead of recording them only have the snapshot before the
+// first event. Makes the snapshot of every other interval by running the memory and softswitch
+// side of the events, as if they had been recorded, so that seeking and saving have all of them.
+void EventRecorder::MakeIntervalRAMSnapshots()
+{
+	auto memMgr = MemoryManager::GetInstance();
+	ApplyRAMSnapshot(0);
+	bLastSnapshotIsLive = false;
+	for (size_t i = 0; i < v_events.size(); ++i)
+	{
+		if ((i > 0) && ((i % m_current_snapshot_cycles) == 0))
+			MakeRAMSnapshot(i);
+		const auto& e = v_events[i];
+		if (e.is_iigs && e.m2sel)
+			continue;
+		auto dispatch = get_event_dispatch(e.addr, e.rw, e.is_iigs);
+		if (dispatch & EVENTDISPATCH_MEMORY)
+			memMgr->WriteToMemory(e.addr, e.data, e.m2b0, e.is_iigs);
+		else if (dispatch & EVENTDISPATCH_SOFTSWITCH)
+			memMgr->ProcessSoftSwitch(e.addr, e.data, e.rw, e.is_iigs);
+	}
+	ApplyRAMSnapshot(0);
 }
 
 void EventRecorder::ReadTextEventsFromFile(std::ifstream& file)
@@ -151,6 +317,7 @@ void EventRecorder::ReadTextEventsFromFile(std::ifstream& file)
 	}
 
 	std::cout << "Read " << v_events.size() << " text events from file" << std::endl;
+	MakeIntervalRAMSnapshots();
 	bHasRecording = true;
 }
 
@@ -168,7 +335,12 @@ void EventRecorder::ReadPaintWorksAnimationsFile(std::ifstream& file)
 	StopReplay();
 	ClearRecording();
 	v_events.reserve(1000000 * MAXRECORDING_SECONDS);
-	auto pMem = MemoryManager::GetInstance()->GetApple2MemAuxPtr() + 0x2000;
+	// The animations are SHR, whatever the mode was before. The snapshot keeps the softswitches.
+	auto memMgr = MemoryManager::GetInstance();
+	memMgr->SetSoftSwitch(A2SS_SHR, true);
+	memMgr->SetSoftSwitch(A2SS_TEXT, false);
+	memMgr->SetSoftSwitch(A2SS_HIRES, false);
+	auto pMem = memMgr->GetApple2MemAuxPtr() + 0x2000;
 	// Read first SHR frame
 	file.read(reinterpret_cast<char*>(pMem), 0x8000);
 	// Then the animations block length
@@ -207,10 +379,22 @@ void EventRecorder::ReadPaintWorksAnimationsFile(std::ifstream& file)
 		}
 		v_events.push_back(SDHREvent(false, false, false, false, 0xC004, 0));	// RAMWRTOFF
 	}
+	MakeIntervalRAMSnapshots();
+	bHasRecording = true;
+}
+
+void EventRecorder::MakeStaticRecording(size_t cycles)
+{
+	StopReplay();
+	ClearRecording();
+	MakeRAMSnapshot(0);
+	// Dummy reads, like the delays between the PaintWorks animation frames
+	v_events.assign(cycles, SDHREvent(false, false, false, true, 0, 0));
+	MakeIntervalRAMSnapshots();
 	bHasRecording = true;
 }
 
-void EventRecorder::WriteEvent(const SDHREvent& event, std::ofstream& file) {
+void EventRecorder::WriteEvent(const SDHREvent& event, std::ostream& file) {
 	// Serialize and write each member of SDHREvent to the file
 	file.write(reinterpret_cast<const char*>(&event.is_iigs), sizeof(event.is_iigs));
 	file.write(reinterpret_cast<const char*>(&event.m2b0), sizeof(event.m2b0));
@@ -219,7 +403,7 @@ void EventRecorder::WriteEvent(const SDHREvent& event, std::ofstream& file) {
 	file.write(reinterpret_cast<const char*>(&event.data), sizeof(event.data));
 }
 
-void EventRecorder::ReadEvent(std::ifstream& file) {
+void EventRecorder::ReadEvent(std::istream& file) {
 	auto event = SDHREvent(false, false, false, 0, 0, 0);
 	file.read(reinterpret_cast<char*>(&event.is_iigs), sizeof(event.is_iigs));
 	file.read(reinterpret_cast<char*>(&event.m2b0), sizeof(event.m2b0));
@@ -256,6 +440,13 @@ void EventRecorder::StartReplay()
 		&bShouldPauseReplay, &bShouldStopReplay);
 }
 
+void EventRecorder::ApplyInitialRAMSnapshot()
+{
+	// Recordings without any event have no snapshot
+	if (GetRAMSnapshotCount() > 0)
+		ApplyRAMSnapshot(0);
+}
+
 void EventRecorder::PauseReplay(bool pause)
 {
 	bShouldPauseReplay = pause;
@@ -304,16 +495,20 @@ int EventRecorder::replay_events_thread(bool* shouldPauseReplay, bool* shouldSto
 			auto first_event_index = snapshot_index * m_current_snapshot_cycles;
 			for (auto i = first_event_index; i < currentReplayEvent; i++)
 			{
-				auto e = v_events.at(i);
+				auto e = GetReplayEvent(i);
 				process_single_event(e);
 			}
 		}
 
-		if ((v_events.size() > 0) && (currentReplayEvent < v_events.size()))
+		if ((GetReplayEventCount() > 0) && (currentReplayEvent < GetReplayEventCount()))
 		{
 			if (*shouldStopReplay)	// In case a stop was sent while sleeping
 				break;
-			auto e = v_events.at(currentReplayEvent);
+			// The events dropped while streaming are missing, restart from the keyframe after them
+			if (bIsStreamed && ((currentReplayEvent % m_current_snapshot_cycles) == 0)
+				&& (streamRecorder.GetDroppedBefore(currentReplayEvent / m_current_snapshot_cycles) > 0))
+				ApplyRAMSnapshot(currentReplayEvent / m_current_snapshot_cycles);
+			auto e = GetReplayEvent(currentReplayEvent);
 			process_single_event(e);
 			currentReplayEvent += 1;
 			// wait 1 clock cycle before adding the next event, compensating for drift
@@ -341,20 +536,62 @@ int EventRecorder::replay_events_thread(bool* shouldPauseReplay, bool* shouldSto
 void EventRecorder::StartRecording()
 {
 	ClearRecording();
-	v_events.reserve(1000000 * MAXRECORDING_SECONDS);
+	if (bStreamToDisk)
+	{
+		if (!streamRecorder.Start(streamDirectory, (uint64_t)streamBudgetMB * 1024 * 1024, bStreamRollingWindow, bIsPAL))
+		{
+			m_lastErrorString = streamRecorder.GetError();
+			bImGuiOpenModal = true;
+			ImGui::OpenPopup("Recorder Error Modal");
+			return;
+		}
+		bIsStreamed = true;
+	}
+	else
+		v_events.reserve(1000000 * MAXRECORDING_SECONDS);
 	SetState(EventRecorderStates_e::RECORDING);
 }
 
 void EventRecorder::StopRecording()
 {
+	if (bIsStreamed)
+	{
+		// The recording thread flushes its last events at its next one, while still recording.
+		// The segments are then the recording, replay them directly.
+		streamRecorder.Stop();
+		SetState(EventRecorderStates_e::STOPPED);
+		bHasRecording = OpenStreamedRecording(streamDirectory);
+		return;
+	}
 	bHasRecording = true;
 	SaveRecording();
 	SetState(EventRecorderStates_e::STOPPED);
 }
 
+bool EventRecorder::OpenStreamedRecording(const std::string& directory)
+{
+	StopReplay();
+	ClearRecording();
+	if (!streamRecorder.Open(directory))
+	{
+		m_lastErrorString = streamRecorder.GetError();
+		bImGuiOpenModal = true;
+		ImGui::OpenPopup("Recorder Error Modal");
+		return false;
+	}
+	bIsStreamed = true;
+	bIsPAL = streamRecorder.IsPAL();
+	m_current_snapshot_cycles = STREAM_CHUNK_EVENTS;
+	bHasRecording = true;
+	return true;
+}
+
 void EventRecorder::ClearRecording()
 {
-	v_memSnapshots.clear();
+	streamRecorder.Stop();
+	streamRecorder.Close();
+	bIsStreamed = false;
+	ClearRAMSnapshots();
 	v_events.clear();
 	v_events.shrink_to_fit();
 	bHasRecording = false;
@@ -376,7 +613,7 @@ void EventRecorder::LoadRecording()
 	IGFD::FileDialogConfig config;
 	config.path = "./recordings/";
 	ImGui::SetNextWindowSize(ImVec2(800, 400));
-	ImGuiFileDialog::Instance()->OpenDialog("ChooseRecordingLoad", "Load Recording File", ".vcr,.shra,#C20000", config);
+	ImGuiFileDialog::Instance()->OpenDialog("ChooseRecordingLoad", "Load Recording File", ".vcr,.vcrs,.shra,#C20000", config);
 }
 
 void EventRecorder::LoadTextEventsFromFile()
@@ -401,6 +638,11 @@ void EventRecorder::RecordEvent(SDHREvent* sdhr_event)
 {
 	if (m_state != EventRecorderStates_e::RECORDING)
 		return;
+	if (bIsStreamed)
+	{
+		streamRecorder.RecordEvent(*sdhr_event);
+		return;
+	}
 	if ((currentReplayEvent % RECORDER_MEM_SNAPSHOT_CYCLES) == 0)
 		MakeRAMSnapshot(currentReplayEvent);
 	v_events.push_back(*sdhr_event);
@@ -435,6 +677,39 @@ void EventRecorder::DisplayImGuiWindow(bool* p_open)
 				this->StartRecording();
 		}
 
+		// Streaming to disk has no length limit, only the disk budget
+		if (m_state == EventRecorderStates_e::RECORDING)
+		{
+			ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f);
+			ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+		}
+		ImGui::Checkbox("Stream to disk", &bStreamToDisk);
+		ImGui::SetItemTooltip("Record without time limit to the segment files in %s", streamDirectory.c_str());
+		if (bStreamToDisk)
+		{
+			if (ImGui::InputInt("Disk budget (MB)", &streamBudgetMB, 1024, 16 * 1024))
+				streamBudgetMB = std::max(streamBudgetMB, 256);
+			ImGui::Checkbox("Rolling window", &bStreamRollingWindow);
+			ImGui::SetItemTooltip("When the budget is full, overwrite the oldest events instead of dropping the new ones");
+		}
+		if (m_state == EventRecorderStates_e::RECORDING)
+		{
+			ImGui::PopItemFlag();
+			ImGui::PopStyleVar();
+		}
+		if (bIsStreamed && (m_state == EventRecorderStates_e::RECORDING))
+		{
+			ImGui::Text("Streamed %.1fM events, %.0f MB", streamRecorder.GetRecordedEvents() / 1'000'000.0,
+				streamRecorder.GetBytesWritten() / (1024.0 * 1024.0));
+			auto dropped = streamRecorder.GetDroppedEvents();
+			if (dropped > 0)
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Dropped %llu events (%s)", (unsigned long long)dropped,
+					streamRecorder.IsDiskFull() ? "disk budget full" : "disk behind");
+			auto streamError = streamRecorder.GetError();
+			if (!streamError.empty())
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", streamError.c_str());
+		}
+
 		static bool bIsInReplayMode = (this->IsInReplayMode());
 		if (ImGui::Checkbox("Replay Mode", &bIsInReplayMode))
 		{
@@ -448,7 +723,13 @@ void EventRecorder::DisplayImGuiWindow(bool* p_open)
 			ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * 0.5f); // Reduce button opacity
 			ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true); // Disable button (and make it unclickable)
 		}
-		bUserMovedEventSlider = ImGui::SliderInt("Event Timeline", reinterpret_cast<int*>(&currentReplayEvent), 0, (int)v_events.size());
+		// Streamed recordings can have more events than an int
+		uint64_t _sliderEvent = currentReplayEvent;
+		const uint64_t _sliderMin = 0;
+		const uint64_t _sliderMax = GetReplayEventCount();
+		bUserMovedEventSlider = ImGui::SliderScalar("Event Timeline", ImGuiDataType_U64, &_sliderEvent, &_sliderMin, &_sliderMax);
+		if (bUserMovedEventSlider)
+			currentReplayEvent = (size_t)_sliderEvent;
 		if (bIsInReplayMode)
 		{
 			if (ImGui::InputInt("X Slowdown", &slowdownMultiplier))
@@ -536,6 +817,8 @@ void EventRecorder::DisplayImGuiWindow(bool* p_open)
 					{
 						if (_fileExtension == ".vcr")
 							ReadRecordingFile(file);
+						else if (_fileExtension == ".vcrs")
+							OpenStreamedRecording(ImGuiFileDialog::Instance()->GetCurrentPath());
 						else if (_fileExtension == ".shra")
 							ReadPaintWorksAnimationsFile(file);
 						else if (_fileExtension == "#C20000")
@@ -630,6 +913,25 @@ void EventRecorder::DisplayImGuiWindow(bool* p_open)
 	}
 }
 
+nlohmann::json EventRecorder::SerializeState()
+{
+	nlohmann::json jsonState = {
+		{"stream to disk", bStreamToDisk},
+		{"stream directory", streamDirectory},
+		{"stream disk budget MB", streamBudgetMB},
+		{"stream rolling window", bStreamRollingWindow},
+	};
+	return jsonState;
+}
+
+void EventRecorder::DeserializeState(const nlohmann::json& jsonState)
+{
+	bStreamToDisk = jsonState.value("stream to disk", bStreamToDisk);
+	streamDirectory = jsonState.value("stream directory", streamDirectory);
+	streamBudgetMB = std::max(jsonState.value("stream disk budget MB", streamBudgetMB), 256);
+	bStreamRollingWindow = jsonState.value("stream rolling window", bStreamRollingWindow);
+}
+
 void EventRecorder::SetState(EventRecorderStates_e _state)
 {
 	if (_state == m_state)
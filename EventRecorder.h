@@ -4,7 +4,7 @@
 
 /*
 	Singleton event recorder class whose job is to:
-		- keep the last 30M events in a buffer
+		- keep the last 30M events in a buffer, or stream any number of them to disk (see StreamRecorder.h)
 		- store the state of RAM before the recording
 		- stop if the recording reaches max
 		- provide an ImGui interface to:
@@ -16,12 +16,23 @@
 
 #include "common.h"
 #include "SDHRNetworking.h"	// for SDHREvent
+#include "VcrFile.h"
+#include "StreamRecorder.h"
+#include <array>
+#include <memory>
 #include <vector>
 #include <string>
 #include <thread>
 
-#define RECORDER_TOTALMEMSIZE 128 * 1024		// 128k memory snapshot
+#define RECORDER_TOTALMEMSIZE 128 * 1024		// 128k memory snapshot in recording files
 #define RECORDER_MEM_SNAPSHOT_CYCLES 1'000'000	// snapshot memory every x cycles
+#define RECORDER_PAGE_SIZE 256					// same as the pages of the MemoryManager's write tracking
+#define RECORDER_SNAPSHOT_PAGES (2 * _A2_MEMORY_SHADOW_END / RECORDER_PAGE_SIZE)
+
+// A RAM snapshot is the pages of the main then the aux bank. The pages that weren't
+// written since the previous snapshot are shared with it instead of copied.
+typedef std::array<uint8_t, RECORDER_PAGE_SIZE> RAMSnapshotPage;
+typedef std::vector<std::shared_ptr<const RAMSnapshotPage>> RAMSnapshot;
 
 enum class EventRecorderStates_e
 {
@@ -43,6 +54,9 @@ public:
 	inline const bool IsRecording() { return (m_state == EventRecorderStates_e::RECORDING); };
 	inline const bool IsInReplayMode() { return (m_state >= EventRecorderStates_e::STOPPED); };
 
+	nlohmann::json SerializeState();
+	void DeserializeState(const nlohmann::json& jsonState);
+
 	// public singleton code
 	static EventRecorder* GetInstance()
 	{
@@ -52,14 +66,34 @@ public:
 	}
 	~EventRecorder();
 
-	// This method reads a binary recording file previously saved using SaveRecording()
-	void ReadRecordingFile(std::ifstream& file);
+	// This method reads a binary recording file previously saved using SaveRecording(), v2 or v1
+	void ReadRecordingFile(std::istream& file);
 	// This method reads a text event file, generally used for debugging
 	void ReadTextEventsFromFile(std::ifstream& file);
 	// This method reads a PaintWorks Animations file, also for debugging
 	void ReadPaintWorksAnimationsFile(std::ifstream& file);
+	// This method opens the segments of a recording streamed to disk, in their directory
+	bool OpenStreamedRecording(const std::string& directory);
 	void StopReplay();
 	void StartReplay();
+	// Writes out what's left of a recording streamed to disk, before quitting
+	void FinishStreaming() { streamRecorder.Stop(); };
+
+	// For the bench_replay tool, which replays the events itself at full speed
+	const std::vector<SDHREvent>& GetEvents() { return v_events; };
+	void ApplyInitialRAMSnapshot();		// the RAM state before the first event
+	// And for its RAM snapshot benchmark
+	void MakeRAMSnapshot(size_t cycle);
+	void ApplyRAMSnapshot(size_t snapshot_index);
+	void ClearRAMSnapshots();
+	size_t GetRAMSnapshotCount() { return (bIsStreamed ? streamRecorder.GetKeyframeCount() : v_memSnapshots.size()); };
+	size_t GetRAMSnapshotsBytes();		// memory used by the snapshots, with the shared pages counted once
+	// And for its replay of the sample images: cycles of events that change nothing, from the current
+	// memory and softswitches
+	void MakeStaticRecording(size_t cycles);
+	// And for its recording file checks
+	void WriteRecordingFile(std::ostream& file, VcrCodec_e codec = VcrCodec_e::LZ4);
+	void WriteRecordingFileV1(std::ostream& file);	// the format before VcrFile.h, to check that it still loads
 
 private:
 	void Initialize();
@@ -71,26 +105,40 @@ private:
 	void SaveRecording();
 	void LoadRecording();
 	void LoadTextEventsFromFile();
+	void MakeIntervalRAMSnapshots();	// for the events that weren't recorded, see ReadTextEventsFromFile()
 	
 	// replay
 	void PauseReplay(bool pause);
 	void RewindReplay();
 
 	// de/serialization
-	void MakeRAMSnapshot(size_t cycle);
-	void ApplyRAMSnapshot(size_t snapshot_index);
-	void WriteRecordingFile(std::ofstream& file);
-	void WriteEvent(const SDHREvent& event, std::ofstream& file);
-	void ReadEvent(std::ifstream& file);
+	void ReadRecordingFileV1(std::istream& file);
+	void ReadRecordingFileV2(std::istream& file);
+	void WriteEvent(const SDHREvent& event, std::ostream& file);
+	void ReadEvent(std::istream& file);
+
+	// The events of the recording in memory, or of the streamed one
+	inline size_t GetReplayEventCount() { return (bIsStreamed ? streamRecorder.GetEventCount() : v_events.size()); };
+	inline SDHREvent GetReplayEvent(size_t index) { return (bIsStreamed ? streamRecorder.GetEvent(index) : v_events.at(index)); };
 
 	bool bIsPAL = false;						// Is the machine PAL?
 	bool bHasRecording = false;
 	EventRecorderStates_e m_state = EventRecorderStates_e::DISABLED;
 	void SetState(EventRecorderStates_e _state);
 
-	std::vector<ByteBuffer> v_memSnapshots;	// memory snapshots at regular intervals
+	std::vector<RAMSnapshot> v_memSnapshots;	// memory snapshots at regular intervals
+	std::vector<std::string> v_stateSnapshots;	// softswitches at each memory snapshot, empty when unknown (v1 files)
+	bool bLastSnapshotIsLive = false;		// the last snapshot was made from the memory, which only changed since through writes
+	uint32_t lastSnapshotEpoch = 0;			// MemoryManager write epoch of the last snapshot
 	std::vector<SDHREvent> v_events;
 
+	// Streaming to disk, see StreamRecorder.h
+	StreamRecorder streamRecorder;
+	bool bIsStreamed = false;					// the recording is in the stream segments, not in v_events
+	bool bStreamToDisk = false;
+	std::string streamDirectory = "./recordings/stream/";
+	int streamBudgetMB = 16 * 1024;
+	bool bStreamRollingWindow = false;			// overwrite the oldest segments instead of dropping the new events
 
 	// Replay thread control
 	std::thread thread_replay;
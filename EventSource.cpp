@@ -0,0 +1,465 @@
+#include "EventSource.h"
+#include "SDHRNetworking.h"
+
+// winsock2.h must come before anything that pulls in windows.h
+#ifdef __NETWORKING_WINDOWS__
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+typedef SOCKET socket_t;
+#define CLOSESOCKET closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define CLOSESOCKET close
+#endif
+
+#include "CycleCounter.h"
+#include "common.h"
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+// Appletini message header: version (8 bits), type (8 bits), length in bytes including the header (16 bits)
+#define MSG_HEADER(type, len) ((1u << 24) | ((uint32_t)(type) << 16) | (uint32_t)(len))
+#define MSG_MAX_LEN 1024
+
+/*
+ *********************************
+ HELPERS
+ *********************************
+ */
+
+// Accumulates a raw byte stream and cuts it into packets on message boundaries
+class MessageStream
+{
+public:
+	void Append(const uint8_t* bytes, size_t count) {
+		if (start > 0 && start == buf.size()) {
+			buf.clear();
+			start = 0;
+		}
+		buf.insert(buf.end(), bytes, bytes + count);
+	}
+	size_t Available() const { return buf.size() - start; };
+	void Clear() { buf.clear(); start = 0; };
+
+	// Moves as many whole messages as fit into the packet. Garbage is passed through a word at
+	// a time so that the processing thread can report it. Returns the number of bus events copied.
+	uint64_t FillPacket(Packet* packet, uint32_t maxSize) {
+		uint64_t events = 0;
+		packet->size = 0;
+		while (Available() >= 4) {
+			uint32_t hdr;
+			memcpy(&hdr, buf.data() + start, 4);
+			size_t msglen = hdr & 0xffff;
+			if (msglen == 0 || msglen > MSG_MAX_LEN || (msglen % 4) != 0)
+				msglen = 4;
+			else if (msglen > Available())
+				break;	// wait for the rest of the message
+			if (packet->size + msglen > maxSize)
+				break;
+			memcpy(packet->data + packet->size, buf.data() + start, msglen);
+			packet->size += (uint32_t)msglen;
+			start += msglen;
+			if (((hdr >> 16) & 0xff) == 1 && msglen > 4)
+				events += (msglen / 4) - 1;
+		}
+		if (start > (1 << 20)) {
+			buf.erase(buf.begin(), buf.begin() + start);
+			start = 0;
+		}
+		return events;
+	}
+private:
+	std::vector<uint8_t> buf;
+	size_t start = 0;
+};
+
+// Throttles a source to the Apple 2 clock: one bus event per cycle
+class BusPacer
+{
+public:
+	void Reset() {
+		t_start = std::chrono::steady_clock::now();
+		events = 0;
+	}
+	void Wait(uint64_t newEvents) {
+		events += newEvents;
+		const uint64_t freq = (CycleCounter::GetInstance()->GetVideoRegion() == VideoRegion_e::PAL ?
+			_A2_CPU_FREQUENCY_PAL : _A2_CPU_FREQUENCY_NTSC);
+		auto target = t_start + std::chrono::microseconds(events * 1'000'000 / freq);
+		auto now = std::chrono::steady_clock::now();
+		if (target > now)
+			std::this_thread::sleep_until(target);
+		else if (now - target > std::chrono::milliseconds(100))
+			Reset();	// we fell way behind, don't try to catch up in a burst
+	}
+private:
+	std::chrono::steady_clock::time_point t_start = std::chrono::steady_clock::now();
+	uint64_t events = 0;
+};
+
+// Waits until a packet is available. Returns nullptr on termination.
+static Packet* wait_for_packet(std::atomic<bool>* shouldTerminate)
+{
+	Packet* packet;
+	while ((packet = ingest_acquire_packet()) == nullptr) {
+		if (*shouldTerminate)
+			return nullptr;
+		std::this_thread::yield();
+	}
+	return packet;
+}
+
+/*
+ *********************************
+ RAW CAPTURE FILE SOURCE
+ *********************************
+ */
+
+class FileEventSource : public EventSource
+{
+public:
+	FileEventSource(const std::string& path, bool unthrottled, bool loop)
+		: m_path(path), m_unthrottled(unthrottled), m_loop(loop) {
+		m_file.open(path, std::ios::binary);
+	};
+	bool IsOpen() const { return m_file.is_open(); };
+	std::string GetName() const override { return "Capture file: " + m_path; };
+	std::string GetStatusString() const override {
+		return m_ended ? "End of capture" : (m_unthrottled ? "Replaying (unthrottled)" : "Replaying");
+	};
+	bool IsOk() const override { return !m_ended; };
+	void Run(std::atomic<bool>* shouldTerminate) override {
+		// Unthrottled uses the largest packets for throughput, otherwise keep the
+		// latency of a synchronous Appletini read
+		const uint32_t packetSize = m_unthrottled ? PKT_MAX_XFERSZ : PKT_BUFSZ;
+		std::vector<uint8_t> chunk(PKT_MAX_XFERSZ);
+		MessageStream stream;
+		BusPacer pacer;
+		Packet* packet = nullptr;
+		pacer.Reset();
+		while (!(*shouldTerminate)) {
+			while (stream.Available() < PKT_MAX_XFERSZ && !m_file.eof()) {
+				m_file.read((char*)chunk.data(), chunk.size());
+				stream.Append(chunk.data(), (size_t)m_file.gcount());
+			}
+			if (stream.Available() < 4 && m_file.eof()) {
+				if (m_loop) {
+					stream.Clear();
+					m_file.clear();
+					m_file.seekg(0);
+					continue;
+				}
+				m_ended = true;
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			if (packet == nullptr && (packet = wait_for_packet(shouldTerminate)) == nullptr)
+				break;
+			uint64_t events = stream.FillPacket(packet, packetSize);
+			if (packet->size == 0) {
+				stream.Clear();		// truncated message at the end of the file
+				continue;
+			}
+			if (!m_unthrottled)
+				pacer.Wait(events);
+			if (ingest_submit_packet(packet))
+				packet = nullptr;
+		}
+	};
+private:
+	std::string m_path;
+	std::ifstream m_file;
+	bool m_unthrottled;
+	bool m_loop;
+	std::atomic<bool> m_ended = false;
+};
+
+/*
+ *********************************
+ TCP / UNIX SOCKET SOURCE
+ *********************************
+ */
+
+// Listens for a single client that streams raw Appletini messages, for example
+// a capture piped through netcat or a bus simulator. When the client goes away,
+// it waits for the next one.
+class SocketEventSource : public EventSource
+{
+public:
+	SocketEventSource(const std::string& address, bool isUnix) : m_address(address), m_isUnix(isUnix) {};
+	~SocketEventSource() {
+		if (m_listen != INVALID_SOCKET)
+			CLOSESOCKET(m_listen);
+#ifndef __NETWORKING_WINDOWS__
+		if (m_isUnix)
+			unlink(m_address.c_str());
+#endif
+	};
+
+	bool Listen(std::string& error) {
+#ifdef __NETWORKING_WINDOWS__
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			error = "WSAStartup failed";
+			return false;
+		}
+		if (m_isUnix) {
+			error = "Unix sockets are not supported on this platform";
+			return false;
+		}
+#endif
+		if (m_isUnix) {
+#ifndef __NETWORKING_WINDOWS__
+			sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			if (m_address.size() >= sizeof(addr.sun_path)) {
+				error = "Unix socket path is too long";
+				return false;
+			}
+			strncpy(addr.sun_path, m_address.c_str(), sizeof(addr.sun_path) - 1);
+			unlink(m_address.c_str());
+			m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (m_listen == INVALID_SOCKET || bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0) {
+				error = "Cannot bind Unix socket " + m_address;
+				return false;
+			}
+#endif
+		}
+		else {
+			int port = atoi(m_address.c_str());
+			if (port <= 0 || port > 65535) {
+				error = "Invalid TCP port " + m_address;
+				return false;
+			}
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			addr.sin_port = htons((uint16_t)port);
+			m_listen = socket(AF_INET, SOCK_STREAM, 0);
+			int reuse = 1;
+			setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+			if (m_listen == INVALID_SOCKET || bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0) {
+				error = "Cannot bind TCP port " + m_address;
+				return false;
+			}
+		}
+		if (listen(m_listen, 1) != 0) {
+			error = "Cannot listen on " + m_address;
+			return false;
+		}
+		return true;
+	};
+
+	std::string GetName() const override { return (m_isUnix ? "Unix socket: " : "TCP 127.0.0.1:") + m_address; };
+	std::string GetStatusString() const override { return m_connected ? "Client connected" : "Waiting for a client"; };
+	bool IsOk() const override { return m_connected; };
+
+	void Run(std::atomic<bool>* shouldTerminate) override {
+		std::vector<uint8_t> chunk(PKT_MAX_XFERSZ);
+		MessageStream stream;
+		Packet* packet = nullptr;
+		socket_t client = INVALID_SOCKET;
+		while (!(*shouldTerminate)) {
+			if (client == INVALID_SOCKET) {
+				if (!WaitReadable(m_listen))
+					continue;
+				client = accept(m_listen, NULL, NULL);
+				if (client == INVALID_SOCKET)
+					continue;
+				stream.Clear();
+				m_connected = true;
+				std::cout << "Event source client connected on " << m_address << std::endl;
+			}
+			if (WaitReadable(client)) {
+				int count = (int)recv(client, (char*)chunk.data(), (int)chunk.size(), 0);
+				if (count <= 0) {
+					CLOSESOCKET(client);
+					client = INVALID_SOCKET;
+					m_connected = false;
+					std::cout << "Event source client disconnected" << std::endl;
+					continue;
+				}
+				stream.Append(chunk.data(), (size_t)count);
+			}
+			// Send whatever whole messages have arrived
+			while (stream.Available() >= 4) {
+				if (packet == nullptr && (packet = wait_for_packet(shouldTerminate)) == nullptr)
+					break;
+				stream.FillPacket(packet, PKT_MAX_XFERSZ);
+				if (packet->size == 0)
+					break;	// partial message, wait for more data
+				if (ingest_submit_packet(packet))
+					packet = nullptr;
+			}
+		}
+		if (client != INVALID_SOCKET)
+			CLOSESOCKET(client);
+		m_connected = false;
+	};
+private:
+	// Short timeout so that termination is noticed
+	bool WaitReadable(socket_t s) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(s, &fds);
+		timeval tv = { 0, 200'000 };
+		return select((int)s + 1, &fds, NULL, NULL, &tv) > 0;
+	};
+
+	std::string m_address;
+	bool m_isUnix;
+	socket_t m_listen = INVALID_SOCKET;
+	std::atomic<bool> m_connected = false;
+};
+
+/*
+ *********************************
+ SYNTHETIC SOURCE
+ *********************************
+ */
+
+// Generates the bus traffic of an Apple //e program that shows HGR page 1, keeps
+// drawing into it and polls the VBL at $C019. It's deterministic, so runs are comparable.
+class SyntheticEventSource : public EventSource
+{
+public:
+	SyntheticEventSource(bool unthrottled) : m_unthrottled(unthrottled) {};
+	std::string GetName() const override { return "Synthetic bus activity"; };
+	std::string GetStatusString() const override { return m_unthrottled ? "Generating (unthrottled)" : "Generating"; };
+	bool IsOk() const override { return true; };
+
+	void Run(std::atomic<bool>* shouldTerminate) override {
+		const uint32_t packetSize = m_unthrottled ? PKT_MAX_XFERSZ : PKT_BUFSZ;
+		const uint32_t eventsPerMsg = (MSG_MAX_LEN / 4) - 1;
+		BusPacer pacer;
+		Packet* packet = nullptr;
+		pacer.Reset();
+		while (!(*shouldTerminate)) {
+			if (packet == nullptr && (packet = wait_for_packet(shouldTerminate)) == nullptr)
+				break;
+			packet->size = 0;
+			uint64_t events = 0;
+			while (packet->size + MSG_MAX_LEN <= packetSize) {
+				uint32_t* p = (uint32_t*)(packet->data + packet->size);
+				*p++ = MSG_HEADER(1, MSG_MAX_LEN);
+				for (uint32_t i = 0; i < eventsPerMsg; ++i)
+					*p++ = NextEvent();
+				packet->size += MSG_MAX_LEN;
+				events += eventsPerMsg;
+			}
+			if (!m_unthrottled)
+				pacer.Wait(events);
+			if (ingest_submit_packet(packet))
+				packet = nullptr;
+		}
+	};
+private:
+	static uint32_t MakeEvent(uint16_t addr, uint8_t data, bool rw) {
+		// reset line is high (not in reset)
+		return ((uint32_t)addr << 16) | ((uint32_t)data << 4) | 0x02 | (rw ? 0x01 : 0x00);
+	};
+	uint32_t Rand() {
+		m_rng ^= m_rng << 13;
+		m_rng ^= m_rng >> 17;
+		m_rng ^= m_rng << 5;
+		return m_rng;
+	};
+	uint32_t NextEvent() {
+		uint32_t cycle = m_cycle;
+		m_cycle = (m_cycle + 1) % CYCLES_TOTAL_NTSC;
+		// Set HGR page 1 full screen at the start of each frame
+		switch (cycle) {
+		case 0: return MakeEvent(0xC050, 0, true);	// TEXTOFF
+		case 1: return MakeEvent(0xC052, 0, true);	// MIXEDOFF
+		case 2: return MakeEvent(0xC054, 0, true);	// PAGE2OFF
+		case 3: return MakeEvent(0xC057, 0, true);	// HIRESON
+		default: break;
+		}
+		// Poll the VBL. On the //e, bit 7 of $C019 is low during the VBL
+		if ((cycle % 16) == 0)
+			return MakeEvent(0xC019, (cycle >= CYCLES_SCREEN) ? 0x00 : 0x80, true);
+		uint32_t r = Rand();
+		if ((r & 3) == 0) {
+			uint16_t addr = _A2VIDEO_HGR1_START + (m_hgrOffset++ % _A2VIDEO_HGR_SIZE);
+			return MakeEvent(addr, (uint8_t)(r >> 8), false);
+		}
+		// instruction and operand fetches
+		return MakeEvent(0x6000 + ((r >> 8) & 0x0FFF), (uint8_t)(r >> 20), true);
+	};
+
+	bool m_unthrottled;
+	uint32_t m_cycle = 0;
+	uint32_t m_hgrOffset = 0;
+	uint32_t m_rng = 0x2545F491;
+};
+
+/*
+ *********************************
+ FACTORY
+ *********************************
+ */
+
+// Removes the option from the end of the spec if it's there
+static bool take_option(std::string& spec, const std::string& option)
+{
+	const std::string suffix = "," + option;
+	if (spec.size() > suffix.size() && spec.compare(spec.size() - suffix.size(), suffix.size(), suffix) == 0) {
+		spec.erase(spec.size() - suffix.size());
+		return true;
+	}
+	return false;
+}
+
+EventSource* create_event_source(const std::string& specIn, std::string& error)
+{
+	std::string spec = specIn;
+	bool unthrottled = false;
+	bool loop = false;
+	// options can come in any order
+	for (bool found = true; found;) {
+		found = false;
+		if (take_option(spec, "unthrottled"))
+			found = unthrottled = true;
+		if (take_option(spec, "loop"))
+			found = loop = true;
+	}
+	std::string type = spec.substr(0, spec.find(':'));
+	std::string arg = (spec.find(':') == std::string::npos) ? "" : spec.substr(spec.find(':') + 1);
+
+	if (type == "ftdi" && arg.empty())
+		return create_ftdi_event_source();
+	if (type == "synthetic" && arg.empty())
+		return new SyntheticEventSource(unthrottled);
+	if (type == "file" && !arg.empty()) {
+		auto source = new FileEventSource(arg, unthrottled, loop);
+		if (source->IsOpen())
+			return source;
+		error = "Cannot open capture file " + arg;
+		delete source;
+		return nullptr;
+	}
+	if ((type == "tcp" || type == "unix") && !arg.empty()) {
+		auto source = new SocketEventSource(arg, type == "unix");
+		if (source->Listen(error))
+			return source;
+		delete source;
+		return nullptr;
+	}
+	error = "Unknown event source: " + specIn;
+	return nullptr;
+}
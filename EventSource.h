@@ -0,0 +1,43 @@
+#pragma once
+#ifndef EVENTSOURCE_H
+#define EVENTSOURCE_H
+
+/*
+	An EventSource feeds Appletini messages into the packet queue that the
+	processing thread consumes. Exactly one source is active, and it runs on
+	the ingest thread (usb_server_thread).
+
+	Available sources, selected with --source on the command line:
+		ftdi								The Appletini over USB (default)
+		file:<path>[,unthrottled][,loop]	Raw capture of the pipe, as written by --capture.
+											Replays at the Apple 2 bus speed unless unthrottled.
+		tcp:<port>							Listens on 127.0.0.1:<port> for a raw message stream
+		unix:<path>							Listens on a Unix domain socket for a raw message stream
+		synthetic[,unthrottled]				Generated bus activity (HGR page 1 writes and VBL polling)
+
+	Implementations hand over data with ingest_acquire_packet() and ingest_submit_packet()
+	(see SDHRNetworking.h), and must only put whole messages into a packet.
+*/
+
+#include <string>
+#include <atomic>
+
+class EventSource
+{
+public:
+	virtual ~EventSource() {};
+	// Description shown in the Appletini menu
+	virtual std::string GetName() const = 0;
+	// Human readable current state, for display
+	virtual std::string GetStatusString() const = 0;
+	// True when data is flowing. Syncing to the Apple 2 bus VBL relies on it.
+	virtual bool IsOk() const = 0;
+	// Runs on the ingest thread until shouldTerminate is set
+	virtual void Run(std::atomic<bool>* shouldTerminate) = 0;
+};
+
+// Creates a source from its command line description.
+// Returns nullptr and fills error if the description is invalid or the source can't be opened.
+EventSource* create_event_source(const std::string& spec, std::string& error);
+
+#endif // EVENTSOURCE_H
@@ -0,0 +1,214 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Stand-in for the FTDI D3XX library, only compiled in with -DFTDI_SHIM
+// (see the "fakeftdi" Makefile target).
+//
+// It pretends an Appletini is connected and replays a byte stream captured
+// from the read pipe, looping at the end of the file. The file is given by
+// the SDD_FTDI_SHIM_FILE environment variable (default: appletini_capture.bin).
+// Reads are served as fast as they're requested, and always end on an
+// Appletini message boundary like the real device does. This allows running
+// and profiling the whole ingest path, synchronous or asynchronous, without
+// any hardware.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifdef FTDI_SHIM
+
+#include "SDHRNetworking.h"
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#ifdef __NETWORKING_WINDOWS__
+#define FTD3XX_STATIC
+#include "ftd3xx_win.h"
+#else
+#include "ftd3xx.h"
+#endif
+
+static std::vector<uint8_t> shimStream;
+static size_t shimPos = 0;
+static bool shimLoaded = false;
+static DWORD shimTimeoutMs = 1000;
+
+static bool shim_load()
+{
+	if (shimLoaded)
+		return !shimStream.empty();
+	shimLoaded = true;
+	const char* path = std::getenv("SDD_FTDI_SHIM_FILE");
+	if (path == nullptr)
+		path = "appletini_capture.bin";
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "FTDI shim: cannot open capture file " << path << std::endl;
+		return false;
+	}
+	shimStream.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	shimStream.resize(shimStream.size() & ~(size_t)3);	// whole words only
+	shimPos = 0;
+	std::cout << "FTDI shim: replaying " << shimStream.size() << " bytes from " << path << std::endl;
+	return !shimStream.empty();
+}
+
+// Copies as many whole messages as fit in the buffer
+static ULONG shim_fill(PUCHAR buffer, ULONG length)
+{
+	ULONG filled = 0;
+	if (!shim_load())
+		return 0;
+	while (filled + 4 <= length) {
+		if (shimPos >= shimStream.size())
+			shimPos = 0;
+		uint32_t hdr;
+		memcpy(&hdr, shimStream.data() + shimPos, 4);
+		size_t msglen = hdr & 0xffff;
+		if (msglen == 0 || msglen > 1024 || (msglen % 4) != 0 || shimPos + msglen > shimStream.size())
+			msglen = 4;		// garbage, pass it through a word at a time
+		if (filled + msglen > length)
+			break;
+		memcpy(buffer + filled, shimStream.data() + shimPos, msglen);
+		filled += (ULONG)msglen;
+		shimPos += msglen;
+	}
+	return filled;
+}
+
+// Asynchronous transfers complete immediately, their result is kept in the OVERLAPPED struct
+static FT_STATUS shim_read_async(PUCHAR buffer, ULONG length, PULONG transferred, LPOVERLAPPED overlapped)
+{
+	ULONG filled = shim_fill(buffer, length);
+	*transferred = filled;
+	overlapped->Internal = (filled > 0) ? FT_OK : FT_IO_INCOMPLETE;
+	overlapped->InternalHigh = filled;
+	return FT_IO_PENDING;
+}
+
+static FT_STATUS shim_read_sync(PUCHAR buffer, ULONG length, PULONG transferred)
+{
+	*transferred = shim_fill(buffer, length);
+	if (*transferred > 0)
+		return FT_OK;
+	std::this_thread::sleep_for(std::chrono::milliseconds(shimTimeoutMs));
+	return FT_TIMEOUT;
+}
+
+FT_STATUS FT_CreateDeviceInfoList(LPDWORD lpdwNumDevs)
+{
+	*lpdwNumDevs = 1;
+	return FT_OK;
+}
+
+FT_STATUS FT_GetDeviceInfoList(FT_DEVICE_LIST_INFO_NODE* ptDest, LPDWORD lpdwNumDevs)
+{
+	*lpdwNumDevs = 1;
+	memset(ptDest, 0, sizeof(FT_DEVICE_LIST_INFO_NODE));
+	strncpy(ptDest->Description, "Appletini (FTDI shim)", sizeof(ptDest->Description) - 1);
+	strncpy(ptDest->SerialNumber, "SHIM0001", sizeof(ptDest->SerialNumber) - 1);
+	return FT_OK;
+}
+
+FT_STATUS FT_Create(PVOID pvArg, DWORD dwFlags, FT_HANDLE* pftHandle)
+{
+	(void)pvArg;
+	(void)dwFlags;
+	*pftHandle = (FT_HANDLE)&shimStream;
+	return FT_OK;
+}
+
+FT_STATUS FT_Close(FT_HANDLE ftHandle)
+{
+	(void)ftHandle;
+	return FT_OK;
+}
+
+FT_STATUS FT_AbortPipe(FT_HANDLE ftHandle, UCHAR ucPipeID)
+{
+	(void)ftHandle;
+	(void)ucPipeID;
+	return FT_OK;
+}
+
+FT_STATUS FT_GetOverlappedResult(FT_HANDLE ftHandle, LPOVERLAPPED pOverlapped, PULONG pulBytesTransferred, BOOL bWait)
+{
+	(void)ftHandle;
+	*pulBytesTransferred = (ULONG)pOverlapped->InternalHigh;
+	if ((FT_STATUS)pOverlapped->Internal == FT_IO_INCOMPLETE)
+		return bWait ? FT_OPERATION_ABORTED : FT_IO_INCOMPLETE;
+	return (FT_STATUS)pOverlapped->Internal;
+}
+
+FT_STATUS FT_InitializeOverlapped(FT_HANDLE ftHandle, LPOVERLAPPED pOverlapped)
+{
+	(void)ftHandle;
+	memset(pOverlapped, 0, sizeof(OVERLAPPED));
+	return FT_OK;
+}
+
+FT_STATUS FT_ReleaseOverlapped(FT_HANDLE ftHandle, LPOVERLAPPED pOverlapped)
+{
+	(void)ftHandle;
+	(void)pOverlapped;
+	return FT_OK;
+}
+
+#ifdef __NETWORKING_WINDOWS__
+
+FT_STATUS FT_SetPipeTimeout(FT_HANDLE ftHandle, UCHAR ucPipeID, ULONG TimeoutInMs)
+{
+	(void)ftHandle;
+	(void)ucPipeID;
+	shimTimeoutMs = TimeoutInMs;
+	return FT_OK;
+}
+
+FT_STATUS FT_ReadPipeEx(FT_HANDLE ftHandle, UCHAR ucPipeID, PUCHAR pucBuffer, ULONG ulBufferLength,
+	PULONG pulBytesTransferred, LPOVERLAPPED pOverlapped)
+{
+	(void)ftHandle;
+	(void)ucPipeID;
+	if (pOverlapped)
+		return shim_read_async(pucBuffer, ulBufferLength, pulBytesTransferred, pOverlapped);
+	return shim_read_sync(pucBuffer, ulBufferLength, pulBytesTransferred);
+}
+
+#else
+
+FT_STATUS FT_SetTransferParams(FT_TRANSFER_CONF* pConf, DWORD dwFifoID)
+{
+	(void)pConf;
+	(void)dwFifoID;
+	return FT_OK;
+}
+
+FT_STATUS FT_SetPipeTimeout(FT_HANDLE ftHandle, UCHAR ucPipeID, DWORD dwTimeoutInMs)
+{
+	(void)ftHandle;
+	(void)ucPipeID;
+	shimTimeoutMs = dwTimeoutInMs;
+	return FT_OK;
+}
+
+FT_STATUS FT_ReadPipeEx(FT_HANDLE ftHandle, UCHAR ucFifoID, PUCHAR pucBuffer, ULONG ulBufferLength,
+	PULONG pulBytesTransferred, DWORD dwTimeoutInMs)
+{
+	(void)ftHandle;
+	(void)ucFifoID;
+	shimTimeoutMs = dwTimeoutInMs;
+	return shim_read_sync(pucBuffer, ulBufferLength, pulBytesTransferred);
+}
+
+FT_STATUS FT_ReadPipeAsync(FT_HANDLE ftHandle, UCHAR ucFifoID, PUCHAR pucBuffer, ULONG ulBufferLength,
+	PULONG pulBytesTransferred, LPOVERLAPPED pOverlapped)
+{
+	(void)ftHandle;
+	(void)ucFifoID;
+	return shim_read_async(pucBuffer, ulBufferLength, pulBytesTransferred, pOverlapped);
+}
+
+#endif
+
+#endif // FTDI_SHIM
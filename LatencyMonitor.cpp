@@ -0,0 +1,206 @@
+#include "LatencyMonitor.h"
+#include "ThreadPlacement.h"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+// below because "The declaration of a static data member in its class definition is not a definition"
+LatencyMonitor* LatencyMonitor::s_instance;
+
+static const char* latencyStageNames[(int)LatencyStage_e::TOTAL_COUNT] = {
+	"Packet Queue", "Packet Decode", "VBL Flip", "A2 Render", "PostProcess", "Swap"
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Histogram
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t LatencyHistogram::BucketIndex(uint64_t ns)
+{
+	if (ns < SUB_BUCKETS)
+		return (uint32_t)ns;
+	uint32_t msb = 0;
+	for (uint32_t shift = 32; shift > 0; shift >>= 1)
+	{
+		if (ns >> (msb + shift))
+			msb += shift;
+	}
+	uint32_t sub = (uint32_t)(ns >> (msb - SUB_BUCKETS_BITS)) & (SUB_BUCKETS - 1);
+	return (msb - SUB_BUCKETS_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(uint32_t idx)
+{
+	if (idx < SUB_BUCKETS)
+		return idx;
+	uint32_t shift = (idx / SUB_BUCKETS) - 1;
+	uint64_t lower = (uint64_t)(SUB_BUCKETS + (idx % SUB_BUCKETS)) << shift;
+	return lower + (((uint64_t)1 << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t ns)
+{
+	buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(ns, std::memory_order_relaxed);
+	if (ns > max.load(std::memory_order_relaxed))
+		max.store(ns, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset()
+{
+	for (auto& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetMean() const
+{
+	uint64_t _count = GetCount();
+	if (_count == 0)
+		return 0;
+	return sum.load(std::memory_order_relaxed) / _count;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const
+{
+	uint64_t _count = GetCount();
+	if (_count == 0)
+		return 0;
+	uint64_t target = (uint64_t)(percentile / 100.0 * (double)_count);
+	if (target >= _count)
+		target = _count - 1;
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen > target)
+			return std::min(BucketUpperBound(i), GetMax());
+	}
+	return GetMax();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Monitor
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t LatencyMonitor::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyMonitor::Record(LatencyStage_e stage, uint64_t since_ns)
+{
+	if (since_ns == 0)
+		return;
+	uint64_t now = Now();
+	histograms[(int)stage].Record(now > since_ns ? now - since_ns : 0);
+}
+
+void LatencyMonitor::Reset()
+{
+	for (auto& histogram : histograms)
+		histogram.Reset();
+}
+
+void LatencyMonitor::BeginFrame(uint64_t bus_ns)
+{
+	frameBusTimestamp = bus_ns;
+	frameStagesRecorded = 0;
+}
+
+void LatencyMonitor::RecordFrameStage(LatencyStage_e stage)
+{
+	if (frameBusTimestamp == 0)
+		return;		// no frame from the bus, or it was already swapped
+	if (frameStagesRecorded & (1 << (int)stage))
+		return;
+	frameStagesRecorded |= (1 << (int)stage);
+	Record(stage, frameBusTimestamp);
+	if (stage == LatencyStage_e::SWAP)
+		frameBusTimestamp = 0;
+}
+
+const char* LatencyMonitor::GetStageName(LatencyStage_e stage)
+{
+	return latencyStageNames[(int)stage];
+}
+
+nlohmann::json LatencyMonitor::SerializeState()
+{
+	nlohmann::json jsonState = nlohmann::json::object();
+	for (int i = 0; i < (int)LatencyStage_e::TOTAL_COUNT; ++i)
+	{
+		const auto& histogram = histograms[i];
+		jsonState[latencyStageNames[i]] = {
+			{"count", histogram.GetCount()},
+			{"mean_ns", histogram.GetMean()},
+			{"p50_ns", histogram.GetPercentile(50.0)},
+			{"p99_ns", histogram.GetPercentile(99.0)},
+			{"max_ns", histogram.GetMax()}
+		};
+	}
+	return jsonState;
+}
+
+void LatencyMonitor::SaveState(std::string filePath)
+{
+	nlohmann::json jsonState = SerializeState();
+	std::ofstream file(filePath);
+	if (file.is_open()) {
+		file << jsonState.dump(4); // Pretty print JSON
+		file.close();
+	}
+	else {
+		std::cerr << "Could not write latency metrics to " << filePath << std::endl;
+	}
+}
+
+void LatencyMonitor::DisplayImGuiWindow(bool* p_open)
+{
+	if (p_open)
+	{
+		ImGui::Begin("Pipeline Metrics", p_open);
+#if SDD_LATENCY_METRICS
+		ImGui::Text("Latency since the packet was received, in microseconds");
+		if (ImGui::BeginTable("latency", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Stage");
+			ImGui::TableSetupColumn("Count");
+			ImGui::TableSetupColumn("Mean");
+			ImGui::TableSetupColumn("p50");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableSetupColumn("Max");
+			ImGui::TableHeadersRow();
+			for (int i = 0; i < (int)LatencyStage_e::TOTAL_COUNT; ++i)
+			{
+				const auto& histogram = histograms[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", latencyStageNames[i]);
+				ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)histogram.GetCount());
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", histogram.GetMean() / 1000.0);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", histogram.GetPercentile(50.0) / 1000.0);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", histogram.GetPercentile(99.0) / 1000.0);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", histogram.GetMax() / 1000.0);
+			}
+			ImGui::EndTable();
+		}
+		if (ImGui::Button("Reset"))
+			Reset();
+		ImGui::SameLine();
+		if (ImGui::Button("Save to latency.json"))
+			SaveState("latency.json");
+#else
+		ImGui::Text("Latency metrics were disabled at build time (SDD_LATENCY_METRICS=0)");
+#endif
+		ImGui::Separator();
+		if (ImGui::CollapsingHeader("Threads", ImGuiTreeNodeFlags_DefaultOpen))
+			ThreadPlacement::GetInstance()->DisplayImGuiTable();
+		ImGui::End();
+	}
+}
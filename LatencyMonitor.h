@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef LATENCYMONITOR_H
+#define LATENCYMONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include "nlohmann/json.hpp"
+
+/*
+	Bus-to-glass latency instrumentation.
+
+	Every stage is measured from the moment the ingest thread received the packet
+	holding the bus events, so each histogram shows the total latency up to that point:
+		PACKET_QUEUE	packet popped by the processing thread
+		PACKET_DECODE	all the packet's events decoded and processed
+		VBL_FLIP		the frame the events ended up in was flipped to the renderer
+		A2_RENDER		A2VideoManager::Render() finished with that frame
+		POSTPROCESS		PostProcessor::Render() finished with that frame
+		SWAP			SDL_GL_SwapWindow() returned with that frame on screen
+
+	The hooks are the LATENCY_* macros below. Build with -DSDD_LATENCY_METRICS=0
+	and they compile to nothing.
+*/
+
+#ifndef SDD_LATENCY_METRICS
+#define SDD_LATENCY_METRICS 1
+#endif
+
+enum class LatencyStage_e
+{
+	PACKET_QUEUE = 0,
+	PACKET_DECODE,
+	VBL_FLIP,
+	A2_RENDER,
+	POSTPROCESS,
+	SWAP,
+	TOTAL_COUNT
+};
+
+// Log-linear histogram of nanosecond values: 8 sub-buckets per power of 2,
+// so percentiles are within 12.5%. Single writer, any number of readers.
+class LatencyHistogram
+{
+public:
+	static constexpr uint32_t SUB_BUCKETS_BITS = 3;
+	static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKETS_BITS;
+	static constexpr uint32_t BUCKET_COUNT = (64 - SUB_BUCKETS_BITS + 1) * SUB_BUCKETS;
+
+	void Record(uint64_t ns);
+	void Reset();
+	uint64_t GetCount() const { return count.load(std::memory_order_relaxed); };
+	uint64_t GetMax() const { return max.load(std::memory_order_relaxed); };
+	uint64_t GetMean() const;
+	// Upper bound of the bucket holding the given percentile (0-100)
+	uint64_t GetPercentile(double percentile) const;
+private:
+	static uint32_t BucketIndex(uint64_t ns);
+	static uint64_t BucketUpperBound(uint32_t idx);
+
+	std::atomic<uint32_t> buckets[BUCKET_COUNT] = {};
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> sum = 0;
+	std::atomic<uint64_t> max = 0;
+};
+
+class LatencyMonitor
+{
+public:
+	// Monotonic timestamp used by all the stages
+	static uint64_t Now();
+
+	void Record(LatencyStage_e stage, uint64_t since_ns);
+	void Reset();
+
+	// Receipt timestamp of the packet currently being processed. Owned by the processing thread.
+	void SetBusTimestamp(uint64_t ns) { busTimestamp = ns; };
+	uint64_t GetBusTimestamp() const { return busTimestamp; };
+
+	// Frame stages, called from the main thread. BeginFrame() is given the bus timestamp of the
+	// frame that was just rendered, and each stage is then only recorded once for that frame.
+	void BeginFrame(uint64_t bus_ns);
+	void RecordFrameStage(LatencyStage_e stage);
+
+	const LatencyHistogram& GetHistogram(LatencyStage_e stage) const { return histograms[(int)stage]; };
+	static const char* GetStageName(LatencyStage_e stage);
+
+	nlohmann::json SerializeState();
+	void SaveState(std::string filePath);
+	void DisplayImGuiWindow(bool* p_open);
+
+	// public singleton code
+	static LatencyMonitor* GetInstance()
+	{
+		if (NULL == s_instance)
+			s_instance = new LatencyMonitor();
+		return s_instance;
+	}
+private:
+	static LatencyMonitor* s_instance;
+	LatencyMonitor() {};
+
+	LatencyHistogram histograms[(int)LatencyStage_e::TOTAL_COUNT];
+	uint64_t busTimestamp = 0;
+	uint64_t frameBusTimestamp = 0;
+	uint32_t frameStagesRecorded = 0;	// bitmask of LatencyStage_e
+};
+
+#if SDD_LATENCY_METRICS
+#define LATENCY_NOW() LatencyMonitor::Now()
+#define LATENCY_RECORD(stage, since_ns) LatencyMonitor::GetInstance()->Record(stage, since_ns)
+#define LATENCY_SET_BUS_TIMESTAMP(ns) LatencyMonitor::GetInstance()->SetBusTimestamp(ns)
+#define LATENCY_GET_BUS_TIMESTAMP() LatencyMonitor::GetInstance()->GetBusTimestamp()
+#define LATENCY_BEGIN_FRAME(bus_ns) LatencyMonitor::GetInstance()->BeginFrame(bus_ns)
+#define LATENCY_FRAME_STAGE(stage) LatencyMonitor::GetInstance()->RecordFrameStage(stage)
+#else
+#define LATENCY_NOW() ((uint64_t)0)
+#define LATENCY_RECORD(stage, since_ns) ((void)0)
+#define LATENCY_SET_BUS_TIMESTAMP(ns) ((void)0)
+#define LATENCY_GET_BUS_TIMESTAMP() ((uint64_t)0)
+#define LATENCY_BEGIN_FRAME(bus_ns) ((void)0)
+#define LATENCY_FRAME_STAGE(stage) ((void)0)
+#endif
+
+#endif // LATENCYMONITOR_H
@@ -0,0 +1,106 @@
+#include "LegacyExpand.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEGACYEXPAND_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define LEGACYEXPAND_NEON
+#include <arm_neon.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar kernel
+//////////////////////////////////////////////////////////////////////////
+
+void legacy_cycles_interleave_scalar(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t* byteStartPtr = vram + i * 4;
+		byteStartPtr[0] = mem[i];
+		byteStartPtr[1] = memAux[i];
+		byteStartPtr[2] = flags;
+		byteStartPtr[3] = colors;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SIMD kernel
+//////////////////////////////////////////////////////////////////////////
+
+#if defined(LEGACYEXPAND_SSE2)
+
+static void legacy_cycles_interleave_simd(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors)
+{
+	const __m128i flagsColors = _mm_set1_epi16((short)(flags | (colors << 8)));
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i m = _mm_loadu_si128((const __m128i*)(mem + i));
+		__m128i a = _mm_loadu_si128((const __m128i*)(memAux + i));
+		// main | aux << 8, then flags | colors << 8 in the upper 16 bits of each cycle
+		__m128i ma0 = _mm_unpacklo_epi8(m, a);
+		__m128i ma1 = _mm_unpackhi_epi8(m, a);
+		__m128i* out = (__m128i*)(vram + i * 4);
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(ma0, flagsColors));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(ma0, flagsColors));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(ma1, flagsColors));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(ma1, flagsColors));
+	}
+	legacy_cycles_interleave_scalar(vram + i * 4, mem + i, memAux + i, count - i, flags, colors);
+}
+
+static const char* s_simdName = "SSE2";
+
+#elif defined(LEGACYEXPAND_NEON)
+
+static void legacy_cycles_interleave_simd(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors)
+{
+	uint8x16x4_t cycles;
+	cycles.val[2] = vdupq_n_u8(flags);
+	cycles.val[3] = vdupq_n_u8(colors);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		cycles.val[0] = vld1q_u8(mem + i);
+		cycles.val[1] = vld1q_u8(memAux + i);
+		vst4q_u8(vram + i * 4, cycles);
+	}
+	legacy_cycles_interleave_scalar(vram + i * 4, mem + i, memAux + i, count - i, flags, colors);
+}
+
+static const char* s_simdName = "NEON";
+
+#else
+
+static void legacy_cycles_interleave_simd(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors)
+{
+	legacy_cycles_interleave_scalar(vram, mem, memAux, count, flags, colors);
+}
+
+static const char* s_simdName = "scalar";
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Dispatch
+//////////////////////////////////////////////////////////////////////////
+
+static void (*s_interleave)(uint8_t*, const uint8_t*, const uint8_t*, size_t, uint8_t, uint8_t) = legacy_cycles_interleave_simd;
+static bool s_bSimd = true;
+
+void legacy_cycles_interleave(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors)
+{
+	s_interleave(vram, mem, memAux, count, flags, colors);
+}
+
+void set_legacy_expand_simd(bool enable)
+{
+	s_bSimd = enable;
+	s_interleave = (enable ? legacy_cycles_interleave_simd : legacy_cycles_interleave_scalar);
+}
+
+const char* get_legacy_expand_name()
+{
+	return (s_bSimd ? s_simdName : "scalar");
+}
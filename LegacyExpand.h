@@ -0,0 +1,32 @@
+#pragma once
+
+#ifndef LEGACYEXPAND_H
+#define LEGACYEXPAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+	Per-line legacy (TEXT, LGR, HGR and their double modes) content expansion
+	done by the beam before the vram upload.
+
+	The vram gets 4 bytes per content cycle: the main and aux memory bytes,
+	then the flags and colors bytes, which are the same for the whole run.
+	Every legacy mode has that layout, the shader decodes the mode from the
+	flags, so a single interleave kernel serves all of them.
+
+	The kernel is SSE2 or NEON when available, and scalar otherwise.
+	set_legacy_expand_simd(false) switches to the scalar one at runtime, which
+	is what the bench_replay tool uses to compare them.
+*/
+
+// Writes the 4 vram bytes of each of the count cycles: mem[i], memAux[i], flags, colors.
+void legacy_cycles_interleave(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors);
+void legacy_cycles_interleave_scalar(uint8_t* vram, const uint8_t* mem, const uint8_t* memAux, size_t count, uint8_t flags, uint8_t colors);
+
+// Selects the kernel used by legacy_cycles_interleave(). SIMD by default.
+void set_legacy_expand_simd(bool enable);
+// Name of the kernel currently used, for display
+const char* get_legacy_expand_name();
+
+#endif // LEGACYEXPAND_H
@@ -13,6 +13,7 @@
 #include "MockingboardManager.h"
 #include "PostProcessor.h"
 #include "EventRecorder.h"
+#include "LatencyMonitor.h"
 #include "SDHRManager.h"
 #include "SDHRNetworking.h"
 #include "extras/MemoryLoader.h"
@@ -62,6 +63,7 @@ public:
 	bool bShowEventRecorderWindow = false;
 	bool bShowLoadFileWindow = false;
 	bool bShowImGuiMetricsWindow = false;
+	bool bShowLatencyWindow = false;
 	bool bShowMemoryHeatMap = false;
 	
 	bool bSampleRunKarateka = false;
@@ -100,7 +102,9 @@ MainMenu::MainMenu(SDL_GLContext gl_context, SDL_Window* window)
 	
 	pGui->mem_edit_a2e.Open = false;
 	pGui->mem_edit_a2e.HighlightFn = Memory_HighlightWriteFunction;
+	pGui->mem_edit_a2e.WriteFn = Memory_EditorWriteFunction;
 	pGui->mem_edit_sdhr_upload.Open = false;
+	pGui->mem_edit_sdhr_upload.WriteFn = Memory_EditorWriteFunction;
 }
 
 MainMenu::~MainMenu() {
@@ -302,6 +306,7 @@ void MainMenu::Render() {
 				// Draw the heat map
 				auto currT = CycleCounter::GetInstance()->GetCycleTimestamp();
 				auto memMgr = MemoryManager::GetInstance();
+				memMgr->SetWriteHighlightSeconds(pGui->mem_edit_a2e.OptHighlightFnSeconds);
 				for (auto j=0; j < 2; ++j) {
 					for (auto i=0; i < _A2_MEMORY_SHADOW_END; ++i) {
 						auto tdiff = currT - memMgr->GetMemWriteTimestamp(i + j*_A2_MEMORY_SHADOW_END);
@@ -514,6 +519,8 @@ void MainMenu::Render() {
 		
 		if (pGui->bShowImGuiMetricsWindow)
 			ImGui::ShowMetricsWindow(&pGui->bShowImGuiMetricsWindow);
+		if (pGui->bShowLatencyWindow)
+			LatencyMonitor::GetInstance()->DisplayImGuiWindow(&pGui->bShowLatencyWindow);
 	}
 	
 	ImGui::Render();
@@ -666,6 +673,40 @@ void MainMenu::ShowSDDMenu() {
 			ImGui::Text("%s", "No data (Apple 2 is off?)");
 		else
 			ImGui::Text("%s", get_tini_last_error_string().c_str());
+		ImGui::Separator();
+		int _usbDepth = (int)get_usb_transfer_depth();
+		if (ImGui::SliderInt("USB transfers in flight", &_usbDepth, 1, USB_MAX_TRANSFERS_IN_FLIGHT))
+			set_usb_transfer_depth((uint32_t)_usbDepth);
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("1 issues one synchronous read at a time.\nAbove 1, reads are queued ahead so the bus is never idle.");
+		if (_usbDepth > 1) {
+			int _usbSizeK = (int)get_usb_transfer_size() / 1024;
+			if (ImGui::SliderInt("USB transfer size (KB)", &_usbSizeK, PKT_BUFSZ / 1024, PKT_MAX_XFERSZ / 1024))
+				set_usb_transfer_size((uint32_t)_usbSizeK * 1024);
+		}
+		ImGui::Text("Transfers in flight: %u", get_usb_transfers_in_flight());
+		ImGui::Text("Throughput: %.2f MB/s", get_usb_bytes_per_second() / (1024.0 * 1024.0));
+		ImGui::Text("Stall time: %llu ms", (unsigned long long)get_usb_stall_time_ms());
+		ImGui::Separator();
+		ImGui::Text("Queued: %.1f KB%s", get_ingest_queued_bytes() / 1024.0, is_ingest_backpressured() ? " (BACKPRESSURE)" : "");
+		ImGui::Text("Frames skipped to catch up: %llu", (unsigned long long)A2VideoManager::GetInstance()->GetSkippedBeamFrames());
+		ImGui::Text("Garbage: %llu  Truncated: %llu  Unknown: %llu",
+			(unsigned long long)get_garbage_message_count(),
+			(unsigned long long)get_truncated_message_count(),
+			(unsigned long long)get_unknown_message_count());
+		ImGui::Text("Dropped: %llu bytes", (unsigned long long)get_dropped_bytes());
+		ImGui::Text("Packet pool ran dry: %llu times", (unsigned long long)get_pool_exhaustion_count());
+		ImGui::Separator();
+		const char* _waitPolicies[] = { "Park (low CPU)", "Yield", "Spin (uses a whole core)" };
+		int _waitPolicy = (int)get_consumer_wait_policy();
+		if (ImGui::Combo("Processing wait", &_waitPolicy, _waitPolicies, IM_ARRAYSIZE(_waitPolicies)))
+			set_consumer_wait_policy((ConsumerWaitPolicy_e)_waitPolicy);
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("How the processing thread waits for USB data.\nSpin gives the lowest and most stable latency\nat the cost of one CPU core, for dedicated display boxes.");
+		ImGui::Text("Waits ended by spin: %llu  yield: %llu  park: %llu",
+			(unsigned long long)get_consumer_wait_spin_count(),
+			(unsigned long long)get_consumer_wait_yield_count(),
+			(unsigned long long)get_consumer_wait_park_count());
 		ImGui::EndMenu();
 	}
 	ImGui::Separator();
@@ -819,6 +860,7 @@ void MainMenu::ShowSamplesMenu() {
 		std::ifstream legacydemo("./samples/tomahawk2_hgr.bin", std::ios::binary);
 		legacydemo.seekg(0, std::ios::beg); // Go back to the start of the file
 		legacydemo.read(reinterpret_cast<char*>(MemoryManager::GetInstance()->GetApple2MemPtr()), 0x4000);
+		MemoryManager::GetInstance()->MarkPagesWritten(0, 0x4000);
 		a2VideoManager->bDEMOMergedMode = true;
 		a2VideoManager->bAlignQuadsToScanline = true;
 		a2VideoManager->ForceBeamFullScreenRender();
@@ -954,6 +996,7 @@ void MainMenu::ShowDeveloperMenu() {
 	}
 	ImGui::Separator();
 	ImGui::MenuItem("ImGui Metrics Window", "", &pGui->bShowImGuiMetricsWindow);
+	ImGui::MenuItem("Pipeline Metrics", "", &pGui->bShowLatencyWindow);
 }
 
 // UTILITY
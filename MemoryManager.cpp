@@ -1,25 +1,34 @@
 #include "MemoryManager.h"
 #include "CycleCounter.h"
 #include "A2VideoManager.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
 float Memory_HighlightWriteFunction(const uint8_t* data, size_t offset, uint8_t cutoffSeconds) {
 	(void)data;
 	// data pointer is the start of memory
-	auto usecdelta = CycleCounter::GetInstance()->GetCycleTimestamp() - MemoryManager::GetInstance()->GetMemWriteTimestamp(offset);
+	auto memMgr = MemoryManager::GetInstance();
+	memMgr->SetWriteHighlightSeconds(cutoffSeconds);
+	auto usecdelta = CycleCounter::GetInstance()->GetCycleTimestamp() - memMgr->GetMemWriteTimestamp(offset);
 	// Return a range between 0 and 1, where 1 is newly updated and 0 is at least 1 second ago
 	if (usecdelta >= 1'000'000 * cutoffSeconds)
 		return 0.f;
 	return (1.f - (static_cast<float>(usecdelta) / (1'000'000 * cutoffSeconds)));
 }
 
+void Memory_EditorWriteFunction(uint8_t* data, size_t offset, uint8_t value) {
+	data[offset] = value;
+	MemoryManager::GetInstance()->MarkPagesWritten(offset, 1);
+}
+
 // below because "The declaration of a static data member in its class definition is not a definition"
 MemoryManager* MemoryManager::s_instance;
 
 MemoryManager::~MemoryManager()
 {
 	delete[] a2mem;
+	delete[] a2mem_writeBits;
 }
 
 void MemoryManager::Initialize()
@@ -30,12 +39,65 @@ void MemoryManager::Initialize()
 	// be sent through the socket and this buffer will be updated
 	// memory of both banks is concatenated into one buffer
 	memset(a2mem, 0x00, _A2_MEMORY_SHADOW_END * 2);
+	ResetWriteTracking();
 	a2SoftSwitches = A2SS_TEXT; // default to TEXT1
+	++softSwitchesVersion;
 	switch_c022 = 0b11110000;	// white fg, black bg
 	switch_c034 = 0;
 	is2gs = false;
 }
 
+void MemoryManager::ResetWriteTracking()
+{
+	// Drop the highlights, but never go back in epochs: the EventRecorder compares the page
+	// epochs with the epoch of its last snapshot. The whole memory was just cleared, so every
+	// page is written in a new epoch.
+	memset(a2mem_writeBits, 0, MEMWRITE_EPOCH_COUNT * MEMWRITE_BITSET_WORDS * sizeof(uint64_t));
+	memset(writeEpochStartUs, 0, sizeof(writeEpochStartUs));
+	++writeEpoch;
+	auto _slot = writeEpoch % MEMWRITE_EPOCH_COUNT;
+	writeEpochBits = a2mem_writeBits + _slot * MEMWRITE_BITSET_WORDS;
+	writeEpochStartUs[_slot] = CycleCounter::GetInstance()->GetCycleTimestamp();
+	std::fill(std::begin(a2mem_pageEpoch), std::end(a2mem_pageEpoch), writeEpoch);
+}
+
+void MemoryManager::AdvanceWriteEpoch(size_t timestamp)
+{
+	if ((timestamp - writeEpochStartUs[writeEpoch % MEMWRITE_EPOCH_COUNT]) < writeEpochMinUs)
+		return;
+	// The oldest epoch of the ring is dropped and becomes the current one
+	++writeEpoch;
+	auto _slot = writeEpoch % MEMWRITE_EPOCH_COUNT;
+	writeEpochBits = a2mem_writeBits + _slot * MEMWRITE_BITSET_WORDS;
+	memset(writeEpochBits, 0, MEMWRITE_BITSET_WORDS * sizeof(uint64_t));
+	writeEpochStartUs[_slot] = timestamp;
+}
+
+void MemoryManager::MarkPagesWritten(size_t offset, size_t size)
+{
+	if ((size == 0) || (offset >= (_A2_MEMORY_SHADOW_END * 2)))
+		return;
+	size_t _lastPage = (std::min(offset + size, (size_t)_A2_MEMORY_SHADOW_END * 2) - 1) >> MEMWRITE_PAGE_SHIFT;
+	for (size_t page = (offset >> MEMWRITE_PAGE_SHIFT); page <= _lastPage; ++page)
+		a2mem_pageEpoch[page] = writeEpoch;
+}
+
+size_t MemoryManager::GetMemWriteTimestamp(size_t offset)
+{
+	if (offset >= (_A2_MEMORY_SHADOW_END * 2))
+		return 0;
+	// The byte was last written at the latest in the last epoch its page was written
+	auto _epoch = a2mem_pageEpoch[offset >> MEMWRITE_PAGE_SHIFT];
+	const uint64_t _bit = 1ull << (offset & 63);
+	for (; (_epoch + MEMWRITE_EPOCH_COUNT) > writeEpoch; --_epoch)
+	{
+		auto _slot = _epoch % MEMWRITE_EPOCH_COUNT;
+		if (a2mem_writeBits[_slot * MEMWRITE_BITSET_WORDS + (offset >> 6)] & _bit)
+			return writeEpochStartUs[_slot];
+	}
+	return 0;
+}
+
 // Return a pointer to the shadowed apple 2 memory
 uint8_t* MemoryManager::GetApple2MemPtr()
 {
@@ -54,9 +116,141 @@ void MemoryManager::SetSoftSwitch(A2SoftSwitch_e ss, bool state)
 		a2SoftSwitches |= ss;
 	else
 		a2SoftSwitches &= ~ss;
+	++softSwitchesVersion;
+}
+
+// Decodes a $C0xx event the same way as ProcessSoftSwitchReference(), for the action table
+static constexpr SoftSwitchAction classify_softswitch(uint8_t addrlo, bool rw, bool is_iigs)
+{
+	(void)is_iigs;		// Appletini brings iigs features to the //e, so both machines decode the same
+	SoftSwitchAction action;
+	if (addrlo < 0x10)
+	{
+		// Write-only OFF/ON pairs. $C008/9 is ALTZP, which isn't tracked.
+		const uint16_t pairMasks[8] = { A2SS_80STORE, A2SS_RAMRD, A2SS_RAMWRT, A2SS_INTCXROM,
+			0, A2SS_SLOTC3ROM, A2SS_80COL, A2SS_ALTCHARSET };
+		if (!rw)
+		{
+			if (addrlo & 1)
+				action.setMask = pairMasks[addrlo >> 1];
+			else
+				action.clearMask = pairMasks[addrlo >> 1];
+		}
+	}
+	else if (addrlo >= 0x50 && addrlo < 0x60)
+	{
+		// OFF/ON pairs on read or write. DHIRES is the other way around: $C05E turns it on.
+		const uint16_t pairMasks[8] = { A2SS_TEXT, A2SS_MIXED, A2SS_PAGE2, A2SS_HIRES, 0, 0, 0, A2SS_DHGR };
+		bool bOn = (addrlo & 1);
+		if (addrlo >= 0x5E)
+			bOn = !bOn;
+		if (bOn)
+			action.setMask = pairMasks[(addrlo - 0x50) >> 1];
+		else
+			action.clearMask = pairMasks[(addrlo - 0x50) >> 1];
+	}
+	else if (rw)
+	{
+		// Status reads, where bit 7 of the value is the state of the switch
+		switch (addrlo)
+		{
+		case 0x13: action.valueMask = A2SS_RAMRD; break;
+		case 0x14: action.valueMask = A2SS_RAMWRT; break;
+		case 0x15: action.valueMask = A2SS_INTCXROM; break;
+		case 0x17: action.valueMask = A2SS_SLOTC3ROM; break;
+		case 0x18: action.valueMask = A2SS_80STORE; break;
+		case 0x1A: action.valueMask = A2SS_TEXT; break;
+		case 0x1B: action.valueMask = A2SS_MIXED; break;
+		case 0x1C: action.valueMask = A2SS_PAGE2; break;
+		case 0x1D: action.valueMask = A2SS_HIRES; break;
+		case 0x1E: action.valueMask = A2SS_ALTCHARSET; break;
+		case 0x1F: action.valueMask = A2SS_80COL; break;
+		case 0x7F: action.valueMask = A2SS_DHGR; break;
+		default: break;
+		}
+	}
+	else
+	{
+		switch (addrlo)
+		{
+		case 0x21: action.valueMask = A2SS_GREYSCALE; break;		// MONOCOLOR
+		case 0x22: action.effect = SoftSwitchEffect_e::SCREENCOLOR; break;
+		case 0x29: action.effect = SoftSwitchEffect_e::NEWVIDEO; break;
+		case 0x34: action.effect = SoftSwitchEffect_e::BORDERCOLOR; break;
+		default: break;
+		}
+	}
+	action.bAffectsVideo = (((action.setMask | action.clearMask | action.valueMask) & A2SS_VIDEO_MASK) != 0)
+		|| (action.effect != SoftSwitchEffect_e::NONE);
+	return action;
+}
+
+// Indexed by [is_iigs][rw][address & 0xFF]
+struct SoftSwitchTable {
+	SoftSwitchAction actions[2][2][0x100];
+	constexpr SoftSwitchTable() : actions() {
+		for (uint32_t iigs = 0; iigs < 2; ++iigs)
+			for (uint32_t rw = 0; rw < 2; ++rw)
+				for (uint32_t i = 0; i < 0x100; ++i)
+					actions[iigs][rw][i] = classify_softswitch((uint8_t)i, rw != 0, iigs != 0);
+	}
+};
+static constexpr SoftSwitchTable softSwitchTable;
+static_assert(softSwitchTable.actions[0][1][0x5E].setMask == A2SS_DHGR, "$C05E turns DHIRES on");
+static_assert(softSwitchTable.actions[0][1][0x5F].clearMask == A2SS_DHGR, "$C05F turns DHIRES off");
+static_assert(softSwitchTable.actions[0][1][0x01].setMask == 0, "$C001 is write only");
+static_assert(!softSwitchTable.actions[0][0][0x05].bAffectsVideo, "RAMWRT doesn't change the display");
+static_assert(!softSwitchTable.actions[0][0][0x30].bAffectsVideo, "The speaker doesn't change the display");
+
+bool MemoryManager::IsVideoSoftSwitch(uint16_t addr, bool rw, bool is_iigs)
+{
+	if ((addr >> 8) != 0xC0)
+		return false;
+	return softSwitchTable.actions[is_iigs][rw][addr & 0xFF].bAffectsVideo;
+}
+
+bool MemoryManager::ProcessSoftSwitch(uint16_t addr, uint8_t val, bool rw, bool is_iigs)
+{
+	if ((addr >> 8) != 0xC0)
+		return false;
+	const SoftSwitchAction& action = softSwitchTable.actions[is_iigs][rw][addr & 0xFF];
+	auto _prevSoftSwitches = a2SoftSwitches;
+	bool bVideoChanged = false;
+	uint16_t _sw = (a2SoftSwitches & ~action.clearMask) | action.setMask;
+	if (action.valueMask)
+		_sw = (val & 0x80) ? (_sw | action.valueMask) : (_sw & ~action.valueMask);
+	switch (action.effect)
+	{
+	case SoftSwitchEffect_e::SCREENCOLOR:
+		bVideoChanged = (switch_c022 != val);
+		switch_c022 = val;
+		break;
+	case SoftSwitchEffect_e::BORDERCOLOR:
+		bVideoChanged = (switch_c034 != val);
+		switch_c034 = val;
+		break;
+	case SoftSwitchEffect_e::NEWVIDEO:
+		// bits 1-4 are reserved, and bit 6 only changes the SHR memory layout in bank E1
+		if (val == 0x21)
+		{
+			// Return to mode TEXT
+			_sw = (_sw & ~A2SS_SHR) | A2SS_TEXT;
+			break;
+		}
+		// bit 5 is DHGR in monochrome @ 560x192, bit 7 the SHR video mode
+		_sw = (val & 0x20) ? (_sw | A2SS_DHGRMONO) : (_sw & ~A2SS_DHGRMONO);
+		_sw = (val & 0x80) ? (_sw | A2SS_SHR) : (_sw & ~A2SS_SHR);
+		break;
+	default:
+		break;
+	}
+	a2SoftSwitches = _sw;
+	if (a2SoftSwitches != _prevSoftSwitches)
+		++softSwitchesVersion;
+	return bVideoChanged || (((a2SoftSwitches ^ _prevSoftSwitches) & A2SS_VIDEO_MASK) != 0);
 }
 
-void MemoryManager::ProcessSoftSwitch(uint16_t addr, uint8_t val, bool rw, bool is_iigs)
+void MemoryManager::ProcessSoftSwitchReference(uint16_t addr, uint8_t val, bool rw, bool is_iigs)
 {
 	(void)is_iigs;		// mark as unused -- Appletini brings iigs features to the //e
 	//std::cerr << "Processing soft switch " << std::hex << (uint32_t)addr << " RW: " << (uint32_t)rw << " 2gs: " << (uint32_t)is_iigs << std::endl;
@@ -130,6 +324,7 @@ void MemoryManager::ProcessSoftSwitch(uint16_t addr, uint8_t val, bool rw, bool
 	*/
 
 AFTERVIDEO7:
+	auto _prevSoftSwitches = a2SoftSwitches;
 	switch (addr)
 	{
 	case 0xC000:	// 80STOREOFF
@@ -404,6 +599,8 @@ AFTERVIDEO7:
 	default:
 		break;
 	}
+	if (a2SoftSwitches != _prevSoftSwitches)
+		++softSwitchesVersion;
 }
 
 void MemoryManager::WriteToMemory(uint16_t addr, uint8_t val, bool m2b0, bool is_iigs) {
@@ -462,11 +659,11 @@ void MemoryManager::WriteToMemory(uint16_t addr, uint8_t val, bool m2b0, bool is
 	if (bIsAux)
 	{
 		a2mem[_A2_MEMORY_SHADOW_END + addr] = val;
-		a2mem_lastUpdate[_A2_MEMORY_SHADOW_END + addr] = CycleCounter::GetInstance()->GetCycleTimestamp();
+		MarkWritten(_A2_MEMORY_SHADOW_END + addr);
 	}
 	else {
 		a2mem[addr] = val;
-		a2mem_lastUpdate[addr] = CycleCounter::GetInstance()->GetCycleTimestamp();
+		MarkWritten(addr);
 
 		// Handle Main ZERO PAGE data changes
 		if (addr < 0x100)
@@ -505,4 +702,5 @@ void MemoryManager::DeserializeSwitches(const std::string& data) {
 	in.read(reinterpret_cast<char*>(&switch_c022), sizeof(switch_c022));
 	in.read(reinterpret_cast<char*>(&switch_c034), sizeof(switch_c034));
 	in.read(reinterpret_cast<char*>(&is2gs), sizeof(is2gs));
+	++softSwitchesVersion;
 }
@@ -65,9 +65,49 @@ enum A2SoftSwitch_e
 	A2SS_SHR = 0b010000000000000,
 	A2SS_GREYSCALE = 0b100000000000000,
 };
+// The softswitches the beam reads. The others only select memory banks and ROMs.
+constexpr uint16_t A2SS_VIDEO_MASK = (uint16_t)~(A2SS_RAMRD | A2SS_RAMWRT | A2SS_INTCXROM | A2SS_SLOTC3ROM);
+
+// What a $C0xx event does besides setting and clearing softswitches
+enum class SoftSwitchEffect_e : uint8_t
+{
+	NONE = 0,
+	SCREENCOLOR,		// $C022 write, sets switch_c022
+	BORDERCOLOR,		// $C034 write, sets switch_c034
+	NEWVIDEO,			// $C029 write, SHR and DHGR monochrome from the value
+};
+
+// The decoded action of a $C0xx event, precomputed for each address, read or write, and machine
+struct SoftSwitchAction
+{
+	uint16_t setMask = 0;		// softswitches turned on
+	uint16_t clearMask = 0;		// softswitches turned off
+	uint16_t valueMask = 0;		// softswitches set to bit 7 of the value (the status reads of the Appletini)
+	SoftSwitchEffect_e effect = SoftSwitchEffect_e::NONE;
+	bool bAffectsVideo = false;	// the event can change what the beam draws
+};
 
 // For highlighting in the UI memory last written to. De-highlights after cutoffSeconds
 float Memory_HighlightWriteFunction(const uint8_t* data, size_t offset, uint8_t cutoffSeconds = 1);
+// For the UI memory editor, so that its changes are tracked like the Apple 2 writes
+void Memory_EditorWriteFunction(uint8_t* data, size_t offset, uint8_t value);
+
+/*
+	Memory write tracking, for the write highlights of the UI.
+	Time is split into write epochs, each lasting at least one frame. Every write stamps
+	the epoch in the generation counter of its 256-byte page, and sets the bit of its byte
+	in the bitset of the epoch. The bitsets are a ring of the last MEMWRITE_EPOCH_COUNT epochs,
+	and a byte's last write is found by going back from its page's epoch to the first bitset
+	that has it. A write touches the page counters, which always stay in cache, and one
+	word of the current bitset.
+	The epochs are scaled to the highlight fade time so that the ring always covers it.
+	The page epochs also tell the EventRecorder which pages changed between its RAM snapshots,
+	so the epochs only ever move forward, even through Initialize().
+	Anything that changes the memory without WriteToMemory() must call MarkPagesWritten().
+*/
+constexpr uint32_t MEMWRITE_PAGE_SHIFT = 8;		// 256-byte pages
+constexpr uint32_t MEMWRITE_EPOCH_COUNT = 64;	// epochs in the ring
+constexpr uint32_t MEMWRITE_BITSET_WORDS = (_A2_MEMORY_SHADOW_END * 2) / 64;
 
 class MemoryManager
 {
@@ -80,18 +120,31 @@ public:
 	uint8_t* GetApple2MemPtr();	// Gets the Apple 2 main memory pointer
 	uint8_t* GetApple2MemAuxPtr();	// Gets the Apple 2 aux memory pointer
 	
-	size_t GetMemWriteTimestamp(size_t offset) {
-		if (offset >= (_A2_MEMORY_SHADOW_END * 2))
-			return 0;
-		return a2mem_lastUpdate[offset];
-	};
+	// Timestamp of the start of the epoch of the last write to the byte, or 0 if it's older than the ring
+	size_t GetMemWriteTimestamp(size_t offset);
+	// Called at each frame start. Moves to the next write epoch when the current one is over.
+	void AdvanceWriteEpoch(size_t timestamp);
+	// The current write epoch, and the epoch of the last write to each 256-byte page
+	uint32_t GetWriteEpoch() { return writeEpoch; };
+	uint32_t GetPageWriteEpoch(size_t page) { return a2mem_pageEpoch[page]; };
+	// For the memory changed directly, without WriteToMemory(). Offset is in both banks.
+	void MarkPagesWritten(size_t offset, size_t size);
+	// The highlight fade time that the write epochs must cover
+	void SetWriteHighlightSeconds(uint32_t seconds) { writeEpochMinUs = (seconds * 1'000'000) / (MEMWRITE_EPOCH_COUNT - 1); };
 	
 	// Use this method to set a byte. It will choose which bank based on current softswitches
 	void WriteToMemory(uint16_t addr, uint8_t val, bool m2b0, bool is_iigs);
 
 	inline bool IsSoftSwitch(A2SoftSwitch_e ss) { return (a2SoftSwitches & ss); };
+	// Changes every time the softswitches change, so that state derived from them can be cached
+	inline uint32_t GetSoftSwitchesVersion() { return softSwitchesVersion; };
 	void SetSoftSwitch(A2SoftSwitch_e ss, bool state);
-	void ProcessSoftSwitch(uint16_t addr, uint8_t val, bool rw, bool is_iigs);
+	// Applies a $C0xx event. Returns true if what the beam draws has changed.
+	bool ProcessSoftSwitch(uint16_t addr, uint8_t val, bool rw, bool is_iigs);
+	// Whether the event can change what the beam draws, so the beam must catch up before it
+	bool IsVideoSoftSwitch(uint16_t addr, bool rw, bool is_iigs);
+	// The original switch-based decoder, kept to validate the action table against
+	void ProcessSoftSwitchReference(uint16_t addr, uint8_t val, bool rw, bool is_iigs);
 
 	// De/serialization in case one wants to save and restore state
 	std::string SerializeSwitches() const;
@@ -124,8 +177,8 @@ private:
 	{
 		auto _memsize = _A2_MEMORY_SHADOW_END * 2;		// anything below _A2_MEMORY_SHADOW_BEGIN is unused
 		a2mem = new uint8_t[_memsize];
-		a2mem_lastUpdate = new size_t[_memsize];
-		if (a2mem == NULL || a2mem_lastUpdate == NULL)
+		a2mem_writeBits = new uint64_t[MEMWRITE_EPOCH_COUNT * MEMWRITE_BITSET_WORDS];
+		if (a2mem == NULL || a2mem_writeBits == NULL)
 		{
 			std::cerr << "FATAL ERROR: COULD NOT ALLOCATE Apple 2 MEMORY" << std::endl;
 			exit(1);
@@ -138,13 +191,26 @@ private:
 	// Internal methods
 	//////////////////////////////////////////////////////////////////////////
 
+	inline void MarkWritten(uint32_t offset) {
+		a2mem_pageEpoch[offset >> MEMWRITE_PAGE_SHIFT] = writeEpoch;
+		writeEpochBits[offset >> 6] |= (1ull << (offset & 63));
+	};
+	void ResetWriteTracking();
+
 	//////////////////////////////////////////////////////////////////////////
 	// Internal data
 	//////////////////////////////////////////////////////////////////////////
 
 	uint8_t* a2mem;					// The current shadowed Apple 2 memory
-	size_t* a2mem_lastUpdate;		// timestamp of last update of each Apple 2 memory byte
+	// Write tracking, see MEMWRITE_EPOCH_COUNT
+	uint32_t a2mem_pageEpoch[(_A2_MEMORY_SHADOW_END * 2) >> MEMWRITE_PAGE_SHIFT];	// last write epoch of each page
+	uint64_t* a2mem_writeBits;		// ring of the bitsets of the bytes written in each epoch
+	uint64_t* writeEpochBits;		// bitset of the current epoch
+	size_t writeEpochStartUs[MEMWRITE_EPOCH_COUNT];	// start timestamp of each epoch of the ring
+	uint32_t writeEpoch = MEMWRITE_EPOCH_COUNT;		// so that going back a whole ring never wraps below 0
+	size_t writeEpochMinUs = 1'000'000 / (MEMWRITE_EPOCH_COUNT - 1);
 	uint16_t a2SoftSwitches;		// Soft switches states
+	uint32_t softSwitchesVersion = 0;	// See GetSoftSwitchesVersion()
 	// uint8_t stateAN3Video7 = 0;		// State of the AN3 toggle for Video-7. Needs to toggle 5 times, starting with off
 	// uint8_t flagsVideo7 = 0;		// 2 bits
 };
@@ -2,6 +2,7 @@
 #include "imgui.h"
 #include "imgui_internal.h"		// for PushItemFlag
 #include "extras/ImGuiFileDialog.h"
+#include "LatencyMonitor.h"
 // For save/restore of presets
 #include <fstream>
 #include <sstream>
@@ -232,7 +233,7 @@ void PostProcessor::DeserializeState(const nlohmann::json &jsonState)
 	p_v_reflectionScale.y = jsonState.value("p_v_reflectionScaleY", p_v_reflectionScale.y);
 	p_v_reflectionTranslation.x = jsonState.value("p_v_reflectionTranslationX", p_v_reflectionTranslation.x);
 	p_v_reflectionTranslation.y = jsonState.value("p_v_reflectionTranslationY", p_v_reflectionTranslation.y);
-
+	bFrameWasDrawn = false;
 }
 
 void PostProcessor::SaveState(std::string filePath) {
@@ -401,7 +402,19 @@ void PostProcessor::RegeneratePreviousTexture()
 	}
 }
 
-void PostProcessor::Render(SDL_Window* window, GLuint inputTextureSlot, GLuint scanlineCount)
+// The effects that change from one frame to the next with the same input
+bool PostProcessor::HasTimeBasedEffects()
+{
+	if (bHalveFramerate || (p_f_ghostingPercent > 0))
+		return true;
+	// In the CRT shader, the new style scanlines scroll, flicker with interlacing and have film grain
+	if ((p_i_postprocessingLevel > 1) && (p_i_scanlineType == 2))
+		return ((p_f_scanlineWeight > 0.00001f) && (p_f_scanSpeed != 0.f))
+			|| (p_f_interlace > 0.f) || (p_f_filmGrain > 0.f);
+	return false;
+}
+
+void PostProcessor::Render(SDL_Window* window, GLuint inputTextureSlot, GLuint scanlineCount, bool bInputChanged)
 {
 	if (bezelImageAsset.tex_id == UINT_MAX)
 	{
@@ -430,6 +443,21 @@ void PostProcessor::Render(SDL_Window* window, GLuint inputTextureSlot, GLuint s
 		viewportWidth -= 1;
 	if (viewportHeight % 2 == 1)
 		viewportHeight -= 1;
+
+	// Static screen: if nothing changed since the last frame that was drawn, the window
+	// already shows this frame. Don't draw it, and main.cpp won't swap it.
+	bFrameUnchanged = bFrameWasDrawn && !bInputChanged && (inputTextureSlot == (GLuint)texUnitCurrent)
+		&& (viewportWidth == prev_viewportWidth) && (viewportHeight == prev_viewportHeight)
+		&& (scanlineCount == prev_scanlineCount) && !HasTimeBasedEffects();
+	if (bFrameUnchanged)
+	{
+		++static_frames_skipped;
+		return;
+	}
+	prev_viewportWidth = viewportWidth;
+	prev_viewportHeight = viewportHeight;
+	prev_scanlineCount = scanlineCount;
+
 	glViewport(0, 0, viewportWidth, viewportHeight);
 	GLenum glerr;
 	if ((glerr = glGetError()) != GL_NO_ERROR) {
@@ -606,6 +634,8 @@ void PostProcessor::Render(SDL_Window* window, GLuint inputTextureSlot, GLuint s
 	// revert the texture assignment
 	glActiveTexture(GL_TEXTURE0);
 	++frame_count;
+	bFrameWasDrawn = true;
+	LATENCY_FRAME_STAGE(LatencyStage_e::POSTPROCESS);
 }
 
 
@@ -670,6 +700,8 @@ void PostProcessor::ResetToDefaults()
 	// imgui vars
 	bImGuiLockWarp = false;
 	bImGuiLockZoom = false;
+
+	bFrameWasDrawn = false;
 }
 
 void PostProcessor::DisplayImGuiWindow(bool* p_open)
@@ -844,6 +876,10 @@ Merges every pair of even and odd frames.\n\
 Effectively halves the frame rate\n\
 but removes any flickering associated\n\
 with page flipping images");
+		ImGui::Text("Static frames skipped: %llu", (unsigned long long)static_frames_skipped);
+		ImGui::SetItemTooltip("Frames not drawn because the screen didn't change.\n\
+Merge Frame Pairs, ghosting and animated CRT effects\n\
+draw every frame");
 		if (p_i_postprocessingLevel == 2) {
 			ImGui::Separator();
 			// Scanline and Interlacing
@@ -24,7 +24,8 @@ public:
 	}
 	~PostProcessor();
 
-	void Render(SDL_Window* window, GLuint inputTextureSlot, GLuint scanlineCount);
+	// bInputChanged is false when the input texture holds the same image as in the previous call
+	void Render(SDL_Window* window, GLuint inputTextureSlot, GLuint scanlineCount, bool bInputChanged = true);
 	void DisplayImGuiWindow(bool* p_open);
 
 	nlohmann::json SerializeState();
@@ -33,8 +34,11 @@ public:
 	// Tells main.cpp to skip flipping the buffers if we are halving the frame rate
 	// This actually skips even frames if ShouldFrameBeSkipped() is called after the frame
 	// is created
-	const bool ShouldFrameBeSkipped() { return (bHalveFramerate && (frame_count & 1) == 1); };
+	// It also skips the frames that Render() didn't draw because the window already shows them
+	const bool ShouldFrameBeSkipped() { return bFrameUnchanged || (bHalveFramerate && (frame_count & 1) == 1); };
 	const bool IsFrameRateHalved() { return bHalveFramerate; };
+	const bool IsFrameUnchanged() { return bFrameUnchanged; };	// the last Render() skipped a static frame
+	const uint64_t GetStaticFramesSkipped() { return static_frames_skipped; };
 
 	// public properties
 	std::vector<Shader>v_ppshaders;
@@ -48,6 +52,7 @@ private:
 	void ResetToDefaults();
 
 	void LoadSelectedBezel();
+	bool HasTimeBasedEffects();
 
 	// Singleton pattern
 	static PostProcessor* s_instance;
@@ -91,6 +96,12 @@ private:
 	bool bCRTFillWindow = false;
 
 	int frame_count = 0;	// Frame count for interlacing, it may not be aligned with A2Video frames
+	// Static screen detection: the output is only drawn when its inputs changed
+	bool bFrameUnchanged = false;
+	bool bFrameWasDrawn = false;	// the previous Render() drew the frame, nothing changed its inputs since
+	GLint prev_viewportWidth = 0, prev_viewportHeight = 0;
+	GLuint prev_scanlineCount = 0;
+	uint64_t static_frames_skipped = 0;
 	char preset_name_buffer[28];	// Preset's name
 	int max_integer_scale = 1;	// Maximum possible integer scale given screen size
 	int integer_scale = 1;		// Base integer scale used
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef REPLAYPROFILE_H
+#define REPLAYPROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+
+/*
+	Per-subsystem time split of the bus event handlers, for the bench_replay tool.
+
+	process_single_event() and process_idle_cycles() wrap each handler call in
+	REPLAY_PROFILE(section, call). The hooks only exist when built with
+	-DSDD_REPLAY_PROFILE=1, which only the bench_replay target does, and even then
+	they only time anything while ReplayProfile::bEnabled is set.
+	Each timed call costs the overhead of two clock reads, which bench_replay measures
+	and subtracts, so the split is an estimate. Use the untimed pass for the totals.
+
+	Single threaded: the bench calls the handlers from its own thread.
+*/
+
+#ifndef SDD_REPLAY_PROFILE
+#define SDD_REPLAY_PROFILE 0
+#endif
+
+enum class ReplaySection_e
+{
+	VIDEO = 0,		// CycleCounter and the beam, BeamIsAtPosition() and BeamFlush()
+	SOUND,			// SoundManager, the speaker
+	MOCKINGBOARD,	// MockingboardManager
+	MEMORY,			// MemoryManager writes and softswitches
+	SDHR,			// SDHRManager commands
+	TOTAL_COUNT
+};
+
+struct ReplayProfile
+{
+	static inline bool bEnabled = false;
+	static inline uint64_t ns[(int)ReplaySection_e::TOTAL_COUNT] = {};
+	static inline uint64_t calls[(int)ReplaySection_e::TOTAL_COUNT] = {};
+
+	static uint64_t Now() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+	static void Reset() {
+		for (int i = 0; i < (int)ReplaySection_e::TOTAL_COUNT; ++i)
+		{
+			ns[i] = 0;
+			calls[i] = 0;
+		}
+	};
+	static const char* GetSectionName(ReplaySection_e section) {
+		switch (section) {
+			case ReplaySection_e::VIDEO: return "video";
+			case ReplaySection_e::SOUND: return "sound";
+			case ReplaySection_e::MOCKINGBOARD: return "mockingboard";
+			case ReplaySection_e::MEMORY: return "memory";
+			case ReplaySection_e::SDHR: return "sdhr";
+			default: return "invalid";
+		}
+	};
+};
+
+// Times its own lifetime into the section
+class ReplayProfileScope
+{
+public:
+	explicit ReplayProfileScope(ReplaySection_e _section)
+		: section(_section), start(ReplayProfile::bEnabled ? ReplayProfile::Now() : 0) {};
+	~ReplayProfileScope() {
+		if (start == 0)
+			return;
+		ReplayProfile::ns[(int)section] += ReplayProfile::Now() - start;
+		++ReplayProfile::calls[(int)section];
+	};
+private:
+	ReplaySection_e section;
+	uint64_t start;
+};
+
+#if SDD_REPLAY_PROFILE
+#define REPLAY_PROFILE(section, call) do { ReplayProfileScope _replayProfileScope(section); call; } while (0)
+#else
+#define REPLAY_PROFILE(section, call) call
+#endif
+
+#endif // REPLAYPROFILE_H
@@ -16,6 +16,7 @@
 
 // below because "The declaration of a static data member in its class definition is not a definition"
 SDHRManager* SDHRManager::s_instance;
+bool SDHRManager::s_bHeadless = false;
 
 //////////////////////////////////////////////////////////////////////////
 // Commands structs
@@ -274,14 +275,14 @@ void SDHRManager::Initialize()
 
 	// tell the next Render() call to run initialization routines
 	// Assign to the GPU the default pink image to all 16 image assets
-	// because the shaders expect 16 textures
-	for (GLint i = 0; i < _SDHR_MAX_TEXTURES; i++)
+	// because the shaders expect 16 textures. Headless, there's no GPU to assign them.
+	for (GLint i = 0; (i < _SDHR_MAX_TEXTURES) && !s_bHeadless; i++)
 	{
 		image_assets[i].tex_id = oglHelper->get_texture_id_at_slot(i);
 	}
-	if (!defaultWindowShaderProgram.isReady)
+	if (!defaultWindowShaderProgram.isReady && !s_bHeadless)
 		defaultWindowShaderProgram.build(_SHADER_SDHR_VERTEX_DEFAULT, _SHADER_SDHR_FRAGMENT_DEFAULT);
-	if (!pixelizationShaderProgram.isReady)
+	if (!pixelizationShaderProgram.isReady && !s_bHeadless)
 		pixelizationShaderProgram.build(_SHADER_SDHR_VERTEX_DEPIXELIZE, _SHADER_SDHR_FRAGMENT_DEPIXELIZE);
 	bShouldInitializeRender = true;
 	dataState = DATASTATE_e::DATA_IDLE;
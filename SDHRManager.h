@@ -144,6 +144,10 @@ public:
 
 	void ResetSdhr();
 
+	// Headless mode, for the bench_replay tool: the commands are processed but nothing
+	// is built for the GPU. Set it before the first GetInstance().
+	static void SetHeadless(bool headless) { s_bHeadless = headless; };
+
 	// public singleton code
 	static SDHRManager* GetInstance()
 	{
@@ -159,6 +163,7 @@ private:
 //////////////////////////////////////////////////////////////////////////
 
 	static SDHRManager* s_instance;
+	static bool s_bHeadless;
 	SDHRManager()
 	{
 		uploaded_data_region = new uint8_t[_SDHR_UPLOAD_REGION_SIZE];
@@ -1,5 +1,7 @@
-#include "ConcurrentQueue.h"
+#include "SPSCRing.h"
 #include "SDHRNetworking.h"
+#include "EventDecoder.h"
+#include "EventSource.h"
 #include "MemoryManager.h"
 #include "A2VideoManager.h"
 #include "SoundManager.h"
@@ -7,10 +9,18 @@
 #include "SDHRManager.h"
 #include "CycleCounter.h"
 #include "EventRecorder.h"
+#include "LatencyMonitor.h"
+#include "ThreadPlacement.h"
+#include "ReplayProfile.h"
 #include "MainMenu.h"
 #include <time.h>
 #include <fcntl.h>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <fstream>
 #ifdef __NETWORKING_WINDOWS__
 #define FTD3XX_STATIC
 #include "ftd3xx_win.h"
@@ -24,6 +34,8 @@
 #define FT_PIPE_READ_ID 0x82
 
 static EventRecorder* eventRecorder;
+static EventSource* eventSource = nullptr;
+static std::ofstream ingestCapture;		// raw copy of everything given to the processing thread
 static bool bIsConnected = false;
 static uint64_t num_processed_packets = 0;
 static uint64_t duration_packet_processing_ns = 0;
@@ -35,14 +47,100 @@ static FT_DEVICE_LIST_INFO_NODE activeNode;	// currently active USB device
 static bool event_reset = 1;
 static bool event_reset_prev = 1;
 
-static ConcurrentQueue<std::shared_ptr<Packet>> packetInQueue;
-static ConcurrentQueue<std::shared_ptr<Packet>> packetFreeQueue;
+// Packets live in a preallocated slab, and the threads only hand each other slab indices.
+// packetInQueue: ingest thread -> processing thread (filled packets)
+// packetFreeQueue: processing thread -> ingest thread (packets ready to be reused)
+// Both are single-producer/single-consumer, so each side must only ever use its own end.
+#define PKT_POOL_SIZE 2048		// 32MB of PKT_MAX_XFERSZ packets
+#define PKT_RING_SIZE 2048		// power of 2, must be >= PKT_POOL_SIZE
+#define PKT_WAIT_SPINS 256		// busy polls before yielding the CPU when a ring is empty
+#define PKT_WAIT_YIELDS 64		// yields before parking, with ConsumerWaitPolicy_e::PARK
+#define PKT_PARK_TIMEOUT_US 1000	// a parked consumer still polls its terminate flag this often
+#define PKT_BACKPRESSURE_ON_BYTES (4 * CYCLES_TOTAL_NTSC * 4)	// 4 frames of bus events waiting
+#define PKT_BACKPRESSURE_OFF_BYTES (CYCLES_TOTAL_NTSC * 4)		// less than a frame waiting
+
+static std::vector<Packet> packetSlab;
+static SPSCRing<uint32_t, PKT_RING_SIZE> packetInQueue;
+static SPSCRing<uint32_t, PKT_RING_SIZE> packetFreeQueue;
+
+// Consumer wait state. The ingest thread only touches the mutex when the consumer is parked.
+static std::atomic<ConsumerWaitPolicy_e> consumer_wait_policy = ConsumerWaitPolicy_e::PARK;
+static std::atomic<bool> consumer_parked = false;
+static std::mutex consumer_park_mutex;
+static std::condition_variable consumer_park_cv;
+static std::atomic<uint64_t> consumer_wait_spin_count = 0;
+static std::atomic<uint64_t> consumer_wait_yield_count = 0;
+static std::atomic<uint64_t> consumer_wait_park_count = 0;
+
+// Stream health
+static bool ingest_pool_exhausted = false;	// ingest thread only
+static std::atomic<uint64_t> ingest_queued_bytes = 0;
+static std::atomic<bool> ingest_backpressure = false;
+static std::atomic<uint64_t> garbage_message_count = 0;
+static std::atomic<uint64_t> truncated_message_count = 0;
+static std::atomic<uint64_t> unknown_message_count = 0;
+static std::atomic<uint64_t> dropped_bytes = 0;
+static std::atomic<uint64_t> pool_exhaustion_count = 0;
+
+// Asynchronous USB ingest: a ring of reads kept queued on the pipe, reaped in order.
+// Each transfer keeps its packet between reads, since only the processing thread
+// may give packets back to packetFreeQueue. The read loop hands them back through
+// ingest_release_packet() when it exits, so a lower depth doesn't strand any.
+struct UsbTransfer {
+	OVERLAPPED overlapped;
+	Packet* packet = nullptr;
+	ULONG transferred = 0;
+};
+static UsbTransfer usbTransfers[USB_MAX_TRANSFERS_IN_FLIGHT];
+static std::atomic<uint32_t> usb_transfer_depth = 1;
+static std::atomic<uint32_t> usb_transfer_size = PKT_MAX_XFERSZ;
+static std::atomic<uint32_t> usb_transfers_in_flight = 0;
+static std::atomic<uint64_t> usb_bytes_per_second = 0;	// bytes/sec given to the processing thread, for any source
+static std::atomic<uint64_t> usb_stall_time_ns = 0;		// time spent waiting on the pipe with no data arriving
+static uint64_t usb_bytes_this_second = 0;
+static std::chrono::steady_clock::time_point usb_bytes_second_start{};
 
 const uint64_t get_number_packets_processed() { return num_processed_packets; };
 const uint64_t get_duration_packet_processing_ns() { return duration_packet_processing_ns; };
 const uint64_t get_duration_network_processing_ns() { return duration_network_processing_ns; };
+const ConsumerWaitPolicy_e get_consumer_wait_policy() { return consumer_wait_policy; };
+const uint64_t get_consumer_wait_spin_count() { return consumer_wait_spin_count; };
+const uint64_t get_consumer_wait_yield_count() { return consumer_wait_yield_count; };
+const uint64_t get_consumer_wait_park_count() { return consumer_wait_park_count; };
+const uint64_t get_garbage_message_count() { return garbage_message_count; };
+const uint64_t get_truncated_message_count() { return truncated_message_count; };
+const uint64_t get_unknown_message_count() { return unknown_message_count; };
+const uint64_t get_dropped_bytes() { return dropped_bytes; };
+const uint64_t get_pool_exhaustion_count() { return pool_exhaustion_count; };
+const uint64_t get_ingest_queued_bytes() { return ingest_queued_bytes; };
+const bool is_ingest_backpressured() { return ingest_backpressure.load(std::memory_order_relaxed); };
 const size_t get_packet_pool_count() { return packetFreeQueue.max_size(); };
 const size_t get_max_incoming_packets() { return packetInQueue.max_size(); };
+const uint32_t get_usb_transfer_depth() { return usb_transfer_depth; };
+const uint32_t get_usb_transfer_size() { return usb_transfer_size; };
+const uint32_t get_usb_transfers_in_flight() { return usb_transfers_in_flight; };
+const uint64_t get_usb_bytes_per_second() { return usb_bytes_per_second; };
+const uint64_t get_usb_stall_time_ms() { return usb_stall_time_ns / 1'000'000; };
+
+void set_usb_transfer_depth(uint32_t depth)
+{
+	if (depth < 1)
+		depth = 1;
+	if (depth > USB_MAX_TRANSFERS_IN_FLIGHT)
+		depth = USB_MAX_TRANSFERS_IN_FLIGHT;
+	usb_transfer_depth = depth;
+}
+
+void set_usb_transfer_size(uint32_t size)
+{
+	// The FT60x works in 1K USB3 bulk packets
+	size = (size / 1024) * 1024;
+	if (size < PKT_BUFSZ)
+		size = PKT_BUFSZ;
+	if (size > PKT_MAX_XFERSZ)
+		size = PKT_MAX_XFERSZ;
+	usb_transfer_size = size;
+}
 
 const std::string get_ft_status_message(FT_STATUS status) {
 	switch (status) {
@@ -117,15 +215,14 @@ const std::string get_ft_status_message(FT_STATUS status) {
 	}
 }
 
-const std::string get_tini_name_string() { return std::string(activeNode.Description); };
+// With a source other than the Appletini, these describe that source instead
+const std::string get_tini_name_string() { return eventSource ? eventSource->GetName() : std::string("NO DEVICE"); };
 const uint32_t get_tini_last_error() { return (uint32_t)ftStatus; };
-const std::string get_tini_last_error_string() { return get_ft_status_message(ftStatus); };
+const std::string get_tini_last_error_string() { return eventSource ? eventSource->GetStatusString() : std::string(""); };
 
 const bool tini_is_ok()
 {
-	if (!bIsConnected)
-		return FT_SUCCESS(FT_DEVICE_NOT_CONNECTED);
-	return FT_SUCCESS(ftStatus);
+	return eventSource ? eventSource->IsOk() : false;
 }
 
 const bool client_is_connected()
@@ -133,15 +230,45 @@ const bool client_is_connected()
 	return bIsConnected;
 }
 
+void set_event_source(EventSource* source)
+{
+	delete eventSource;
+	eventSource = source;
+}
+
+bool set_ingest_capture_file(const std::string& path)
+{
+	ingestCapture.open(path, std::ios::binary | std::ios::trunc);
+	return ingestCapture.is_open();
+}
+
+Packet* ingest_acquire_packet()
+{
+	uint32_t pktIdx;
+	if (!packetFreeQueue.pop(pktIdx))
+	{
+		// Count each time the pool runs dry, not each retry
+		if (!ingest_pool_exhausted)
+			++pool_exhaustion_count;
+		ingest_pool_exhausted = true;
+		return nullptr;
+	}
+	ingest_pool_exhausted = false;
+	return &packetSlab[pktIdx];
+}
+
 void clear_queues()
 {
+	// Both rings are single producer and single consumer: this thread may be neither once
+	// the ingest and processing threads are running
 	packetInQueue.clear();
 	packetFreeQueue.clear();
-	for (size_t allocSize = 0; allocSize < 10000; allocSize++)	// preallocate 10,000 packets
-	{
-		auto packet = std::make_shared<Packet>();
-		packetFreeQueue.push(std::move(packet));
-	}
+	if (packetSlab.size() != PKT_POOL_SIZE)
+		packetSlab.resize(PKT_POOL_SIZE);	// preallocate all packets
+	for (uint32_t i = 0; i < PKT_POOL_SIZE; i++)
+		packetFreeQueue.push(i);
+	ingest_queued_bytes = 0;
+	ingest_backpressure = false;
 }
 
 void insert_event(SDHREvent* e)
@@ -150,12 +277,214 @@ void insert_event(SDHREvent* e)
 	assert("ERROR: CANNOT INSERT EVENT");
 }
 
+void set_consumer_wait_policy(ConsumerWaitPolicy_e policy)
+{
+	if (policy >= ConsumerWaitPolicy_e::TOTAL_COUNT)
+		policy = ConsumerWaitPolicy_e::PARK;
+	consumer_wait_policy = policy;
+	consumer_park_cv.notify_one();	// don't leave the consumer parked under a non-parking policy
+}
+
+// Wakes up the processing thread if it's parked. Called by the ingest thread after each push.
+static inline void consumer_wake()
+{
+	// Pairs with the fence in consumer_wait_for_packet(): either the consumer sees the new
+	// packet before parking, or we see it parked here.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (consumer_parked.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(consumer_park_mutex);
+		consumer_park_cv.notify_one();
+	}
+}
+
+// Pops the next packet index, waiting according to the wait policy.
+// Returns false if shouldTerminate was set while waiting.
+static bool consumer_wait_for_packet(uint32_t& pktIdx, std::atomic<bool>* shouldTerminate)
+{
+	if (packetInQueue.pop(pktIdx))
+		return true;
+	uint32_t spins = 0;
+	uint32_t yields = 0;
+	while (!(*shouldTerminate))
+	{
+		const ConsumerWaitPolicy_e policy = consumer_wait_policy.load(std::memory_order_relaxed);
+		if ((spins < PKT_WAIT_SPINS) || (policy == ConsumerWaitPolicy_e::SPIN))
+		{
+			++spins;
+			spsc_cpu_relax();
+			if (packetInQueue.pop(pktIdx)) {
+				++consumer_wait_spin_count;
+				return true;
+			}
+		}
+		else if ((yields < PKT_WAIT_YIELDS) || (policy == ConsumerWaitPolicy_e::YIELD))
+		{
+			++yields;
+			std::this_thread::yield();
+			if (packetInQueue.pop(pktIdx)) {
+				++consumer_wait_yield_count;
+				return true;
+			}
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(consumer_park_mutex);
+			consumer_parked.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (packetInQueue.empty())
+				consumer_park_cv.wait_for(lock, std::chrono::microseconds(PKT_PARK_TIMEOUT_US));
+			consumer_parked.store(false, std::memory_order_relaxed);
+			lock.unlock();
+			if (packetInQueue.pop(pktIdx)) {
+				++consumer_wait_park_count;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 void terminate_processing_thread()
 {
-	// Force a dummy packet to process, so that shouldTerminateProcessing is triggered
-	// and the loop is closed cleanly.
-	auto packet = std::make_shared<Packet>();
-	packetInQueue.push(std::move(packet));
+	// The processing thread polls shouldTerminateProcessing while waiting, and parks
+	// with a timeout. Wake it up so it exits right away.
+	consumer_park_cv.notify_one();
+}
+
+/*
+ *********************************
+ EVENT DISPATCH
+ *********************************
+ */
+
+// What process_single_event() needs to do with an event, besides counting its cycle
+enum class EventClass_e : uint8_t
+{
+	IGNORE = 0,			// only the cycle matters
+	SHADOW_WRITE,		// write to shadowed main or aux memory
+	SOFTSWITCH,			// $C0xx
+	VBL_SOFTSWITCH,		// $C019 read, which also tells us where the VBL is
+	SPEAKER,			// $C03x, toggles the speaker and is a softswitch
+	MOCKINGBOARD,		// $C4xx and $C5xx
+	SDHR,				// $C0A0 and $C0A1 on the //e
+};
+
+static constexpr EventClass_e classify_event(uint16_t addr, bool rw)
+{
+	const uint8_t addrhi = addr >> 8;
+	if (addrhi == 0xC4 || addrhi == 0xC5)
+		return EventClass_e::MOCKINGBOARD;
+	if (addrhi == 0xC0)
+	{
+		if (addr == CXSDHR_CTRL || addr == CXSDHR_DATA)
+			return EventClass_e::SDHR;
+		if ((addr & 0xFFF0) == 0xC030)
+			return EventClass_e::SPEAKER;
+		if (addr == 0xC019 && rw)
+			return EventClass_e::VBL_SOFTSWITCH;
+		return EventClass_e::SOFTSWITCH;
+	}
+	if (!rw && (addr >= _A2_MEMORY_SHADOW_BEGIN) && (addr < _A2_MEMORY_SHADOW_END))
+		return EventClass_e::SHADOW_WRITE;
+	return EventClass_e::IGNORE;
+}
+
+// Outside of the $C0 page the class only depends on the page, so the table is two-level:
+// one entry per page, plus one entry per $C0xx softswitch. Indexed by [rw][page or offset].
+// Kept small so it's well within every compiler's constexpr evaluation limits.
+struct EventClassTable {
+	EventClass_e pages[2][0x100];
+	EventClass_e softswitches[2][0x100];
+	constexpr EventClassTable() : pages(), softswitches() {
+		for (uint32_t rw = 0; rw < 2; ++rw)
+		{
+			for (uint32_t i = 0; i < 0x100; ++i)
+			{
+				pages[rw][i] = classify_event((uint16_t)(i << 8), rw != 0);
+				softswitches[rw][i] = classify_event((uint16_t)(0xC000 | i), rw != 0);
+			}
+		}
+	}
+};
+static constexpr EventClassTable eventClassTable;
+static_assert(eventClassTable.pages[1][0x20] == EventClass_e::IGNORE, "Reads of RAM are only a cycle");
+static_assert(eventClassTable.pages[0][0x20] == EventClass_e::SHADOW_WRITE, "Writes to RAM are shadowed");
+static_assert(eventClassTable.softswitches[1][0x19] == EventClass_e::VBL_SOFTSWITCH, "$C019 reads give the VBL");
+
+// Memory the beam reads: the text/lores pages, and the hires and SHR areas (SCBs and palettes included)
+static inline bool is_display_address(uint16_t addr)
+{
+	return ((addr >= _A2VIDEO_TEXT1_START) && (addr < (_A2VIDEO_TEXT2_START + _A2VIDEO_TEXT_SIZE)))
+		|| ((addr >= _A2VIDEO_SHR_START) && (addr < (_A2VIDEO_SHR_START + _A2VIDEO_SHR_SIZE)));
+}
+
+static inline EventClass_e get_event_class(uint16_t addr, uint8_t rw)
+{
+	const uint8_t addrhi = addr >> 8;
+	if (addrhi == 0xC0)
+		return eventClassTable.softswitches[rw & 1][addr & 0xFF];
+	return eventClassTable.pages[rw & 1][addrhi];
+}
+
+uint8_t get_event_dispatch(uint16_t addr, bool rw, bool is_iigs)
+{
+	switch (get_event_class(addr, rw))
+	{
+	case EventClass_e::SHADOW_WRITE:
+		return EVENTDISPATCH_MEMORY;
+	case EventClass_e::SOFTSWITCH:
+		return EVENTDISPATCH_SOFTSWITCH;
+	case EventClass_e::VBL_SOFTSWITCH:
+		return EVENTDISPATCH_VBL | EVENTDISPATCH_SOFTSWITCH;
+	case EventClass_e::SPEAKER:
+		return EVENTDISPATCH_SPEAKER | EVENTDISPATCH_SOFTSWITCH;
+	case EventClass_e::MOCKINGBOARD:
+		return EVENTDISPATCH_MOCKINGBOARD;
+	case EventClass_e::SDHR:
+		return (is_iigs ? EVENTDISPATCH_SOFTSWITCH : EVENTDISPATCH_SDHR);
+	default:
+		return 0;
+	}
+}
+
+uint8_t get_event_dispatch_reference(uint16_t addr, bool rw, bool is_iigs)
+{
+	uint8_t dispatch = 0;
+	if ((addr == 0xC019) && rw)
+		dispatch |= EVENTDISPATCH_VBL;
+	if ((addr & 0xFFF0) == 0xC030)
+		dispatch |= EVENTDISPATCH_SPEAKER;
+	// MockingboardManager::EventReceived() was called with every event, and only took these
+	if (((addr >> 8) == 0xC4) || ((addr >> 8) == 0xC5))
+		dispatch |= EVENTDISPATCH_MOCKINGBOARD;
+	if (rw && ((addr & 0xF000) != 0xC000))
+		return dispatch;
+	if ((addr >= _A2_MEMORY_SHADOW_BEGIN) && (addr < _A2_MEMORY_SHADOW_END))
+		return dispatch | EVENTDISPATCH_MEMORY;
+	if ((is_iigs == true) || ((addr != CXSDHR_CTRL) && (addr != CXSDHR_DATA))) {
+		if (addr >> 8 == 0xc0)
+			dispatch |= EVENTDISPATCH_SOFTSWITCH;
+		return dispatch;
+	}
+	return dispatch | EVENTDISPATCH_SDHR;
+}
+
+// The singletons never change once created, so each thread looks them up once
+struct EventHandlers {
+	EventRecorder* eventRecorder = EventRecorder::GetInstance();
+	CycleCounter* cycleCounter = CycleCounter::GetInstance();
+	SoundManager* soundMgr = SoundManager::GetInstance();
+	MockingboardManager* mockingboardMgr = MockingboardManager::GetInstance();
+	MemoryManager* memMgr = MemoryManager::GetInstance();
+	SDHRManager* sdhrMgr = SDHRManager::GetInstance();
+	A2VideoManager* a2VideoMgr = A2VideoManager::GetInstance();
+};
+
+static inline const EventHandlers& get_event_handlers()
+{
+	static thread_local const EventHandlers handlers;
+	return handlers;
 }
 
 void process_single_event(SDHREvent& e)
@@ -185,67 +514,78 @@ void process_single_event(SDHREvent& e)
 
 	// std::cout << e.is_iigs << " " << e.rw << " " << std::hex << e.addr << " " << (uint32_t)e.data << std::endl;
 
-	eventRecorder = EventRecorder::GetInstance();
-	if (eventRecorder->IsRecording())
-		eventRecorder->RecordEvent(&e);
+	const EventHandlers& h = get_event_handlers();
+	if (h.eventRecorder->IsRecording())
+		h.eventRecorder->RecordEvent(&e);
+	EventClass_e eventClass = get_event_class(e.addr, e.rw);
+
 	// Update the cycle counting and VBL hit
 	VBLState_e vblState = VBLState_e::Unknown;
-	if ((e.addr == 0xC019) && e.rw)
+	if (eventClass == EventClass_e::VBL_SOFTSWITCH)
 	{
 		if ((e.data >> 7) == (e.is_iigs ? 1 : 0))
 			vblState = VBLState_e::On;
 		else
 			vblState = VBLState_e::Off;
 	}
-	CycleCounter::GetInstance()->IncrementCycles(1, vblState);
+	REPLAY_PROFILE(ReplaySection_e::VIDEO, h.cycleCounter->IncrementCycles(1, vblState));
 
 	/*
 	 *********************************
 	 HANDLE SOUND AND PASSTHROUGH
 	 *********************************
 	 */
-	auto soundMgr = SoundManager::GetInstance();
-	soundMgr->EventReceived((e.addr & 0xFFF0) == 0xC030);
+	REPLAY_PROFILE(ReplaySection_e::SOUND, h.soundMgr->EventReceived(eventClass == EventClass_e::SPEAKER));
 
 	/*
 	 *********************************
 	 HANDLE MOCKINGBOARD EVENTS
 	 *********************************
 	 */
-	auto mockingboardMgr = MockingboardManager::GetInstance();
-	mockingboardMgr->EventReceived(e.addr, e.data, e.rw);
+	if (eventClass == EventClass_e::MOCKINGBOARD)
+		REPLAY_PROFILE(ReplaySection_e::MOCKINGBOARD, h.mockingboardMgr->EventReceived(e.addr, e.data, e.rw));
 
 	if (e.is_iigs && e.m2sel) {
 		// ignore updates from iigs_mode firmware with m2sel high
 		return;
 	}
-	if (e.rw && ((e.addr & 0xF000) != 0xC000)) {
-		// ignoring all read events not softswitches
-		return;
-	}
 
-	auto memMgr = MemoryManager::GetInstance();
+	// TODO: *** SDHR IS DISABLED FOR 2GS ***
+	//		because we're getting spurious 0xC0A0 events from the GS
+	if (e.is_iigs && (eventClass == EventClass_e::SDHR))
+		eventClass = EventClass_e::SOFTSWITCH;
 
+	switch (eventClass)
+	{
 	/*
 	 *********************************
 	 HANDLE SIMPLE MEMORY WRITE EVENTS
 	 *********************************
 	 */
-	if ((e.addr >= _A2_MEMORY_SHADOW_BEGIN) && (e.addr < _A2_MEMORY_SHADOW_END)) {
-		memMgr->WriteToMemory(e.addr, e.data, e.m2b0, e.is_iigs);
+	case EventClass_e::SHADOW_WRITE:
+		// The beam cycles queued until now must see the memory as it was
+		if (is_display_address(e.addr) || (e.is_iigs != h.memMgr->is2gs))
+			REPLAY_PROFILE(ReplaySection_e::VIDEO, h.a2VideoMgr->BeamFlush());
+		REPLAY_PROFILE(ReplaySection_e::MEMORY, h.memMgr->WriteToMemory(e.addr, e.data, e.m2b0, e.is_iigs));
 		return;
-	}
 	/*
 	 *********************************
 	 HANDLE SOFT SWITCHES EVENTS
 	 *********************************
 	 */
-	 // TODO: *** SDHR IS DISABLED FOR 2GS ***
-	 //		because we're getting spurious 0xC0A0 events from the GS
-	if ((e.is_iigs == true) || ((e.addr != CXSDHR_CTRL) && (e.addr != CXSDHR_DATA))) {
-		if (e.addr >> 8 == 0xc0)
-			memMgr->ProcessSoftSwitch(e.addr, e.data, e.rw, e.is_iigs);
-		// ignore non-control
+	case EventClass_e::SOFTSWITCH:
+	case EventClass_e::VBL_SOFTSWITCH:
+	case EventClass_e::SPEAKER:
+		// Only the softswitches that change the display need the queued beam cycles drawn first
+		if (h.memMgr->IsVideoSoftSwitch(e.addr, e.rw, e.is_iigs))
+			REPLAY_PROFILE(ReplaySection_e::VIDEO, h.a2VideoMgr->BeamFlush());
+		REPLAY_PROFILE(ReplaySection_e::MEMORY, h.memMgr->ProcessSoftSwitch(e.addr, e.data, e.rw, e.is_iigs));
+		return;
+	case EventClass_e::SDHR:
+		REPLAY_PROFILE(ReplaySection_e::VIDEO, h.a2VideoMgr->BeamFlush());
+		break;
+	default:
+		// ignore everything else
 		return;
 	}
 	/*
@@ -254,8 +594,8 @@ void process_single_event(SDHREvent& e)
 	 *********************************
 	 */
 	 //std::cerr << "cmd " << e.addr << " " << (uint32_t) e.data << std::endl;
-	auto sdhrMgr = SDHRManager::GetInstance();
-	auto a2VideoMgr = A2VideoManager::GetInstance();
+	auto sdhrMgr = h.sdhrMgr;
+	auto a2VideoMgr = h.a2VideoMgr;
 	SDHRCtrl_e _ctrl;
 	switch (e.addr & 0x0f)
 	{
@@ -296,7 +636,8 @@ void process_single_event(SDHREvent& e)
 			std::cout << "CONTROL: Process SDHR" << std::endl;
 #endif
 			while (sdhrMgr->dataState != DATASTATE_e::DATA_IDLE) {};
-			bool processingSucceeded = sdhrMgr->ProcessCommands();
+			bool processingSucceeded = false;
+			REPLAY_PROFILE(ReplaySection_e::SDHR, processingSucceeded = sdhrMgr->ProcessCommands());
 			sdhrMgr->dataState = DATASTATE_e::DATA_UPDATED;
 			if (processingSucceeded)
 			{
@@ -319,7 +660,7 @@ void process_single_event(SDHREvent& e)
 		break;
 	case 0x01:
 		// std::cout << "This is a data packet" << std::endl;
-		sdhrMgr->AddPacketDataToBuffer(e.data);
+		REPLAY_PROFILE(ReplaySection_e::SDHR, sdhrMgr->AddPacketDataToBuffer(e.data));
 		break;
 	default:
 		std::cerr << "ERROR: Unknown packet type: " << std::hex << e.addr << std::endl;
@@ -327,10 +668,56 @@ void process_single_event(SDHREvent& e)
 	}
 }
 
+void process_idle_cycles(uint32_t count)
+{
+	if (count == 0)
+		return;
+	const EventHandlers& h = get_event_handlers();
+	REPLAY_PROFILE(ReplaySection_e::VIDEO, h.cycleCounter->AdvanceCycles(count));
+	REPLAY_PROFILE(ReplaySection_e::SOUND, h.soundMgr->IdleCyclesReceived(count));
+}
+
+void process_event_batch(const SDHREventBatch& batch)
+{
+	// Runs of events that process_single_event() would only count as a cycle are
+	// collapsed into a single cycle advance, unless the recorder needs to see every event
+	const bool canCollapse = !get_event_handlers().eventRecorder->IsRecording();
+	uint32_t idleRun = 0;
+	for (size_t i = 0; i < batch.count; ++i) {
+		event_reset = (batch.reset[i] != 0);
+		if ((event_reset == 0) && (event_reset_prev == 1)) {
+			A2VideoManager::GetInstance()->bShouldReboot = true;
+		}
+		event_reset_prev = event_reset;
+		if (canCollapse && (get_event_class(batch.addr[i], batch.rw[i]) == EventClass_e::IGNORE)) {
+			++idleRun;
+			continue;
+		}
+		process_idle_cycles(idleRun);
+		idleRun = 0;
+		SDHREvent ev(0, 0, 0, batch.rw[i] != 0, batch.addr[i], batch.data[i]);
+		process_single_event(ev);
+	}
+	process_idle_cycles(idleRun);
+}
+
 int process_usb_events_thread(std::atomic<bool>* shouldTerminateProcessing) {
 	std::cout << "starting usb processing thread" << std::endl;
-	while (!(*shouldTerminateProcessing)) {
-		auto packet = packetInQueue.pop();
+	ThreadPlacement::GetInstance()->ApplyToCurrentThread(PipelineThread_e::PROCESSING);
+	uint32_t pktIdx;
+	SDHREventBatch eventBatch;
+	while (consumer_wait_for_packet(pktIdx, shouldTerminateProcessing)) {
+		Packet* packet = &packetSlab[pktIdx];
+		if (packet->size == 0) {	// given back unused by the ingest thread, see ingest_release_packet()
+			packetFreeQueue.push(pktIdx);
+			continue;
+		}
+#if SDD_LATENCY_METRICS
+		const uint64_t tsDequeued = LatencyMonitor::Now();
+		duration_network_processing_ns = tsDequeued - packet->timestamp_ns;
+		LATENCY_RECORD(LatencyStage_e::PACKET_QUEUE, packet->timestamp_ns);
+		LATENCY_SET_BUS_TIMESTAMP(packet->timestamp_ns);	// stamps the frames that end in this packet
+#endif
 		uint32_t* p = (uint32_t*)packet->data;
 		while ((uint8_t*)p < packet->data + packet->size) {
 			uint32_t hdr = *p;
@@ -340,54 +727,219 @@ int process_usb_events_thread(std::atomic<bool>* shouldTerminateProcessing) {
 			if (packet_len == 0 || packet_len > 1024 || ((packet_len % 4) != 0)) {
 				printf("invalid packet len: %u\n", packet_len);
 				// this packet is garbage somehow, stop processing
+				++garbage_message_count;
+				dropped_bytes += (packet->data + packet->size) - (uint8_t*)p;
 				break;
 			}
 			if ((uint8_t*)p + packet_len > packet->data + packet->size) {
 				// shouldn't happen, but also garbage condition
 				printf("packet len exceeds buffer\n");
+				++truncated_message_count;
+				dropped_bytes += (packet->data + packet->size) - (uint8_t*)p;
 				break;
 			}
 			if (packet_version != 1) {
 				// shouldn't happen
 				printf("packet error, version must be 1\n");
+				++garbage_message_count;
+				dropped_bytes += packet_len;
 				p += (packet_len / 4);
 				continue;
 			}
 			if (packet_type != 1) {
 				// when we start doing different messages we'd handle it here
+				++unknown_message_count;
 				p += (packet_len / 4);
 				continue;
 			}
 			else {
-				++p;
-				for (uint32_t i = 1; i < packet_len / 4; ++i) {
-					uint32_t event = *p++;
-					uint16_t addr = (event >> 16) & 0xffff;
-					uint8_t misc = (event) & 0x0f;
-					uint8_t data = (event >> 4) & 0xff;
-					bool rw = (misc & 0x01) == 0x01;
-					event_reset = ((misc & 0x02) == 0x02);
-					if ((event_reset == 0) && (event_reset_prev == 1)) {
-						A2VideoManager::GetInstance()->bShouldReboot = true;
-					}
-					event_reset_prev = event_reset;
-					SDHREvent ev(0, 0, 0, rw, addr, data);
-					process_single_event(ev);
-				}
+				// Decode the whole message at once, then feed the events downstream
+				decode_event_words((const uint8_t*)(p + 1), (packet_len / 4) - 1, eventBatch);
+				process_event_batch(eventBatch);
+				p += (packet_len / 4);
 			}
 		}
-		packetFreeQueue.push(std::move(packet));
+#if SDD_LATENCY_METRICS
+		LATENCY_RECORD(LatencyStage_e::PACKET_DECODE, packet->timestamp_ns);
+		LATENCY_SET_BUS_TIMESTAMP(0);
+		duration_packet_processing_ns = LatencyMonitor::Now() - tsDequeued;
+#endif
+		// Backpressure, with hysteresis so it doesn't flicker on every packet
+		const uint64_t queued = ingest_queued_bytes.fetch_sub(packet->size, std::memory_order_relaxed) - packet->size;
+		if (queued > PKT_BACKPRESSURE_ON_BYTES)
+			ingest_backpressure.store(true, std::memory_order_relaxed);
+		else if (queued < PKT_BACKPRESSURE_OFF_BYTES)
+			ingest_backpressure.store(false, std::memory_order_relaxed);
+		packetFreeQueue.push(pktIdx);	// can't fail, the ring is as large as the pool
 	}
 	return 0;
 }
 
-int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking) {
-	eventRecorder = EventRecorder::GetInstance();
-	clear_queues();
-	std::cout << "Starting USB thread" << std::endl;
+static void ingest_account_bytes(uint64_t bytes)
+{
+	usb_bytes_this_second += bytes;
+	auto now = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - usb_bytes_second_start).count();
+	if (elapsed >= 1'000'000)
+	{
+		usb_bytes_per_second = usb_bytes_this_second * 1'000'000 / elapsed;
+		usb_bytes_this_second = 0;
+		usb_bytes_second_start = now;
+	}
+}
+
+void ingest_release_packet(Packet* packet)
+{
+	packet->size = 0;
+	packet->timestamp_ns = LATENCY_NOW();
+	packetInQueue.push((uint32_t)(packet - packetSlab.data()));	// can't fail, the ring is as large as the pool
+	consumer_wake();
+}
+
+bool ingest_submit_packet(Packet* packet)
+{
+	packet->timestamp_ns = LATENCY_NOW();
+	ingest_account_bytes(packet->size);
+	if (eventRecorder->IsInReplayMode())
+		return false;
+	if (ingestCapture.is_open())
+		ingestCapture.write((const char*)packet->data, packet->size);
+	ingest_queued_bytes.fetch_add(packet->size, std::memory_order_relaxed);
+	packetInQueue.push((uint32_t)(packet - packetSlab.data()));	// can't fail, the ring is as large as the pool
+	consumer_wake();
+	return true;
+}
+
+/*
+ *********************************
+ FTDI (APPLETINI USB) SOURCE
+ *********************************
+ */
+
+class FTDIEventSource : public EventSource
+{
+public:
+	std::string GetName() const override { return std::string(activeNode.Description); };
+	std::string GetStatusString() const override { return get_ft_status_message(ftStatus); };
+	bool IsOk() const override {
+		if (!bIsConnected)
+			return FT_SUCCESS(FT_DEVICE_NOT_CONNECTED);
+		return FT_SUCCESS(ftStatus);
+	};
+	void Run(std::atomic<bool>* shouldTerminate) override;
+};
+
+EventSource* create_ftdi_event_source()
+{
+	return new FTDIEventSource();
+}
+
+static FT_STATUS usb_submit_transfer(FT_HANDLE handle, UsbTransfer& t, uint32_t size)
+{
+	Packet* packet = t.packet;
+	t.transferred = 0;
+#ifdef __NETWORKING_WINDOWS__
+	FT_STATUS status = FT_ReadPipeEx(handle, FT_PIPE_READ_ID, packet->data, size, &t.transferred, &t.overlapped);
+#else
+	FT_STATUS status = FT_ReadPipeAsync(handle, 0, packet->data, size, &t.transferred, &t.overlapped);
+#endif
+	return (status == FT_IO_PENDING) ? FT_OK : status;
+}
+
+// Keeps usb_transfer_depth reads queued on the pipe and hands them to the processing thread
+// in the order they were issued.
+// Returns on termination, when the transfer settings change, or when the pipe errors or times out.
+static void usb_async_read_loop(FT_HANDLE handle, std::atomic<bool>* shouldTerminateNetworking)
+{
+	const uint32_t depth = usb_transfer_depth;
+	const uint32_t size = usb_transfer_size;
+	uint32_t head = 0;			// oldest outstanding transfer
+	uint32_t submitted = 0;		// number of outstanding transfers
+	auto last_completion = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < depth; ++i)
+		FT_InitializeOverlapped(handle, &usbTransfers[i].overlapped);
+
+	ftStatus = FT_OK;
+	while (!(*shouldTerminateNetworking) && (depth == usb_transfer_depth) && (size == usb_transfer_size)) {
+		// Top up the ring
+		while (submitted < depth) {
+			UsbTransfer& t = usbTransfers[(head + submitted) % depth];
+			if (t.packet == nullptr && (t.packet = ingest_acquire_packet()) == nullptr)
+				break;	// all packets are waiting to be processed
+			ftStatus = usb_submit_transfer(handle, t, size);
+			if (ftStatus != FT_OK)
+				break;
+			++submitted;
+		}
+		usb_transfers_in_flight = submitted;
+		if (ftStatus != FT_OK) {
+			std::cerr << "Failed to queue FPGA usb read: " << get_ft_status_message(ftStatus) << std::endl;
+			break;
+		}
+		if (submitted == 0) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Reap the oldest one
+		UsbTransfer& t = usbTransfers[head];
+		auto wait_start = std::chrono::steady_clock::now();
+		ftStatus = FT_GetOverlappedResult(handle, &t.overlapped, &t.transferred, false);
+		if (ftStatus == FT_IO_INCOMPLETE) {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			auto now = std::chrono::steady_clock::now();
+			usb_stall_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - wait_start).count();
+			ingest_account_bytes(0);
+			if (now - last_completion < std::chrono::milliseconds(1000)) {
+				ftStatus = FT_OK;
+				continue;
+			}
+			// Same as the synchronous pipe timeout: the Apple is off. No data is coming in
+			ftStatus = FT_TIMEOUT;
+			break;
+		}
+		head = (head + 1) % depth;
+		--submitted;
+		if (ftStatus != FT_OK) {
+			std::cerr << "Failed to read from FPGA usb packet pipe: " << get_ft_status_message(ftStatus) << std::endl;
+			break;
+		}
+		last_completion = std::chrono::steady_clock::now();
+		if (t.transferred > 0) {
+			t.packet->size = t.transferred;
+			if (ingest_submit_packet(t.packet))
+				t.packet = nullptr;
+		}
+		// else keep the packet for the next read
+	}
+
+	// Cancel whatever is still queued and wait for the driver to let go of the buffers
+	if (submitted > 0) {
+		FT_AbortPipe(handle, FT_PIPE_READ_ID);
+		for (; submitted > 0; --submitted) {
+			UsbTransfer& t = usbTransfers[head];
+			FT_GetOverlappedResult(handle, &t.overlapped, &t.transferred, true);
+			head = (head + 1) % depth;
+		}
+	}
+	usb_transfers_in_flight = 0;
+	for (uint32_t i = 0; i < depth; ++i) {
+		FT_ReleaseOverlapped(handle, &usbTransfers[i].overlapped);
+		if (usbTransfers[i].packet != nullptr) {
+			ingest_release_packet(usbTransfers[i].packet);
+			usbTransfers[i].packet = nullptr;
+		}
+	}
+}
+
+void FTDIEventSource::Run(std::atomic<bool>* shouldTerminateNetworking) {
 	FT_HANDLE handle = NULL;
 	bIsConnected = false;
 	std::chrono::steady_clock::time_point next_connect_timeout{};
+	// The usb thread holds on to one free packet until it has data to hand over.
+	// It never gives packets back to packetFreeQueue itself, since that's the processing thread's end.
+	Packet* packet = nullptr;
 	while (!(*shouldTerminateNetworking)) {
 		if (!bIsConnected) {
 			if (next_connect_timeout > std::chrono::steady_clock::now()) {
@@ -471,8 +1023,20 @@ int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking) {
 			bIsConnected = true;
 		}
 
-		auto packet = packetFreeQueue.pop();
+		if (usb_transfer_depth > 1) {
+			usb_async_read_loop(handle, shouldTerminateNetworking);
+			continue;
+		}
+
+		if (packet == nullptr) {
+			if ((packet = ingest_acquire_packet()) == nullptr) {
+				// All packets are waiting to be processed
+				std::this_thread::yield();
+				continue;
+			}
+		}
 		// Synchronous Read
+		auto read_start = std::chrono::steady_clock::now();
 #ifdef __NETWORKING_WINDOWS__
 		ftStatus = FT_ReadPipeEx(handle, FT_PIPE_READ_ID, packet->data, PKT_BUFSZ, (ULONG*)&(packet->size), NULL);
 #else
@@ -484,18 +1048,33 @@ int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking) {
 			{
 				std::cerr << "Failed to read from FPGA usb packet pipe: " << get_ft_status_message(ftStatus) << std::endl;
 			}
+			else {
+				usb_stall_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - read_start).count();
+			}
+			ingest_account_bytes(0);
 			FT_AbortPipe(handle, FT_PIPE_READ_ID);
-			packetFreeQueue.push(std::move(packet));
-			continue;
+			continue;	// keep the packet for the next read
 		}
 
-		if (!eventRecorder->IsInReplayMode()) {
-			packetInQueue.push(std::move(packet));
-		}
-		else {
-			packetFreeQueue.push(std::move(packet));
-		}
+		if (ingest_submit_packet(packet))
+			packet = nullptr;
+		// else drop the data and reuse the packet for the next read
 	}
-	std::cout << "ending usb read loop" << std::endl;
+	if (handle != NULL)
+		FT_Close(handle);
+	bIsConnected = false;
+}
+
+int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking) {
+	ThreadPlacement::GetInstance()->ApplyToCurrentThread(PipelineThread_e::INGEST);
+	eventRecorder = EventRecorder::GetInstance();
+	if (eventSource == nullptr)
+		eventSource = create_ftdi_event_source();
+	usb_bytes_second_start = std::chrono::steady_clock::now();
+	std::cout << "Starting ingest thread: " << eventSource->GetName() << std::endl;
+	eventSource->Run(shouldTerminateNetworking);
+	std::cout << "ending ingest loop" << std::endl;
+	if (ingestCapture.is_open())
+		ingestCapture.close();
 	return 0;
 }
@@ -21,15 +21,18 @@
 #include <iostream>
 #include <cstring>
 #include <atomic>
+#include <string>
 
-#define PKT_BUFSZ 2048
+#define PKT_BUFSZ 2048			// size of a synchronous read
+#define PKT_MAX_XFERSZ 16384	// largest transfer when multiple reads are in flight
 
 #pragma pack(push, 1)
 
 struct Packet {
-	uint8_t data[PKT_BUFSZ];
+	uint8_t data[PKT_MAX_XFERSZ];
 	uint32_t size;
-	Packet() : size(1) {
+	uint64_t timestamp_ns;		// when the ingest thread received it, for the latency metrics
+	Packet() : size(1), timestamp_ns(0) {
 		memset(data, 0, 1);
 	}
 };
@@ -52,6 +55,8 @@ struct SDHREvent {
 		is_iigs(is_iigs_), m2b0(m2b0_), m2sel(m2sel_), rw(rw_), addr(addr_), data(data_) {}
 };
 
+struct SDHREventBatch;	// see EventDecoder.h
+
 enum class ENET_RES
 {
 	OK = 0,
@@ -62,10 +67,27 @@ enum class ENET_RES
 #define CXSDHR_DATA 0xC0A1	// SDHR data
 
 // Call this method as a new thread
-// It loops infinitely and waits for packets
-// And puts it in an events queue
+// It runs the active EventSource (the Appletini over USB by default)
+// which loops infinitely and puts incoming packets in the events queue
 int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking);
 
+class EventSource;
+// Sets the source of Appletini messages, taking ownership of it.
+// Must be called before usb_server_thread starts.
+void set_event_source(EventSource* source);
+EventSource* create_ftdi_event_source();
+// Also writes every byte given to the processing thread to a raw capture file,
+// which can be replayed with the file source. Must be called before usb_server_thread starts.
+bool set_ingest_capture_file(const std::string& path);
+// Packet handoff for EventSource implementations, only to be called from the ingest thread.
+// ingest_acquire_packet() returns nullptr when all packets are waiting to be processed.
+// ingest_submit_packet() returns false when the packet wasn't taken (during replays),
+// in which case the caller keeps it for its next read.
+// ingest_release_packet() gives back a packet that the caller won't use, through the processing thread.
+Packet* ingest_acquire_packet();
+bool ingest_submit_packet(Packet* packet);
+void ingest_release_packet(Packet* packet);
+
 // Call this method as a new thread
 // It loops indefinitely and processes the packets queue
 // Each packet contains a minumum of 64 events.
@@ -74,15 +96,72 @@ int usb_server_thread(std::atomic<bool>* shouldTerminateNetworking);
 // which itself processes the command_buffer
 int process_usb_events_thread(std::atomic<bool>* shouldTerminateProcessing);
 void process_single_event(SDHREvent& e);
+// Processes a decoded run of Appletini events in order, including reset edge detection
+// Runs of events that only matter as elapsed cycles are collapsed into a process_idle_cycles() call
+void process_event_batch(const SDHREventBatch& batch);
+// Advances the beam and the beeper by count cycles without any bus activity to handle
+void process_idle_cycles(uint32_t count);
+// What process_single_event() does with an event besides counting its cycle, as EVENTDISPATCH_ flags.
+// The reference is the original chain of address compares, kept to validate the class table against.
+#define EVENTDISPATCH_VBL			0x01
+#define EVENTDISPATCH_SPEAKER		0x02
+#define EVENTDISPATCH_MOCKINGBOARD	0x04
+#define EVENTDISPATCH_MEMORY		0x08
+#define EVENTDISPATCH_SOFTSWITCH	0x10
+#define EVENTDISPATCH_SDHR			0x20
+uint8_t get_event_dispatch(uint16_t addr, bool rw, bool is_iigs);
+uint8_t get_event_dispatch_reference(uint16_t addr, bool rw, bool is_iigs);
 void terminate_processing_thread();
 
+// Empties the packet queue and fills the free packet pool. Call it before usb_server_thread and
+// process_usb_events_thread start.
 void clear_queues();
 
+// How the processing thread waits for packets when the queue is empty.
+// It always starts by spinning, and the policy decides what comes next.
+enum class ConsumerWaitPolicy_e
+{
+	PARK = 0,	// spin, yield, then sleep until the ingest thread wakes it up. Lowest CPU use.
+	YIELD,		// spin, then yield the CPU forever. Never sleeps.
+	SPIN,		// spin forever. Lowest and most stable latency, uses a whole core.
+	TOTAL_COUNT
+};
+void set_consumer_wait_policy(ConsumerWaitPolicy_e policy);
+const ConsumerWaitPolicy_e get_consumer_wait_policy();
+// Number of waits for a packet that ended in each phase
+const uint64_t get_consumer_wait_spin_count();
+const uint64_t get_consumer_wait_yield_count();
+const uint64_t get_consumer_wait_park_count();
+
+// Stream health. The v1 Appletini message header (version:8 type:8 length:16) has no
+// sequence number, so a lost transfer can't be detected, only the damage it leaves.
+const uint64_t get_garbage_message_count();		// invalid length or version, the rest of the packet is dropped on bad lengths
+const uint64_t get_truncated_message_count();	// messages running past the end of their packet
+const uint64_t get_unknown_message_count();		// valid messages of a type we don't handle
+const uint64_t get_dropped_bytes();				// bytes discarded because of garbage or truncation
+const uint64_t get_pool_exhaustion_count();		// times the ingest thread found no free packet
+// Backpressure: set when the processing thread is several frames behind the ingest thread,
+// cleared once it's caught up. The beam then skips frames to catch up (see A2VideoManager).
+const uint64_t get_ingest_queued_bytes();
+const bool is_ingest_backpressured();
+
 const uint64_t get_number_packets_processed();
 const uint64_t get_duration_packet_processing_ns();
 const uint64_t get_duration_network_processing_ns();
 const size_t get_packet_pool_count();
 const size_t get_max_incoming_packets();
+
+// USB ingest. A transfer depth of 1 issues one synchronous PKT_BUFSZ read at a time.
+// Above 1, that many asynchronous reads of the transfer size are kept queued on the pipe.
+#define USB_MAX_TRANSFERS_IN_FLIGHT 16
+void set_usb_transfer_depth(uint32_t depth);
+const uint32_t get_usb_transfer_depth();
+void set_usb_transfer_size(uint32_t size);
+const uint32_t get_usb_transfer_size();
+const uint32_t get_usb_transfers_in_flight();
+const uint64_t get_usb_bytes_per_second();
+const uint64_t get_usb_stall_time_ms();
+
 const bool tini_is_ok();
 const bool client_is_connected();
 const std::string get_tini_name_string();
@@ -0,0 +1,185 @@
+#include "SHRExpand.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHREXPAND_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define SHREXPAND_NEON
+#include <arm_neon.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+//////////////////////////////////////////////////////////////////////////
+
+void shr_colorfill_scalar(uint8_t* bytes, size_t count, uint8_t prevPixel)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		auto byteColor = bytes[i];
+		// if the first color of the byte is 0, give it the last color of the previous byte
+		if ((byteColor & 0xF0) == 0)
+			byteColor |= (prevPixel << 4);
+		// if the second color of the byte is 0, give it the first color of the byte
+		if ((byteColor & 0x0F) == 0)
+			byteColor |= (byteColor >> 4);
+		bytes[i] = byteColor;
+		prevPixel = byteColor & 0x0F;
+	}
+}
+
+void shr_pal256_expand_scalar(const uint8_t* indices, size_t count, const uint8_t* palette, uint8_t* colors)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// get the palette color (2 bytes), the palette being all 256 colors in a single palette
+		auto paletteColorStart = palette + ((uint32_t)indices[i] * 2);
+		colors[2 * i] = paletteColorStart[0];
+		colors[2 * i + 1] = paletteColorStart[1];
+	}
+}
+
+// There's no gather in SSE2 or NEON, and a table lookup of 512 bytes doesn't fit their byte shuffles.
+// So the PAL256 expansion is done with whole 2-byte colors instead of single bytes.
+static void shr_pal256_expand_words(const uint8_t* indices, size_t count, const uint8_t* palette, uint8_t* colors)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		uint16_t c[4];
+		for (int j = 0; j < 4; j++)
+			memcpy(&c[j], palette + (uint32_t)indices[i + j] * 2, 2);	// the palette isn't aligned
+		memcpy(colors + 2 * i, c, sizeof(c));
+	}
+	shr_pal256_expand_scalar(indices + i, count - i, palette, colors + 2 * i);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SIMD kernels
+//////////////////////////////////////////////////////////////////////////
+
+#if defined(SHREXPAND_SSE2)
+
+// Fills each 0 pixel of the 16 pixels with the nearest nonzero pixel before it, if any
+static inline __m128i fill_zero_pixels(__m128i p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	p = _mm_or_si128(p, _mm_and_si128(_mm_cmpeq_epi8(p, zero), _mm_slli_si128(p, 1)));
+	p = _mm_or_si128(p, _mm_and_si128(_mm_cmpeq_epi8(p, zero), _mm_slli_si128(p, 2)));
+	p = _mm_or_si128(p, _mm_and_si128(_mm_cmpeq_epi8(p, zero), _mm_slli_si128(p, 4)));
+	p = _mm_or_si128(p, _mm_and_si128(_mm_cmpeq_epi8(p, zero), _mm_slli_si128(p, 8)));
+	return p;
+}
+
+// And the 0 pixels left, which had none before them, take the carry pixel
+static inline __m128i fill_carry_pixels(__m128i p, uint8_t carry)
+{
+	return _mm_or_si128(p, _mm_and_si128(_mm_cmpeq_epi8(p, _mm_setzero_si128()), _mm_set1_epi8((char)carry)));
+}
+
+static void shr_colorfill_simd(uint8_t* bytes, size_t count, uint8_t prevPixel)
+{
+	const __m128i mask_0f = _mm_set1_epi8(0x0F);
+	const __m128i mask_00ff = _mm_set1_epi16(0x00FF);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i*)(bytes + i));
+		// One pixel per byte, in screen order: high nibble then low nibble of each byte
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), mask_0f);
+		__m128i lo = _mm_and_si128(b, mask_0f);
+		__m128i p0 = fill_carry_pixels(fill_zero_pixels(_mm_unpacklo_epi8(hi, lo)), prevPixel);
+		__m128i p1 = fill_zero_pixels(_mm_unpackhi_epi8(hi, lo));
+		p1 = fill_carry_pixels(p1, (uint8_t)(_mm_cvtsi128_si32(_mm_srli_si128(p0, 15)) & 0xFF));
+		prevPixel = (uint8_t)(_mm_cvtsi128_si32(_mm_srli_si128(p1, 15)) & 0xFF);
+		// Back to 2 pixels per byte
+		__m128i b0 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(p0, mask_00ff), 4), _mm_srli_epi16(p0, 8));
+		__m128i b1 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(p1, mask_00ff), 4), _mm_srli_epi16(p1, 8));
+		_mm_storeu_si128((__m128i*)(bytes + i), _mm_packus_epi16(b0, b1));
+	}
+	shr_colorfill_scalar(bytes + i, count - i, prevPixel);
+}
+
+static const char* s_simdName = "SSE2";
+
+#elif defined(SHREXPAND_NEON)
+
+// Fills each 0 pixel of the 16 pixels with the nearest nonzero pixel before it, if any
+static inline uint8x16_t fill_zero_pixels(uint8x16_t p)
+{
+	const uint8x16_t zero = vdupq_n_u8(0);
+	p = vbslq_u8(vceqq_u8(p, zero), vextq_u8(zero, p, 15), p);
+	p = vbslq_u8(vceqq_u8(p, zero), vextq_u8(zero, p, 14), p);
+	p = vbslq_u8(vceqq_u8(p, zero), vextq_u8(zero, p, 12), p);
+	p = vbslq_u8(vceqq_u8(p, zero), vextq_u8(zero, p, 8), p);
+	return p;
+}
+
+// And the 0 pixels left, which had none before them, take the carry pixel
+static inline uint8x16_t fill_carry_pixels(uint8x16_t p, uint8_t carry)
+{
+	return vbslq_u8(vceqq_u8(p, vdupq_n_u8(0)), vdupq_n_u8(carry), p);
+}
+
+static void shr_colorfill_simd(uint8_t* bytes, size_t count, uint8_t prevPixel)
+{
+	const uint8x16_t mask_0f = vdupq_n_u8(0x0F);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16_t b = vld1q_u8(bytes + i);
+		// One pixel per byte, in screen order: high nibble then low nibble of each byte
+		uint8x16x2_t p = vzipq_u8(vshrq_n_u8(b, 4), vandq_u8(b, mask_0f));
+		uint8x16_t p0 = fill_carry_pixels(fill_zero_pixels(p.val[0]), prevPixel);
+		uint8x16_t p1 = fill_carry_pixels(fill_zero_pixels(p.val[1]), vgetq_lane_u8(p0, 15));
+		prevPixel = vgetq_lane_u8(p1, 15);
+		// Back to 2 pixels per byte
+		uint8x16x2_t hilo = vuzpq_u8(p0, p1);
+		vst1q_u8(bytes + i, vorrq_u8(vshlq_n_u8(hilo.val[0], 4), hilo.val[1]));
+	}
+	shr_colorfill_scalar(bytes + i, count - i, prevPixel);
+}
+
+static const char* s_simdName = "NEON";
+
+#else
+
+static void shr_colorfill_simd(uint8_t* bytes, size_t count, uint8_t prevPixel)
+{
+	shr_colorfill_scalar(bytes, count, prevPixel);
+}
+
+static const char* s_simdName = "scalar";
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Dispatch
+//////////////////////////////////////////////////////////////////////////
+
+static void (*s_colorfill)(uint8_t*, size_t, uint8_t) = shr_colorfill_simd;
+static void (*s_pal256Expand)(const uint8_t*, size_t, const uint8_t*, uint8_t*) = shr_pal256_expand_words;
+static bool s_bSimd = true;
+
+void shr_colorfill(uint8_t* bytes, size_t count, uint8_t prevPixel)
+{
+	s_colorfill(bytes, count, prevPixel);
+}
+
+void shr_pal256_expand(const uint8_t* indices, size_t count, const uint8_t* palette, uint8_t* colors)
+{
+	s_pal256Expand(indices, count, palette, colors);
+}
+
+void set_shr_expand_simd(bool enable)
+{
+	s_bSimd = enable;
+	s_colorfill = (enable ? shr_colorfill_simd : shr_colorfill_scalar);
+	s_pal256Expand = (enable ? shr_pal256_expand_words : shr_pal256_expand_scalar);
+}
+
+const char* get_shr_expand_name()
+{
+	return (s_bSimd ? s_simdName : "scalar");
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef SHREXPAND_H
+#define SHREXPAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+	Per-line SHR content expansion done by the beam before the vram upload.
+
+	Colorfill (320 mode, SCB bit 5): every pixel of color 0 takes the color of
+	the pixel before it. Each byte is 2 pixels, high nibble first, so it is a
+	scan over the line: the kernels resolve it 16 bytes (32 pixels) at a time.
+
+	PAL256 (SHR4): each content byte is an index into the 256 colors of all
+	16 palettes, and is expanded into the 2 bytes of its color.
+
+	The kernels are SSE2 or NEON when available, and scalar otherwise.
+	set_shr_expand_simd(false) switches to the scalar ones at runtime, which
+	is what the bench_replay tool uses to compare them.
+*/
+
+// Resolves the colorfill of count content bytes in place.
+// prevPixel is the color (0-15) of the pixel before the first byte, 0 at the start of a line.
+void shr_colorfill(uint8_t* bytes, size_t count, uint8_t prevPixel);
+void shr_colorfill_scalar(uint8_t* bytes, size_t count, uint8_t prevPixel);
+
+// Writes the 2 palette bytes of each of the count indices into colors.
+// palette is the 512 bytes of the 16 SHR palettes.
+void shr_pal256_expand(const uint8_t* indices, size_t count, const uint8_t* palette, uint8_t* colors);
+void shr_pal256_expand_scalar(const uint8_t* indices, size_t count, const uint8_t* palette, uint8_t* colors);
+
+// Selects the kernels used by shr_colorfill() and shr_pal256_expand(). SIMD by default.
+void set_shr_expand_simd(bool enable);
+// Name of the kernels currently used, for display
+const char* get_shr_expand_name();
+
+#endif // SHREXPAND_H
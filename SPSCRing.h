@@ -0,0 +1,117 @@
+#pragma once
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**************************************************************/
+/* Bounded lock-free single-producer/single-consumer ring.    */
+/* Exactly one thread may call push(), and exactly one other  */
+/* thread may call pop(). Neither call ever blocks: they      */
+/* return false when the ring is full or empty respectively.  */
+/* Capacity must be a power of 2. The producer and consumer   */
+/* indices live on separate cache lines so the two threads    */
+/* don't fight over the same line on every transfer.          */
+/**************************************************************/
+
+#ifndef SPSC_CACHELINE_SIZE
+#define SPSC_CACHELINE_SIZE 64
+#endif
+
+// Hint to the CPU that we're in a spin-wait loop. Saves power, and on SMT cores
+// leaves the execution resources to the sibling thread.
+inline void spsc_cpu_relax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+	__yield();
+#elif defined(__SSE2__)
+	_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+template <typename T, size_t Capacity>
+class SPSCRing
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SPSCRing capacity must be a power of 2");
+private:
+	static constexpr size_t kMask = Capacity - 1;
+
+	// Producer side: its own index, plus its last view of the consumer index
+	alignas(SPSC_CACHELINE_SIZE) std::atomic<size_t> d_head{ 0 };
+	size_t d_tail_cached = 0;
+
+	// Consumer side: its own index, plus its last view of the producer index
+	alignas(SPSC_CACHELINE_SIZE) std::atomic<size_t> d_tail{ 0 };
+	size_t d_head_cached = 0;
+	std::atomic<size_t> d_max_size{ 0 };
+
+	alignas(SPSC_CACHELINE_SIZE) T d_slots[Capacity];
+public:
+	// Producer thread only
+	bool push(const T& value) {
+		const size_t head = d_head.load(std::memory_order_relaxed);
+		if (head - d_tail_cached >= Capacity)
+		{
+			d_tail_cached = d_tail.load(std::memory_order_acquire);
+			if (head - d_tail_cached >= Capacity)
+				return false;
+		}
+		d_slots[head & kMask] = value;
+		d_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+	// Consumer thread only
+	bool pop(T& value) {
+		const size_t tail = d_tail.load(std::memory_order_relaxed);
+		if (tail == d_head_cached)
+		{
+			d_head_cached = d_head.load(std::memory_order_acquire);
+			if (tail == d_head_cached)
+				return false;
+			// The high-water mark is sampled here, off the producer's path
+			const size_t count = d_head_cached - tail;
+			if (count > d_max_size.load(std::memory_order_relaxed))
+				d_max_size.store(count, std::memory_order_relaxed);
+		}
+		value = d_slots[tail & kMask];
+		d_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+	// Approximate when called while the other side is active
+	size_t size() const {
+		const size_t tail = d_tail.load(std::memory_order_acquire);
+		const size_t head = d_head.load(std::memory_order_acquire);
+		return head - tail;
+	}
+	bool empty() const {
+		return size() == 0;
+	}
+	// High-water mark of the number of queued elements, as seen by the consumer each time it
+	// catches up with the producer. It misses what's pushed while the consumer drains what it saw.
+	size_t max_size() const {
+		return d_max_size.load(std::memory_order_relaxed);
+	}
+	static constexpr size_t capacity() {
+		return Capacity;
+	}
+	// Only call when neither the producer nor the consumer is active
+	void clear() {
+		d_head.store(0, std::memory_order_relaxed);
+		d_tail.store(0, std::memory_order_relaxed);
+		d_tail_cached = 0;
+		d_head_cached = 0;
+		d_max_size.store(0, std::memory_order_relaxed);
+	}
+};
+
+#endif // SPSCRING_H
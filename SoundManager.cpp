@@ -2,6 +2,7 @@
 #include "imgui.h"
 #include <iostream>
 #include "MockingboardManager.h"
+#include "ThreadPlacement.h"
 #define CHIPS_IMPL
 #include "beeper.h"
 
@@ -110,13 +111,7 @@ float SoundManager::DCAdjustment(float freq)
 	return (dcadj_sum / SM_BEEPER_DCADJ_BUFLEN);
 }
 
-void SoundManager::EventReceived(bool isC03x) {
-	if (!bIsEnabled)
-		return;
-	if (!bIsPlaying)
-		BeginPlay();
-	if (isC03x)
-		beeper_toggle(&beeper);
+void SoundManager::TickBeeper() {
 	if (beeper_tick(&beeper))
 	{
 		if (((beeper_samples_idx_write + 1) % SM_BEEPER_BUFFER_SIZE) == beeper_samples_idx_read)
@@ -130,10 +125,36 @@ void SoundManager::EventReceived(bool isC03x) {
 	}
 }
 
+void SoundManager::EventReceived(bool isC03x) {
+	if (!bIsEnabled)
+		return;
+	if (!bIsPlaying)
+		BeginPlay();
+	if (isC03x)
+		beeper_toggle(&beeper);
+	TickBeeper();
+}
+
+void SoundManager::IdleCyclesReceived(uint32_t count) {
+	if (!bIsEnabled)
+		return;
+	if (!bIsPlaying)
+		BeginPlay();
+	for (uint32_t i = 0; i < count; ++i)
+		TickBeeper();
+}
+
 void SoundManager::AudioCallback(void* userdata, uint8_t* stream, int len)
 {
 	SoundManager* self = static_cast<SoundManager*>(userdata);
 
+	// SDL owns the audio thread, so it's placed on its first callback
+	static thread_local bool bThreadIsPlaced = false;
+	if (!bThreadIsPlaced) {
+		bThreadIsPlaced = true;
+		ThreadPlacement::GetInstance()->ApplyToCurrentThread(PipelineThread_e::AUDIO);
+	}
+
 	if (self->master_volume < 0.01f)	// if master volume is zero, turn off the sound
 	{
 		SDL_memset(stream, 0, len);		// shouldn't be necessary, but better be safe
@@ -32,6 +32,7 @@ public:
 	void StopPlay();
 	bool IsPlaying();
 	void EventReceived(bool isC03x = false);	// Received any event -- if isC03x then the event is a 0xC03x
+	void IdleCyclesReceived(uint32_t count);	// Received count events that aren't 0xC03x
 	void SetPAL(bool isPal);				// Sets PAL (true) or NTSC (false)
 
 	// DC Adjustment
@@ -53,6 +54,7 @@ private:
 	static SoundManager* s_instance;
 	SoundManager(uint32_t sampleRate, uint32_t bufferSize);
 	static void AudioCallback(void* userdata, uint8_t* stream, int len);
+	void TickBeeper();							// One cycle of the beeper
 
 	SDL_AudioSpec audioSpec;
 	SDL_AudioDeviceID audioDevice;
@@ -0,0 +1,501 @@
+#include "StreamRecorder.h"
+#include "MemoryManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#if defined(__NETWORKING_WINDOWS__)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+	Segment file layout, in the native byte order since the events are read in place:
+		header		SEGMENT_HEADER_SIZE bytes: magic, version, events per chunk, chunk slots,
+					chunks written, sequence number, region
+		slots		STREAM_CHUNKS_PER_SEGMENT of SLOT_SIZE bytes, each:
+					slot header (stream index, dropped before, event count, state size, state),
+					the keyframe memory, then the packed events
+	The chunk count is updated after each chunk is copied, so a segment cut short only loses its last chunk.
+*/
+constexpr char SEGMENT_MAGIC[8] = { 'S', 'D', 'D', 'V', 'C', 'R', 'S', '\0' };
+constexpr uint32_t SEGMENT_VERSION = 1;
+constexpr size_t SEGMENT_HEADER_SIZE = 4096;
+constexpr size_t SLOT_HEADER_SIZE = 64;
+constexpr size_t SLOT_EVENTS_OFFSET = SLOT_HEADER_SIZE + STREAM_KEYFRAME_RAM;
+constexpr size_t SLOT_SIZE = (SLOT_EVENTS_OFFSET + (size_t)STREAM_CHUNK_EVENTS * 4 + 4095) & ~(size_t)4095;
+constexpr size_t SEGMENT_SIZE = SEGMENT_HEADER_SIZE + STREAM_CHUNKS_PER_SEGMENT * SLOT_SIZE;
+
+static_assert(24 + STREAM_STATE_SIZE <= SLOT_HEADER_SIZE, "The slot header holds the softswitch state");
+
+//////////////////////////////////////////////////////////////////////////
+// Memory-mapped files
+//////////////////////////////////////////////////////////////////////////
+
+class MappedFile
+{
+public:
+	~MappedFile() { Unmap(); };
+	// Creates or truncates the file to size, mapped read-write
+	bool Create(const std::string& path, size_t _size);
+	bool OpenReadOnly(const std::string& path);
+	void Unmap();
+	uint8_t* Data() { return data; };
+	size_t Size() { return size; };
+
+private:
+	uint8_t* data = nullptr;
+	size_t size = 0;
+#if defined(__NETWORKING_WINDOWS__)
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	HANDLE hMapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+#if defined(__NETWORKING_WINDOWS__)
+
+bool MappedFile::Create(const std::string& path, size_t _size)
+{
+	hFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	hMapping = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, (DWORD)((uint64_t)_size >> 32), (DWORD)(_size & 0xFFFFFFFF), NULL);
+	if (hMapping != NULL)
+		data = (uint8_t*)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, _size);
+	if (data == nullptr)
+	{
+		Unmap();
+		return false;
+	}
+	size = _size;
+	return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string& path)
+{
+	hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER fileSize;
+	if ((hFile == INVALID_HANDLE_VALUE) || !GetFileSizeEx(hFile, &fileSize) || (fileSize.QuadPart == 0))
+	{
+		Unmap();
+		return false;
+	}
+	hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping != NULL)
+		data = (uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		Unmap();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (hMapping != NULL)
+		CloseHandle(hMapping);
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	data = nullptr;
+	size = 0;
+	hMapping = NULL;
+	hFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Create(const std::string& path, size_t _size)
+{
+	// Truncating first makes the file sparse, so the old pages of a reused segment are never read back
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, (off_t)_size) != 0))
+	{
+		Unmap();
+		return false;
+	}
+	void* p = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		Unmap();
+		return false;
+	}
+	data = (uint8_t*)p;
+	size = _size;
+	return true;
+}
+
+bool MappedFile::OpenReadOnly(const std::string& path)
+{
+	fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0))
+	{
+		Unmap();
+		return false;
+	}
+	void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	{
+		Unmap();
+		return false;
+	}
+	data = (uint8_t*)p;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+	if (data)
+		munmap(data, size);
+	if (fd >= 0)
+		close(fd);
+	data = nullptr;
+	size = 0;
+	fd = -1;
+}
+
+#endif
+
+static std::string segment_path(const std::string& directory, uint32_t slot)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "segment_%04u%s", slot, STREAM_SEGMENT_EXTENSION);
+	return (std::filesystem::path(directory) / name).string();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Recording
+//////////////////////////////////////////////////////////////////////////
+
+StreamRecorder::StreamRecorder()
+{
+}
+
+StreamRecorder::~StreamRecorder()
+{
+	Stop();
+	Close();
+}
+
+std::string StreamRecorder::GetError()
+{
+	std::lock_guard<std::mutex> lock(errorMutex);
+	return m_lastError;
+}
+
+bool StreamRecorder::Start(const std::string& directory, uint64_t diskBudgetBytes, bool bRollingWindow, bool _bIsPAL)
+{
+	Stop();
+	{
+		std::lock_guard<std::mutex> lock(errorMutex);
+		m_lastError.clear();
+	}
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (ec)
+	{
+		std::lock_guard<std::mutex> lock(errorMutex);
+		m_lastError = "Cannot create " + directory + ": " + ec.message();
+		return false;
+	}
+	// The segments of the previous recording would mix with the new ones
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+	{
+		if (entry.is_regular_file() && (entry.path().extension() == STREAM_SEGMENT_EXTENSION))
+			std::filesystem::remove(entry.path(), ec);
+	}
+
+	segmentDirectory = directory;
+	maxSegments = (uint32_t)std::max<uint64_t>(2, std::min<uint64_t>(diskBudgetBytes / SEGMENT_SIZE, 9999));
+	bRolling = bRollingWindow;
+	bIsPAL = _bIsPAL;
+	segmentSequence = 0;
+	segmentChunks = 0;
+	for (auto& chunk : chunkPool)
+	{
+		chunk.ram.resize(STREAM_KEYFRAME_RAM);
+		chunk.events.resize(STREAM_CHUNK_EVENTS);
+	}
+	chunkEvents = nullptr;
+	chunkFill = STREAM_CHUNK_EVENTS;
+	publishedEvents = 0;
+	pendingDrops = 0;
+	publishedChunks = 0;
+	consumedChunks = 0;
+	recordedEvents = 0;
+	droppedEvents = 0;
+	overBudgetEvents = 0;
+	bytesWritten = 0;
+	bDiskFull = false;
+	bShouldStopWriter = false;
+	stopState = StopState_e::RECORDING;
+	thread_writer = std::thread(&StreamRecorder::writer_thread, this);
+	return true;
+}
+
+bool StreamRecorder::StartChunk()
+{
+	if (bDiskFull.load(std::memory_order_relaxed))
+		return false;
+	// Only this thread publishes chunks
+	const uint64_t n = publishedChunks.load(std::memory_order_relaxed);
+	if ((n - consumedChunks.load(std::memory_order_acquire)) >= STREAM_CHUNK_POOL)
+		return false;
+	Chunk& chunk = chunkPool[n % STREAM_CHUNK_POOL];
+	chunk.streamIndex = publishedEvents + droppedEvents.load(std::memory_order_relaxed);
+	chunk.droppedBefore = pendingDrops;
+	pendingDrops = 0;
+	auto memMgr = MemoryManager::GetInstance();
+	memcpy(chunk.ram.data(), memMgr->GetApple2MemPtr(), STREAM_KEYFRAME_RAM);
+	auto state = memMgr->SerializeSwitches();
+	chunk.stateSize = (uint32_t)std::min<size_t>(state.size(), STREAM_STATE_SIZE);
+	memcpy(chunk.state, state.data(), chunk.stateSize);
+	chunkEvents = chunk.events.data();
+	chunkFill = 0;
+	return true;
+}
+
+void StreamRecorder::PublishChunk()
+{
+	const uint64_t n = publishedChunks.load(std::memory_order_relaxed);
+	chunkPool[n % STREAM_CHUNK_POOL].eventCount = chunkFill;
+	publishedEvents += chunkFill;
+	publishedChunks.store(n + 1, std::memory_order_release);
+	chunkFill = STREAM_CHUNK_EVENTS;	// the next event starts a new chunk
+}
+
+void StreamRecorder::FlushLastChunk()
+{
+	if ((chunkFill > 0) && (chunkFill < STREAM_CHUNK_EVENTS))
+		PublishChunk();
+	stopState.store(StopState_e::DONE, std::memory_order_release);
+}
+
+void StreamRecorder::AcknowledgeStop()
+{
+	auto expected = StopState_e::REQUESTED;
+	if (stopState.compare_exchange_strong(expected, StopState_e::FLUSHING))
+		FlushLastChunk();
+}
+
+void StreamRecorder::Stop()
+{
+	if (!thread_writer.joinable())
+		return;
+	// The recording thread publishes its last chunk at its next event. If no event comes, it isn't
+	// recording anymore and the chunk is published from here.
+	stopState.store(StopState_e::REQUESTED, std::memory_order_release);
+	auto _tstart = std::chrono::steady_clock::now();
+	while ((stopState.load(std::memory_order_acquire) == StopState_e::REQUESTED)
+		&& ((std::chrono::steady_clock::now() - _tstart) < std::chrono::milliseconds(100)))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	auto expected = StopState_e::REQUESTED;
+	if (stopState.compare_exchange_strong(expected, StopState_e::FLUSHING))
+		FlushLastChunk();
+	while (stopState.load(std::memory_order_acquire) != StopState_e::DONE)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	bShouldStopWriter.store(true, std::memory_order_release);
+	thread_writer.join();
+	for (auto& chunk : chunkPool)
+	{
+		std::vector<uint8_t>().swap(chunk.ram);
+		std::vector<uint32_t>().swap(chunk.events);
+	}
+	std::cout << "Streamed " << recordedEvents << " events to " << segmentDirectory << ", dropped "
+		<< GetDroppedEvents() << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Writer thread
+//////////////////////////////////////////////////////////////////////////
+
+int StreamRecorder::writer_thread()
+{
+	while (true)
+	{
+		const uint64_t n = consumedChunks.load(std::memory_order_relaxed);
+		if (n == publishedChunks.load(std::memory_order_acquire))
+		{
+			// Stop() sets the flag after the last chunk is published
+			if (bShouldStopWriter.load(std::memory_order_acquire) && (n == publishedChunks.load(std::memory_order_acquire)))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+		WriteChunk(chunkPool[n % STREAM_CHUNK_POOL]);
+		consumedChunks.store(n + 1, std::memory_order_release);
+	}
+	CloseSegment();
+	return 0;
+}
+
+void StreamRecorder::WriteChunk(const Chunk& chunk)
+{
+	if (!bDiskFull.load(std::memory_order_relaxed) && (!segment || (segmentChunks == STREAM_CHUNKS_PER_SEGMENT)) && !NextSegment())
+		bDiskFull.store(true, std::memory_order_relaxed);
+	if (bDiskFull.load(std::memory_order_relaxed))
+	{
+		overBudgetEvents.store(overBudgetEvents.load(std::memory_order_relaxed) + chunk.eventCount, std::memory_order_relaxed);
+		return;
+	}
+	uint8_t* slot = segment->Data() + SEGMENT_HEADER_SIZE + segmentChunks * SLOT_SIZE;
+	memcpy(slot, &chunk.streamIndex, 8);
+	memcpy(slot + 8, &chunk.droppedBefore, 8);
+	memcpy(slot + 16, &chunk.eventCount, 4);
+	memcpy(slot + 20, &chunk.stateSize, 4);
+	memcpy(slot + 24, chunk.state, STREAM_STATE_SIZE);
+	memcpy(slot + SLOT_HEADER_SIZE, chunk.ram.data(), STREAM_KEYFRAME_RAM);
+	memcpy(slot + SLOT_EVENTS_OFFSET, chunk.events.data(), (size_t)chunk.eventCount * 4);
+	++segmentChunks;
+	memcpy(segment->Data() + 20, &segmentChunks, 4);
+	recordedEvents.store(recordedEvents.load(std::memory_order_relaxed) + chunk.eventCount, std::memory_order_relaxed);
+	bytesWritten.store(bytesWritten.load(std::memory_order_relaxed) + SLOT_EVENTS_OFFSET + (size_t)chunk.eventCount * 4,
+		std::memory_order_relaxed);
+}
+
+bool StreamRecorder::NextSegment()
+{
+	CloseSegment();
+	if ((segmentSequence >= maxSegments) && !bRolling)
+		return false;
+	// The ring slot of the sequence number is the one of the oldest segment
+	auto path = segment_path(segmentDirectory, (uint32_t)(segmentSequence % maxSegments));
+	segment = std::make_unique<MappedFile>();
+	if (!segment->Create(path, SEGMENT_SIZE))
+	{
+		segment.reset();
+		std::lock_guard<std::mutex> lock(errorMutex);
+		m_lastError = "Cannot create the segment " + path;
+		return false;
+	}
+	uint8_t* header = segment->Data();
+	const uint32_t fields[] = { SEGMENT_VERSION, STREAM_CHUNK_EVENTS, STREAM_CHUNKS_PER_SEGMENT, 0 };
+	memcpy(header, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+	memcpy(header + 8, fields, sizeof(fields));
+	memcpy(header + 24, &segmentSequence, 8);
+	header[32] = bIsPAL;
+	++segmentSequence;
+	segmentChunks = 0;
+	return true;
+}
+
+void StreamRecorder::CloseSegment()
+{
+	// Unmapping leaves the dirty pages to the OS to write back
+	segment.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Replay
+//////////////////////////////////////////////////////////////////////////
+
+bool StreamRecorder::Open(const std::string& directory)
+{
+	Close();
+	struct Segment {
+		uint64_t sequence;
+		std::unique_ptr<MappedFile> file;
+	};
+	std::vector<Segment> segments;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+	{
+		if (!entry.is_regular_file() || (entry.path().extension() != STREAM_SEGMENT_EXTENSION))
+			continue;
+		auto file = std::make_unique<MappedFile>();
+		if (!file->OpenReadOnly(entry.path().string()))
+			continue;
+		const uint8_t* header = file->Data();
+		uint32_t fields[4] = {};
+		if (file->Size() >= SEGMENT_HEADER_SIZE)
+			memcpy(fields, header + 8, sizeof(fields));
+		if ((file->Size() != SEGMENT_SIZE) || (memcmp(header, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0)
+			|| (fields[0] != SEGMENT_VERSION) || (fields[1] != STREAM_CHUNK_EVENTS)
+			|| (fields[2] != STREAM_CHUNKS_PER_SEGMENT) || (fields[3] > STREAM_CHUNKS_PER_SEGMENT))
+		{
+			std::cerr << "Skipping invalid segment " << entry.path().generic_string() << std::endl;
+			continue;
+		}
+		Segment segment;
+		memcpy(&segment.sequence, header + 24, 8);
+		segment.file = std::move(file);
+		segments.push_back(std::move(segment));
+	}
+	std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.sequence < b.sequence; });
+
+	if (!segments.empty())
+		bReplayIsPAL = (segments.front().file->Data()[32] != 0);
+	bool bIsCut = false;
+	for (auto& segment : segments)
+	{
+		const uint8_t* header = segment.file->Data();
+		uint32_t chunkCount;
+		memcpy(&chunkCount, header + 20, 4);
+		for (uint32_t c = 0; (c < chunkCount) && !bIsCut; ++c)
+		{
+			// Only the last chunk can be partial, for the events to map directly to their chunk
+			if (!replayChunks.empty() && (replayChunks.back().eventCount != STREAM_CHUNK_EVENTS))
+			{
+				std::cerr << "Ignoring the chunks after a partial one in " << directory << std::endl;
+				bIsCut = true;
+				break;
+			}
+			const uint8_t* slot = header + SEGMENT_HEADER_SIZE + c * SLOT_SIZE;
+			ReplayChunk chunk;
+			memcpy(&chunk.streamIndex, slot, 8);
+			memcpy(&chunk.droppedBefore, slot + 8, 8);
+			memcpy(&chunk.eventCount, slot + 16, 4);
+			if ((chunk.eventCount == 0) || (chunk.eventCount > STREAM_CHUNK_EVENTS))
+			{
+				bIsCut = true;
+				break;
+			}
+			chunk.slot = slot;
+			chunk.events = reinterpret_cast<const uint32_t*>(slot + SLOT_EVENTS_OFFSET);
+			replayChunks.push_back(chunk);
+			replayEventCount += chunk.eventCount;
+		}
+		replaySegments.push_back(std::move(segment.file));
+	}
+	if (replayChunks.empty())
+	{
+		Close();
+		std::lock_guard<std::mutex> lock(errorMutex);
+		m_lastError = "No recorded events in " + directory;
+		return false;
+	}
+	return true;
+}
+
+void StreamRecorder::Close()
+{
+	replayChunks.clear();
+	replaySegments.clear();
+	replayEventCount = 0;
+}
+
+void StreamRecorder::GetKeyframe(size_t chunkIndex, const uint8_t*& ram, std::string& state)
+{
+	const uint8_t* slot = replayChunks.at(chunkIndex).slot;
+	uint32_t stateSize;
+	memcpy(&stateSize, slot + 20, 4);
+	state.assign(reinterpret_cast<const char*>(slot + 24), std::min<uint32_t>(stateSize, STREAM_STATE_SIZE));
+	ram = slot + SLOT_HEADER_SIZE;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#ifndef STREAMRECORDER_H
+#define STREAMRECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "SDHRNetworking.h"	// for SDHREvent
+#include "VcrFile.h"		// for the packed events
+
+/*
+	Recording of unlimited length to disk, for the EventRecorder's "Stream to disk" mode.
+
+	The events are packed (see vcr_pack_event()) into chunks of STREAM_CHUNK_EVENTS, each
+	starting with a keyframe of the memory and the softswitches. The recording thread only fills
+	a fixed pool of STREAM_CHUNK_POOL chunks in RAM. A background writer thread copies the full
+	chunks into the slots of memory-mapped segment files of STREAM_CHUNKS_PER_SEGMENT chunks.
+	RecordEvent() never waits: the page faults and the disk writes all happen in the writer, and
+	when the whole pool waits for the disk, the events are dropped and counted. The next chunk
+	starts with a new keyframe, so the replay picks up cleanly after a gap.
+
+	The segments are a ring in a directory, named by their slot in the ring. The disk budget
+	sets the number of slots. When they are all used, the oldest is overwritten (rolling window)
+	or all the following events are dropped.
+	Each segment header has the sequence number of the segment, which orders the ring for replay.
+
+	Replay maps the segments read-only and reads the events and keyframes directly from them.
+	Event i of the replay is in chunk i / STREAM_CHUNK_EVENTS, so the keyframes are the
+	EventRecorder's RAM snapshots. Dropped events aren't part of the replay.
+*/
+
+constexpr uint32_t STREAM_CHUNK_EVENTS = 1'000'000;		// same as RECORDER_MEM_SNAPSHOT_CYCLES
+constexpr uint32_t STREAM_CHUNKS_PER_SEGMENT = 16;
+constexpr uint32_t STREAM_CHUNK_POOL = 8;				// chunks waiting for the writer, 33MB
+constexpr uint32_t STREAM_KEYFRAME_RAM = 2 * _A2_MEMORY_SHADOW_END;
+constexpr uint32_t STREAM_STATE_SIZE = 32;				// room for MemoryManager::SerializeSwitches()
+constexpr char STREAM_SEGMENT_EXTENSION[] = ".vcrs";
+
+class MappedFile;
+
+class StreamRecorder
+{
+public:
+	StreamRecorder();
+	~StreamRecorder();
+
+	//////////////////////////////////////////////////////////////////////////
+	// Recording
+	//////////////////////////////////////////////////////////////////////////
+
+	// Removes the segments already in the directory and starts the writer.
+	// Returns false with GetError() set if the directory can't be used.
+	bool Start(const std::string& directory, uint64_t diskBudgetBytes, bool bRollingWindow, bool bIsPAL);
+	// Called from the thread that records the events, for every event
+	inline void RecordEvent(const SDHREvent& e) {
+		if (stopState.load(std::memory_order_acquire) != StopState_e::RECORDING)
+		{
+			AcknowledgeStop();
+			return;
+		}
+		if ((chunkFill == STREAM_CHUNK_EVENTS) && !StartChunk())
+		{
+			++pendingDrops;
+			// Only this thread writes it, no need for an atomic increment
+			droppedEvents.store(droppedEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+		chunkEvents[chunkFill++] = vcr_pack_event(e);
+		if (chunkFill == STREAM_CHUNK_EVENTS)
+			PublishChunk();
+	};
+	// Flushes the last events and waits for the writer to finish the segments.
+	// Can be called from any thread, the recording thread flushes its chunk at its next event.
+	void Stop();
+	bool IsRecording() { return thread_writer.joinable(); };
+
+	// The events in the segments, and those lost because the disk was behind or the budget full
+	uint64_t GetRecordedEvents() { return recordedEvents.load(std::memory_order_relaxed); };
+	uint64_t GetDroppedEvents() { return droppedEvents.load(std::memory_order_relaxed) + overBudgetEvents.load(std::memory_order_relaxed); };
+	uint64_t GetBytesWritten() { return bytesWritten.load(std::memory_order_relaxed); };
+	bool IsDiskFull() { return bDiskFull.load(std::memory_order_relaxed); };
+	std::string GetError();
+
+	//////////////////////////////////////////////////////////////////////////
+	// Replay
+	//////////////////////////////////////////////////////////////////////////
+
+	// Maps the segments of the directory. Returns false with GetError() set if there are none.
+	bool Open(const std::string& directory);
+	void Close();
+	bool IsOpen() { return !replayChunks.empty(); };
+	uint64_t GetEventCount() { return replayEventCount; };
+	inline SDHREvent GetEvent(uint64_t index) {
+		const auto& chunk = replayChunks[index / STREAM_CHUNK_EVENTS];
+		return vcr_unpack_event(chunk.events[index % STREAM_CHUNK_EVENTS]);
+	};
+	size_t GetKeyframeCount() { return replayChunks.size(); };
+	// The keyframe at the start of chunk i, ram being STREAM_KEYFRAME_RAM bytes, main then aux
+	void GetKeyframe(size_t chunkIndex, const uint8_t*& ram, std::string& state);
+	// The events that weren't recorded just before the chunk
+	uint64_t GetDroppedBefore(size_t chunkIndex) { return replayChunks.at(chunkIndex).droppedBefore; };
+	// The index of the first event of the chunk in the whole stream, dropped events included
+	uint64_t GetStreamIndex(size_t chunkIndex) { return replayChunks.at(chunkIndex).streamIndex; };
+	bool IsPAL() { return bReplayIsPAL; };
+
+private:
+	struct Chunk {
+		uint64_t streamIndex = 0;
+		uint64_t droppedBefore = 0;
+		uint32_t eventCount = 0;
+		uint32_t stateSize = 0;
+		uint8_t state[STREAM_STATE_SIZE] = {};
+		std::vector<uint8_t> ram;
+		std::vector<uint32_t> events;
+	};
+	struct ReplayChunk {
+		uint64_t streamIndex;
+		uint64_t droppedBefore;
+		uint32_t eventCount;
+		const uint8_t* slot;
+		const uint32_t* events;
+	};
+
+	enum class StopState_e : uint8_t {
+		RECORDING = 0,
+		REQUESTED,			// Stop() waits for the recording thread to publish its last chunk
+		FLUSHING,			// it's being published, by the recording thread or by Stop() when no event came
+		DONE,
+	};
+
+	bool StartChunk();
+	void PublishChunk();
+	void AcknowledgeStop();
+	void FlushLastChunk();
+	int writer_thread();
+	void WriteChunk(const Chunk& chunk);
+	bool NextSegment();
+	void CloseSegment();
+
+	// Recording thread
+	Chunk chunkPool[STREAM_CHUNK_POOL];
+	uint32_t* chunkEvents = nullptr;		// events of the chunk being filled
+	uint32_t chunkFill = STREAM_CHUNK_EVENTS;	// none is being filled
+	uint64_t publishedEvents = 0;
+	uint64_t pendingDrops = 0;				// dropped since the last chunk
+	// Shared with the writer thread. The pool is used in order: chunk n is chunkPool[n % STREAM_CHUNK_POOL]
+	std::atomic<uint64_t> publishedChunks{ 0 };
+	std::atomic<uint64_t> consumedChunks{ 0 };
+	std::atomic<uint64_t> recordedEvents{ 0 };
+	std::atomic<uint64_t> droppedEvents{ 0 };		// by the recording thread
+	std::atomic<uint64_t> overBudgetEvents{ 0 };	// by the writer, when the budget is full
+	std::atomic<uint64_t> bytesWritten{ 0 };
+	std::atomic<bool> bDiskFull{ false };
+	std::atomic<StopState_e> stopState{ StopState_e::DONE };
+	std::atomic<bool> bShouldStopWriter{ false };
+	std::thread thread_writer;
+	// Writer thread
+	std::string segmentDirectory;
+	uint32_t maxSegments = 0;
+	bool bRolling = false;
+	bool bIsPAL = false;
+	uint64_t segmentSequence = 0;
+	std::unique_ptr<MappedFile> segment;
+	uint32_t segmentChunks = 0;
+	std::mutex errorMutex;		// the writer also sets the error
+	std::string m_lastError;
+	// Replay
+	std::vector<std::unique_ptr<MappedFile>> replaySegments;
+	std::vector<ReplayChunk> replayChunks;
+	uint64_t replayEventCount = 0;
+	bool bReplayIsPAL = false;
+};
+
+#endif // STREAMRECORDER_H
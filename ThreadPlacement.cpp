@@ -0,0 +1,190 @@
+#include "ThreadPlacement.h"
+#include "SDHRNetworking.h"		// for the platform defines
+#include "imgui.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__NETWORKING_WINDOWS__)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+#if defined(__NETWORKING_LINUX__)
+#include <sys/syscall.h>
+#endif
+
+// below because "The declaration of a static data member in its class definition is not a definition"
+ThreadPlacement* ThreadPlacement::s_instance;
+
+static const char* threadNames[(int)PipelineThread_e::TOTAL_COUNT] = {
+	"ingest", "processing", "audio", "render"
+};
+
+void ThreadPlacement::SetStatus(PipelineThread_e thread, const std::string& status)
+{
+	std::lock_guard<std::mutex> lock(statusMutex);
+	statuses[(int)thread] = status;
+}
+
+void ThreadPlacement::ApplyToCurrentThread(PipelineThread_e thread)
+{
+	const Placement& pl = placements[(int)thread];
+	std::string status;
+
+	// CPU affinity
+	if (pl.cpu >= 0)
+	{
+#if defined(__NETWORKING_LINUX__)
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(pl.cpu, &cpuset);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+		status += (err == 0) ? "pinned" : std::string("pin failed: ") + strerror(err);
+#elif defined(__NETWORKING_WINDOWS__)
+		if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << pl.cpu) != 0)
+			status += "pinned";
+		else
+			status += "pin failed: error " + std::to_string(GetLastError());
+#else
+		status += "pinning not supported";
+#endif
+	}
+
+	// Scheduling: realtime priority, otherwise nice level
+	if (pl.realtimePriority > 0)
+	{
+		if (!status.empty())
+			status += ", ";
+#if defined(__NETWORKING_WINDOWS__)
+		if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+			status += "time critical";
+		else
+			status += "priority failed: error " + std::to_string(GetLastError());
+#else
+		sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = std::min(std::max(pl.realtimePriority, sched_get_priority_min(SCHED_FIFO)),
+			sched_get_priority_max(SCHED_FIFO));
+		int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		status += (err == 0) ? "SCHED_FIFO" : std::string("SCHED_FIFO failed: ") + strerror(err);
+#endif
+	}
+	else if (pl.nice != 0)
+	{
+		if (!status.empty())
+			status += ", ";
+#if defined(__NETWORKING_LINUX__)
+		// On Linux the nice level is per thread
+		if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), pl.nice) == 0)
+			status += "nice set";
+		else
+			status += std::string("nice failed: ") + strerror(errno);
+#elif defined(__NETWORKING_WINDOWS__)
+		int winPriority = THREAD_PRIORITY_NORMAL;
+		if (pl.nice <= -10) winPriority = THREAD_PRIORITY_HIGHEST;
+		else if (pl.nice < 0) winPriority = THREAD_PRIORITY_ABOVE_NORMAL;
+		else if (pl.nice >= 10) winPriority = THREAD_PRIORITY_LOWEST;
+		else winPriority = THREAD_PRIORITY_BELOW_NORMAL;
+		if (SetThreadPriority(GetCurrentThread(), winPriority))
+			status += "priority set";
+		else
+			status += "priority failed: error " + std::to_string(GetLastError());
+#else
+		status += "per-thread nice not supported";
+#endif
+	}
+
+	if (status.empty())
+		status = "default";
+#if defined(__NETWORKING_LINUX__)
+	status += " (on cpu " + std::to_string(sched_getcpu()) + ")";
+#endif
+	if (status.find("failed") != std::string::npos)
+		std::cerr << "Thread " << threadNames[(int)thread] << ": " << status << std::endl;
+	SetStatus(thread, status);
+}
+
+void ThreadPlacement::ApplyMemoryLock()
+{
+	if (!bLockMemory)
+		return;
+	std::lock_guard<std::mutex> lock(statusMutex);
+#if defined(__NETWORKING_WINDOWS__)
+	memoryLockStatus = "Not supported on Windows";
+#else
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+		memoryLockStatus = "Locked";
+	else
+		memoryLockStatus = std::string("Failed: ") + strerror(errno);
+#endif
+	std::cout << "Memory lock: " << memoryLockStatus << std::endl;
+}
+
+nlohmann::json ThreadPlacement::SerializeState()
+{
+	nlohmann::json jsonState = {
+		{"lock memory", bLockMemory},
+	};
+	for (int i = 0; i < (int)PipelineThread_e::TOTAL_COUNT; ++i)
+	{
+		jsonState[threadNames[i]] = {
+			{"cpu", placements[i].cpu},
+			{"realtime priority", placements[i].realtimePriority},
+			{"nice", placements[i].nice},
+		};
+	}
+	return jsonState;
+}
+
+void ThreadPlacement::DeserializeState(const nlohmann::json& jsonState)
+{
+	bLockMemory = jsonState.value("lock memory", bLockMemory);
+	for (int i = 0; i < (int)PipelineThread_e::TOTAL_COUNT; ++i)
+	{
+		if (!jsonState.contains(threadNames[i]))
+			continue;
+		auto _st = jsonState[threadNames[i]];
+		placements[i].cpu = _st.value("cpu", placements[i].cpu);
+		placements[i].realtimePriority = _st.value("realtime priority", placements[i].realtimePriority);
+		placements[i].nice = _st.value("nice", placements[i].nice);
+	}
+}
+
+void ThreadPlacement::DisplayImGuiTable()
+{
+	std::lock_guard<std::mutex> lock(statusMutex);
+	if (ImGui::BeginTable("threads", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("Thread");
+		ImGui::TableSetupColumn("CPU");
+		ImGui::TableSetupColumn("RT Priority");
+		ImGui::TableSetupColumn("Nice");
+		ImGui::TableSetupColumn("Status");
+		ImGui::TableHeadersRow();
+		for (int i = 0; i < (int)PipelineThread_e::TOTAL_COUNT; ++i)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", threadNames[i]);
+			ImGui::TableNextColumn();
+			if (placements[i].cpu < 0)
+				ImGui::Text("any");
+			else
+				ImGui::Text("%d", placements[i].cpu);
+			ImGui::TableNextColumn(); ImGui::Text("%d", placements[i].realtimePriority);
+			ImGui::TableNextColumn(); ImGui::Text("%d", placements[i].nice);
+			ImGui::TableNextColumn(); ImGui::Text("%s", statuses[i].empty() ? "not started" : statuses[i].c_str());
+		}
+		ImGui::EndTable();
+	}
+	ImGui::Text("Memory lock: %s", bLockMemory ? memoryLockStatus.c_str() : "Not requested");
+	ImGui::Text("Set in the \"Threads\" section of Settings.json, applied at startup");
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <stdint.h>
+#include <string>
+#include <mutex>
+#include "nlohmann/json.hpp"
+
+/*
+	CPU placement and scheduling of the display pipeline threads, from the "Threads"
+	section of Settings.json. For example, on a 4-core display box:
+
+	"Threads": {
+		"lock memory": true,
+		"ingest":     { "cpu": 1, "realtime priority": 70, "nice": 0 },
+		"processing": { "cpu": 2, "realtime priority": 80, "nice": 0 },
+		"audio":      { "cpu": 3, "realtime priority": 60, "nice": 0 },
+		"render":     { "cpu": 0, "realtime priority": 0, "nice": -5 }
+	}
+
+	cpu:				core to pin the thread to, -1 lets the OS decide
+	realtime priority:	1-99 runs the thread with SCHED_FIFO at that priority, 0 is normal scheduling
+	nice:				nice level for normal scheduling (-20 to 19)
+	lock memory:		locks all the process memory in RAM (mlockall), so it's never paged out
+
+	Each thread applies its own placement when it starts. Realtime priorities, negative
+	nice levels and memory locking usually need elevated privileges (CAP_SYS_NICE and
+	CAP_IPC_LOCK on Linux); failures are reported and the thread runs with the defaults.
+	Changes take effect on the next start.
+*/
+
+enum class PipelineThread_e
+{
+	INGEST = 0,		// usb_server_thread, runs the event source
+	PROCESSING,		// process_usb_events_thread, runs the beam
+	AUDIO,			// SDL audio callback
+	RENDER,			// main loop
+	TOTAL_COUNT
+};
+
+class ThreadPlacement
+{
+public:
+	struct Placement {
+		int cpu = -1;
+		int realtimePriority = 0;
+		int nice = 0;
+	};
+
+	// Call from the thread itself, when it starts
+	void ApplyToCurrentThread(PipelineThread_e thread);
+	// Call once before starting the threads
+	void ApplyMemoryLock();
+
+	nlohmann::json SerializeState();
+	void DeserializeState(const nlohmann::json& jsonState);
+	// Table of the threads with their requested placement and the outcome
+	void DisplayImGuiTable();
+
+	// public singleton code
+	static ThreadPlacement* GetInstance()
+	{
+		if (NULL == s_instance)
+			s_instance = new ThreadPlacement();
+		return s_instance;
+	}
+private:
+	static ThreadPlacement* s_instance;
+	ThreadPlacement() {};
+
+	void SetStatus(PipelineThread_e thread, const std::string& status);
+
+	Placement placements[(int)PipelineThread_e::TOTAL_COUNT];
+	bool bLockMemory = false;
+	std::mutex statusMutex;		// the statuses are written by each thread, read by the UI
+	std::string statuses[(int)PipelineThread_e::TOTAL_COUNT];
+	std::string memoryLockStatus = "Not requested";
+};
+
+#endif // THREADPLACEMENT_H
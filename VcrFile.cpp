@@ -0,0 +1,481 @@
+#include "VcrFile.h"
+#include "common.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <zlib.h>
+
+constexpr size_t VCR_HEADER_SIZE = 48;
+constexpr size_t VCR_INDEX_ENTRY_SIZE = 20;
+constexpr uint32_t VCR_MAX_EVENTS_PER_BLOCK = 16 * 1024 * 1024;
+
+//////////////////////////////////////////////////////////////////////////
+// Packed events
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t vcr_pack_event(const SDHREvent& e)
+{
+	return (uint32_t)e.addr
+		| ((uint32_t)e.data << 16)
+		| ((uint32_t)e.rw << 24)
+		| ((uint32_t)e.m2b0 << 25)
+		| ((uint32_t)e.m2sel << 26)
+		| ((uint32_t)e.is_iigs << 27);
+}
+
+SDHREvent vcr_unpack_event(uint32_t packed)
+{
+	return SDHREvent((packed >> 27) & 1, (packed >> 25) & 1, (packed >> 26) & 1, (packed >> 24) & 1,
+		(uint16_t)(packed & 0xFFFF), (uint8_t)((packed >> 16) & 0xFF));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Little endian fields
+//////////////////////////////////////////////////////////////////////////
+
+static inline void put_u32(uint8_t* p, uint32_t v)
+{
+	for (int i = 0; i < 4; ++i)
+		p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline void put_u64(uint8_t* p, uint64_t v)
+{
+	for (int i = 0; i < 8; ++i)
+		p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint32_t get_u32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t get_u64(const uint8_t* p)
+{
+	return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// LZ4 block codec
+// The standard LZ4 block format: sequences of a token, the literals and a match
+// of at least 4 bytes up to 64k back. The compressor is the greedy single hash one.
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t LZ4_MINMATCH = 4;
+constexpr size_t LZ4_LASTLITERALS = 5;		// the last 5 bytes are always literals
+constexpr size_t LZ4_MFLIMIT = 12;			// and the last match starts 12 bytes before the end
+constexpr size_t LZ4_MAX_OFFSET = 0xFFFF;
+constexpr uint32_t LZ4_HASH_BITS = 16;
+
+static inline uint32_t lz4_read32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Writes the extra bytes of a length of 15 or more
+static inline uint8_t* lz4_write_length(uint8_t* op, size_t length)
+{
+	length -= 15;
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+// Returns the compressed size, or 0 if it doesn't fit in dstCapacity
+static size_t lz4_compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+	std::vector<uint32_t> table(1 << LZ4_HASH_BITS, 0);
+	uint8_t* op = dst;
+	const uint8_t* const oend = dst + dstCapacity;
+	size_t anchor = 0;
+	if (srcSize > LZ4_MFLIMIT)
+	{
+		const size_t ipLimit = srcSize - LZ4_MFLIMIT;
+		const size_t matchLimit = srcSize - LZ4_LASTLITERALS;
+		size_t ip = 0;
+		while (ip <= ipLimit)
+		{
+			uint32_t sequence = lz4_read32(src + ip);
+			uint32_t h = lz4_hash(sequence);
+			size_t ref = table[h];
+			table[h] = (uint32_t)ip;
+			if ((ref >= ip) || ((ip - ref) > LZ4_MAX_OFFSET) || (lz4_read32(src + ref) != sequence))
+			{
+				// Skip faster through data that doesn't match
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			while ((ip > anchor) && (ref > 0) && (src[ip - 1] == src[ref - 1]))
+			{
+				--ip;
+				--ref;
+			}
+			size_t matchLength = LZ4_MINMATCH;
+			while (((ip + matchLength) < matchLimit) && (src[ip + matchLength] == src[ref + matchLength]))
+				++matchLength;
+
+			size_t literalLength = ip - anchor;
+			if ((op + 1 + (literalLength / 255 + 1) + literalLength + 2 + ((matchLength - LZ4_MINMATCH) / 255 + 1)) > oend)
+				return 0;
+			uint8_t* token = op++;
+			*token = (uint8_t)(std::min<size_t>(literalLength, 15) << 4);
+			if (literalLength >= 15)
+				op = lz4_write_length(op, literalLength);
+			memcpy(op, src + anchor, literalLength);
+			op += literalLength;
+			size_t offset = ip - ref;
+			*op++ = (uint8_t)(offset & 0xFF);
+			*op++ = (uint8_t)(offset >> 8);
+			*token |= (uint8_t)std::min<size_t>(matchLength - LZ4_MINMATCH, 15);
+			if ((matchLength - LZ4_MINMATCH) >= 15)
+				op = lz4_write_length(op, matchLength - LZ4_MINMATCH);
+
+			ip += matchLength;
+			anchor = ip;
+			// Keep the matches of runs that end inside this one
+			if (ip <= ipLimit)
+				table[lz4_hash(lz4_read32(src + ip - 2))] = (uint32_t)(ip - 2);
+		}
+	}
+	// The last literals
+	size_t literalLength = srcSize - anchor;
+	if ((op + 1 + (literalLength / 255 + 1) + literalLength) > oend)
+		return 0;
+	uint8_t* token = op++;
+	*token = (uint8_t)(std::min<size_t>(literalLength, 15) << 4);
+	if (literalLength >= 15)
+		op = lz4_write_length(op, literalLength);
+	memcpy(op, src + anchor, literalLength);
+	op += literalLength;
+	return (size_t)(op - dst);
+}
+
+// dstSize is the exact decompressed size. Returns false on corrupt data.
+static bool lz4_decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* ip = src;
+	const uint8_t* const iend = src + srcSize;
+	uint8_t* op = dst;
+	uint8_t* const oend = dst + dstSize;
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			uint8_t b;
+			do {
+				if (ip >= iend)
+					return false;
+				b = *ip++;
+				literalLength += b;
+			} while (b == 255);
+		}
+		if (((size_t)(iend - ip) < literalLength) || ((size_t)(oend - op) < literalLength))
+			return false;
+		memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+		if (ip == iend)
+			break;		// the last sequence has no match
+
+		if ((iend - ip) < 2)
+			return false;
+		size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if ((offset == 0) || (offset > (size_t)(op - dst)))
+			return false;
+		size_t matchLength = token & 0x0F;
+		if (matchLength == 15)
+		{
+			uint8_t b;
+			do {
+				if (ip >= iend)
+					return false;
+				b = *ip++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += LZ4_MINMATCH;
+		if ((size_t)(oend - op) < matchLength)
+			return false;
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength)
+			memcpy(op, match, matchLength);
+		else
+		{
+			// Overlapping match, repeats the last offset bytes
+			for (size_t i = 0; i < matchLength; ++i)
+				op[i] = match[i];
+		}
+		op += matchLength;
+	}
+	return op == oend;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Chunks
+//////////////////////////////////////////////////////////////////////////
+
+// Compresses raw into compressed, and returns the codec used. Falls back to RAW when the codec doesn't shrink the data.
+static VcrCodec_e compress_chunk(const std::vector<uint8_t>& raw, std::vector<uint8_t>& compressed, VcrCodec_e codec)
+{
+	compressed.clear();
+	if (raw.empty())
+		return VcrCodec_e::RAW;
+	switch (codec)
+	{
+	case VcrCodec_e::LZ4:
+	{
+		compressed.resize(raw.size() - 1);
+		size_t size = lz4_compress(raw.data(), raw.size(), compressed.data(), compressed.size());
+		if (size > 0)
+		{
+			compressed.resize(size);
+			return VcrCodec_e::LZ4;
+		}
+		break;
+	}
+	case VcrCodec_e::ZLIB:
+	{
+		uLongf size = compressBound((uLong)raw.size());
+		compressed.resize(size);
+		if ((compress2(compressed.data(), &size, raw.data(), (uLong)raw.size(), Z_BEST_SPEED) == Z_OK) && (size < raw.size()))
+		{
+			compressed.resize(size);
+			return VcrCodec_e::ZLIB;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	compressed = raw;
+	return VcrCodec_e::RAW;
+}
+
+// Splits the events into their 4 byte planes
+static void events_to_planes(const SDHREvent* events, size_t count, std::vector<uint8_t>& planes)
+{
+	planes.resize(count * 4);
+	uint8_t* p = planes.data();
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t packed = vcr_pack_event(events[i]);
+		p[i] = (uint8_t)packed;
+		p[count + i] = (uint8_t)(packed >> 8);
+		p[2 * count + i] = (uint8_t)(packed >> 16);
+		p[3 * count + i] = (uint8_t)(packed >> 24);
+	}
+}
+
+static void serialize_keyframe(const VcrKeyframe& keyframe, std::vector<uint8_t>& raw)
+{
+	raw.resize(8 + keyframe.ram.size() + keyframe.state.size());
+	put_u32(raw.data(), (uint32_t)keyframe.ram.size());
+	if (!keyframe.ram.empty())
+		memcpy(raw.data() + 4, keyframe.ram.data(), keyframe.ram.size());
+	put_u32(raw.data() + 4 + keyframe.ram.size(), (uint32_t)keyframe.state.size());
+	if (!keyframe.state.empty())
+		memcpy(raw.data() + 8 + keyframe.ram.size(), keyframe.state.data(), keyframe.state.size());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Writer
+//////////////////////////////////////////////////////////////////////////
+
+void vcr_write(std::ostream& out, VcrHeader header, const std::vector<SDHREvent>& events,
+	const std::vector<VcrKeyframe>& keyframes, VcrCodec_e codec)
+{
+	header.version = VCR2_VERSION;
+	header.cycles = events.size();
+	if (header.eventsPerBlock == 0)
+		header.eventsPerBlock = VCR_EVENTS_PER_BLOCK;
+	header.blockCount = (uint32_t)((header.cycles + header.eventsPerBlock - 1) / header.eventsPerBlock);
+	header.keyframeCount = (uint32_t)keyframes.size();
+
+	uint8_t headerBytes[VCR_HEADER_SIZE] = {};
+	memcpy(headerBytes, VCR2_MAGIC, sizeof(VCR2_MAGIC));
+	put_u32(headerBytes + 8, header.version);
+	headerBytes[12] = header.is_iigs;
+	headerBytes[13] = header.is_pal;
+	put_u64(headerBytes + 16, header.cycles);
+	put_u32(headerBytes + 24, header.eventsPerBlock);
+	put_u32(headerBytes + 28, header.blockCount);
+	put_u64(headerBytes + 32, header.keyframeCycles);
+	put_u32(headerBytes + 40, header.keyframeCount);
+
+	// The index is written once the chunks are, when their sizes are known
+	const std::streampos start = out.tellp();
+	const size_t chunkCount = (size_t)header.blockCount + header.keyframeCount;
+	std::vector<uint8_t> index(chunkCount * VCR_INDEX_ENTRY_SIZE, 0);
+	out.write(reinterpret_cast<const char*>(headerBytes), VCR_HEADER_SIZE);
+	out.write(reinterpret_cast<const char*>(index.data()), index.size());
+
+	uint64_t offset = VCR_HEADER_SIZE + index.size();
+	std::vector<uint8_t> raw;
+	std::vector<uint8_t> compressed;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		if (i < header.blockCount)
+		{
+			size_t first = i * header.eventsPerBlock;
+			size_t count = std::min<size_t>(header.eventsPerBlock, events.size() - first);
+			events_to_planes(events.data() + first, count, raw);
+		}
+		else
+			serialize_keyframe(keyframes[i - header.blockCount], raw);
+		auto chunkCodec = compress_chunk(raw, compressed, codec);
+		uint8_t* entry = index.data() + i * VCR_INDEX_ENTRY_SIZE;
+		put_u64(entry, offset);
+		put_u32(entry + 8, (uint32_t)compressed.size());
+		put_u32(entry + 12, (uint32_t)raw.size());
+		entry[16] = (uint8_t)chunkCodec;
+		out.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+		offset += compressed.size();
+	}
+
+	out.seekp(start + (std::streamoff)VCR_HEADER_SIZE);
+	out.write(reinterpret_cast<const char*>(index.data()), index.size());
+	out.seekp(start + (std::streamoff)offset);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Reader
+//////////////////////////////////////////////////////////////////////////
+
+bool vcr_is_v2(std::istream& in)
+{
+	const auto pos = in.tellg();
+	char magic[sizeof(VCR2_MAGIC)] = {};
+	in.read(magic, sizeof(magic));
+	bool bIsV2 = (in.gcount() == sizeof(magic)) && (memcmp(magic, VCR2_MAGIC, sizeof(magic)) == 0);
+	in.clear();
+	in.seekg(pos);
+	return bIsV2;
+}
+
+VcrReader::VcrReader(std::istream& _in) : in(_in)
+{
+	start = in.tellg();
+	uint8_t headerBytes[VCR_HEADER_SIZE];
+	in.read(reinterpret_cast<char*>(headerBytes), VCR_HEADER_SIZE);
+	if ((in.gcount() != VCR_HEADER_SIZE) || (memcmp(headerBytes, VCR2_MAGIC, sizeof(VCR2_MAGIC)) != 0))
+		throw std::ios_base::failure("Not a v2 recording file");
+	header.version = get_u32(headerBytes + 8);
+	if (header.version != VCR2_VERSION)
+		throw std::ios_base::failure("Unsupported recording file version " + std::to_string(header.version));
+	header.is_iigs = headerBytes[12] != 0;
+	header.is_pal = headerBytes[13] != 0;
+	header.cycles = get_u64(headerBytes + 16);
+	header.eventsPerBlock = get_u32(headerBytes + 24);
+	header.blockCount = get_u32(headerBytes + 28);
+	header.keyframeCycles = get_u64(headerBytes + 32);
+	header.keyframeCount = get_u32(headerBytes + 40);
+	if ((header.eventsPerBlock == 0) || (header.eventsPerBlock > VCR_MAX_EVENTS_PER_BLOCK)
+		|| (header.blockCount != (header.cycles + header.eventsPerBlock - 1) / header.eventsPerBlock))
+		throw std::ios_base::failure("Corrupt recording file header");
+
+	const size_t chunkCount = (size_t)header.blockCount + header.keyframeCount;
+	std::vector<uint8_t> index(chunkCount * VCR_INDEX_ENTRY_SIZE);
+	in.read(reinterpret_cast<char*>(index.data()), index.size());
+	if ((size_t)in.gcount() != index.size())
+		throw std::ios_base::failure("Truncated recording file index");
+	blocks.reserve(header.blockCount);
+	keyframes.reserve(header.keyframeCount);
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		const uint8_t* entry = index.data() + i * VCR_INDEX_ENTRY_SIZE;
+		Chunk chunk = { get_u64(entry), get_u32(entry + 8), get_u32(entry + 12), (VcrCodec_e)entry[16] };
+		if (i < header.blockCount)
+		{
+			size_t count = std::min<uint64_t>(header.eventsPerBlock, header.cycles - i * header.eventsPerBlock);
+			if (chunk.rawSize != count * 4)
+				throw std::ios_base::failure("Corrupt recording file index");
+			blocks.push_back(chunk);
+		}
+		else
+			keyframes.push_back(chunk);
+	}
+}
+
+void VcrReader::ReadChunk(const Chunk& chunk, std::vector<uint8_t>& raw)
+{
+	compressed.resize(chunk.size);
+	in.clear();
+	in.seekg(start + (std::streamoff)chunk.offset);
+	in.read(reinterpret_cast<char*>(compressed.data()), chunk.size);
+	if ((size_t)in.gcount() != chunk.size)
+		throw std::ios_base::failure("Truncated recording file");
+	raw.resize(chunk.rawSize);
+	bool bOk = false;
+	switch (chunk.codec)
+	{
+	case VcrCodec_e::RAW:
+		bOk = (chunk.size == chunk.rawSize);
+		if (bOk)
+			raw.swap(compressed);
+		break;
+	case VcrCodec_e::LZ4:
+		bOk = lz4_decompress(compressed.data(), compressed.size(), raw.data(), raw.size());
+		break;
+	case VcrCodec_e::ZLIB:
+	{
+		uLongf size = (uLongf)raw.size();
+		bOk = (uncompress(raw.data(), &size, compressed.data(), (uLong)compressed.size()) == Z_OK) && (size == raw.size());
+		break;
+	}
+	default:
+		break;
+	}
+	if (!bOk)
+		throw std::ios_base::failure("Corrupt recording file chunk");
+}
+
+void VcrReader::ReadBlock(size_t blockIndex, std::vector<SDHREvent>& events)
+{
+	ReadChunk(blocks.at(blockIndex), planes);
+	const size_t count = planes.size() / 4;
+	const uint8_t* p = planes.data();
+	events.reserve(events.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t packed = (uint32_t)p[i] | ((uint32_t)p[count + i] << 8)
+			| ((uint32_t)p[2 * count + i] << 16) | ((uint32_t)p[3 * count + i] << 24);
+		events.push_back(vcr_unpack_event(packed));
+	}
+}
+
+uint64_t VcrReader::ReadBlockAt(uint64_t cycle, std::vector<SDHREvent>& events)
+{
+	size_t blockIndex = (size_t)(cycle / header.eventsPerBlock);
+	ReadBlock(blockIndex, events);
+	return (uint64_t)blockIndex * header.eventsPerBlock;
+}
+
+VcrKeyframe VcrReader::ReadKeyframe(size_t keyframeIndex)
+{
+	std::vector<uint8_t> raw;
+	ReadChunk(keyframes.at(keyframeIndex), raw);
+	VcrKeyframe keyframe;
+	size_t ramSize = (raw.size() >= 4) ? get_u32(raw.data()) : SIZE_MAX;
+	if ((raw.size() < 8) || (ramSize > raw.size() - 8))
+		throw std::ios_base::failure("Corrupt recording file keyframe");
+	size_t stateSize = get_u32(raw.data() + 4 + ramSize);
+	if (stateSize != raw.size() - 8 - ramSize)
+		throw std::ios_base::failure("Corrupt recording file keyframe");
+	keyframe.ram.assign(raw.begin() + 4, raw.begin() + 4 + ramSize);
+	keyframe.state.assign(reinterpret_cast<const char*>(raw.data()) + 8 + ramSize, stateSize);
+	return keyframe;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#ifndef VCRFILE_H
+#define VCRFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "SDHRNetworking.h"	// for SDHREvent
+
+/*
+	.vcr v2 recording files, written and read by the EventRecorder.
+
+	The v1 files are a snapshot interval, an event count, 128k RAM snapshots and
+	then 5 bytes per event (m2sel is dropped), all written field by field.
+	The v2 files start with the VCR2_MAGIC bytes, which a v1 file can't start with,
+	so EventRecorder::ReadRecordingFile() still reads both.
+
+	v2 layout, all integers little endian:
+		header		magic, version, machine, region, cycle count, events per block,
+					keyframe interval, block count, keyframe count
+		index		one chunk entry per event block, then one per keyframe
+		chunks		the compressed data the index points to
+
+	Each event is packed in 4 bytes (see vcr_pack_event()). The events are cut in
+	blocks of VCR_EVENTS_PER_BLOCK, so the block of any cycle is found directly in
+	the index. A block is stored as 4 byte planes, each byte of all the events in
+	turn, which compresses much better than whole events.
+	A keyframe is the main and aux memory and the softswitches at the cycle
+	keyframe * keyframe interval. Replays and seeks start from them.
+
+	Chunks are compressed with the in-tree LZ4 block codec, or zlib when asked.
+	Chunks that don't compress are stored raw.
+*/
+
+constexpr char VCR2_MAGIC[8] = { 'S', 'D', 'D', 'V', 'C', 'R', '\x1A', '\0' };
+constexpr uint32_t VCR2_VERSION = 2;
+constexpr uint32_t VCR_EVENTS_PER_BLOCK = 64 * 1024;
+
+enum class VcrCodec_e : uint8_t
+{
+	RAW = 0,
+	LZ4 = 1,
+	ZLIB = 2,
+};
+
+struct VcrHeader {
+	uint32_t version = VCR2_VERSION;
+	bool is_iigs = false;			// machine type
+	bool is_pal = false;			// region
+	uint64_t cycles = 0;			// one event per cycle
+	uint32_t eventsPerBlock = VCR_EVENTS_PER_BLOCK;
+	uint64_t keyframeCycles = 0;	// cycles between keyframes
+	uint32_t blockCount = 0;
+	uint32_t keyframeCount = 0;
+};
+
+struct VcrKeyframe {
+	std::vector<uint8_t> ram;		// main then aux memory, _A2_MEMORY_SHADOW_END bytes each
+	std::string state;				// MemoryManager::SerializeSwitches()
+};
+
+// Packed event: bits 0-15 address, 16-23 data, 24 rw, 25 m2b0, 26 m2sel, 27 is_iigs
+uint32_t vcr_pack_event(const SDHREvent& e);
+SDHREvent vcr_unpack_event(uint32_t packed);
+
+// Writes a whole v2 recording. keyframes[i] is the state at cycle i * header.keyframeCycles.
+// The header's block and keyframe counts are set from events and keyframes.
+void vcr_write(std::ostream& out, VcrHeader header, const std::vector<SDHREvent>& events,
+	const std::vector<VcrKeyframe>& keyframes, VcrCodec_e codec = VcrCodec_e::LZ4);
+
+// Whether the stream is at the start of a v2 recording. Doesn't move the stream.
+bool vcr_is_v2(std::istream& in);
+
+// Reads the header and index of a v2 recording, then any block or keyframe on demand.
+// Throws std::ios_base::failure on files it can't read.
+class VcrReader
+{
+public:
+	explicit VcrReader(std::istream& in);
+	const VcrHeader& GetHeader() const { return header; };
+	// Appends the events of a block to events
+	void ReadBlock(size_t blockIndex, std::vector<SDHREvent>& events);
+	// Appends the events of the block that holds cycle, and returns the first cycle of the block
+	uint64_t ReadBlockAt(uint64_t cycle, std::vector<SDHREvent>& events);
+	VcrKeyframe ReadKeyframe(size_t keyframeIndex);
+
+private:
+	struct Chunk {
+		uint64_t offset;
+		uint32_t size;
+		uint32_t rawSize;
+		VcrCodec_e codec;
+	};
+	void ReadChunk(const Chunk& chunk, std::vector<uint8_t>& raw);
+
+	std::istream& in;
+	std::streampos start;			// the stream position of the magic
+	VcrHeader header;
+	std::vector<Chunk> blocks;
+	std::vector<Chunk> keyframes;
+	std::vector<uint8_t> compressed;	// reused between chunks
+	std::vector<uint8_t> planes;
+};
+
+#endif // VCRFILE_H
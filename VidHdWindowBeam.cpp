@@ -233,13 +233,19 @@ void VidHdWindowBeam::Render()
 		std::cerr << "VidHdWindowBeam::Render 5 error: " << glerr << std::endl;
 	}
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-	if (bVramTextureExists)	// it exists, do a glTexSubImage2D() update
+	bytesUploaded = 0;
+	if (bVramTextureExists)	// it exists, only upload the text rows that changed with glTexSubImage2D()
 	{
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _VIDHDMODES_TEXT_WIDTH, _VIDHDMODES_TEXT_HEIGHT, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, vram_text);
+		bytesUploaded = vramDirtyRows.Upload(reinterpret_cast<const uint8_t*>(vram_text), _VIDHDMODES_TEXT_WIDTH * sizeof(uint32_t),
+			_VIDHDMODES_TEXT_HEIGHT, [&](uint32_t y, uint32_t count) {
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, _VIDHDMODES_TEXT_WIDTH, count, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+					vram_text + _VIDHDMODES_TEXT_WIDTH * y);
+			});
 	}
 	else {	// texture doesn't exist, create it with glTexImage2D()
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, _VIDHDMODES_TEXT_WIDTH, _VIDHDMODES_TEXT_HEIGHT, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, vram_text);
 		bVramTextureExists = true;
+		vramDirtyRows.Invalidate();
 	}
 
 	if ((glerr = glGetError()) != GL_NO_ERROR) {
@@ -29,6 +29,7 @@
 #define VIDHDWINDOWBEAM_H
 
 #include "shader.h"
+#include "DirtyRows.h"
 #include <stdio.h>
 
 // The 40X24 and 80X24 modes are special. They're like the standard D/TEXT except
@@ -112,6 +113,9 @@ public:
 	void SetQuadRelativeBounds(SDL_FRect bounds);
 	SDL_FRect GetQuadRelativeBounds() const { return quad; };
 	void Render();
+	size_t GetBytesUploaded() const { return bytesUploaded; };	// VRAM bytes sent to the GPU by the last Render()
+	uint64_t HashVRAM() const { return dirtyrows_hash_row(reinterpret_cast<const uint8_t*>(vram_text),
+		_VIDHDMODES_TEXT_WIDTH * _VIDHDMODES_TEXT_HEIGHT * sizeof(uint32_t)); };	// for the static frame detection
 	void DisplayImGuiWindow(bool* p_open);
 
 	std::vector<VidHdBeamVertex> vertices;	// Vertices with XYRelative and XYPixels
@@ -125,6 +129,8 @@ private:
 	uXY screen_count = {_VIDHDMODES_PIXEL_WIDTH,_VIDHDMODES_PIXEL_HEIGHT};	// width,height in pixels of visible screen area of window
 
 	unsigned int VRAMTEX = UINT_MAX;		// GL_R8UI VRAM buffer texture.
+	DirtyRowTracker vramDirtyRows;			// rows of VRAMTEX that need an upload
+	size_t bytesUploaded = 0;
 
 	uint32_t* vram_text;					// 240x135 characters
 											// byte 0: text value
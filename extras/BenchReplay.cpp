@@ -0,0 +1,2041 @@
+//
+//  BenchReplay.cpp
+//  SuperDuperDisplay
+//
+//  Headless replay benchmark and regression runner.
+//  Loads recordings the same way as the EventRecorder (.vcr, .csv, .shra and #C20000),
+//  and pushes every event through process_single_event() as fast as possible, with no
+//  window and no GL: the real CycleCounter, beam, memory, sound and Mockingboard handlers run,
+//  and each frame the beam flips is hashed instead of rendered.
+//  The sample images (.lgr, .dgr, .hgr, .dhr, .shr and #C10000) replay as a few frames of
+//  events that change nothing, in the mode the main menu shows them in.
+//  It reports the cycles/s, the frames, a hash of each frame and the time split between the
+//  subsystems. Build it with "make bench_replay".
+//
+
+#include <SDL.h>
+#include "../common.h"
+#include "../SDHRNetworking.h"
+#include "../EventRecorder.h"
+#include "../MemoryManager.h"
+#include "../CycleCounter.h"
+#include "../A2VideoManager.h"
+#include "../SDHRManager.h"
+#include "../SoundManager.h"
+#include "../MockingboardManager.h"
+#include "../ReplayProfile.h"
+#include "../DirtyRows.h"
+#include "../SHRExpand.h"
+#include "../LegacyExpand.h"
+#include "../VcrFile.h"
+#include "../StreamRecorder.h"
+#include "../EventDecoder.h"
+#include "../SPSCRing.h"
+#include "../A2SoftRenderer.h"
+#include "MemoryLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ReplayResult {
+	uint64_t cycles = 0;
+	uint64_t frames = 0;
+	uint64_t hash = 0;				// all the frame hashes combined
+	uint64_t handlerNs = 0;			// time in process_single_event(), without the frame hashing
+	uint64_t hashNs = 0;
+};
+
+static bool is_recording_file(const std::filesystem::path& path)
+{
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	auto filename = path.filename().string();
+	return (ext == ".vcr") || (ext == ".csv") || (ext == ".shra")
+		|| (filename.find("#C20000") != std::string::npos) || (filename.find("#c20000") != std::string::npos);
+}
+
+static bool is_sample_file(const std::filesystem::path& path)
+{
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	auto filename = path.filename().string();
+	return (ext == ".lgr") || (ext == ".dgr") || (ext == ".hgr") || (ext == ".dhr") || (ext == ".shr")
+		|| (filename.find("#C10000") != std::string::npos) || (filename.find("#c10000") != std::string::npos);
+}
+
+// Loads a sample image with the softswitches of the main menu's samples, and makes a recording
+// of 3 PAL frames that only shows it
+static bool load_sample(const std::filesystem::path& path)
+{
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	auto memMgr = MemoryManager::GetInstance();
+	memMgr->Initialize();
+	memMgr->SetSoftSwitch(A2SS_TEXT, false);
+	bool res = false;
+	if (ext == ".lgr")
+		res = MemoryLoadLGR(path.string());
+	else if (ext == ".dgr")
+	{
+		memMgr->SetSoftSwitch(A2SS_80COL, true);
+		memMgr->SetSoftSwitch(A2SS_DHGR, true);
+		res = MemoryLoadDGR(path.string());
+	}
+	else if (ext == ".hgr")
+	{
+		memMgr->SetSoftSwitch(A2SS_HIRES, true);
+		res = MemoryLoadHGR(path.string());
+	}
+	else if (ext == ".dhr")
+	{
+		memMgr->SetSoftSwitch(A2SS_80COL, true);
+		memMgr->SetSoftSwitch(A2SS_HIRES, true);
+		memMgr->SetSoftSwitch(A2SS_DHGR, true);
+		res = MemoryLoadDHR(path.string());
+	}
+	else
+	{
+		memMgr->SetSoftSwitch(A2SS_SHR, true);
+		// Some only have the pixels, without the SCBs and palettes
+		if (std::filesystem::file_size(path) < 0x8000)
+			res = MemoryLoad(path.string(), 0x2000, true);
+		else
+			res = MemoryLoadSHR(path.string());
+	}
+	if (!res)
+	{
+		std::cerr << "ERROR: Cannot read " << path.generic_string() << std::endl;
+		return false;
+	}
+	EventRecorder::GetInstance()->MakeStaticRecording(3 * CYCLES_TOTAL_PAL);
+	return true;
+}
+
+// Same dispatch as the EventRecorder's load dialogs
+static bool load_recording(const std::filesystem::path& path)
+{
+	// The samples meant for the COLOR140 MIXED mode are named as such
+	A2VideoManager::GetInstance()->bUseDHGRCOL140Mixed = (path.filename().string().find("140mix") != std::string::npos);
+	if (is_sample_file(path))
+		return load_sample(path);
+	auto ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	bool bIsText = (ext == ".csv");
+	std::ifstream file(path, bIsText ? std::ios::in : std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "ERROR: Cannot open " << path.generic_string() << std::endl;
+		return false;
+	}
+	// The loaders read into the shadowed memory, start from a clean one
+	MemoryManager::GetInstance()->Initialize();
+	auto eventRecorder = EventRecorder::GetInstance();
+	try {
+		if (ext == ".vcr")
+			eventRecorder->ReadRecordingFile(file);
+		else if (bIsText)
+			eventRecorder->ReadTextEventsFromFile(file);
+		else
+			eventRecorder->ReadPaintWorksAnimationsFile(file);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "ERROR: Cannot read " << path.generic_string() << ": " << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Puts the machine back to its state before the recording's first event, so that
+// every pass and every file starts the same
+static void reset_machine(bool bPAL = false)
+{
+	MemoryManager::GetInstance()->Initialize();
+	EventRecorder::GetInstance()->ApplyInitialRAMSnapshot();
+	// Reset() goes back to NTSC without telling the sound and the recorder
+	auto cycleCounter = CycleCounter::GetInstance();
+	cycleCounter->SetVideoRegion(VideoRegion_e::NTSC);
+	cycleCounter->Reset();
+	if (bPAL)
+		cycleCounter->SetVideoRegion(VideoRegion_e::PAL);
+	MockingboardManager::GetInstance()->Initialize();
+	A2VideoManager::GetInstance()->Initialize();
+}
+
+static uint64_t hash_combine(uint64_t h, uint64_t v)
+{
+	h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+	return h ^ (h >> 32);
+}
+
+// Hashes the parts of the vrams that the renderer would read for the frame's mode
+static uint64_t hash_frame(A2VideoManager* a2VideoMgr, const A2VideoManager::BeamRenderVRAMs* frame)
+{
+	uint64_t h = hash_combine((uint64_t)frame->mode, ((uint64_t)frame->frameSHR4Modes << 32) | (uint32_t)frame->pagedMode);
+	bool bHasLegacy = (frame->mode == A2Mode_e::LEGACY) || (frame->mode == A2Mode_e::MERGED);
+	bool bHasSHR = (frame->mode == A2Mode_e::SHR) || (frame->mode == A2Mode_e::MERGED);
+	if (bHasLegacy)
+		h = hash_combine(h, dirtyrows_hash_row(frame->vram_legacy, a2VideoMgr->GetVramSizeLegacy()));
+	if (bHasSHR)
+	{
+		h = hash_combine(h, dirtyrows_hash_row(frame->vram_shr, a2VideoMgr->GetVramSizeSHR()));
+		if (frame->frameSHR4Modes & A2_VSM_SHR4PAL256)
+			h = hash_combine(h, dirtyrows_hash_row(frame->vram_pal256,
+				_A2VIDEO_SHR_BYTES_PER_LINE * 2 * _A2VIDEO_SHR_SCANLINES * _INTERLACE_MULTIPLIER));
+	}
+	if (frame->mode == A2Mode_e::MERGED)
+		h = hash_combine(h, dirtyrows_hash_row(reinterpret_cast<const uint8_t*>(frame->offset_buffer),
+			a2VideoMgr->GetVramHeightSHR() * sizeof(GLfloat)));
+	return h;
+}
+
+// How a recording is replayed, besides as recorded. Each variant has its own golden hash.
+struct ReplayVariant {
+	const char* suffix;		// after the path in the golden file
+	bool bPAL;
+	bool bMerged;
+};
+
+// The merged variant flips to SHR at line 50 and back at line 130 of every frame's worth of
+// cycles, with IIgs NEWVIDEO writes. They go in between the events so that none is lost.
+static std::vector<SDHREvent> make_merged_events(const std::vector<SDHREvent>& events)
+{
+	std::vector<SDHREvent> merged;
+	merged.reserve(events.size() + 2 * (events.size() / CYCLES_TOTAL_NTSC + 1));
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		auto cycle = i % CYCLES_TOTAL_NTSC;
+		if (cycle == 50 * CYCLES_SC_TOTAL)
+			merged.push_back(SDHREvent(false, false, false, false, 0xC029, 0x81));
+		else if (cycle == 130 * CYCLES_SC_TOTAL)
+			merged.push_back(SDHREvent(false, false, false, false, 0xC029, 0x01));
+		merged.push_back(events[i]);
+	}
+	return merged;
+}
+
+// With --batched, the events go through process_event_batch() in batches of an Appletini message,
+// like the live pipeline does. It collapses the runs of events that only count as cycles into
+// CycleCounter::AdvanceCycles() calls, and drops the IIgs and m2b0 flags like the messages do.
+static bool bReplayBatched = false;
+
+// onFrame, if any, is also given each frame
+static void replay_events(const std::vector<SDHREvent>& events, ReplayResult& result, std::vector<uint64_t>* frameHashes,
+	bool bPAL = false, const std::function<void(const A2VideoManager::BeamRenderVRAMs*)>& onFrame = nullptr)
+{
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	auto sdhrMgr = SDHRManager::GetInstance();
+	reset_machine(bPAL);
+	result = ReplayResult();
+	uint64_t hashNs = 0;
+	SDHREventBatch batch;
+	auto tStart = ReplayProfile::Now();
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		if (bReplayBatched)
+		{
+			const auto& event = events[i];
+			batch.addr[batch.count] = event.addr;
+			batch.data[batch.count] = event.data;
+			batch.rw[batch.count] = event.rw;
+			batch.reset[batch.count] = 1;
+			if ((++batch.count < EVENTBATCH_MAX_EVENTS) && ((i + 1) < events.size()))
+				continue;
+			process_event_batch(batch);
+			batch.count = 0;
+		}
+		else
+		{
+			SDHREvent e = events[i];
+			process_single_event(e);
+		}
+		// There's no GPU to upload the SDHR data to, it's immediately ready for the next commands
+		if (sdhrMgr->dataState == DATASTATE_e::DATA_UPDATED)
+			sdhrMgr->dataState = DATASTATE_e::DATA_IDLE;
+		// Consume the frames as soon as they are complete, so that none are dropped
+		if (auto frame = a2VideoMgr->AcquireHeadlessFrame())
+		{
+			auto tHash = ReplayProfile::Now();
+			auto h = hash_frame(a2VideoMgr, frame);
+			result.hash = hash_combine(result.hash, h);
+			++result.frames;
+			if (frameHashes)
+				frameHashes->push_back(h);
+			if (onFrame)
+				onFrame(frame);
+			hashNs += ReplayProfile::Now() - tHash;
+		}
+	}
+	result.cycles = events.size();
+	result.hashNs = hashNs;
+	result.handlerNs = ReplayProfile::Now() - tStart - hashNs;
+}
+
+// Replays every file and variant with the beam rendering each cycle as it comes, then with the lazy
+// beam that queues them, and compares the hashes frame by frame. Returns the number of mismatches.
+static uint32_t check_lazy_beam(const std::vector<std::filesystem::path>& files, const std::vector<ReplayVariant>& variants)
+{
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	const bool _bLazyBeam = a2VideoMgr->bLazyBeam;
+	uint32_t mismatches = 0;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+		{
+			++mismatches;
+			continue;
+		}
+		const auto& recordedEvents = EventRecorder::GetInstance()->GetEvents();
+		for (const auto& variant : variants)
+		{
+			const std::vector<SDHREvent> mergedEvents = (variant.bMerged ? make_merged_events(recordedEvents) : std::vector<SDHREvent>());
+			const auto& events = (variant.bMerged ? mergedEvents : recordedEvents);
+			ReplayResult result;
+			std::vector<uint64_t> frameHashes[2];
+			for (int lazy = 0; lazy < 2; ++lazy)
+			{
+				a2VideoMgr->bLazyBeam = (lazy != 0);
+				replay_events(events, result, &frameHashes[lazy], variant.bPAL);
+			}
+			auto mismatch = std::mismatch(frameHashes[0].begin(), frameHashes[0].end(), frameHashes[1].begin(), frameHashes[1].end());
+			bool bSame = (mismatch.first == frameHashes[0].end()) && (mismatch.second == frameHashes[1].end());
+			std::cout << (bSame ? "ok       " : "MISMATCH ") << std::setw(6) << frameHashes[0].size() << " frames  "
+				<< path.generic_string() << variant.suffix;
+			if (!bSame)
+			{
+				std::cout << "  first at frame " << (mismatch.first - frameHashes[0].begin())
+					<< " (" << frameHashes[0].size() << " immediate, " << frameHashes[1].size() << " lazy)";
+				++mismatches;
+			}
+			std::cout << std::endl;
+		}
+	}
+	a2VideoMgr->bLazyBeam = _bLazyBeam;
+	return mismatches;
+}
+
+// Time of an empty REPLAY_PROFILE() scope: what it adds inside the section, and in total
+static void measure_profile_overhead(double& insideNs, double& totalNs)
+{
+	constexpr int count = 1'000'000;
+	ReplayProfile::Reset();
+	ReplayProfile::bEnabled = true;
+	auto tStart = ReplayProfile::Now();
+	for (int i = 0; i < count; ++i)
+		ReplayProfileScope _scope(ReplaySection_e::VIDEO);
+	totalNs = (double)(ReplayProfile::Now() - tStart) / count;
+	insideNs = (double)ReplayProfile::ns[(int)ReplaySection_e::VIDEO] / count;
+	ReplayProfile::bEnabled = false;
+	ReplayProfile::Reset();
+}
+
+static void print_split(const std::vector<SDHREvent>& events, double insideNs, double totalNs, bool bPAL)
+{
+	ReplayResult result;
+	ReplayProfile::Reset();
+	ReplayProfile::bEnabled = true;
+	replay_events(events, result, nullptr, bPAL);
+	ReplayProfile::bEnabled = false;
+
+	double sections[(int)ReplaySection_e::TOTAL_COUNT];
+	double sectionsSum = 0;
+	uint64_t scopes = 0;
+	for (int i = 0; i < (int)ReplaySection_e::TOTAL_COUNT; ++i)
+	{
+		sections[i] = std::max(0.0, ReplayProfile::ns[i] - ReplayProfile::calls[i] * insideNs);
+		sectionsSum += sections[i];
+		scopes += ReplayProfile::calls[i];
+	}
+	if (scopes == 0)
+	{
+		std::cout << "  split: not available, build with -DSDD_REPLAY_PROFILE=1" << std::endl;
+		return;
+	}
+	double total = std::max(sectionsSum, result.handlerNs - scopes * totalNs);
+	std::cout << "  split:" << std::fixed << std::setprecision(1);
+	for (int i = 0; i < (int)ReplaySection_e::TOTAL_COUNT; ++i)
+		std::cout << " " << ReplayProfile::GetSectionName((ReplaySection_e)i) << " " << (total > 0 ? 100.0 * sections[i] / total : 0) << "%";
+	std::cout << " dispatch " << (total > 0 ? 100.0 * (total - sectionsSum) / total : 0) << "%" << std::endl;
+}
+
+// Compares the SHR expansion kernels in use against the scalar ones, on random lines
+// with runs of 0 pixels and at random starting bytes. Returns the number of mismatches.
+static uint32_t check_shr_expand_kernels(uint32_t count)
+{
+	uint32_t mismatches = 0;
+	uint8_t palette[512];
+	for (auto& b : palette)
+		b = (uint8_t)std::rand();
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		uint8_t line[_A2VIDEO_SHR_BYTES_PER_LINE];
+		int zeroOdds = std::rand() % 4;		// from no 0 pixel forced to mostly 0 pixels
+		for (auto& b : line)
+		{
+			b = (uint8_t)std::rand();
+			if (zeroOdds > 0 && (std::rand() % 4) < zeroOdds)
+				b &= ((std::rand() & 1) ? 0xF0 : 0x0F);
+			if (zeroOdds > 1 && (std::rand() % 4) < zeroOdds)
+				b = 0;
+		}
+		uint32_t xfb = std::rand() % _A2VIDEO_SHR_BYTES_PER_LINE;
+		uint32_t byteCount = 1 + std::rand() % (_A2VIDEO_SHR_BYTES_PER_LINE - xfb);
+		uint8_t prevPixel = (xfb != 0) ? (line[xfb - 1] & 0x0F) : 0;
+
+		uint8_t lineTest[_A2VIDEO_SHR_BYTES_PER_LINE];
+		std::memcpy(lineTest, line, sizeof(line));
+		shr_colorfill(lineTest + xfb, byteCount, prevPixel);
+		shr_colorfill_scalar(line + xfb, byteCount, prevPixel);
+		if (std::memcmp(lineTest, line, sizeof(line)) != 0)
+			++mismatches;
+
+		uint8_t colors[_A2VIDEO_SHR_BYTES_PER_LINE * 2];
+		uint8_t colorsTest[_A2VIDEO_SHR_BYTES_PER_LINE * 2];
+		shr_pal256_expand(line + xfb, byteCount, palette, colorsTest);
+		shr_pal256_expand_scalar(line + xfb, byteCount, palette, colors);
+		if (std::memcmp(colorsTest, colors, byteCount * 2) != 0)
+			++mismatches;
+	}
+	return mismatches;
+}
+
+// Compares the legacy interleave kernel in use with the scalar one, on count random runs of a line's cycles
+static uint32_t check_legacy_expand_kernel(uint32_t count)
+{
+	uint32_t mismatches = 0;
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		uint8_t mem[CYCLES_SC_CONTENT];
+		uint8_t memAux[CYCLES_SC_CONTENT];
+		for (uint32_t i = 0; i < CYCLES_SC_CONTENT; ++i)
+		{
+			mem[i] = (uint8_t)std::rand();
+			memAux[i] = (uint8_t)std::rand();
+		}
+		uint32_t xStart = std::rand() % CYCLES_SC_CONTENT;
+		uint32_t cycleCount = 1 + std::rand() % (CYCLES_SC_CONTENT - xStart);
+		uint8_t flags = (uint8_t)std::rand();
+		uint8_t colors = (uint8_t)std::rand();
+
+		uint8_t vram[CYCLES_SC_CONTENT * 4];
+		uint8_t vramTest[CYCLES_SC_CONTENT * 4];
+		legacy_cycles_interleave(vramTest, mem + xStart, memAux + xStart, cycleCount, flags, colors);
+		legacy_cycles_interleave_scalar(vram, mem + xStart, memAux + xStart, cycleCount, flags, colors);
+		if (std::memcmp(vramTest, vram, cycleCount * 4) != 0)
+			++mismatches;
+	}
+	return mismatches;
+}
+
+// Times count memory writes through MemoryManager::WriteToMemory(), spread over the
+// text and graphics pages as a program drawing would. For comparison, the same writes
+// are also timed with a timestamp stored for every byte, as the write tracking used to do.
+static void bench_memory_writes(uint32_t count)
+{
+	auto memMgr = MemoryManager::GetInstance();
+	auto cycleCounter = CycleCounter::GetInstance();
+	std::vector<uint16_t> addrs(4096);
+	for (auto& addr : addrs)
+		addr = (uint16_t)(0x400 + std::rand() % (0xA000 - 0x400));
+
+	auto _tstart = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		memMgr->WriteToMemory(addrs[i % addrs.size()], (uint8_t)i, false, false);
+		if ((i % 17030) == 0)		// a frame's worth of cycles
+			memMgr->AdvanceWriteEpoch((i / 17030) * 16'667);
+	}
+	double trackedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count();
+
+	std::vector<uint8_t> mem(_A2_MEMORY_SHADOW_END * 2);
+	std::vector<size_t> lastUpdate(_A2_MEMORY_SHADOW_END * 2);
+	_tstart = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		auto addr = addrs[i % addrs.size()];
+		mem[addr] = (uint8_t)i;
+		lastUpdate[addr] = cycleCounter->GetCycleTimestamp();
+	}
+	double timestampNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count();
+	volatile uint8_t sink = mem[addrs[0]] + (uint8_t)lastUpdate[addrs[0]];
+	(void)sink;
+
+	std::cout << std::fixed << std::setprecision(1) << count << " memory writes: "
+		<< (count / trackedNs * 1000.0) << " M/s with the page and bitset tracking, "
+		<< (count / timestampNs * 1000.0) << " M/s with per-byte timestamps" << std::endl;
+}
+
+// Sets the softswitches and the IIgs colors to a random state
+static void randomize_softswitches(MemoryManager* memMgr)
+{
+	for (uint32_t ss = A2SS_80STORE; ss <= A2SS_GREYSCALE; ss <<= 1)
+		memMgr->SetSoftSwitch((A2SoftSwitch_e)ss, (std::rand() & 1) != 0);
+	memMgr->switch_c022 = std::rand() & 0xFF;
+	memMgr->switch_c034 = std::rand() & 0xFF;
+}
+
+// Compares the softswitch action table against the original decoder, for every $C0xx
+// address, read and write, in both machine modes, with values that hit all the bits
+// they look at and from random starting states. Returns the number of mismatches.
+static uint32_t check_softswitch_table()
+{
+	auto memMgr = MemoryManager::GetInstance();
+	const uint8_t values[] = { 0x00, 0x20, 0x21, 0x40, 0x7F, 0x80, 0xA0, 0xA1, 0xE0, 0xFF };
+	uint32_t mismatches = 0;
+	for (uint32_t iigs = 0; iigs < 2; ++iigs)
+	{
+		for (uint32_t rw = 0; rw < 2; ++rw)
+		{
+			for (uint32_t addr = 0xC000; addr < 0xC100; ++addr)
+			{
+				for (uint32_t n = 0; n < 16; ++n)
+				{
+					for (auto val : values)
+					{
+						randomize_softswitches(memMgr);
+						auto before = memMgr->SerializeSwitches();
+						memMgr->ProcessSoftSwitchReference((uint16_t)addr, val, rw != 0, iigs != 0);
+						auto expected = memMgr->SerializeSwitches();
+						memMgr->DeserializeSwitches(before);
+						bool bVideoChanged = memMgr->ProcessSoftSwitch((uint16_t)addr, val, rw != 0, iigs != 0);
+						auto result = memMgr->SerializeSwitches();
+						// The beam only skips catching up on events that can't change the display
+						bool bIsVideo = memMgr->IsVideoSoftSwitch((uint16_t)addr, rw != 0, iigs != 0);
+						if ((result != expected) || (bVideoChanged && !bIsVideo))
+						{
+							if (mismatches < 10)
+								std::cerr << "Softswitch mismatch at $" << std::hex << addr << " rw " << rw
+									<< " value " << (uint32_t)val << " iigs " << iigs << std::dec << std::endl;
+							++mismatches;
+						}
+					}
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Times the softswitch decoders on the $C0xx events of the recordings
+static void bench_softswitches(const std::vector<std::filesystem::path>& files)
+{
+	std::vector<SDHREvent> events;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			continue;
+		for (const auto& e : EventRecorder::GetInstance()->GetEvents())
+		{
+			if ((e.addr >> 8) == 0xC0)
+				events.push_back(e);
+		}
+	}
+	if (events.empty())
+	{
+		std::cerr << "ERROR: No softswitch events in the recordings" << std::endl;
+		return;
+	}
+	auto memMgr = MemoryManager::GetInstance();
+	const uint32_t passes = std::max<uint32_t>(1, 50'000'000 / (uint32_t)events.size());
+	double decoderNs[2];
+	for (int d = 0; d < 2; ++d)
+	{
+		memMgr->Initialize();
+		auto _tstart = std::chrono::steady_clock::now();
+		for (uint32_t p = 0; p < passes; ++p)
+		{
+			for (const auto& e : events)
+			{
+				if (d == 0)
+					memMgr->ProcessSoftSwitchReference(e.addr, e.data, e.rw, e.is_iigs);
+				else
+					memMgr->ProcessSoftSwitch(e.addr, e.data, e.rw, e.is_iigs);
+			}
+		}
+		decoderNs[d] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count()
+			/ ((double)passes * events.size());
+	}
+	uint64_t videoEvents = 0;
+	for (const auto& e : events)
+		videoEvents += memMgr->IsVideoSoftSwitch(e.addr, e.rw, e.is_iigs);
+	std::cout << std::fixed << std::setprecision(2) << events.size() << " softswitch events: switch "
+		<< decoderNs[0] << " ns/event, table " << decoderNs[1] << " ns/event, "
+		<< (100.0 * videoEvents / events.size()) << "% of them make the beam catch up" << std::endl;
+}
+
+// Stands in for a GL texture that the DirtyRowTracker uploads to: records the glTexSubImage2D() calls
+// and applies them to a copy of the texels, so that it holds what the GPU would.
+struct RecordedTexture {
+	struct Call { uint32_t y; uint32_t count; };
+	std::vector<uint8_t> texels;
+	std::vector<Call> calls;
+	uint32_t rowBytes = 0;
+	uint32_t rowCount = 0;
+	uint64_t bytesUploaded = 0;
+
+	void TexImage2D(uint32_t _rowBytes, uint32_t _rowCount, const uint8_t* pixels)
+	{
+		rowBytes = _rowBytes;
+		rowCount = _rowCount;
+		texels.assign(pixels, pixels + (size_t)rowBytes * rowCount);
+		bytesUploaded += texels.size();
+	}
+	void TexSubImage2D(uint32_t y, uint32_t count, const uint8_t* pixels)
+	{
+		calls.push_back({ y, count });
+		if ((y + count) <= rowCount)
+			std::memcpy(texels.data() + (size_t)y * rowBytes, pixels, (size_t)count * rowBytes);
+		bytesUploaded += (size_t)count * rowBytes;
+	}
+};
+
+// Uploads data to the texture like the beam windows do: the whole of it when the texture is created,
+// then through the tracker. Returns the number of errors: the texture doesn't end up as data,
+// or the calls are out of bounds, overlap, are out of order, or have clean gaps they should have merged.
+static uint32_t upload_and_check(RecordedTexture& texture, DirtyRowTracker& tracker, const uint8_t* data,
+	uint32_t rowBytes, uint32_t rowCount)
+{
+	if (texture.texels.empty())
+	{
+		texture.TexImage2D(rowBytes, rowCount, data);
+		tracker.Invalidate();
+	}
+	texture.calls.clear();
+	size_t bytes = tracker.Upload(data, rowBytes, rowCount, [&](uint32_t y, uint32_t count) {
+		texture.TexSubImage2D(y, count, data + (size_t)y * rowBytes);
+	});
+	uint32_t errors = 0;
+	size_t callBytes = 0;
+	for (size_t i = 0; i < texture.calls.size(); ++i)
+	{
+		const auto& call = texture.calls[i];
+		callBytes += (size_t)call.count * rowBytes;
+		if ((call.count == 0) || ((call.y + call.count) > rowCount))
+			++errors;
+		if ((i > 0) && (call.y <= (texture.calls[i - 1].y + texture.calls[i - 1].count + DIRTYROWS_MAX_MERGE_GAP)))
+			++errors;
+	}
+	if ((bytes != callBytes) || (std::memcmp(texture.texels.data(), data, (size_t)rowBytes * rowCount) != 0))
+		++errors;
+	return errors;
+}
+
+// Checks that the partial uploads of the DirtyRowTracker cover every changed row, first on synthetic
+// changes at the edges and around the merge gap, then on the legacy, SHR and PAL256 vrams of every
+// frame of the recordings. Returns the number of errors.
+static uint32_t check_vram_uploads(const std::vector<std::filesystem::path>& files, const std::vector<ReplayVariant>& variants)
+{
+	uint32_t errors = 0;
+	{
+		const uint32_t rowBytes = 24;
+		const uint32_t rowCount = 64;
+		std::vector<uint8_t> data(rowBytes * rowCount, 0);
+		RecordedTexture texture;
+		DirtyRowTracker tracker;
+		errors += upload_and_check(texture, tracker, data.data(), rowBytes, rowCount);
+		std::srand(1);
+		for (uint32_t n = 0; n < 10'000; ++n)
+		{
+			// A few changed rows, often the first and last, and pairs separated by the merge gap and one more
+			uint32_t changes = std::rand() % 4;
+			for (uint32_t c = 0; c < changes; ++c)
+			{
+				uint32_t y = std::rand() % rowCount;
+				switch (std::rand() % 4)
+				{
+				case 0: y = (std::rand() & 1) ? 0 : (rowCount - 1); break;
+				case 1:
+					if (y + DIRTYROWS_MAX_MERGE_GAP + 2 < rowCount)
+						++data[(y + DIRTYROWS_MAX_MERGE_GAP + 1 + (std::rand() & 1)) * rowBytes + std::rand() % rowBytes];
+					break;
+				default: break;
+				}
+				++data[y * rowBytes + std::rand() % rowBytes];
+			}
+			errors += upload_and_check(texture, tracker, data.data(), rowBytes, rowCount);
+		}
+		if (errors > 0)
+			std::cerr << "Synthetic uploads: " << errors << " error(s)" << std::endl;
+	}
+
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+		{
+			++errors;
+			continue;
+		}
+		const auto& recordedEvents = EventRecorder::GetInstance()->GetEvents();
+		for (const auto& variant : variants)
+		{
+			const std::vector<SDHREvent> mergedEvents = (variant.bMerged ? make_merged_events(recordedEvents) : std::vector<SDHREvent>());
+			const auto& events = (variant.bMerged ? mergedEvents : recordedEvents);
+			RecordedTexture textures[3];
+			DirtyRowTracker trackers[3];
+			uint32_t fileErrors = 0;
+			uint64_t fullBytes = 0;
+			ReplayResult result;
+			replay_events(events, result, nullptr, variant.bPAL, [&](const A2VideoManager::BeamRenderVRAMs* frame) {
+				if ((frame->mode == A2Mode_e::LEGACY) || (frame->mode == A2Mode_e::MERGED))
+				{
+					uint32_t rowBytes = a2VideoMgr->GetVramWidthLegacy() * 4;
+					uint32_t rowCount = a2VideoMgr->GetVramHeightLegacy() * _INTERLACE_MULTIPLIER;
+					fileErrors += upload_and_check(textures[0], trackers[0], frame->vram_legacy, rowBytes, rowCount);
+					fullBytes += (uint64_t)rowBytes * rowCount;
+				}
+				if ((frame->mode == A2Mode_e::SHR) || (frame->mode == A2Mode_e::MERGED))
+				{
+					uint32_t rowBytes = a2VideoMgr->GetVramWidthSHR();
+					uint32_t rowCount = a2VideoMgr->GetVramHeightSHR() * _INTERLACE_MULTIPLIER;
+					fileErrors += upload_and_check(textures[1], trackers[1], frame->vram_shr, rowBytes, rowCount);
+					fullBytes += (uint64_t)rowBytes * rowCount;
+					if (frame->frameSHR4Modes & A2_VSM_SHR4PAL256)
+					{
+						rowBytes = _A2VIDEO_SHR_BYTES_PER_LINE * 2;
+						rowCount = _A2VIDEO_SHR_SCANLINES * _INTERLACE_MULTIPLIER;
+						fileErrors += upload_and_check(textures[2], trackers[2], frame->vram_pal256, rowBytes, rowCount);
+						fullBytes += (uint64_t)rowBytes * rowCount;
+					}
+				}
+			});
+			uint64_t bytesUploaded = textures[0].bytesUploaded + textures[1].bytesUploaded + textures[2].bytesUploaded;
+			std::cout << path.generic_string() << variant.suffix << ": " << result.frames << " frames, "
+				<< std::fixed << std::setprecision(1) << (fullBytes ? (100.0 * bytesUploaded / fullBytes) : 0.0)
+				<< "% of the vram bytes uploaded" << (fileErrors ? ", UPLOAD ERRORS" : "") << std::endl;
+			errors += fileErrors;
+		}
+	}
+	return errors;
+}
+
+// Compares what process_single_event() does with every possible event through the class table
+// and through the original chain of address compares. Returns the number of mismatches.
+static uint32_t check_event_classes()
+{
+	uint32_t mismatches = 0;
+	for (uint32_t iigs = 0; iigs < 2; ++iigs)
+	{
+		for (uint32_t rw = 0; rw < 2; ++rw)
+		{
+			for (uint32_t addr = 0; addr < 0x10000; ++addr)
+			{
+				uint8_t dispatch = get_event_dispatch((uint16_t)addr, rw != 0, iigs != 0);
+				uint8_t expected = get_event_dispatch_reference((uint16_t)addr, rw != 0, iigs != 0);
+				if (dispatch != expected)
+				{
+					if (mismatches < 10)
+						std::cerr << "Event class mismatch at $" << std::hex << addr << " rw " << rw << " iigs " << iigs
+							<< ": " << (uint32_t)dispatch << " instead of " << (uint32_t)expected << std::dec << std::endl;
+					++mismatches;
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Times the class table and the chain of address compares on the events of the recordings
+static void bench_event_classes(const std::vector<std::filesystem::path>& files)
+{
+	std::vector<SDHREvent> events;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			continue;
+		const auto& recording = EventRecorder::GetInstance()->GetEvents();
+		events.insert(events.end(), recording.begin(), recording.end());
+	}
+	if (events.empty())
+	{
+		std::cerr << "ERROR: No events in the recordings" << std::endl;
+		return;
+	}
+	const uint32_t passes = std::max<uint32_t>(1, 100'000'000 / (uint32_t)events.size());
+	double classifierNs[2];
+	uint64_t sink = 0;
+	for (int d = 0; d < 2; ++d)
+	{
+		auto _tstart = std::chrono::steady_clock::now();
+		for (uint32_t p = 0; p < passes; ++p)
+		{
+			for (const auto& e : events)
+			{
+				if (d == 0)
+					sink += get_event_dispatch_reference(e.addr, e.rw, e.is_iigs);
+				else
+					sink += get_event_dispatch(e.addr, e.rw, e.is_iigs);
+			}
+		}
+		classifierNs[d] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count()
+			/ ((double)passes * events.size());
+	}
+	volatile uint64_t _sink = sink;
+	(void)_sink;
+	std::cout << std::fixed << std::setprecision(2) << events.size() << " events: address compares "
+		<< classifierNs[0] << " ns/event, class table " << classifierNs[1] << " ns/event" << std::endl;
+}
+
+// Times the RAM snapshots of a 30 second recording: the recording is replayed in a loop up to
+// 30M cycles, with a snapshot every RECORDER_MEM_SNAPSHOT_CYCLES like EventRecorder::RecordEvent().
+// Each snapshot is compared with the full 128k copy that the snapshots used to be.
+static void bench_ram_snapshots(const std::filesystem::path& path)
+{
+	if (!load_recording(path))
+		return;
+	auto eventRecorder = EventRecorder::GetInstance();
+	const std::vector<SDHREvent> events = eventRecorder->GetEvents();
+	if (events.empty())
+	{
+		std::cerr << "ERROR: No events in " << path.generic_string() << std::endl;
+		return;
+	}
+	auto memMgr = MemoryManager::GetInstance();
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	auto sdhrMgr = SDHRManager::GetInstance();
+	reset_machine();
+	eventRecorder->ClearRAMSnapshots();
+
+	const size_t totalCycles = 30'000'000;
+	ByteBuffer fullCopy(RECORDER_TOTALMEMSIZE);
+	double makeUs = 0, makeWorstUs = 0, fullCopyUs = 0;
+	for (size_t i = 0; i < totalCycles; ++i)
+	{
+		if ((i % RECORDER_MEM_SNAPSHOT_CYCLES) == 0)
+		{
+			auto _t0 = std::chrono::steady_clock::now();
+			eventRecorder->MakeRAMSnapshot(i);
+			auto _t1 = std::chrono::steady_clock::now();
+			fullCopy.copyFrom(memMgr->GetApple2MemPtr(), 0, _A2_MEMORY_SHADOW_END);
+			fullCopy.copyFrom(memMgr->GetApple2MemAuxPtr(), 0x10000, _A2_MEMORY_SHADOW_END);
+			auto _t2 = std::chrono::steady_clock::now();
+			double _us = std::chrono::duration<double, std::micro>(_t1 - _t0).count();
+			makeUs += _us;
+			makeWorstUs = std::max(makeWorstUs, _us);
+			fullCopyUs += std::chrono::duration<double, std::micro>(_t2 - _t1).count();
+		}
+		SDHREvent e = events[i % events.size()];
+		process_single_event(e);
+		if (sdhrMgr->dataState == DATASTATE_e::DATA_UPDATED)
+			sdhrMgr->dataState = DATASTATE_e::DATA_IDLE;
+		a2VideoMgr->AcquireHeadlessFrame();
+	}
+	const size_t count = eventRecorder->GetRAMSnapshotCount();
+
+	// Seeking applies the snapshot before the requested event
+	double seekUs = 0, seekFullCopyUs = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto _t0 = std::chrono::steady_clock::now();
+		eventRecorder->ApplyRAMSnapshot(i);
+		auto _t1 = std::chrono::steady_clock::now();
+		fullCopy.copyTo(memMgr->GetApple2MemPtr(), 0, _A2_MEMORY_SHADOW_END);
+		fullCopy.copyTo(memMgr->GetApple2MemAuxPtr(), 0x10000, _A2_MEMORY_SHADOW_END);
+		auto _t2 = std::chrono::steady_clock::now();
+		seekUs += std::chrono::duration<double, std::micro>(_t1 - _t0).count();
+		seekFullCopyUs += std::chrono::duration<double, std::micro>(_t2 - _t1).count();
+	}
+
+	std::cout << std::fixed << std::setprecision(1) << count << " RAM snapshots over " << totalCycles << " cycles of "
+		<< path.generic_string() << "\n"
+		<< "  creation: " << (makeUs / count) << " us average, " << makeWorstUs << " us worst (full copy "
+		<< (fullCopyUs / count) << " us)\n"
+		<< "  memory: " << (eventRecorder->GetRAMSnapshotsBytes() / 1024.0) << " KB (full copies "
+		<< (count * RECORDER_TOTALMEMSIZE / 1024.0) << " KB)\n"
+		<< "  seek: " << (seekUs / count) << " us average (full copy " << (seekFullCopyUs / count) << " us)" << std::endl;
+}
+
+// Records snapshots of each recording like EventRecorder::RecordEvent(), but every 250k cycles, with
+// the machine reset in the middle of the recording. Each snapshot must have the memory that a full
+// copy made at the same time has. Returns the number of mismatches.
+static uint32_t check_ram_snapshots(const std::vector<std::filesystem::path>& files)
+{
+	constexpr size_t snapshotCycles = 250'000;
+	constexpr size_t totalCycles = 4'000'000;
+	constexpr size_t resetCycle = 2'100'000;
+	auto eventRecorder = EventRecorder::GetInstance();
+	auto memMgr = MemoryManager::GetInstance();
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	auto sdhrMgr = SDHRManager::GetInstance();
+	uint32_t mismatches = 0;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			return mismatches + 1;
+		const std::vector<SDHREvent> events = eventRecorder->GetEvents();
+		if (events.empty())
+			continue;
+		reset_machine();
+		eventRecorder->ClearRAMSnapshots();
+		std::vector<std::vector<uint8_t>> fullCopies;
+		for (size_t i = 0; i < totalCycles; ++i)
+		{
+			if (i == resetCycle)
+				memMgr->Initialize();
+			if ((i % snapshotCycles) == 0)
+			{
+				eventRecorder->MakeRAMSnapshot(i);
+				const uint8_t* pMem = memMgr->GetApple2MemPtr();
+				fullCopies.emplace_back(pMem, pMem + 2 * _A2_MEMORY_SHADOW_END);
+			}
+			SDHREvent e = events[i % events.size()];
+			process_single_event(e);
+			if (sdhrMgr->dataState == DATASTATE_e::DATA_UPDATED)
+				sdhrMgr->dataState = DATASTATE_e::DATA_IDLE;
+			a2VideoMgr->AcquireHeadlessFrame();
+		}
+		uint32_t fileMismatches = 0;
+		for (size_t i = 0; i < fullCopies.size(); ++i)
+		{
+			eventRecorder->ApplyRAMSnapshot(i);
+			const uint8_t* pMem = memMgr->GetApple2MemPtr();
+			if (std::memcmp(pMem, fullCopies[i].data(), 2 * _A2_MEMORY_SHADOW_END) != 0)
+				++fileMismatches;
+		}
+		std::cout << (fileMismatches == 0 ? "ok       " : "MISMATCH ") << fileMismatches << "/" << fullCopies.size()
+			<< " snapshots  " << path.generic_string() << std::endl;
+		mismatches += fileMismatches;
+	}
+	eventRecorder->ClearRAMSnapshots();
+	return mismatches;
+}
+
+// What a loaded recording replays: its events, and the memory and softswitches of each snapshot
+struct RecordingContents {
+	std::vector<SDHREvent> events;
+	std::vector<std::vector<uint8_t>> ram;
+	std::vector<std::string> switches;
+};
+
+static RecordingContents capture_recording()
+{
+	auto eventRecorder = EventRecorder::GetInstance();
+	auto memMgr = MemoryManager::GetInstance();
+	RecordingContents contents;
+	contents.events = eventRecorder->GetEvents();
+	for (size_t i = 0; i < eventRecorder->GetRAMSnapshotCount(); ++i)
+	{
+		// Snapshots without softswitches leave them as initialized
+		memMgr->Initialize();
+		eventRecorder->ApplyRAMSnapshot(i);
+		const uint8_t* pMem = memMgr->GetApple2MemPtr();
+		contents.ram.emplace_back(pMem, pMem + 2 * _A2_MEMORY_SHADOW_END);
+		contents.switches.push_back(memMgr->SerializeSwitches());
+	}
+	return contents;
+}
+
+// Counts the differences between a recording and its reload. v1 files drop m2sel and the softswitches.
+static uint32_t compare_recordings(const RecordingContents& expected, const RecordingContents& result, bool bIsV1)
+{
+	uint32_t mismatches = 0;
+	if (expected.events.size() != result.events.size())
+		++mismatches;
+	else
+	{
+		const uint32_t mask = (bIsV1 ? ~(1u << 26) : ~0u);
+		for (size_t i = 0; i < expected.events.size(); ++i)
+		{
+			if ((vcr_pack_event(expected.events[i]) & mask) != (vcr_pack_event(result.events[i]) & mask))
+				++mismatches;
+		}
+	}
+	// v1 files store as many snapshots as the events need
+	if (expected.events.empty() && bIsV1)
+		return mismatches;
+	if (expected.ram.size() != result.ram.size())
+		return mismatches + 1;
+	for (size_t i = 0; i < expected.ram.size(); ++i)
+	{
+		if (expected.ram[i] != result.ram[i])
+			++mismatches;
+		if (!bIsV1 && (expected.switches[i] != result.switches[i]))
+			++mismatches;
+	}
+	return mismatches;
+}
+
+// Checks that every recording reloads the same from v2 files with each codec and from v1 files,
+// and that random events go through the v2 blocks and keyframes unchanged, seeking included.
+// Returns the number of mismatches.
+static uint32_t check_vcr_files(const std::vector<std::filesystem::path>& files)
+{
+	auto eventRecorder = EventRecorder::GetInstance();
+	uint32_t mismatches = 0;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			return mismatches + 1;
+		const auto expected = capture_recording();
+		const char* formats[] = { "v2 lz4", "v2 zlib", "v1" };
+		for (int f = 0; f < 3; ++f)
+		{
+			if (!load_recording(path))
+				return mismatches + 1;
+			std::stringstream stream;
+			if (f == 2)
+				eventRecorder->WriteRecordingFileV1(stream);
+			else
+				eventRecorder->WriteRecordingFile(stream, (f == 0) ? VcrCodec_e::LZ4 : VcrCodec_e::ZLIB);
+			uint32_t fileMismatches = 0;
+			try {
+				eventRecorder->ReadRecordingFile(stream);
+				fileMismatches = compare_recordings(expected, capture_recording(), f == 2);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "ERROR: " << e.what() << std::endl;
+				fileMismatches = 1;
+			}
+			if (fileMismatches > 0)
+				std::cerr << "Recording mismatch: " << path.generic_string() << " through " << formats[f] << std::endl;
+			mismatches += fileMismatches;
+		}
+	}
+
+	std::srand(1);
+	for (int codec = 0; codec < 3; ++codec)
+	{
+		std::vector<SDHREvent> events;
+		for (uint32_t i = 0; i < 300'000; ++i)
+			events.push_back(vcr_unpack_event(((uint32_t)std::rand() << 16 | (uint32_t)std::rand()) & 0x0FFFFFFF));
+		std::vector<VcrKeyframe> keyframes(3);
+		for (auto& keyframe : keyframes)
+		{
+			keyframe.ram.resize(2 * _A2_MEMORY_SHADOW_END);
+			for (auto& b : keyframe.ram)
+				b = (uint8_t)(std::rand() & 3);
+			keyframe.state = MemoryManager::GetInstance()->SerializeSwitches();
+		}
+		VcrHeader header;
+		header.keyframeCycles = 100'000;
+		std::stringstream stream;
+		vcr_write(stream, header, events, keyframes, (VcrCodec_e)codec);
+		try {
+			VcrReader reader(stream);
+			for (uint32_t n = 0; n < 100; ++n)
+			{
+				uint64_t cycle = (uint64_t)std::rand() % events.size();
+				std::vector<SDHREvent> block;
+				uint64_t first = reader.ReadBlockAt(cycle, block);
+				if ((cycle < first) || ((cycle - first) >= block.size())
+					|| (vcr_pack_event(block[cycle - first]) != vcr_pack_event(events[cycle])))
+					++mismatches;
+			}
+			for (size_t i = 0; i < keyframes.size(); ++i)
+			{
+				auto keyframe = reader.ReadKeyframe(i);
+				if ((keyframe.ram != keyframes[i].ram) || (keyframe.state != keyframes[i].state))
+					++mismatches;
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			++mismatches;
+		}
+	}
+	return mismatches;
+}
+
+// Times saving and loading each recording in memory, in v1 and in v2 with each codec
+static void bench_vcr_files(const std::vector<std::filesystem::path>& files)
+{
+	auto eventRecorder = EventRecorder::GetInstance();
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			continue;
+		const size_t count = eventRecorder->GetEvents().size();
+		std::cout << path.generic_string() << ": " << count << " events" << std::endl;
+		const char* formats[] = { "v1", "v2 lz4", "v2 zlib" };
+		for (int f = 0; f < 3; ++f)
+		{
+			std::stringstream stream;
+			auto _t0 = std::chrono::steady_clock::now();
+			if (f == 0)
+				eventRecorder->WriteRecordingFileV1(stream);
+			else
+				eventRecorder->WriteRecordingFile(stream, (f == 1) ? VcrCodec_e::LZ4 : VcrCodec_e::ZLIB);
+			auto _t1 = std::chrono::steady_clock::now();
+			const size_t size = stream.str().size();
+			eventRecorder->ReadRecordingFile(stream);
+			auto _t2 = std::chrono::steady_clock::now();
+			double saveMs = std::chrono::duration<double, std::milli>(_t1 - _t0).count();
+			double loadMs = std::chrono::duration<double, std::milli>(_t2 - _t1).count();
+			std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(8) << formats[f] << ": "
+				<< (size / 1024.0) << " KB, save " << saveMs << " ms (" << (count / 1000.0 / std::max(saveMs, 0.001))
+				<< " M events/s), load " << loadMs << " ms (" << (count / 1000.0 / std::max(loadMs, 0.001))
+				<< " M events/s)" << std::endl;
+		}
+	}
+}
+
+// Streams count events of the recordings, looped, to segment files in the temp directory as fast as
+// possible, once within the budget and once in a rolling window of 3 segments. Reports the recording
+// speed, the worst time of 4096 events, and the drops, then checks the replay from the segments
+// against the events that weren't dropped. Returns the number of mismatches.
+static uint32_t bench_stream_recorder(const std::vector<std::filesystem::path>& files, uint64_t count)
+{
+	std::vector<SDHREvent> events;
+	for (const auto& path : files)
+	{
+		if (load_recording(path))
+		{
+			const auto& _ev = EventRecorder::GetInstance()->GetEvents();
+			events.insert(events.end(), _ev.begin(), _ev.end());
+		}
+	}
+	if (events.empty())
+	{
+		std::cerr << "ERROR: No events in the recordings" << std::endl;
+		return 1;
+	}
+	const std::string directory = (std::filesystem::temp_directory_path() / "sdd_stream_bench").string();
+	// Close enough to the segment size for the budgets
+	const uint64_t segmentBytes = (uint64_t)STREAM_CHUNKS_PER_SEGMENT * (STREAM_KEYFRAME_RAM + STREAM_CHUNK_EVENTS * 4ull);
+	uint32_t mismatches = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const bool bRolling = (pass == 1);
+		StreamRecorder recorder;
+		if (!recorder.Start(directory, bRolling ? (7 * segmentBytes / 2) : (count * 5 + 2 * segmentBytes), bRolling, false))
+		{
+			std::cerr << "ERROR: " << recorder.GetError() << std::endl;
+			return mismatches + 1;
+		}
+		double worstUs = 0;
+		auto _tstart = std::chrono::steady_clock::now();
+		auto _tbatch = _tstart;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			recorder.RecordEvent(events[i % events.size()]);
+			if ((i & 4095) == 4095)
+			{
+				auto _tnow = std::chrono::steady_clock::now();
+				worstUs = std::max(worstUs, std::chrono::duration<double, std::micro>(_tnow - _tbatch).count());
+				_tbatch = _tnow;
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _tstart).count();
+		recorder.Stop();
+
+		uint64_t passMismatches = 0;
+		if (!recorder.Open(directory))
+		{
+			std::cerr << "ERROR: " << recorder.GetError() << std::endl;
+			passMismatches = 1;
+		}
+		for (uint64_t i = 0; i < recorder.GetEventCount(); ++i)
+		{
+			uint64_t streamIndex = recorder.GetStreamIndex(i / STREAM_CHUNK_EVENTS) + (i % STREAM_CHUNK_EVENTS);
+			if (vcr_pack_event(recorder.GetEvent(i)) != vcr_pack_event(events[streamIndex % events.size()]))
+				++passMismatches;
+		}
+		// Without drops, everything the window keeps is there
+		if ((recorder.GetDroppedEvents() == 0) && !bRolling && (recorder.GetEventCount() != count))
+			++passMismatches;
+		std::cout << std::fixed << std::setprecision(1) << (bRolling ? "Rolling window: " : "Within budget:  ")
+			<< (count / seconds / 1'000'000.0) << " M events/s, worst " << worstUs << " us per 4096 events, "
+			<< recorder.GetDroppedEvents() << " dropped, " << (recorder.GetBytesWritten() / (1024.0 * 1024.0)) << " MB written, "
+			<< recorder.GetEventCount() << " events replayed from " << recorder.GetKeyframeCount() << " chunks, "
+			<< passMismatches << " mismatch(es)" << std::endl;
+		recorder.Close();
+		mismatches += (uint32_t)std::min<uint64_t>(passMismatches, 1'000'000);
+	}
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+	return mismatches;
+}
+
+// The recordings and the sample images in a directory and its subdirectories
+static void add_directory_files(const std::filesystem::path& directory, std::vector<std::filesystem::path>& files)
+{
+	std::vector<std::filesystem::path> found;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, ec))
+	{
+		if (entry.is_regular_file() && (is_recording_file(entry.path()) || is_sample_file(entry.path())))
+			found.push_back(entry.path());
+	}
+	std::sort(found.begin(), found.end());
+	files.insert(files.end(), found.begin(), found.end());
+}
+
+// The Appletini messages of the recordings' events, cut in transfers like the ingest thread gets them.
+// Some transfers end in the tails that the processing thread counts and drops: garbage lengths,
+// messages longer than what's left, and messages of unknown versions or types.
+// Raw captures made with --capture are added as they are, in transfers of PKT_MAX_XFERSZ.
+struct DecodePackets {
+	std::vector<std::vector<uint8_t>> packets;
+	std::vector<uint32_t> eventWords;		// the words of the valid messages of the recordings, in order
+	uint64_t captureBytes = 0;
+};
+
+static void append_word(std::vector<uint8_t>& packet, uint32_t word)
+{
+	for (int b = 0; b < 4; ++b)
+		packet.push_back((uint8_t)(word >> (8 * b)));
+}
+
+static DecodePackets make_decode_packets(const std::vector<std::filesystem::path>& files, const std::vector<std::string>& captures)
+{
+	DecodePackets result;
+	std::srand(1);
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+			continue;
+		const auto& events = EventRecorder::GetInstance()->GetEvents();
+		std::vector<uint8_t> packet;
+		size_t i = 0;
+		while (i < events.size())
+		{
+			// Mostly full messages, like the Appletini sends when the bus is busy
+			size_t count = ((std::rand() % 4) == 0) ? (1 + std::rand() % (EVENTBATCH_MAX_EVENTS - 1)) : (EVENTBATCH_MAX_EVENTS - 1);
+			count = std::min(count, events.size() - i);
+			// With room for a skipped message and a tail
+			if (packet.size() + 4 * (count + 1) + 8 + 4 + 200 > PKT_MAX_XFERSZ)
+			{
+				result.packets.push_back(std::move(packet));
+				packet.clear();
+			}
+			// Messages the processing thread skips, and goes on after
+			if ((std::rand() % 64) == 0)
+			{
+				bool bBadVersion = (std::rand() & 1);
+				append_word(packet, (bBadVersion ? (2u << 24) | (1u << 16) : (1u << 24) | (7u << 16)) | 8);
+				append_word(packet, (uint32_t)std::rand());
+			}
+			append_word(packet, (1u << 24) | (1u << 16) | (uint32_t)(4 * (count + 1)));
+			for (size_t n = 0; n < count; ++n, ++i)
+			{
+				const auto& e = events[i];
+				uint32_t word = ((uint32_t)e.addr << 16) | ((uint32_t)e.data << 4) | (1u << 1) | (e.rw ? 1u : 0u);
+				append_word(packet, word);
+				result.eventWords.push_back(word);
+			}
+			// Tails that stop the processing of the transfer
+			if ((std::rand() % 128) == 0)
+			{
+				static const uint32_t garbageLengths[] = { 0, 1, 6, 1023, 1028, 0xFFFF };
+				if (std::rand() & 1)
+					append_word(packet, (1u << 24) | (1u << 16) | garbageLengths[std::rand() % 6]);
+				else
+					append_word(packet, (1u << 24) | (1u << 16) | 1024);	// truncated
+				size_t tail = std::rand() % 201;
+				for (size_t n = 0; n < tail; ++n)
+					packet.push_back((uint8_t)std::rand());
+				result.packets.push_back(std::move(packet));
+				packet.clear();
+			}
+		}
+		if (!packet.empty())
+			result.packets.push_back(std::move(packet));
+	}
+	for (const auto& capture : captures)
+	{
+		std::ifstream file(capture, std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cerr << "ERROR: Cannot open " << capture << std::endl;
+			continue;
+		}
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		for (size_t pos = 0; pos < data.size(); pos += PKT_MAX_XFERSZ)
+			result.packets.emplace_back(data.begin() + pos, data.begin() + std::min(data.size(), pos + PKT_MAX_XFERSZ));
+		result.captureBytes += data.size();
+	}
+	return result;
+}
+
+static bool batches_match(const SDHREventBatch& a, const SDHREventBatch& b)
+{
+	return (a.count == b.count)
+		&& (std::memcmp(a.addr, b.addr, a.count * sizeof(a.addr[0])) == 0)
+		&& (std::memcmp(a.data, b.data, a.count) == 0)
+		&& (std::memcmp(a.rw, b.rw, a.count) == 0)
+		&& (std::memcmp(a.reset, b.reset, a.count) == 0);
+}
+
+// Walks the messages of each transfer with the same rules as process_usb_events_thread(), from
+// unaligned buffers. Every message is decoded by decode_event_words() and the scalar decoder, and
+// the events of the recordings must come out as they went in. So must the words after a garbage or
+// truncated message, which are decoded too though they're dropped. Returns the number of mismatches.
+static uint32_t check_event_decoders(const DecodePackets& input)
+{
+	auto batch = std::make_unique<SDHREventBatch>();
+	auto batchScalar = std::make_unique<SDHREventBatch>();
+	std::vector<uint8_t> buffer(PKT_MAX_XFERSZ + 4);
+	uint64_t messages = 0, events = 0, skipped = 0, garbage = 0, truncated = 0, droppedBytes = 0;
+	size_t eventWord = 0;
+	uint32_t mismatches = 0;
+	auto check = [&](const uint8_t* words, size_t count) {
+		while (count > 0)
+		{
+			size_t n = std::min(count, EVENTBATCH_MAX_EVENTS);
+			decode_event_words(words, n, *batch);
+			decode_event_words_scalar(words, n, *batchScalar);
+			if (!batches_match(*batch, *batchScalar))
+				++mismatches;
+			words += 4 * n;
+			count -= n;
+		}
+	};
+	for (size_t pk = 0; pk < input.packets.size(); ++pk)
+	{
+		const auto& packet = input.packets[pk];
+		uint8_t* data = buffer.data() + 1 + (pk % 3);
+		std::memcpy(data, packet.data(), packet.size());
+		const uint8_t* end = data + packet.size();
+		const uint8_t* p = data;
+		while (p < end)
+		{
+			uint32_t hdr;
+			std::memcpy(&hdr, p, 4);
+			uint32_t len = hdr & 0xFFFF;
+			if (len == 0 || len > 1024 || (len % 4) != 0 || (p + len > end))
+			{
+				if (len == 0 || len > 1024 || (len % 4) != 0)
+					++garbage;
+				else
+					++truncated;
+				droppedBytes += end - p;
+				check(p, (end - p) / 4);
+				break;
+			}
+			if ((hdr >> 24) != 1 || ((hdr >> 16) & 0xFF) != 1)
+			{
+				++skipped;
+				p += len;
+				continue;
+			}
+			size_t count = (len / 4) - 1;
+			check(p + 4, count);
+			// The recordings' events, which come before those of the raw captures
+			decode_event_words(p + 4, count, *batch);
+			for (size_t n = 0; (n < count) && (eventWord < input.eventWords.size()); ++n)
+			{
+				uint32_t w = input.eventWords[eventWord++];
+				if ((batch->addr[n] != (uint16_t)(w >> 16)) || (batch->data[n] != (uint8_t)(w >> 4))
+					|| (batch->rw[n] != (w & 1)) || (batch->reset[n] != ((w >> 1) & 1)))
+					++mismatches;
+			}
+			++messages;
+			events += count;
+			p += len;
+		}
+	}
+	if (eventWord != input.eventWords.size())
+		++mismatches;
+	std::cout << input.packets.size() << " transfers, " << messages << " messages, " << events << " events, "
+		<< skipped << " skipped messages, " << garbage << " garbage and " << truncated << " truncated tails ("
+		<< droppedBytes << " bytes)" << std::endl;
+	return mismatches;
+}
+
+// Times both decoders on the valid messages of the transfers
+static void bench_event_decoders(const DecodePackets& input)
+{
+	std::vector<std::pair<const uint8_t*, size_t>> messages;
+	uint64_t events = 0;
+	for (const auto& packet : input.packets)
+	{
+		const uint8_t* p = packet.data();
+		const uint8_t* end = p + packet.size();
+		while (p < end)
+		{
+			uint32_t hdr;
+			std::memcpy(&hdr, p, 4);
+			uint32_t len = hdr & 0xFFFF;
+			if (len == 0 || len > 1024 || (len % 4) != 0 || (p + len > end))
+				break;
+			if ((hdr >> 24) == 1 && ((hdr >> 16) & 0xFF) == 1)
+			{
+				messages.emplace_back(p + 4, (len / 4) - 1);
+				events += (len / 4) - 1;
+			}
+			p += len;
+		}
+	}
+	if (events == 0)
+	{
+		std::cerr << "ERROR: No events to decode" << std::endl;
+		return;
+	}
+	auto batch = std::make_unique<SDHREventBatch>();
+	const uint32_t passes = std::max<uint32_t>(1, (uint32_t)(200'000'000 / events));
+	double decoderNs[2];
+	uint64_t sink = 0;
+	for (int d = 0; d < 2; ++d)
+	{
+		auto _tstart = std::chrono::steady_clock::now();
+		for (uint32_t pass = 0; pass < passes; ++pass)
+		{
+			for (const auto& message : messages)
+			{
+				if (d == 0)
+					decode_event_words_scalar(message.first, message.second, *batch);
+				else
+					decode_event_words(message.first, message.second, *batch);
+				sink += batch->addr[0];
+			}
+		}
+		decoderNs[d] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count();
+	}
+	volatile uint64_t _sink = sink;
+	(void)_sink;
+	const double total = (double)events * passes;
+	std::cout << std::fixed << std::setprecision(1) << events << " events in " << messages.size() << " messages: scalar "
+		<< (total / decoderNs[0] * 1000.0) << " M events/s, " << get_event_decoder_name() << " "
+		<< (total / decoderNs[1] * 1000.0) << " M events/s (" << std::setprecision(2) << (decoderNs[0] / decoderNs[1]) << "x)" << std::endl;
+}
+
+// Waits on a full or empty ring like the processing thread does: busy polls, then yields the CPU
+static void ring_wait(uint32_t& spins)
+{
+	if (++spins < 256)		// PKT_WAIT_SPINS
+		spsc_cpu_relax();
+	else
+		std::this_thread::yield();
+}
+
+// Times count packet indices going from one thread to another, through the SPSCRing of the
+// packet queues and through the ConcurrentQueue they replaced. Also checks the ring's order and
+// high-water mark. Returns the number of errors.
+static uint32_t bench_packet_rings(uint32_t count)
+{
+	constexpr size_t ringSize = 2048;		// PKT_RING_SIZE
+	uint32_t errors = 0;
+
+	// One at a time, the ring never holds more than 1
+	auto ring = std::make_unique<SPSCRing<uint32_t, ringSize>>();
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < 10 * ringSize; ++i)
+	{
+		ring->push(i);
+		if (!ring->pop(value) || (value != i))
+			++errors;
+	}
+	if (ring->max_size() != 1)
+	{
+		std::cerr << "ERROR: Ring high-water mark of " << ring->max_size() << " instead of 1" << std::endl;
+		++errors;
+	}
+	// Filled, then emptied, it held all of them
+	for (uint32_t i = 0; i < ringSize; ++i)
+		ring->push(i);
+	if (ring->push(0))
+		++errors;
+	while (ring->pop(value)) {}
+	if (ring->max_size() != ringSize)
+	{
+		std::cerr << "ERROR: Ring high-water mark of " << ring->max_size() << " instead of " << ringSize << std::endl;
+		++errors;
+	}
+	ring->clear();
+
+	auto _tstart = std::chrono::steady_clock::now();
+	std::thread producer([&ring, count]() {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t spins = 0;
+			while (!ring->push(i))
+				ring_wait(spins);
+		}
+	});
+	uint32_t outOfOrder = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t spins = 0;
+		while (!ring->pop(value))
+			ring_wait(spins);
+		outOfOrder += (value != i);
+	}
+	producer.join();
+	double ringNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count();
+	errors += outOfOrder;
+	const size_t ringMaxSize = ring->max_size();
+	if (ringMaxSize > ringSize)
+		++errors;
+
+	ConcurrentQueue<uint32_t> queue;
+	_tstart = std::chrono::steady_clock::now();
+	std::thread queueProducer([&queue, count]() {
+		for (uint32_t i = 0; i < count; ++i)
+			queue.push(uint32_t(i));
+	});
+	for (uint32_t i = 0; i < count; ++i)
+		outOfOrder += (queue.pop() != i);
+	queueProducer.join();
+	double queueNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _tstart).count();
+	errors += outOfOrder;
+
+	std::cout << std::fixed << std::setprecision(1) << count << " packets between 2 threads: SPSCRing "
+		<< (count / ringNs * 1000.0) << " M/s (" << (ringNs / count) << " ns each, high-water " << ringMaxSize << "), ConcurrentQueue "
+		<< (count / queueNs * 1000.0) << " M/s (" << (queueNs / count) << " ns each), " << errors << " error(s)" << std::endl;
+	return errors;
+}
+
+static std::vector<std::filesystem::path> default_recording_files()
+{
+	std::vector<std::filesystem::path> files;
+	add_directory_files("recordings", files);
+	add_directory_files("samples", files);
+	return files;
+}
+
+static std::map<std::string, uint64_t> read_golden_file(const std::string& goldenPath)
+{
+	std::map<std::string, uint64_t> goldens;
+	std::ifstream file(goldenPath);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream ss(line);
+		std::string hashStr, path;
+		uint64_t frames = 0;
+		ss >> hashStr >> frames;
+		std::getline(ss >> std::ws, path);
+		goldens[path] = std::stoull(hashStr, nullptr, 16);
+	}
+	return goldens;
+}
+
+static bool load_mode_texture(A2SoftRenderer& renderer, A2SoftRenderer::ModeTexture_e idx, const char* filename,
+	std::vector<std::vector<uint8_t>>& storage)
+{
+	int width;
+	int height;
+	int channels;
+	unsigned char* data = stbi_load(filename, &width, &height, &channels, 4);
+	if (data == NULL) {
+		std::cerr << "ERROR: STBI load failure: " << stbi_failure_reason() << std::endl;
+		std::cerr << "Tried loading: " << filename << std::endl;
+		return false;
+	}
+	storage.emplace_back(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+	renderer.SetModeTexture(idx, A2SoftTexture({ storage.back().data(), (uint32_t)width, (uint32_t)height }));
+	return true;
+}
+
+static void write_ppm(const std::filesystem::path& path, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << width << " " << height << "\n255\n";
+	for (size_t i = 0; i < rgba.size(); i += 4)
+		file.write(reinterpret_cast<const char*>(rgba.data() + i), 3);
+}
+
+// Replays every file and renders each of its frames on the CPU with A2SoftRenderer, from the vrams
+// that the beam built, with the uniforms that A2VideoManager::Render() gives the windows.
+// Merged frames render their legacy and SHR vrams separately. The image hashes of each file are
+// chained and compared with goldenPath, or written to it with bUpdate. Returns the number of failures.
+static uint32_t run_softrender(const std::vector<std::filesystem::path>& files, const std::string& goldenPath,
+	bool bUpdate, const std::string& dumpDir)
+{
+	A2SoftRenderer renderer;
+	std::vector<std::vector<uint8_t>> textureStorage;
+	textureStorage.reserve(A2SoftRenderer::MODETEX_TOTAL_COUNT);
+	bool bTexturesOk = load_mode_texture(renderer, A2SoftRenderer::MODETEX_FONT_REGULAR, "assets/Apple2eFont14x16/00_US-Regular.png", textureStorage)
+		&& load_mode_texture(renderer, A2SoftRenderer::MODETEX_FONT_ALTERNATE, "assets/Apple2eFont14x16/01_US-Alternate.png", textureStorage)
+		&& load_mode_texture(renderer, A2SoftRenderer::MODETEX_LGR, "assets/Texture_composite_lgr.png", textureStorage)
+		&& load_mode_texture(renderer, A2SoftRenderer::MODETEX_HGR, "assets/Texture_composite_hgr.png", textureStorage)
+		&& load_mode_texture(renderer, A2SoftRenderer::MODETEX_DHGR, "assets/Texture_composite_dhgr.png", textureStorage);
+	if (!bTexturesOk)
+		return 1;
+
+	auto a2VideoMgr = A2VideoManager::GetInstance();
+	std::map<std::string, uint64_t> goldens;
+	if (!bUpdate)
+		goldens = read_golden_file(goldenPath);
+	std::ostringstream goldenOut;
+	goldenOut << "# A2SoftRenderer hashes of the frames of the beam, default settings. Regenerate with: make softrender-update\n";
+	goldenOut << "# hash frames file\n";
+	uint32_t failures = 0;
+	uint64_t totalPixels = 0;
+	uint64_t totalNs = 0;
+	std::vector<uint8_t> rgba;
+	for (const auto& path : files)
+	{
+		std::string pathStr = path.generic_string();
+		if (!load_recording(path))
+		{
+			++failures;
+			continue;
+		}
+		renderer.hborder = (a2VideoMgr->GetVramWidthLegacy() - 40) / 2;
+		renderer.vborder = (a2VideoMgr->GetVramHeightLegacy() - 192) / 2;
+		uint64_t hash = 0;
+		uint32_t images = 0;
+		uint64_t pixels = 0;
+		uint64_t renderNs = 0;
+		uint32_t lastWidth = 0;
+		uint32_t lastHeight = 0;
+		auto addImage = [&](uint32_t width, uint32_t height) {
+			hash = hash_combine(hash, dirtyrows_hash_row(rgba.data(), rgba.size()));
+			++images;
+			pixels += (uint64_t)width * height;
+			lastWidth = width;
+			lastHeight = height;
+		};
+		ReplayResult result;
+		replay_events(EventRecorder::GetInstance()->GetEvents(), result, nullptr, false,
+			[&](const A2VideoManager::BeamRenderVRAMs* frame) {
+				if ((frame->mode == A2Mode_e::LEGACY) || (frame->mode == A2Mode_e::MERGED))
+				{
+					renderer.specialModesMask = (a2VideoMgr->bUseDHGRCOL140Mixed ? A2_VSM_DHGRCOL140Mixed : 0)
+						| (a2VideoMgr->bUseHGRSPEC1 ? A2_VSM_HGRSPEC1 : 0) | (a2VideoMgr->bUseHGRSPEC2 ? A2_VSM_HGRSPEC2 : 0);
+					auto tStart = ReplayProfile::Now();
+					renderer.RenderLegacy(frame->vram_legacy, rgba);
+					renderNs += ReplayProfile::Now() - tStart;
+					addImage(renderer.GetLegacyWidth(), renderer.GetLegacyHeight());
+				}
+				if ((frame->mode == A2Mode_e::SHR) || (frame->mode == A2Mode_e::MERGED))
+				{
+					renderer.specialModesMask = frame->frameSHR4Modes;
+					renderer.doubleSHR4Mode = frame->pagedMode;
+					auto tStart = ReplayProfile::Now();
+					renderer.RenderSHR(frame->vram_shr, frame->vram_pal256, rgba);
+					renderNs += ReplayProfile::Now() - tStart;
+					addImage(renderer.GetSHRWidth(), renderer.GetSHRHeight());
+				}
+			});
+		totalPixels += pixels;
+		totalNs += renderNs;
+		if (!dumpDir.empty() && (images > 0))
+			write_ppm(std::filesystem::path(dumpDir) / (path.filename().string() + ".ppm"), rgba, lastWidth, lastHeight);
+
+		std::ostringstream hashStr;
+		hashStr << std::hex << std::setw(16) << std::setfill('0') << hash;
+		goldenOut << hashStr.str() << " " << images << " " << pathStr << "\n";
+		std::string status;
+		if (!bUpdate)
+		{
+			auto it = goldens.find(pathStr);
+			if (it == goldens.end())
+				status = "NO GOLDEN";
+			else if (it->second == hash)
+				status = "ok";
+			else
+				status = "MISMATCH";
+			if (status != "ok")
+				++failures;
+		}
+		std::cout << hashStr.str() << " " << std::setw(5) << std::setfill(' ') << images << " images "
+			<< std::fixed << std::setprecision(1) << std::setw(8)
+			<< (renderNs > 0 ? (pixels * 1e3 / renderNs) : 0) << " Mpixels/s  "
+			<< pathStr << (status.empty() ? "" : "  ") << status << std::endl;
+	}
+	std::cout << "Total: " << files.size() << " files, " << std::fixed << std::setprecision(1)
+		<< (totalPixels / 1e6) << " Mpixels in " << std::setprecision(3) << (totalNs / 1e9) << " s, "
+		<< std::setprecision(1) << (totalNs > 0 ? (totalPixels * 1e3 / totalNs) : 0) << " Mpixels/s" << std::endl;
+	if (bUpdate)
+	{
+		std::ofstream file(goldenPath);
+		file << goldenOut.str();
+		std::cout << "Wrote " << goldenPath << std::endl;
+	}
+	return failures;
+}
+
+
+static void print_usage()
+{
+	std::cout << "Usage: sdd_bench_replay [options] [recording or directory...]\n"
+		"Replays .vcr, .csv, .shra and #C20000 recordings at full speed through the event handlers,\n"
+		"without a window, and shows the .lgr, .dgr, .hgr, .dhr, .shr and #C10000 sample images for\n"
+		"3 frames. Without any file, replays everything in recordings/ and samples/.\n"
+		"Run it from the SuperDuperDisplay directory.\n"
+		"  --repeat N        replay each recording N times and report the fastest (default 1)\n"
+		"  --batched         replay through process_event_batch() like the live pipeline, without the IIgs flags\n"
+		"  --pal             also replay each recording on a PAL machine\n"
+		"  --merged          also replay each recording flipping to SHR for lines 50 to 129 of every frame\n"
+		"  --no-split        skip the profiled pass that splits the time between the subsystems\n"
+		"  --shr-scalar      use the scalar SHR colorfill and PAL256 kernels instead of the SIMD ones\n"
+		"  --legacy-scalar   use the scalar legacy interleave kernel instead of the SIMD one\n"
+		"  --lazy-check      compare each frame of the lazy beam with the beam rendering every cycle, and exit\n"
+		"                    with --pal and --merged, also in those variants\n"
+		"  --shr-check       compare the SIMD SHR kernels against the scalar ones, and exit\n"
+		"  --legacy-check    compare the SIMD legacy kernel against the scalar one, and exit\n"
+		"  --merge-stress N  time 600 frames flipping between SHR and legacy every N lines, and exit\n"
+		"  --beam-bench N    time N full frames of each beam on the memory at the end of each recording,\n"
+		"                    check that they render the same vrams, and exit\n"
+		"  --ring-bench N    time N million packets through the SPSC packet ring and a ConcurrentQueue, and exit\n"
+		"  --mem-write N     time N million memory writes with the write tracking, and exit\n"
+		"  --ss-check        compare the softswitch action table against the original decoder, and exit\n"
+		"  --ss-bench        time both softswitch decoders on the recordings' $C0xx events, and exit\n"
+		"  --upload-check    check that the partial vram uploads cover every changed row, on synthetic changes\n"
+		"                    and on every frame of the recordings, with --pal and --merged in those variants too, and exit\n"
+		"  --class-check     compare the event class table against the original address compares, and exit\n"
+		"  --class-bench     time both event classifiers on the recordings' events, and exit\n"
+		"  --decode-check    compare the SIMD event decoder against the scalar one on the recordings' events\n"
+		"                    in Appletini transfers, with garbage and truncated tails, and exit\n"
+		"  --decode-bench    time both event decoders on those transfers, and exit\n"
+		"  --capture FILE    add a raw Appletini capture to the transfers of --decode-check and --decode-bench\n"
+		"  --snapshot-check  compare the RAM snapshots with full copies, with a reset mid-recording, and exit\n"
+		"  --snapshot-bench  time the RAM snapshots of 30 seconds of the first recording, and exit\n"
+		"  --vcr-check       reload the recordings through v2 and v1 files and compare them, and exit\n"
+		"  --vcr-bench       time saving and loading the recordings in v1 and v2 files, and exit\n"
+		"  --stream-bench N  stream N million events to disk segments, check their replay, and exit\n"
+		"  --softrender FILE render every frame on the CPU with A2SoftRenderer and compare the image hashes\n"
+		"                    with FILE, or rewrite it with --update, and exit\n"
+		"  --dump DIR        with --softrender, write the last image of each file as a PPM in DIR\n"
+		"  --frames FILE     write the hash of every frame to FILE\n"
+		"  --golden FILE     compare the hash of each recording's frames with FILE, exit 1 on mismatch\n"
+		"  --update          with --golden, rewrite FILE with the current hashes instead\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::string goldenPath;
+	std::string framesPath;
+	std::string softrenderPath;
+	std::string dumpDir;
+	bool bUpdate = false;
+	bool bSplit = true;
+	uint32_t repeat = 1;
+	uint32_t mergeStressLines = 0;
+	uint32_t beamBenchFrames = 0;
+	bool bSoftSwitchBench = false;
+	bool bClassBench = false;
+	bool bSnapshotBench = false;
+	bool bSnapshotCheck = false;
+	bool bVcrCheck = false;
+	bool bVcrBench = false;
+	bool bLazyCheck = false;
+	bool bUploadCheck = false;
+	bool bDecodeCheck = false;
+	bool bDecodeBench = false;
+	std::vector<std::string> captures;
+	uint32_t streamBenchEvents = 0;
+	std::vector<ReplayVariant> variants = { { "", false, false } };
+	std::vector<std::filesystem::path> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = (i + 1) < argc;
+		if (arg == "--golden" && hasValue)
+			goldenPath = argv[++i];
+		else if (arg == "--update")
+			bUpdate = true;
+		else if (arg == "--frames" && hasValue)
+			framesPath = argv[++i];
+		else if (arg == "--softrender" && hasValue)
+			softrenderPath = argv[++i];
+		else if (arg == "--dump" && hasValue)
+			dumpDir = argv[++i];
+		else if (arg == "--repeat" && hasValue)
+			repeat = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--merge-stress" && hasValue)
+			mergeStressLines = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--beam-bench" && hasValue)
+			beamBenchFrames = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--no-split")
+			bSplit = false;
+		else if (arg == "--batched")
+			bReplayBatched = true;
+		else if (arg == "--pal")
+			variants.push_back({ " (PAL)", true, false });
+		else if (arg == "--merged")
+			variants.push_back({ " (merged)", false, true });
+		else if (arg == "--lazy-check")
+			bLazyCheck = true;
+		else if (arg == "--upload-check")
+			bUploadCheck = true;
+		else if (arg == "--shr-scalar")
+			set_shr_expand_simd(false);
+		else if (arg == "--shr-check")
+		{
+			uint32_t mismatches = check_shr_expand_kernels(100'000);
+			std::cout << get_shr_expand_name() << " SHR kernels: " << mismatches << " mismatch(es) against scalar" << std::endl;
+			return (mismatches == 0 ? 0 : 1);
+		}
+		else if (arg == "--legacy-scalar")
+			set_legacy_expand_simd(false);
+		else if (arg == "--legacy-check")
+		{
+			uint32_t mismatches = check_legacy_expand_kernel(100'000);
+			std::cout << get_legacy_expand_name() << " legacy kernel: " << mismatches << " mismatch(es) against scalar" << std::endl;
+			return (mismatches == 0 ? 0 : 1);
+		}
+		else if (arg == "--ss-check")
+		{
+			uint32_t mismatches = check_softswitch_table();
+			std::cout << "Softswitch table: " << mismatches << " mismatch(es) against the original decoder" << std::endl;
+			return (mismatches == 0 ? 0 : 1);
+		}
+		else if (arg == "--ss-bench")
+			bSoftSwitchBench = true;
+		else if (arg == "--class-check")
+		{
+			uint32_t mismatches = check_event_classes();
+			std::cout << "Event class table: " << mismatches << " mismatch(es) against the original address compares" << std::endl;
+			return (mismatches == 0 ? 0 : 1);
+		}
+		else if (arg == "--class-bench")
+			bClassBench = true;
+		else if (arg == "--decode-check")
+			bDecodeCheck = true;
+		else if (arg == "--decode-bench")
+			bDecodeBench = true;
+		else if (arg == "--capture" && hasValue)
+			captures.push_back(argv[++i]);
+		else if (arg == "--snapshot-check")
+			bSnapshotCheck = true;
+		else if (arg == "--snapshot-bench")
+			bSnapshotBench = true;
+		else if (arg == "--vcr-check")
+			bVcrCheck = true;
+		else if (arg == "--vcr-bench")
+			bVcrBench = true;
+		else if (arg == "--stream-bench" && hasValue)
+			streamBenchEvents = (uint32_t)std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--ring-bench" && hasValue)
+		{
+			uint32_t errors = bench_packet_rings((uint32_t)std::max(1, std::atoi(argv[++i])) * 1'000'000);
+			return (errors == 0 ? 0 : 1);
+		}
+		else if (arg == "--mem-write" && hasValue)
+		{
+			bench_memory_writes((uint32_t)std::max(1, std::atoi(argv[++i])) * 1'000'000);
+			return 0;
+		}
+		else if (arg == "--help" || arg == "-h" || arg[0] == '-')
+		{
+			print_usage();
+			return (arg[0] == '-' && arg != "--help" && arg != "-h") ? 2 : 0;
+		}
+		else if (std::filesystem::is_directory(arg))
+			add_directory_files(arg, files);
+		else
+			files.push_back(arg);
+	}
+	if (files.empty() && mergeStressLines == 0)
+		files = default_recording_files();
+	if (files.empty() && mergeStressLines == 0)
+	{
+		std::cerr << "ERROR: No recordings to replay" << std::endl;
+		return 1;
+	}
+
+	// No window, no GL, and sound that goes nowhere. All before the singletons are created.
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	A2VideoManager::SetHeadless(true);
+	SDHRManager::SetHeadless(true);
+	SoundManager::GetInstance();
+
+	if (bLazyCheck)
+	{
+		uint32_t mismatches = check_lazy_beam(files, variants);
+		std::cout << "Lazy beam: " << mismatches << " mismatch(es) against the beam rendering every cycle" << std::endl;
+		return (mismatches == 0 ? 0 : 1);
+	}
+	if (!softrenderPath.empty())
+	{
+		uint32_t failures = run_softrender(files, softrenderPath, bUpdate, dumpDir);
+		if (failures > 0)
+			std::cout << failures << " failure(s)" << std::endl;
+		return (failures == 0 ? 0 : 1);
+	}
+	if (bUploadCheck)
+	{
+		uint32_t errors = check_vram_uploads(files, variants);
+		std::cout << "VRAM uploads: " << errors << " error(s)" << std::endl;
+		return (errors == 0 ? 0 : 1);
+	}
+	if (bSnapshotCheck)
+	{
+		uint32_t mismatches = check_ram_snapshots(files);
+		std::cout << "RAM snapshots: " << mismatches << " mismatch(es) against full copies" << std::endl;
+		return (mismatches == 0 ? 0 : 1);
+	}
+	if (bSnapshotBench)
+	{
+		bench_ram_snapshots(files[0]);
+		return 0;
+	}
+	if (bDecodeCheck || bDecodeBench)
+	{
+		DecodePackets input = make_decode_packets(files, captures);
+		if (bDecodeCheck)
+		{
+			uint32_t mismatches = check_event_decoders(input);
+			std::cout << get_event_decoder_name() << " event decoder: " << mismatches << " mismatch(es) against scalar" << std::endl;
+			if (mismatches != 0)
+				return 1;
+		}
+		if (bDecodeBench)
+			bench_event_decoders(input);
+		return 0;
+	}
+	if (bClassBench)
+	{
+		bench_event_classes(files);
+		return 0;
+	}
+	if (bSoftSwitchBench)
+	{
+		bench_softswitches(files);
+		return 0;
+	}
+	if (bVcrCheck)
+	{
+		uint32_t mismatches = check_vcr_files(files);
+		std::cout << "Recording files: " << mismatches << " mismatch(es) after reloading" << std::endl;
+		return (mismatches == 0 ? 0 : 1);
+	}
+	if (bVcrBench)
+	{
+		bench_vcr_files(files);
+		return 0;
+	}
+	if (streamBenchEvents > 0)
+	{
+		uint32_t mismatches = bench_stream_recorder(files, (uint64_t)streamBenchEvents * 1'000'000);
+		return (mismatches == 0 ? 0 : 1);
+	}
+
+	if (beamBenchFrames > 0)
+	{
+		uint32_t mismatches = 0;
+		for (const auto& path : files)
+		{
+			if (!load_recording(path))
+			{
+				++mismatches;
+				continue;
+			}
+			ReplayResult result;
+			replay_events(EventRecorder::GetInstance()->GetEvents(), result, nullptr);
+			std::cout << path.generic_string() << ": ";
+			if (!A2VideoManager::GetInstance()->BenchmarkBeam(beamBenchFrames))
+				++mismatches;
+		}
+		std::cout << "Beams: " << mismatches << " mismatch(es)" << std::endl;
+		return (mismatches == 0 ? 0 : 1);
+	}
+
+	// The merged mode stress runs on the memory of the first recording given, if any
+	if (mergeStressLines > 0)
+	{
+		if (!files.empty() && !load_recording(files[0]))
+			return 1;
+		reset_machine();
+		A2VideoManager::GetInstance()->BenchmarkMergedMode(mergeStressLines, 600);
+		return 0;
+	}
+
+	double profileInsideNs = 0;
+	double profileTotalNs = 0;
+	if (bSplit)
+		measure_profile_overhead(profileInsideNs, profileTotalNs);
+
+	std::map<std::string, uint64_t> goldens;
+	if (!goldenPath.empty() && !bUpdate)
+		goldens = read_golden_file(goldenPath);
+	std::ofstream framesFile;
+	if (!framesPath.empty())
+		framesFile.open(framesPath);
+
+	std::ostringstream goldenOut;
+	goldenOut << "# bench_replay frame hashes. Regenerate with: make bench-replay-update\n";
+	goldenOut << "# hash frames file\n";
+	uint32_t failures = 0;
+	uint64_t totalCycles = 0;
+	uint64_t totalNs = 0;
+	uint32_t replays = 0;
+	for (const auto& path : files)
+	{
+		if (!load_recording(path))
+		{
+			++failures;
+			continue;
+		}
+		const auto& recordedEvents = EventRecorder::GetInstance()->GetEvents();
+		for (const auto& variant : variants)
+		{
+			std::string pathStr = path.generic_string() + variant.suffix;
+			const std::vector<SDHREvent> mergedEvents = (variant.bMerged ? make_merged_events(recordedEvents) : std::vector<SDHREvent>());
+			const auto& events = (variant.bMerged ? mergedEvents : recordedEvents);
+
+			// Untimed by the profiler, for the throughput and the hashes
+			ReplayResult result;
+			std::vector<uint64_t> frameHashes;
+			replay_events(events, result, &frameHashes, variant.bPAL);
+			for (uint32_t r = 1; r < repeat; ++r)
+			{
+				ReplayResult repeatResult;
+				replay_events(events, repeatResult, nullptr, variant.bPAL);
+				if (repeatResult.hash != result.hash)
+					std::cerr << "WARNING: " << pathStr << " replays differently on pass " << (r + 1) << std::endl;
+				result.handlerNs = std::min(result.handlerNs, repeatResult.handlerNs);
+			}
+			++replays;
+			totalCycles += result.cycles;
+			totalNs += result.handlerNs;
+			if (framesFile.is_open())
+			{
+				for (size_t f = 0; f < frameHashes.size(); ++f)
+					framesFile << std::hex << std::setw(16) << std::setfill('0') << frameHashes[f] << std::dec
+						<< " " << f << " " << pathStr << "\n";
+			}
+
+			std::ostringstream hashStr;
+			hashStr << std::hex << std::setw(16) << std::setfill('0') << result.hash;
+			goldenOut << hashStr.str() << " " << result.frames << " " << pathStr << "\n";
+			std::string status;
+			if (!goldenPath.empty() && !bUpdate)
+			{
+				auto it = goldens.find(pathStr);
+				if (it == goldens.end())
+					status = "NO GOLDEN";
+				else if (it->second == result.hash)
+					status = "ok";
+				else
+					status = "MISMATCH";
+				if (status != "ok")
+					++failures;
+			}
+
+			double seconds = result.handlerNs / 1e9;
+			double cyclesPerSec = (seconds > 0 ? result.cycles / seconds : 0);
+			std::cout << hashStr.str() << " " << std::setw(6) << std::setfill(' ') << result.frames << " frames "
+				<< std::fixed << std::setprecision(2) << std::setw(8) << (cyclesPerSec / 1e6) << " Mcycles/s ("
+				<< std::setprecision(1) << (cyclesPerSec / _A2_CPU_FREQUENCY_NTSC) << "x real time) "
+				<< std::setprecision(1) << (result.frames > 0 ? result.handlerNs / 1e3 / result.frames : 0) << " us/frame "
+				<< result.cycles << " cycles  " << pathStr << (status.empty() ? "" : "  ") << status << std::endl;
+			if (bSplit)
+				print_split(events, profileInsideNs, profileTotalNs, variant.bPAL);
+		}
+	}
+	std::cout << "Total (" << get_shr_expand_name() << " SHR, " << get_legacy_expand_name() << " legacy kernels): " << replays << " replays of " << files.size() << " files, " << totalCycles << " cycles in "
+		<< std::fixed << std::setprecision(3) << (totalNs / 1e9) << " s, " << std::setprecision(2)
+		<< (totalNs > 0 ? (totalCycles / (totalNs / 1e9) / 1e6) : 0) << " Mcycles/s" << std::endl;
+
+	if (bUpdate && !goldenPath.empty())
+	{
+		std::ofstream file(goldenPath);
+		file << goldenOut.str();
+		std::cout << "Wrote " << goldenPath << std::endl;
+	}
+	if (failures > 0)
+	{
+		std::cout << failures << " failure(s)" << std::endl;
+		return 1;
+	}
+	return 0;
+}
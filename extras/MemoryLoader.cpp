@@ -14,6 +14,13 @@
 #include <locale.h>
 #include <sstream>
 
+// The loaders write to the memory directly, so they tell the MemoryManager what changed
+static void mark_loaded(const uint8_t* pMem, size_t size)
+{
+	auto memMgr = MemoryManager::GetInstance();
+	memMgr->MarkPagesWritten(pMem - memMgr->GetApple2MemPtr(), size);
+}
+
 bool MemoryLoad(const std::string &filePath, uint32_t position, bool bAuxBank, size_t fileSize) {
 	bool res = false;
 	
@@ -38,6 +45,7 @@ bool MemoryLoad(const std::string &filePath, uint32_t position, bool bAuxBank, s
 				fileSize = _A2_MEMORY_SHADOW_END - position;
 			file.seekg(0, std::ios::beg); // Go back to the start of the file
 			file.read(reinterpret_cast<char*>(pMem), fileSize);
+			mark_loaded(pMem, fileSize);
 			res = true;
 		}
 		file.close();
@@ -121,9 +129,11 @@ bool MemoryLoadLGR(const std::string& filePath)
 		file.seekg(0, std::ios::beg); // Go back to the start of the file
 		pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x400;
 		file.read(reinterpret_cast<char*>(pMem), 0x400);
+		mark_loaded(pMem, 0x400);
 		if (fileSize == 0x800) {	// interlace or page flip
 			pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x800;
 			file.read(reinterpret_cast<char*>(pMem), 0x400);
+			mark_loaded(pMem, 0x400);
 		}
 		res = true;
 	}
@@ -150,13 +160,17 @@ bool MemoryLoadDGR(const std::string& filePath)
 		// Read first the aux and then the main memory
 		pMem = MemoryManager::GetInstance()->GetApple2MemAuxPtr() + 0x400;
 		file.read(reinterpret_cast<char*>(pMem), 0x400);
+		mark_loaded(pMem, 0x400);
 		pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x400;
 		file.read(reinterpret_cast<char*>(pMem), 0x400);
+		mark_loaded(pMem, 0x400);
 		if (fileSize == 0x8000) {	// interlace or page flip
 			pMem = MemoryManager::GetInstance()->GetApple2MemAuxPtr() + 0x800;
 			file.read(reinterpret_cast<char*>(pMem), 0x400);
+			mark_loaded(pMem, 0x400);
 			pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x800;
 			file.read(reinterpret_cast<char*>(pMem), 0x400);
+			mark_loaded(pMem, 0x400);
 		}
 		res = true;
 	}
@@ -181,9 +195,11 @@ bool MemoryLoadHGR(const std::string &filePath) {
 		file.seekg(0, std::ios::beg); // Go back to the start of the file
 		pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x2000;
 		file.read(reinterpret_cast<char*>(pMem), 0x2000);
+		mark_loaded(pMem, 0x2000);
 		if (fileSize == 0x4000) {	// interlace or page flip
 			pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x4000;
 			file.read(reinterpret_cast<char*>(pMem), 0x2000);
+			mark_loaded(pMem, 0x2000);
 		}
 		res = true;
 	}
@@ -209,13 +225,17 @@ bool MemoryLoadDHR(const std::string &filePath) {
 		// Read first the aux and then the main memory
 		pMem = MemoryManager::GetInstance()->GetApple2MemAuxPtr() + 0x2000;
 		file.read(reinterpret_cast<char*>(pMem), 0x2000);
+		mark_loaded(pMem, 0x2000);
 		pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x2000;
 		file.read(reinterpret_cast<char*>(pMem), 0x2000);
+		mark_loaded(pMem, 0x2000);
 		if (fileSize == 0x8000) {	// interlace or page flip
 			pMem = MemoryManager::GetInstance()->GetApple2MemAuxPtr() + 0x4000;
 			file.read(reinterpret_cast<char*>(pMem), 0x2000);
+			mark_loaded(pMem, 0x2000);
 			pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x4000;
 			file.read(reinterpret_cast<char*>(pMem), 0x2000);
+			mark_loaded(pMem, 0x2000);
 		}
 		res = true;
 	}
@@ -240,9 +260,11 @@ bool MemoryLoadSHR(const std::string &filePath) {
 
 		file.seekg(0, std::ios::beg); // Go back to the start of the file
 		file.read(reinterpret_cast<char*>(pMem), 0x8000);
+		mark_loaded(pMem, 0x8000);
 		if (fileSize == 0x10000) {	// interlace or page flip
 			pMem = MemoryManager::GetInstance()->GetApple2MemPtr() + 0x2000;
 			file.read(reinterpret_cast<char*>(pMem), 0x8000);
+			mark_loaded(pMem, 0x8000);
 		}
 		res = true;
 	}
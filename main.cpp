@@ -24,6 +24,7 @@
 #include "MosaicMesh.h"
 
 #include "SDHRNetworking.h"
+#include "EventSource.h"
 #include "MemoryManager.h"
 #include "SDHRManager.h"
 #include "A2VideoManager.h"
@@ -34,6 +35,8 @@
 #include "extras/MemoryLoader.h"
 #include "extras/ImGuiFileDialog.h"
 #include "PostProcessor.h"
+#include "LatencyMonitor.h"
+#include "ThreadPlacement.h"
 #include "EventRecorder.h"
 #include "MainMenu.h"
 
@@ -71,6 +74,7 @@ bool bShouldRenderA2Video = true;	// Render the Apple 2 video buffer
 bool bA2VideoDidRender = false;		// Did the Apple 2 video render, or no need?
 bool bShouldPostProcess = false;	// Send to PP and possibly to flip the frame
 bool bShouldSwapFrame = true;		// After PP, frame should be swapped
+bool bWindowNeedsRedraw = true;		// The window lost its content, PP must draw the next frame even if static
 
 // OpenGL Debug callback function
 void GLAPIENTRY DebugCallbackKHR(GLenum source,
@@ -338,10 +342,52 @@ void Main_ResetA2SS() {
 }
 
 // Main code
+static void print_usage(const char* exe)
+{
+	std::cout << "Usage: " << exe << " [options]" << std::endl
+		<< "  --source <source>   Where the Apple 2 bus events come from:" << std::endl
+		<< "                        ftdi                              the Appletini (default)" << std::endl
+		<< "                        file:<path>[,unthrottled][,loop]  raw capture made with --capture" << std::endl
+		<< "                        tcp:<port>                        raw stream on 127.0.0.1:<port>" << std::endl
+		<< "                        unix:<path>                       raw stream on a Unix socket" << std::endl
+		<< "                        synthetic[,unthrottled]           generated HGR activity" << std::endl
+		<< "  --capture <path>    Save the raw incoming stream, for replay with file:<path>" << std::endl
+		<< "  --help              Show this help" << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
-	(void)argc;		// mark as unused
-	(void)argv;		// mark as unused
+	// Parse the command line before changing directories, so that relative paths work
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.rfind("-psn_", 0) == 0)
+			continue;	// process serial number added by older macOS Finder launches
+		if ((arg == "--source") && (i + 1 < argc))
+		{
+			std::string error;
+			EventSource* source = create_event_source(argv[++i], error);
+			if (source == nullptr)
+			{
+				std::cerr << "ERROR: " << error << std::endl;
+				return -1;
+			}
+			set_event_source(source);
+		}
+		else if ((arg == "--capture") && (i + 1 < argc))
+		{
+			if (!set_ingest_capture_file(argv[++i]))
+			{
+				std::cerr << "ERROR: Cannot create capture file " << argv[i] << std::endl;
+				return -1;
+			}
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return (arg == "--help" ? 0 : -1);
+		}
+	}
 #if defined(__NETWORKING_APPLE__) || defined (__NETWORKING_LINUX__)
 	// when double-clicking the app, change to its working directory
 	char *dir = dirname(strdup(argv[0]));
@@ -537,6 +583,18 @@ int main(int argc, char* argv[])
 		if (settingsState.contains("Mockingboard")) {
 			mockingboardManager->DeserializeState(settingsState["Mockingboard"]);
 		}
+		if (settingsState.contains("Threads")) {
+			ThreadPlacement::GetInstance()->DeserializeState(settingsState["Threads"]);
+		}
+		if (settingsState.contains("Recorder")) {
+			eventRecorder->DeserializeState(settingsState["Recorder"]);
+		}
+		if (settingsState.contains("Appletini")) {
+			auto _st = settingsState["Appletini"];
+			set_usb_transfer_depth(_st.value("usb transfers in flight", get_usb_transfer_depth()));
+			set_usb_transfer_size(_st.value("usb transfer size", get_usb_transfer_size()));
+			set_consumer_wait_policy((ConsumerWaitPolicy_e)_st.value("consumer wait policy", (int)get_consumer_wait_policy()));
+		}
 		if (settingsState.contains("Main")) {
 			SDL_GetWindowPosition(window, &g_wx, &g_wy);
 			SDL_GetWindowSize(window, &g_ww, &g_wh);
@@ -596,6 +654,13 @@ int main(int argc, char* argv[])
 	if (bDisplayFPSOnScreen)
 		Main_DrawFPSOverlay();
 
+	// Place the pipeline threads as configured. The other threads place themselves when they start.
+	auto threadPlacement = ThreadPlacement::GetInstance();
+	threadPlacement->ApplyMemoryLock();
+	threadPlacement->ApplyToCurrentThread(PipelineThread_e::RENDER);
+
+	// The packet pool is filled before either side of its rings runs
+	clear_queues();
 	// Run the network thread that will update the internal state as well as the apple 2 memory
 	std::thread thread_server(usb_server_thread, &bShouldTerminateNetworking);
 	// And run the processing thread
@@ -646,6 +711,8 @@ int main(int argc, char* argv[])
 						g_wh = event.window.data2;
 					}
 				}
+				if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+					bWindowNeedsRedraw = true;
 				if (event.window.event == SDL_WINDOWEVENT_MOVED) {
 					if (!Main_IsFullScreen())
 					{
@@ -763,20 +830,25 @@ int main(int argc, char* argv[])
 							window_bgcolor[2],
 							window_bgcolor[3]);
 						glClear(GL_COLOR_BUFFER_BIT);
-						postProcessor->Render(window, A2VIDEO_TEX_UNIT, a2VideoManager->ScreenSize().y);
+						// ImGui draws over the PP output, so PP must draw it when ImGui is on
+						postProcessor->Render(window, A2VIDEO_TEX_UNIT, a2VideoManager->ScreenSize().y,
+							bA2VideoDidRender || Main_IsImGuiOn() || bWindowNeedsRedraw);
+						bWindowNeedsRedraw = false;
+						if (!Main_IsImGuiOn())
+						{
+							if ((SDL_GetTicks() - lastMouseMoveTime) > cursorHideDelay)
+								SDL_ShowCursor(SDL_DISABLE);
+							else
+								SDL_ShowCursor(SDL_ENABLE);
+						}
 						if (!postProcessor->ShouldFrameBeSkipped())
 						{
 							if (Main_IsImGuiOn())
 							{
 								menu->Render();
 							}
-							else {
-								if ((SDL_GetTicks() - lastMouseMoveTime) > cursorHideDelay)
-									SDL_ShowCursor(SDL_DISABLE);
-								else
-									SDL_ShowCursor(SDL_ENABLE);
-							}
 							SDL_GL_SwapWindow(window);
+							LATENCY_FRAME_STAGE(LatencyStage_e::SWAP);
 							fps_frame_count++;
 						}
 					}
@@ -809,15 +881,30 @@ int main(int argc, char* argv[])
 			// Now run the postprocessing (not for IsSwapApple2Bus)
 			if (!bIsSwapApple2Bus)
 			{
-				postProcessor->Render(window, A2VIDEO_TEX_UNIT, a2VideoManager->ScreenSize().y);
+				// ImGui draws over the PP output, so PP must draw it when ImGui is on
+				postProcessor->Render(window, A2VIDEO_TEX_UNIT, a2VideoManager->ScreenSize().y,
+					bA2VideoDidRender || Main_IsImGuiOn() || bWindowNeedsRedraw);
+				bWindowNeedsRedraw = false;
 			}
 
 			// Determine if frame should be swapped, or nothing done
 			// Do that after the postprocessing phase, because PP may
-			// be asking to skip a frame for merging even/odd frames
+			// be asking to skip a frame for merging even/odd frames,
+			// or because the screen is static
 			if (postProcessor->ShouldFrameBeSkipped())
 				bShouldSwapFrame = false;	// PP asking to not display the frame
 
+			if (!Main_IsImGuiOn())
+			{
+				// Disable mouse if unused after cursorHideDelay
+				// It's possible that the cursor won't get disabled when in windowed mode
+				// (MacOS doesn't allow this, for example)
+				if ((SDL_GetTicks() - lastMouseMoveTime) > cursorHideDelay)
+					SDL_ShowCursor(SDL_DISABLE);
+				else
+					SDL_ShowCursor(SDL_ENABLE);
+			}
+
 			if (bShouldSwapFrame)
 			{
 				// This frame will be shown, so update ImGui and swap
@@ -825,16 +912,8 @@ int main(int argc, char* argv[])
 				{
 					menu->Render();
 				}
-				else {
-					// Disable mouse if unused after cursorHideDelay
-					// It's possible that the cursor won't get disabled when in windowed mode
-					// (MacOS doesn't allow this, for example)
-					if ((SDL_GetTicks() - lastMouseMoveTime) > cursorHideDelay)
-						SDL_ShowCursor(SDL_DISABLE);
-					else
-						SDL_ShowCursor(SDL_ENABLE);
-				}
 				SDL_GL_SwapWindow(window);
+				LATENCY_FRAME_STAGE(LatencyStage_e::SWAP);
 				fps_frame_count++;
 			}
 		}	// !bIsSwapApple2Bus
@@ -853,11 +932,13 @@ int main(int argc, char* argv[])
 			else
 				_newfpsLimit = 60;			// set a fixed 60 fps, no need for more
 		}
+		else if (postProcessor->IsFrameUnchanged())
+			_newfpsLimit = 60;				// static screen: there was no swap to wait for the VSYNC
 		if (_newfpsLimit != UINT32_MAX)
 		{
 			float _frameTicks = pfreq / (float)g_fpsLimit;
 			float _regionFps = (a2VideoManager->GetCurrentRegion() == VideoRegion_e::NTSC ? 59.95 : 50.00);
-			if (g_swapInterval == SWAPINTERVAL_APPLE2BUS)
+			if (g_swapInterval != SWAPINTERVAL_NONE)
 				_frameTicks = pfreq / _regionFps;
 			uint64_t _elapsedTicks;
 			uint32_t delayMs;
@@ -921,6 +1002,7 @@ int main(int argc, char* argv[])
 	thread_processor.join();
 	bShouldTerminateNetworking = true;
 	thread_server.join();
+	eventRecorder->FinishStreaming();
 
 	// Serialize settings and save them
 	{
@@ -935,6 +1017,13 @@ int main(int argc, char* argv[])
 		settingsState["Apple 2 Video"] = a2VideoManager->SerializeState();
 		settingsState["Sound"] = soundManager->SerializeState();
 		settingsState["Mockingboard"] = mockingboardManager->SerializeState();
+		settingsState["Threads"] = threadPlacement->SerializeState();
+		settingsState["Recorder"] = eventRecorder->SerializeState();
+		settingsState["Appletini"] = {
+			{"usb transfers in flight", get_usb_transfer_depth()},
+			{"usb transfer size", get_usb_transfer_size()},
+			{"consumer wait policy", (int)get_consumer_wait_policy()},
+		};
 		settingsState["Main"] = {
 			{"display index", SDL_GetWindowDisplayIndex(window)},
 			{"window x", _wx},